@@ -0,0 +1 @@
+../../ultra96v2_pynq_dpu/software/inference_code/inference_cpp.py
\ No newline at end of file
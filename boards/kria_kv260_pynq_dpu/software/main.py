@@ -26,7 +26,8 @@ def arg_to_name(class_file, inference_result, inference_result_name):
 
 # Init
 overlay = DpuOverlay("../dpu.bit")
-overlay.load_model("../kv260_tipu12.xmodel")
+xmodel_file = "../kv260_tipu12.xmodel"
+overlay.load_model(xmodel_file)
 
 image_folder = "/path/to/image/folder"
 class_file = "/path/to/class/file"
@@ -41,13 +42,22 @@ num_thread = 4
 
 show_all_info = False
 evaluate_on_thread_range = True
+# Preprocessing and inference in C++ (tipu_dpu module, see inference_cpp.py)
+use_cpp = False
+manifest_file = "tipu12.manifest"
+
+def run_test(num_thread):
+    if use_cpp==True:
+        from inference_cpp import test_accuracy_cpp
+        return test_accuracy_cpp(manifest_file, xmodel_file, image_folder, num_thread, show_all_info, inference_result)
+    return test_accuracy(overlay, image_folder, num_thread, show_all_info, class_file, inference_result)
 
 if evaluate_on_thread_range==True:
     for i in range(num_thread):
-        predictions_list = test_accuracy(overlay, image_folder, i+1, show_all_info, class_file, inference_result)
+        predictions_list = run_test(i+1)
         
 else:
-    predictions_list = test_accuracy(overlay, image_folder, num_thread, show_all_info, class_file, inference_result)
+    predictions_list = run_test(num_thread)
     
 # Convert args into names
 arg_to_name(class_file, inference_result, inference_result_name)
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "cascade.h"
+#include "kernels.h"
+#include "model_manifest.h"
+
+using namespace std;
+
+// g++ -O2 -std=c++17 -DMOCK_VART -DCOUNT_ALLOCATIONS -o alloc_bench alloc_bench.cpp alloc_counter.cpp cascade.cpp kernels.cpp model_manifest.cpp power_meter.cpp -lpthread
+
+static long run_images(RunnerPool& pool, const ModelKernels& kernels, const vector<uint8_t>& images, int n_images,
+                       vector<int8_t>& input, vector<int8_t>& output, int* n_correct) {
+    /*
+        Heap allocations to preprocess, run and classify n_images, as
+        main.cpp does with a RunnerPool. The classes are only counted so that
+        the work is not optimized away.
+    */
+    int image_bytes = kernels.input_size();
+    long before = alloc_count();
+    for (int i = 0; i < n_images; i++) {
+        kernels.preprocess(images.data() + (size_t)i * image_bytes, input.data() + (size_t)i * image_bytes);
+    }
+    atomic<int> next_index(0);
+    pool.run(input.data(), pool.input_scale(), [&](int* indices, int max) {
+        int n = 0;
+        while (n < max) {
+            int index = next_index++;
+            if (index >= n_images) {
+                break;
+            }
+            indices[n++] = index;
+        }
+        return n;
+    }, output.data());
+    *n_correct = 0;
+    for (int i = 0; i < n_images; i++) {
+        *n_correct += kernels.classify(output.data() + (size_t)i * pool.output_size(), pool.output_scale()) == i % kernels.n_classes();
+    }
+    return alloc_count() - before;
+}
+
+static long run_images_on_runner(vart::Runner* runner, const vector<int8_t>& input, vector<int8_t>& output, int n_images) {
+    // The threads of main without a pool (runDPU): the allocations of the thread after its first image
+    run_on_runner(runner, input.data(), output.data(), 0, 1);
+    long before = thread_alloc_count();
+    run_on_runner(runner, input.data(), output.data(), 1, n_images);
+    return thread_alloc_count() - before;
+}
+
+int main(int argc, char* argv[]) {
+    /*
+        The same loop over n and 2n images: the allocations of a run (its
+        threads, the first batch) do not depend on the number of images, so
+        the difference must be 0 once the runners are warmed up.
+    */
+    int n_images = argc > 1 ? atoi(argv[1]) : 500;
+    int n_runners = argc > 2 ? atoi(argv[2]) : 2;
+    int batch = argc > 3 ? atoi(argv[3]) : 1;
+    if (n_images <= 0 || n_runners <= 0 || batch <= 0) {
+        printf("Usage: %s [n_images] [n_runners] [batch]\n", argv[0]);
+        return 1;
+    }
+
+    if (alloc_count() < 0) {
+        printf("[ERROR] The allocations are not counted: build with -DCOUNT_ALLOCATIONS\n");
+        return 1;
+    }
+
+    ModelManifest manifest = default_model_manifest();
+    ModelKernels kernels(manifest, 64);
+    int image_bytes = kernels.input_size();
+    xir::Subgraph subgraph("subgraph_mock", xir::Tensor("input", {batch, manifest.height, manifest.width, 3}, 6),
+                           xir::Tensor("output", {batch, kernels.n_classes()}, 2), 100);
+    vector<unique_ptr<vart::Runner>> owned;
+    vector<vart::Runner*> runners;
+    for (int i = 0; i < n_runners; i++) {
+        owned.push_back(vart::Runner::create_runner(&subgraph, "run"));
+        runners.push_back(owned.back().get());
+    }
+    RunnerPool pool(runners);
+
+    vector<uint8_t> images((size_t)2 * n_images * image_bytes);
+    uint32_t state = 1;
+    for (auto& v : images) {
+        state = state * 1664525u + 1013904223u;
+        v = state >> 24;
+    }
+    vector<int8_t> input(images.size()), output((size_t)2 * n_images * pool.output_size());
+
+    int n_correct;
+    run_images(pool, kernels, images, 8, input, output, &n_correct);
+    long rss = current_rss_kb();
+    long once = run_images(pool, kernels, images, n_images, input, output, &n_correct);
+    long twice = run_images(pool, kernels, images, 2 * n_images, input, output, &n_correct);
+    printf("%d runners, batch %d: %ld allocations for %d images, %ld for %d images (%.3f per image)\n", n_runners,
+           batch, once, n_images, twice, 2 * n_images, (double)(twice - once) / n_images);
+    printf("RSS: %.1f MB after the warm-up, %.1f MB now, peak %.1f MB\n", rss / 1024.0, current_rss_kb() / 1024.0,
+           peak_rss_kb() / 1024.0);
+
+    // runDPU: one image per job on a runner of batch 1
+    xir::Subgraph single("subgraph_single", xir::Tensor("input", {1, manifest.height, manifest.width, 3}, 6),
+                         xir::Tensor("output", {1, kernels.n_classes()}, 2), 100);
+    auto runner = vart::Runner::create_runner(&single, "run");
+    long single_once = run_images_on_runner(runner.get(), input, output, n_images);
+    long single_twice = run_images_on_runner(runner.get(), input, output, 2 * n_images);
+    printf("runDPU: %ld allocations for %d images, %ld for %d images\n", single_once, n_images, single_twice, 2 * n_images);
+    if (twice != once || single_twice != single_once) {
+        printf("[ERROR] The steady state allocates\n");
+        return 1;
+    }
+    printf("[SUCCESS] No allocation per image, with the runner pool and with runDPU\n");
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <errno.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "alloc_counter.h"
+
+#ifdef COUNT_ALLOCATIONS
+
+/*
+    The allocation functions of glibc, called by the interposed ones. The
+    counters are plain integers: they must not allocate themselves, and the
+    thread counter is in the static TLS of the executable.
+*/
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void* __libc_valloc(size_t size);
+void* __libc_pvalloc(size_t size);
+void __libc_free(void* ptr);
+}
+
+static std::atomic<long> allocations{0};
+static std::atomic<long> allocated_bytes{0};
+static __thread long thread_allocations = 0;
+
+static inline void count(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    thread_allocations++;
+}
+
+extern "C" {
+
+void* malloc(size_t size) {
+    count(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+    count(n * size);
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    count(size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    count(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    count(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    count(size);
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr == NULL ? ENOMEM : 0;
+}
+
+void* valloc(size_t size) {
+    count(size);
+    return __libc_valloc(size);
+}
+
+void* pvalloc(size_t size) {
+    count(size);
+    return __libc_pvalloc(size);
+}
+
+}  // extern "C"
+
+long alloc_count() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+long thread_alloc_count() {
+    return thread_allocations;
+}
+
+long alloc_bytes() {
+    return allocated_bytes.load(std::memory_order_relaxed);
+}
+
+#else
+
+// Not counted: malloc is the one of glibc
+long alloc_count() {
+    return -1;
+}
+
+long thread_alloc_count() {
+    return -1;
+}
+
+long alloc_bytes() {
+    return -1;
+}
+
+#endif // COUNT_ALLOCATIONS
+
+long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+long current_rss_kb() {
+    // Second field of statm, in pages
+    long pages = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file != NULL) {
+        if (fscanf(file, "%*s %ld", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(file);
+    }
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
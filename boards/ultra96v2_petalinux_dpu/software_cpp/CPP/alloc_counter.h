@@ -0,0 +1,31 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+/*
+    Count of the heap allocations of the process, to check that the hot
+    loops do not allocate once warmed up. Built with -DCOUNT_ALLOCATIONS,
+    alloc_counter.cpp interposes malloc, calloc, realloc, valloc, pvalloc
+    and the aligned allocations of glibc (new and the allocators of OpenCV
+    end there), so linking it is enough to count them; the counters are read
+    before and after a loop:
+
+        long before = thread_alloc_count();
+        ... process the images ...
+        long allocations = thread_alloc_count() - before;
+
+    Without COUNT_ALLOCATIONS nothing is interposed and the counters are -1.
+    The RSS is measured in both builds.
+*/
+
+// Allocations since the start of the process, in all the threads
+long alloc_count();
+// Allocations of the calling thread
+long thread_alloc_count();
+// Bytes requested by these allocations
+long alloc_bytes();
+
+// Peak resident set size of the process in kB (ru_maxrss), and the current one
+long peak_rss_kb();
+long current_rss_kb();
+
+#endif // ALLOC_COUNTER_H
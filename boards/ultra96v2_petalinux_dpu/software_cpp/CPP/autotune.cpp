@@ -0,0 +1,206 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "autotune.h"
+
+using namespace std;
+
+TuneOptions default_tune_options() {
+    TuneOptions options;
+    options.objective = "fps";
+    options.max_threads = 4;
+    options.max_depth = 4;
+    options.min_gain = 0.03;
+    return options;
+}
+
+static double score(const string& objective, double fps, double watts) {
+    if (objective == "fpsw") {
+        return watts > 0 ? fps / watts : 0;
+    }
+    return fps;
+}
+
+int autotune(const TuneOptions& options, const TunePass& pass, TuneProfile* best) {
+    /*
+        best_depth is the best configuration of the current depth, best the
+        best of all. The depth 1 is always tried after the host buffers:
+        zero-copy is another mode, not one more step of the same one.
+    */
+    cout << "Threads  Buffers       FPS        W    FPS/W" << endl;
+    best->threads = 0;
+    best->zero_copy_depth = 0;
+    best->objective = options.objective;
+    best->fps = best->watts = 0;
+    double best_score = 0, previous_depth_score = 0;
+    int n_passes = 0;
+    for (int depth = 0; depth <= options.max_depth; depth++) {
+        TuneProfile best_depth = {0, depth, options.objective, 0, 0};
+        double best_depth_score = 0;
+        for (int threads = 1; threads <= options.max_threads; threads++) {
+            double fps = 0, watts = 0;
+            if (pass(threads, depth, &fps, &watts) != 0) {
+                break;
+            }
+            n_passes++;
+            double s = score(options.objective, fps, watts);
+            cout << setw(7) << threads << "  " << setw(7) << (depth == 0 ? string("host") : "ring " + to_string(depth))
+                 << fixed << setprecision(2) << setw(10) << fps << setw(9) << watts << setw(9)
+                 << (watts > 0 ? fps / watts : 0.0) << endl;
+            if (s > best_depth_score * (1 + options.min_gain)) {
+                best_depth_score = s;
+                best_depth.threads = threads;
+                best_depth.fps = fps;
+                best_depth.watts = watts;
+            } else {
+                // More runners do not help at this depth
+                break;
+            }
+        }
+        if (best_depth.threads == 0) {
+            // This depth cannot run, nor the deeper ones
+            break;
+        }
+        if (best_depth_score > best_score * (1 + options.min_gain)) {
+            best_score = best_depth_score;
+            *best = best_depth;
+        }
+        if (depth >= 2 && best_depth_score <= previous_depth_score * (1 + options.min_gain)) {
+            // A deeper ring does not help
+            break;
+        }
+        if (depth >= 1) {
+            previous_depth_score = max(previous_depth_score, best_depth_score);
+        }
+    }
+    return best->threads > 0 ? n_passes : -1;
+}
+
+static string read_line(const string& path) {
+    // The model of the device tree ends with a NUL
+    char line[256] = "";
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        return "";
+    }
+    size_t n = fread(line, 1, sizeof(line) - 1, file);
+    fclose(file);
+    line[n] = '\0';
+    line[strcspn(line, "\r\n")] = '\0';
+    return line;
+}
+
+static string trim(const string& s) {
+    size_t first = s.find_first_not_of(" \t\r\n");
+    size_t last = s.find_last_not_of(" \t\r\n");
+    return first == string::npos ? "" : s.substr(first, last - first + 1);
+}
+
+static string slug(const string& s) {
+    // Lowercase letters and digits, the rest as single underscores
+    string out;
+    for (char c : s) {
+        if (isalnum((unsigned char)c)) {
+            out += tolower((unsigned char)c);
+        } else if (!out.empty() && out.back() != '_') {
+            out += '_';
+        }
+    }
+    while (!out.empty() && out.back() == '_') {
+        out.pop_back();
+    }
+    return out.empty() ? "board" : out;
+}
+
+string board_name() {
+    string name = trim(read_line("/proc/device-tree/model"));
+    if (name.empty()) {
+        name = trim(read_line("/sys/class/dmi/id/product_name"));
+    }
+    if (name.empty()) {
+        char host[256] = "";
+        gethostname(host, sizeof(host) - 1);
+        name = host;
+    }
+    return name;
+}
+
+string default_profile_path(const string& xmodel) {
+    string model = xmodel.substr(xmodel.rfind('/') + 1);
+    model = model.substr(0, model.rfind('.'));
+    return "profiles/" + slug(board_name()) + "_" + slug(model) + ".profile";
+}
+
+int load_profile(const string& path, const string& xmodel, TuneProfile* profile) {
+    ifstream file(path);
+    if (!file) {
+        return -1;
+    }
+    TuneProfile loaded = {0, 0, "fps", 0, 0};
+    string line, profile_xmodel;
+    while (getline(file, line)) {
+        line = trim(line.substr(0, line.find('#')));
+        size_t equal = line.find('=');
+        if (line.empty() || equal == string::npos) {
+            continue;
+        }
+        string key = trim(line.substr(0, equal)), value = trim(line.substr(equal + 1));
+        if (key == "xmodel") {
+            profile_xmodel = value;
+        } else if (key == "objective") {
+            loaded.objective = value;
+        } else if (key == "threads") {
+            loaded.threads = atoi(value.c_str());
+        } else if (key == "zerocopy") {
+            loaded.zero_copy_depth = atoi(value.c_str());
+        } else if (key == "fps") {
+            loaded.fps = atof(value.c_str());
+        } else if (key == "watts") {
+            loaded.watts = atof(value.c_str());
+        }
+    }
+    if (profile_xmodel != xmodel) {
+        cerr << "[WARNING] The profile " << path << " was made for " << profile_xmodel << ", not " << xmodel << endl;
+        return -1;
+    }
+    if (loaded.threads < 1 || loaded.zero_copy_depth < 0) {
+        cerr << "[ERROR] No configuration in the profile " << path << endl;
+        return -1;
+    }
+    *profile = loaded;
+    return 0;
+}
+
+int save_profile(const string& path, const string& xmodel, const TuneProfile& profile) {
+    size_t slash = path.rfind('/');
+    if (slash != string::npos && slash > 0) {
+        mkdir(path.substr(0, slash).c_str(), 0755);
+    }
+    ofstream file(path);
+    if (!file) {
+        cerr << "[ERROR] Could not write the profile " << path << endl;
+        return -1;
+    }
+    time_t now = time(NULL);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M", localtime(&now));
+    file << "# Auto-tuned on " << date << ", read by ./main when n_threads is auto" << endl;
+    file << "board = " << board_name() << endl;
+    file << "xmodel = " << xmodel << endl;
+    file << "objective = " << profile.objective << endl;
+    file << "threads = " << profile.threads << endl;
+    file << "zerocopy = " << profile.zero_copy_depth << endl;
+    file << fixed << setprecision(2) << "fps = " << profile.fps << endl;
+    file << "watts = " << profile.watts << endl;
+    return file.good() ? 0 : -1;
+}
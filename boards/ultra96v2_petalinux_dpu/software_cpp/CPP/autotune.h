@@ -0,0 +1,62 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <functional>
+#include <string>
+
+/*
+    Search of the configuration of the driver that gives the highest FPS, or
+    FPS per watt, on this board, by short calibration passes over a sample
+    of the images. The pass is given by the caller: it runs the sample with
+    a number of runners (threads) and a zero-copy ring depth (the runners
+    in flight per thread, 0 for the host buffers of runDPU) and returns the
+    FPS and the average power.
+    For each depth (host buffers, then zero-copy rings of 1, 2, ...) the
+    runners are added one at a time, and the search stops adding them when
+    the score does not gain min_gain; the depths stop the same way. A
+    configuration is only preferred to a smaller one if it gains min_gain,
+    so the noise of the measures does not add runners for nothing.
+
+    The result is saved as a profile of the board and model, read on the
+    later runs:
+
+        board = Avnet Ultra96-V2 Rev1
+        xmodel = /home/root/.../ultra96v2_tipu12.xmodel
+        objective = fps
+        threads = 3
+        zerocopy = 2
+*/
+
+typedef struct {
+    int threads;
+    int zero_copy_depth;        // 0 for the host buffers
+    std::string objective;      // "fps" or "fpsw"
+    double fps;                 // Measured in the calibration pass
+    double watts;               // 0 when not measured
+} TuneProfile;
+
+typedef struct {
+    std::string objective;      // "fps" or "fpsw"
+    int max_threads;
+    int max_depth;              // Deepest zero-copy ring, 0 for the host buffers only
+    double min_gain;            // Relative gain under which the search stops in a direction
+} TuneOptions;
+
+TuneOptions default_tune_options();
+
+// Calibration pass: 0 and the FPS and watts (0 if not measured), -1 if the configuration cannot run
+typedef std::function<int(int threads, int depth, double* fps, double* watts)> TunePass;
+
+// Search and print a line per pass. Returns the number of passes, -1 if none succeeded
+int autotune(const TuneOptions& options, const TunePass& pass, TuneProfile* best);
+
+// Model of the device tree, else the DMI product name, else the hostname
+std::string board_name();
+// profiles/<board>_<model>.profile, relative to the working directory
+std::string default_profile_path(const std::string& xmodel);
+
+// -1 when the profile is missing or was made for another model
+int load_profile(const std::string& path, const std::string& xmodel, TuneProfile* profile);
+int save_profile(const std::string& path, const std::string& xmodel, const TuneProfile& profile);
+
+#endif // AUTOTUNE_H
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+#include "autotune.h"
+
+using namespace std;
+
+// g++ -O2 -std=c++17 -o autotune_bench autotune_bench.cpp autotune.cpp
+
+#define MAX_THREADS     4
+#define MAX_DEPTH       4
+#define NOISE           0.015   // Relative noise of a calibration pass
+
+/*
+    The passes of the driver on a model of a board, instead of the DPU:
+    - host buffers (depth 0): the images are preprocessed by one thread
+      before the run, then each runner copies its image (copy_ms), submits
+      the job and waits for it;
+    - zero-copy ring of depth d: each runner preprocesses into the buffers
+      of its ring while the d jobs of the ring run;
+    - the DPU has dpu_cores cores of dpu_ms per image, and loses some of its
+      throughput with each job in flight beyond 2 per core (scheduling,
+      memory bandwidth);
+    - power: static + busy CPU cores + busy DPU + each runner in flight.
+*/
+typedef struct {
+    double prep_ms, copy_ms, job_ms, dpu_ms;
+    int dpu_cores, cpu_cores;
+    double static_w, core_w, dpu_w, runner_w;
+} BoardModel;
+
+static void model_pass(const BoardModel& m, int threads, int depth, double* fps, double* watts) {
+    int in_flight = threads * max(depth, 1);
+    double efficiency = 1 / (1 + 0.03 * max(0, in_flight - 2 * m.dpu_cores));
+    double dpu_rate = m.dpu_cores / m.dpu_ms * efficiency;     // Images per ms
+    double cpu_ms = depth == 0 ? m.copy_ms + m.job_ms : m.prep_ms + m.job_ms;
+    double latency_rate = threads * max(depth, 1) / (cpu_ms + m.dpu_ms);
+    double cpu_rate = min(threads, m.cpu_cores) / cpu_ms;
+    double rate = min(latency_rate, min(dpu_rate, cpu_rate));
+    double run_w = m.static_w + m.core_w * rate * cpu_ms + m.dpu_w * rate * m.dpu_ms / m.dpu_cores + m.runner_w * in_flight;
+    if (depth == 0) {
+        // Preprocessing before the run, on one core
+        double image_ms = m.prep_ms + 1 / rate;
+        double joules = m.prep_ms * (m.static_w + m.core_w) + run_w / rate;
+        *fps = 1000 / image_ms;
+        *watts = joules / image_ms;
+    } else {
+        *fps = 1000 * rate;
+        *watts = run_w;
+    }
+}
+
+static double score(const string& objective, double fps, double watts) {
+    return objective == "fpsw" ? fps / watts : fps;
+}
+
+static bool run_objective(const BoardModel& model, const string& objective) {
+    printf("\nObjective %s\n", objective.c_str());
+    mt19937 random(42);
+    uniform_real_distribution<double> noise(-NOISE, NOISE);
+    TuneOptions options = default_tune_options();
+    options.objective = objective;
+    options.max_threads = MAX_THREADS;
+    options.max_depth = MAX_DEPTH;
+    TuneProfile best;
+    int n_passes = autotune(options, [&](int threads, int depth, double* fps, double* watts) {
+        model_pass(model, threads, depth, fps, watts);
+        *fps *= 1 + noise(random);
+        *watts *= 1 + noise(random);
+        return 0;
+    }, &best);
+    if (n_passes < 0) {
+        printf("[ERROR] No configuration found\n");
+        return false;
+    }
+
+    // All the configurations, without the noise
+    double fps, watts, best_score = 0, chosen_score;
+    int best_threads = 0, best_depth = 0;
+    for (int depth = 0; depth <= MAX_DEPTH; depth++) {
+        for (int threads = 1; threads <= MAX_THREADS; threads++) {
+            model_pass(model, threads, depth, &fps, &watts);
+            if (score(objective, fps, watts) > best_score) {
+                best_score = score(objective, fps, watts);
+                best_threads = threads;
+                best_depth = depth;
+            }
+        }
+    }
+    model_pass(model, best.threads, best.zero_copy_depth, &fps, &watts);
+    chosen_score = score(objective, fps, watts);
+    int n_configurations = MAX_THREADS * (MAX_DEPTH + 1);
+    printf("Chosen: %d threads, depth %d, %.2f %s in %d passes. Best of the %d configurations: %d threads, depth %d, %.2f\n",
+           best.threads, best.zero_copy_depth, chosen_score, objective == "fpsw" ? "FPS/W" : "FPS", n_passes,
+           n_configurations, best_threads, best_depth, best_score);
+    if (chosen_score < best_score * (1 - 2 * options.min_gain) || n_passes >= n_configurations) {
+        printf("[ERROR] The search is %.1f%% under the best configuration with %d passes\n",
+               100 * (1 - chosen_score / best_score), n_passes);
+        return false;
+    }
+    return true;
+}
+
+static bool check_profile() {
+    char dir[] = "/tmp/autotune_XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        printf("[ERROR] Cannot create a directory for the profile\n");
+        return false;
+    }
+    string path = string(dir) + "/profiles/board.profile";
+    string xmodel = "/home/root/Vitis-AI/demo/VART/resnet50_mt_py/ultra96v2_tipu12.xmodel";
+    TuneProfile saved = {3, 2, "fpsw", 231.5, 5.25}, loaded;
+    bool ok = save_profile(path, xmodel, saved) == 0 && load_profile(path, xmodel, &loaded) == 0 &&
+              loaded.threads == saved.threads && loaded.zero_copy_depth == saved.zero_copy_depth &&
+              loaded.objective == saved.objective;
+    // Another model does not take this profile
+    ok = ok && load_profile(path, "other.xmodel", &loaded) != 0;
+    printf("\nProfile %s for %s (%s): %s\n", path.c_str(), board_name().c_str(), default_profile_path(xmodel).c_str(),
+           ok ? "read back" : "wrong");
+    unlink(path.c_str());
+    rmdir((string(dir) + "/profiles").c_str());
+    rmdir(dir);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    double dpu_ms = argc > 1 ? atof(argv[1]) : 8;
+    int dpu_cores = argc > 2 ? atoi(argv[2]) : 2;
+    double prep_ms = argc > 3 ? atof(argv[3]) : 2;
+    if (dpu_ms <= 0 || dpu_cores < 1 || prep_ms <= 0) {
+        printf("Usage: %s [DPU ms per image] [DPU cores] [preprocessing ms per image]\n", argv[0]);
+        return 1;
+    }
+    BoardModel model = {prep_ms, 1.5, 0.3, dpu_ms, dpu_cores, 4, 3.5, 0.4, 2.0, 0.1};
+    printf("Model: DPU of %d cores of %.1f ms (up to %.0f FPS), preprocessing %.1f ms, %d CPU cores\n", dpu_cores, dpu_ms,
+           1000 * dpu_cores / dpu_ms, prep_ms, model.cpu_cores);
+    bool ok = run_objective(model, "fps");
+    ok = run_objective(model, "fpsw") && ok;
+    ok = check_profile() && ok;
+    printf(ok ? "[SUCCESS] Configurations within %.0f%% of the best, profile saved and read\n" : "[ERROR] Failed\n",
+           200 * default_tune_options().min_gain);
+    return ok ? 0 : 1;
+}
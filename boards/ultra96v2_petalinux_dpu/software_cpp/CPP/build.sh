@@ -29,17 +29,42 @@ else
 	OPENCV_FLAGS=$(pkg-config --cflags --libs-only-L opencv)
 fi
 
+# Sources shared with the Zybo Z7 tools (colour correction)
+ZYBO_SOFTWARE=${ZYBO_SOFTWARE:-$PWD/../../../zyboz7_tcu/software}
+# Shared-memory frame ring, to receive the frames of a capture process
+FRAME_RING=${FRAME_RING:-$PWD/../../../../systems/frame_ring}
+# COUNT_ALLOCATIONS=1 ./build.sh: debug build that counts the heap allocations of the runs (alloc_counter.h)
+ALLOC_FLAGS=""
+if [ "${COUNT_ALLOCATIONS:-0}" = "1" ]; then
+	ALLOC_FLAGS="-DCOUNT_ALLOCATIONS"
+fi
+
 name=$(basename $PWD)
 if [[ "$CXX"  == *"sysroot"* ]];then
-$CXX -O2 -fno-inline -I. \
+$CXX -O2 -fno-inline ${ALLOC_FLAGS} -I. \
      -I=/usr/include/opencv4 \
      -I=/install/Debug/include \
      -I=/install/Release/include \
      -L=/install/Debug/lib \
      -L=/install/Release/lib \
-     -I$PWD/../common  -o $name -std=c++17 \
+     -I$PWD/../common  -I${ZYBO_SOFTWARE} -I${FRAME_RING} -o $name -std=c++17 \
      $PWD/main.cpp \
+     $PWD/tar_dataset.cpp \
+     $PWD/prefetch_reader.cpp \
+     $PWD/cascade.cpp \
+     $PWD/power_meter.cpp \
+     $PWD/xmodel_pipeline.cpp \
+     $PWD/cpu_ops.cpp \
+     $PWD/zero_copy.cpp \
+     $PWD/model_manifest.cpp \
+     $PWD/kernels.cpp \
+     $PWD/alloc_counter.cpp \
+     $PWD/governor.cpp \
+     $PWD/autotune.cpp \
+     $PWD/deadline_scheduler.cpp \
      $PWD/../common/common.cpp  \
+     ${ZYBO_SOFTWARE}/color_correction.cpp \
+     ${FRAME_RING}/frame_ring.cpp \
      -Wl,-rpath=$PWD/lib \
      -lvart-runner \
      ${OPENCV_FLAGS} \
@@ -51,18 +76,34 @@ $CXX -O2 -fno-inline -I. \
      -lglog \
      -lxir \
      -lunilog \
+     -lrt \
      -lpthread
 else
-$CXX -O2 -fno-inline -I. \
+$CXX -O2 -fno-inline ${ALLOC_FLAGS} -I. \
      -I${install_prefix_default}.Debug/include \
      -I${install_prefix_default}.Release/include \
      -L${install_prefix_default}.Debug/lib \
      -L${install_prefix_default}.Release/lib \
      -Wl,-rpath=${install_prefix_default}.Debug/lib \
      -Wl,-rpath=${install_prefix_default}.Release/lib \
-     -I$PWD/../common  -o $name -std=c++17 \
+     -I$PWD/../common  -I${ZYBO_SOFTWARE} -I${FRAME_RING} -o $name -std=c++17 \
      $PWD/main.cpp \
+     $PWD/tar_dataset.cpp \
+     $PWD/prefetch_reader.cpp \
+     $PWD/cascade.cpp \
+     $PWD/power_meter.cpp \
+     $PWD/xmodel_pipeline.cpp \
+     $PWD/cpu_ops.cpp \
+     $PWD/zero_copy.cpp \
+     $PWD/model_manifest.cpp \
+     $PWD/kernels.cpp \
+     $PWD/alloc_counter.cpp \
+     $PWD/governor.cpp \
+     $PWD/autotune.cpp \
+     $PWD/deadline_scheduler.cpp \
      $PWD/../common/common.cpp  \
+     ${ZYBO_SOFTWARE}/color_correction.cpp \
+     ${FRAME_RING}/frame_ring.cpp \
      -Wl,-rpath=$PWD/lib \
      -lvart-runner \
      ${OPENCV_FLAGS} \
@@ -74,5 +115,6 @@ $CXX -O2 -fno-inline -I. \
      -lglog \
      -lxir \
      -lunilog \
+     -lrt \
      -lpthread
 fi
@@ -0,0 +1,40 @@
+#
+# Python module tipu_dpu (python_bindings.cpp), for the PYNQ notebooks and
+# scripts. Needs pybind11 (pip3 install pybind11) and the VART headers of the
+# image. Copy tipu_dpu*.so next to the notebook or add this folder to PYTHONPATH.
+#
+
+cd "$( dirname "${BASH_SOURCE[0]}" )" >/dev/null 2>&1
+CXX=${CXX:-g++}
+PYTHON=${PYTHON:-python3}
+
+result=0 && pkg-config --list-all | grep opencv4 && result=1
+if [ $result -eq 1 ]; then
+	OPENCV_FLAGS=$(pkg-config --cflags --libs-only-L opencv4)
+else
+	OPENCV_FLAGS=$(pkg-config --cflags --libs-only-L opencv)
+fi
+
+ZYBO_SOFTWARE=${ZYBO_SOFTWARE:-$PWD/../../../zyboz7_tcu/software}
+
+$CXX -O2 -shared -fPIC -I. \
+     $($PYTHON -m pybind11 --includes) \
+     -I$PWD/../common  -I${ZYBO_SOFTWARE} -std=c++17 \
+     -o tipu_dpu$($PYTHON-config --extension-suffix) \
+     $PWD/python_bindings.cpp \
+     $PWD/cascade.cpp \
+     $PWD/power_meter.cpp \
+     $PWD/tar_dataset.cpp \
+     $PWD/model_manifest.cpp \
+     $PWD/kernels.cpp \
+     $PWD/../common/common.cpp  \
+     ${ZYBO_SOFTWARE}/color_correction.cpp \
+     -lvart-runner \
+     ${OPENCV_FLAGS} \
+     -lopencv_imgcodecs \
+     -lopencv_imgproc \
+     -lopencv_core \
+     -lglog \
+     -lxir \
+     -lunilog \
+     -lpthread
@@ -0,0 +1,318 @@
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "cascade.h"
+#include "power_meter.h"
+
+using namespace std;
+using namespace chrono;
+
+#ifndef MOCK_VART
+RunnerPool::RunnerPool(const string& xmodel_file, int n_runners) {
+    graph = xir::Graph::deserialize(xmodel_file);
+    auto subgraph = get_dpu_subgraph(graph.get());
+    CHECK_EQ(subgraph.size(), 1u) << "Subgraph should have one and only one dpu subgraph.";
+    for (int i = 0; i < n_runners; i++) {
+        owned.push_back(vart::Runner::create_runner(subgraph[0], "run"));
+        runners.push_back(owned.back().get());
+    }
+    init();
+}
+#endif
+
+RunnerPool::RunnerPool(const vector<vart::Runner*>& runners) : runners(runners) {
+    init();
+}
+
+void RunnerPool::init() {
+    // The first dimension of the tensors is the batch of the DPU
+    auto input_tensor = runners[0]->get_input_tensors()[0];
+    auto output_tensor = runners[0]->get_output_tensors()[0];
+    batch = input_tensor->get_shape()[0];
+    in_size = input_tensor->get_element_num() / batch;
+    out_size = output_tensor->get_element_num() / batch;
+    in_scale = get_input_scale(input_tensor);
+    out_scale = get_output_scale(output_tensor);
+}
+
+void RunnerPool::worker(vart::Runner* runner, const int8_t* input, float input_scale, const function<int(int*, int)>& next,
+                        int8_t* output, const function<void(const int*, int)>& done) {
+    /*
+        Takes up to a batch of crops at a time. A single crop at the scale of
+        the model is given to the DPU in place; otherwise the crops are
+        gathered in the batch buffer, requantized if the model has another
+        input scale (both are powers of 2, through a table of the 256 values).
+    */
+    auto input_tensor = runner->get_input_tensors()[0];
+    auto output_tensor = runner->get_output_tensors()[0];
+    vector<int8_t> in_batch((size_t)batch * in_size), out_batch((size_t)batch * out_size);
+    vector<int> indices(batch);
+    vector<vart::TensorBuffer*> inputs(1), outputs(1);
+    bool requantize = input_scale != in_scale;
+    int8_t table[256];
+    for (int v = -128; v < 128; v++) {
+        table[v + 128] = (int8_t)max(-128.0f, min(127.0f, roundf(v * in_scale / input_scale)));
+    }
+
+    int n;
+    while ((n = next(indices.data(), batch)) > 0) {
+        int8_t* in_data = in_batch.data();
+        int8_t* out_data = out_batch.data();
+        if (batch == 1 && !requantize) {
+            in_data = const_cast<int8_t*>(input + (size_t)indices[0] * in_size);
+            out_data = output + (size_t)indices[0] * out_size;
+        } else {
+            for (int i = 0; i < n; i++) {
+                const int8_t* crop = input + (size_t)indices[i] * in_size;
+                int8_t* dst = in_batch.data() + (size_t)i * in_size;
+                if (requantize) {
+                    for (int j = 0; j < in_size; j++) {
+                        dst[j] = table[crop[j] + 128];
+                    }
+                } else {
+                    memcpy(dst, crop, in_size);
+                }
+            }
+        }
+
+        // On the stack, and in the vectors of the thread: no allocation per batch
+        CpuFlatTensorBuffer input_buffer(in_data, input_tensor);
+        CpuFlatTensorBuffer output_buffer(out_data, output_tensor);
+        inputs[0] = &input_buffer;
+        outputs[0] = &output_buffer;
+        auto job_id = runner->execute_async(inputs, outputs);
+        runner->wait(job_id.first, -1);
+
+        if (out_data == out_batch.data()) {
+            for (int i = 0; i < n; i++) {
+                memcpy(output + (size_t)indices[i] * out_size, out_batch.data() + (size_t)i * out_size, out_size);
+            }
+        }
+        if (done) {
+            lock_guard<mutex> lock(done_mutex);
+            done(indices.data(), n);
+        }
+    }
+}
+
+void RunnerPool::run(const int8_t* input, float input_scale, const function<int(int*, int)>& next, int8_t* output,
+                     const function<void(const int*, int)>& done) {
+    vector<thread> threads;
+    for (vart::Runner* runner : runners) {
+        threads.emplace_back([&, runner]() { worker(runner, input, input_scale, next, output, done); });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+void run_on_runner(vart::Runner* runner, const int8_t* input, int8_t* output, int first, int last) {
+    /*
+        The loop of the driver without a pool (runDPU): one image per job,
+        the tensor buffers on the stack and the vectors of pointers made
+        once per call.
+    */
+    auto input_tensor = runner->get_input_tensors()[0];
+    auto output_tensor = runner->get_output_tensors()[0];
+    size_t in_size = input_tensor->get_element_num() / input_tensor->get_shape()[0];
+    size_t out_size = output_tensor->get_element_num() / output_tensor->get_shape()[0];
+    vector<vart::TensorBuffer*> inputs(1), outputs(1);
+    for (int i = first; i < last; i++) {
+        CpuFlatTensorBuffer input_buffer(const_cast<int8_t*>(input + i * in_size), input_tensor);
+        CpuFlatTensorBuffer output_buffer(output + i * out_size, output_tensor);
+        inputs[0] = &input_buffer;
+        outputs[0] = &output_buffer;
+        auto job_id = runner->execute_async(inputs, outputs);
+        runner->wait(job_id.first, -1);
+    }
+}
+
+void EscalationQueue::push(int index) {
+    unique_lock<mutex> lock(queue_mutex);
+    changed.wait(lock, [&]() { return !indices.full(); });
+    indices.push(index);
+    changed.notify_all();
+}
+
+void EscalationQueue::close() {
+    lock_guard<mutex> lock(queue_mutex);
+    closed = true;
+    changed.notify_all();
+}
+
+int EscalationQueue::pop(int* out, int max_n) {
+    unique_lock<mutex> lock(queue_mutex);
+    size_t wanted = min((size_t)max_n, indices.capacity());
+    changed.wait(lock, [&]() { return indices.size() >= wanted || closed; });
+    int n = min(max_n, (int)indices.size());
+    for (int i = 0; i < n; i++) {
+        out[i] = indices.pop();
+    }
+    changed.notify_all();
+    return n;
+}
+
+float cascade_confidence(const int8_t* logits, int n_classes, float scale, int gate, int* best) {
+    // Softmax shifted by the largest logit, the 2 best probabilities
+    int8_t largest = *max_element(logits, logits + n_classes);
+    float sum = 0, first = 0, second = 0;
+    *best = 0;
+    for (int i = 0; i < n_classes; i++) {
+        float p = expf((logits[i] - largest) * scale);
+        sum += p;
+        if (p > first) {
+            second = first;
+            first = p;
+            *best = i;
+        } else if (p > second) {
+            second = p;
+        }
+    }
+    return gate == GATE_MARGIN ? (first - second) / sum : first / sum;
+}
+
+static function<int(int*, int)> take_range(atomic<int>& next, int n_images) {
+    // The crops next, next + 1, ... of 0..n_images - 1, shared by the runners
+    return [&next, n_images](int* indices, int max_n) {
+        int first = next.fetch_add(max_n);
+        int n = max(0, min(max_n, n_images - first));
+        for (int i = 0; i < n; i++) {
+            indices[i] = first + i;
+        }
+        return n;
+    };
+}
+
+static void print_rate(const char* name, int n_images, double seconds, double watts) {
+    cout << name << ": " << fixed << setprecision(2) << seconds << " seconds, FPS " << n_images / seconds;
+    if (watts > 0) {
+        cout << ", " << watts << " W, FPS/W " << n_images / seconds / watts;
+    }
+    cout << endl;
+}
+
+int run_cascade(RunnerPool& small, RunnerPool& large, const int8_t* input, float input_scale, const uint16_t* labels,
+                int n_images, int n_classes, const CascadeOptions& options, int8_t* output) {
+    /*
+        Runs the cascade, both stages at the same time, and prints its
+        measures. For the sweep, each model then runs alone on all the crops:
+        with e the fraction of crops escalated at a threshold, a crop costs
+        the time and energy of the small model plus e times those of the
+        large one, and is classified by the large model when escalated.
+    */
+    if (small.input_size() != large.input_size() || small.output_size() < n_classes || large.output_size() < n_classes) {
+        cerr << "[ERROR] The models of the cascade have different inputs or less than " << n_classes << " outputs" << endl;
+        return -1;
+    }
+    bool has_labels = count(labels, labels + n_images, UINT16_MAX) == 0;
+    PowerMeter meter(options.power);
+    if (!meter.available()) {
+        cout << "No power sensor for " << options.power << ", FPS/W not computed" << endl;
+    }
+    const char* gate_name = options.gate == GATE_MARGIN ? "margin" : "max prob";
+    int small_size = small.output_size(), large_size = large.output_size();
+    vector<int8_t> small_out((size_t)n_images * small_size), large_out((size_t)n_images * large_size);
+    vector<float> confidence(n_images);
+    vector<int> small_class(n_images), large_class(n_images);
+
+    // The cascade: the large model takes the crops escalated by the small one as they come
+    EscalationQueue queue(n_images);
+    vector<uint8_t> escalated(n_images, 0);
+    atomic<int> next_crop(0);
+    meter.start();
+    auto start = steady_clock::now();
+    thread small_stage([&]() {
+        small.run(input, input_scale, take_range(next_crop, n_images), small_out.data(), [&](const int* indices, int n) {
+            for (int i = 0; i < n; i++) {
+                int c = indices[i];
+                confidence[c] = cascade_confidence(small_out.data() + (size_t)c * small_size, n_classes, small.output_scale(),
+                                                   options.gate, &small_class[c]);
+                if (confidence[c] < options.threshold) {
+                    escalated[c] = 1;
+                    queue.push(c);
+                }
+            }
+        });
+        queue.close();
+    });
+    large.run(input, input_scale, [&](int* indices, int max_n) { return queue.pop(indices, max_n); }, large_out.data());
+    small_stage.join();
+    double seconds = duration<double>(steady_clock::now() - start).count();
+    double watts = meter.stop();
+
+    int n_escalated = 0;
+    for (int i = 0; i < n_images; i++) {
+        const int8_t* logits = escalated[i] ? large_out.data() + (size_t)i * large_size : small_out.data() + (size_t)i * small_size;
+        memcpy(output + (size_t)i * n_classes, logits, n_classes);
+        n_escalated += escalated[i];
+    }
+    cout << "Cascade (" << gate_name << " < " << options.threshold << ", large model batch " << large.batch_size() << "): "
+         << n_escalated << " of " << n_images << " crops escalated (" << fixed << setprecision(2)
+         << 100.0 * n_escalated / n_images << "%)" << endl;
+    print_rate("Cascade", n_images, seconds, watts);
+    if (options.sweep.empty()) {
+        return 0;
+    }
+
+    // Each model alone on all the crops
+    double stage_seconds[2], stage_watts[2];
+    RunnerPool* pools[2] = {&small, &large};
+    int8_t* outputs[2] = {small_out.data(), large_out.data()};
+    for (int s = 0; s < 2; s++) {
+        atomic<int> next(0);
+        meter.start();
+        auto stage_start = steady_clock::now();
+        pools[s]->run(input, input_scale, take_range(next, n_images), outputs[s]);
+        stage_seconds[s] = duration<double>(steady_clock::now() - stage_start).count();
+        stage_watts[s] = meter.stop();
+    }
+    int small_correct = 0, large_correct = 0;
+    for (int i = 0; i < n_images; i++) {
+        confidence[i] = cascade_confidence(small_out.data() + (size_t)i * small_size, n_classes, small.output_scale(), options.gate,
+                                           &small_class[i]);
+        cascade_confidence(large_out.data() + (size_t)i * large_size, n_classes, large.output_scale(), options.gate, &large_class[i]);
+        small_correct += has_labels && small_class[i] == labels[i];
+        large_correct += has_labels && large_class[i] == labels[i];
+    }
+    print_rate("Small model alone", n_images, stage_seconds[0], stage_watts[0]);
+    print_rate("Large model alone", n_images, stage_seconds[1], stage_watts[1]);
+
+    cout << setw(10) << "Threshold" << setw(12) << "Escalated" << setw(11) << "Accuracy" << setw(9) << "FPS" << setw(9) << "FPS/W" << endl;
+    auto print_row = [&](const string& name, int n_escalated, int n_correct, double time, double energy) {
+        cout << setw(10) << name << setw(11) << 100.0 * n_escalated / n_images << "%";
+        if (has_labels) {
+            cout << setw(10) << 100.0 * n_correct / n_images << "%";
+        } else {
+            cout << setw(11) << "-";
+        }
+        cout << setw(9) << n_images / time;
+        if (energy > 0) {
+            cout << setw(9) << n_images / energy;
+        }
+        cout << endl;
+    };
+    print_row("small", 0, small_correct, stage_seconds[0], stage_seconds[0] * stage_watts[0]);
+    for (float threshold : options.sweep) {
+        int n_escalated = 0, n_correct = 0;
+        for (int i = 0; i < n_images; i++) {
+            bool escalate = confidence[i] < threshold;
+            n_escalated += escalate;
+            n_correct += has_labels && (escalate ? large_class[i] : small_class[i]) == labels[i];
+        }
+        double e = (double)n_escalated / n_images;
+        ostringstream name;
+        name << fixed << setprecision(2) << threshold;
+        print_row(name.str(), n_escalated, n_correct, stage_seconds[0] + e * stage_seconds[1],
+                  stage_seconds[0] * stage_watts[0] + e * stage_seconds[1] * stage_watts[1]);
+    }
+    print_row("large", n_images, large_correct, stage_seconds[1], stage_seconds[1] * stage_watts[1]);
+    return 0;
+}
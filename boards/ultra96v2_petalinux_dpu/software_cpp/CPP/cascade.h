@@ -0,0 +1,107 @@
+#ifndef CASCADE_H
+#define CASCADE_H
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef MOCK_VART
+#include "mock_vart.h"
+#else
+#include "common.h"
+#endif
+#include "frame_arena.h"
+
+#define GATE_MAX_PROB   0   // Probability of the best class
+#define GATE_MARGIN     1   // Best probability minus the second one
+
+/*
+    Two-stage cascade: a small model classifies every crop, and the crops on
+    which it is unsure (confidence under the threshold) are escalated to the
+    large model. Each stage has its own pool of runners; the escalated crops
+    are queued while the small model runs and sent to the large model in
+    batches of the batch size of its DPU.
+*/
+
+// Runners of one xmodel, one thread each
+class RunnerPool {
+public:
+#ifndef MOCK_VART
+    // n_runners new runners of the DPU subgraph of xmodel_file
+    RunnerPool(const std::string& xmodel_file, int n_runners);
+#endif
+    // Existing runners, owned by the caller
+    explicit RunnerPool(const std::vector<vart::Runner*>& runners);
+
+    // Run the crops given by next, which fills up to max indices and returns how many (0 when
+    // there are no more), on all the runners. The crops are input_size() int8 values each,
+    // quantized with input_scale, and the outputs are written at index * output_size().
+    // done is called with the indices of each batch once its outputs are written.
+    void run(const int8_t* input, float input_scale, const std::function<int(int*, int)>& next, int8_t* output,
+             const std::function<void(const int*, int)>& done = nullptr);
+
+    int batch_size() const { return batch; }
+    int input_size() const { return in_size; }
+    int output_size() const { return out_size; }
+    float input_scale() const { return in_scale; }
+    float output_scale() const { return out_scale; }
+
+private:
+    void init();
+    void worker(vart::Runner* runner, const int8_t* input, float input_scale, const std::function<int(int*, int)>& next,
+                int8_t* output, const std::function<void(const int*, int)>& done);
+
+#ifndef MOCK_VART
+    std::unique_ptr<xir::Graph> graph;
+#endif
+    std::vector<std::unique_ptr<vart::Runner>> owned;
+    std::vector<vart::Runner*> runners;
+    int batch, in_size, out_size;
+    float in_scale, out_scale;
+    std::mutex done_mutex;
+};
+
+// The images first to last - 1 on one runner, one image per job, the input and output of image i at
+// i times the size of an image of the tensors. No allocation per image.
+void run_on_runner(vart::Runner* runner, const int8_t* input, int8_t* output, int first, int last);
+
+// Indices of the escalated crops, from the small model to the large one, up to capacity
+class EscalationQueue {
+public:
+    explicit EscalationQueue(int capacity) : indices(capacity) {}
+    void push(int index);
+    // No more crops after this
+    void close();
+    // Wait for max indices (or the close) and take them, return 0 when closed and empty
+    int pop(int* indices, int max);
+
+private:
+    IndexRing indices;
+    bool closed = false;
+    std::mutex queue_mutex;
+    std::condition_variable changed;
+};
+
+// Confidence of the outputs of a crop with the gate, and its class in best
+float cascade_confidence(const int8_t* logits, int n_classes, float scale, int gate, int* best);
+
+typedef struct {
+    float threshold;                // Escalate under this confidence
+    int gate;                       // GATE_MAX_PROB or GATE_MARGIN
+    std::vector<float> sweep;       // Thresholds to compare, empty for none
+    std::string power;              // Source of the power meter (see power_meter.h)
+} CascadeOptions;
+
+// Classify n_images preprocessed crops with the cascade and write n_classes logits per crop in
+// output, from the large model for the escalated crops. Print the escalation rate and FPS/W,
+// then the threshold sweep with the accuracy if all the labels are known (UINT16_MAX otherwise).
+// Return 0 on success, -1 on error.
+int run_cascade(RunnerPool& small, RunnerPool& large, const int8_t* input, float input_scale, const uint16_t* labels,
+                int n_images, int n_classes, const CascadeOptions& options, int8_t* output);
+
+#endif // CASCADE_H
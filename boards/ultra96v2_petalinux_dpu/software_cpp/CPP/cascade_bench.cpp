@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "cascade.h"
+
+using namespace std;
+
+// g++ -O2 -std=c++17 -DMOCK_VART -o cascade_bench cascade_bench.cpp cascade.cpp power_meter.cpp -lpthread
+
+#define N_CLASSES       10
+#define CROP_SIZE       64
+#define INPUT_FIX       6       // Input scale of the crops and of the small model
+#define LARGE_INPUT_FIX 5       // The large model takes its inputs at half the scale
+#define UNSURE_LOGIT    30      // Under this, the small model is wrong
+#define LARGE_LOGIT     120
+
+/*
+    The cascade on mock runners (-DMOCK_VART) with models that read the
+    crops: the value 0 of a crop is 10 times its label at the input scale,
+    the value 1 the logit of the small model for its class. The small model
+    (batch 1) is wrong when this logit is low, which is also when it is
+    unsure; the large model (batch 4, half the input scale) is always right
+    with a logit of LARGE_LOGIT, so its outputs show which crops were
+    escalated, and it only finds the label when the crops are requantized.
+*/
+
+static void small_model(const int8_t* crop, int8_t* logits) {
+    int label = crop[0] / 10;
+    fill(logits, logits + N_CLASSES, 0);
+    logits[crop[1] < UNSURE_LOGIT ? (label + 1) % N_CLASSES : label] = crop[1];
+}
+
+static void large_model(const int8_t* crop, int8_t* logits) {
+    fill(logits, logits + N_CLASSES, 0);
+    logits[(crop[0] / 5) % N_CLASSES] = LARGE_LOGIT;
+}
+
+int main(int argc, char* argv[]) {
+    int n_images = argc > 1 ? atoi(argv[1]) : 200;
+    float threshold = argc > 2 ? atof(argv[2]) : 0.8f;
+    if (n_images < 1 || threshold <= 0 || threshold > 1) {
+        printf("Usage: %s [images] [threshold in ]0, 1]]\n", argv[0]);
+        return 1;
+    }
+    xir::Subgraph small_subgraph("small", xir::Tensor("small_in", {1, CROP_SIZE}, INPUT_FIX),
+                                 xir::Tensor("small_out", {1, N_CLASSES}, 4), 200);
+    xir::Subgraph large_subgraph("large", xir::Tensor("large_in", {4, CROP_SIZE}, LARGE_INPUT_FIX),
+                                 xir::Tensor("large_out", {4, N_CLASSES}, 4), 1000);
+    small_subgraph.model = small_model;
+    large_subgraph.model = large_model;
+    vector<unique_ptr<vart::Runner>> owned;
+    vector<vart::Runner*> small_runners, large_runners;
+    for (int i = 0; i < 2; i++) {
+        owned.push_back(vart::Runner::create_runner(&small_subgraph, "run"));
+        small_runners.push_back(owned.back().get());
+        owned.push_back(vart::Runner::create_runner(&large_subgraph, "run"));
+        large_runners.push_back(owned.back().get());
+    }
+    RunnerPool small(small_runners), large(large_runners);
+
+    mt19937 random(7);
+    vector<int8_t> input((size_t)n_images * CROP_SIZE, 0), output((size_t)n_images * N_CLASSES);
+    vector<uint16_t> labels(n_images);
+    for (int i = 0; i < n_images; i++) {
+        labels[i] = random() % N_CLASSES;
+        input[(size_t)i * CROP_SIZE] = 10 * labels[i];
+        input[(size_t)i * CROP_SIZE + 1] = random() % 120;
+    }
+
+    // The crops under the threshold with the logits of the small model
+    int n_expected = 0, errors = 0;
+    vector<uint8_t> expected(n_images);
+    for (int i = 0; i < n_images; i++) {
+        int8_t logits[N_CLASSES];
+        int best;
+        small_model(input.data() + (size_t)i * CROP_SIZE, logits);
+        expected[i] = cascade_confidence(logits, N_CLASSES, small.output_scale(), GATE_MAX_PROB, &best) < threshold;
+        n_expected += expected[i];
+    }
+
+    CascadeOptions options = {threshold, GATE_MAX_PROB, {}, "2"};
+    mock_vart_counters().reset();
+    if (run_cascade(small, large, input.data(), small.input_scale(), labels.data(), n_images, N_CLASSES, options,
+                    output.data()) != 0) {
+        printf("[ERROR] The cascade failed\n");
+        return 1;
+    }
+    long large_jobs = mock_vart_counters().jobs - n_images;
+    int n_escalated = 0, n_correct = 0, n_wrong_escalation = 0;
+    for (int i = 0; i < n_images; i++) {
+        const int8_t* logits = output.data() + (size_t)i * N_CLASSES;
+        int best = max_element(logits, logits + N_CLASSES) - logits;
+        bool escalated = logits[best] == LARGE_LOGIT;
+        n_escalated += escalated;
+        n_correct += best == labels[i];
+        n_wrong_escalation += escalated != (bool)expected[i];
+    }
+    printf("%d of %d crops escalated (%d expected), %d correct, %ld jobs of batch 4 on the large model\n", n_escalated,
+           n_images, n_expected, n_correct, large_jobs);
+    if (n_wrong_escalation > 0) {
+        printf("[ERROR] %d crops escalated or kept against their confidence\n", n_wrong_escalation);
+        errors++;
+    }
+    if (n_correct != n_images) {
+        printf("[ERROR] %d wrong predictions (large model inputs not requantized?)\n", n_images - n_correct);
+        errors++;
+    }
+    if (large_jobs != (n_escalated + 3) / 4) {
+        printf("[ERROR] %ld jobs on the large model for %d escalated crops, %d expected in full batches\n", large_jobs,
+               n_escalated, (n_escalated + 3) / 4);
+        errors++;
+    }
+
+    // The threshold sweep, each model alone on all the crops
+    options.sweep = {0.5f, threshold, 0.95f};
+    if (run_cascade(small, large, input.data(), small.input_scale(), labels.data(), n_images, N_CLASSES, options,
+                    output.data()) != 0) {
+        printf("[ERROR] The threshold sweep failed\n");
+        errors++;
+    }
+    if (errors == 0) {
+        printf("[SUCCESS] Escalations, batches, requantization and predictions of the cascade\n");
+    }
+    return errors == 0 ? 0 : 1;
+}
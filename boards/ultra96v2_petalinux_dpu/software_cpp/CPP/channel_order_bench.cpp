@@ -0,0 +1,115 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "frame_ring.h"
+#include "isp.h"
+#include "kernels.h"
+#include "uart_link.h"
+
+using namespace std;
+
+// g++ -O2 -std=c++17 -I../../../../systems/frame_ring -I../../../../systems/2-board_system/uart_link -I../../../../systems/isp
+//     -o channel_order_bench channel_order_bench.cpp kernels.cpp model_manifest.cpp ../../../../systems/frame_ring/frame_ring.cpp
+//     ../../../../systems/2-board_system/uart_link/uart_link.cpp ../../../../systems/isp/isp.cpp -lpthread -lrt
+
+#define INPUT_SCALE 64
+
+/*
+    Channel order from the camera to the DPU input. A crop with different
+    values in R, G and B goes the way of the 2-boards system: encoded on
+    the UART link, parsed, written by frame_to_rgb into a slot of a frame
+    ring, then preprocessed from the slot like load_images_from_ring. The
+    DPU input must be the one of the same picture decoded from a file by
+    OpenCV (BGR) with the kernels of the files, and its first channel must
+    be R for an RGB model.
+*/
+
+static void test_image(int width, int height, vector<uint8_t>& rgb) {
+    rgb.resize((size_t)width * height * 3);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t* p = &rgb[((size_t)y * width + x) * 3];
+            p[0] = 200 + (x % 50);          // R
+            p[1] = 100 + (y % 50);          // G
+            p[2] = (x + y) % 50;            // B
+        }
+    }
+}
+
+int main() {
+    ModelManifest manifest = default_model_manifest();
+    int width = manifest.width, height = manifest.height;
+    vector<uint8_t> rgb;
+    test_image(width, height, rgb);
+
+    // UART link: encode, parse, frame_to_rgb into the ring like uart_receiver
+    string name = "/channel_order_" + to_string(getpid());
+    FrameRing* ring = frame_ring_create(name.c_str(), 2, width * height * 3);
+    if (ring == NULL) {
+        printf("[ERROR] Cannot create the frame ring %s\n", name.c_str());
+        return 1;
+    }
+    uint8_t gamma_lut[1024];
+    build_gamma_lut(0, gamma_lut);
+    int n_frames = 0;
+    FrameParser parser([&](Frame& frame) {
+        uint8_t* slot = frame_ring_write_slot(ring, 1000);
+        if (slot == NULL) {
+            return;
+        }
+        frame_to_rgb(frame, gamma_lut, slot, frame.header.width * 3);
+        FrameRingInfo info = {(uint32_t)(frame.header.width * frame.header.height * 3), frame.header.width,
+                              frame.header.height, FRAME_RING_NO_LABEL, 0};
+        frame_ring_commit(ring, &info);
+        n_frames++;
+    });
+    vector<uint8_t> wire;
+    encode_frame(rgb.data(), width, height, 0, false, wire);
+    parser.feed(wire.data(), wire.size());
+
+    // Preprocessed from the slot with the kernels of the ring
+    vector<int8_t> ring_input(rgb.size()), file_input(rgb.size()), wrong_input(rgb.size());
+    FrameRingInfo info;
+    uint8_t* slot = n_frames == 1 ? frame_ring_read_slot(ring, &info, 1000) : NULL;
+    if (slot == NULL) {
+        printf("[ERROR] The frame did not reach the ring\n");
+        frame_ring_destroy(ring);
+        return 1;
+    }
+    ModelKernels ring_kernels(manifest, INPUT_SCALE, true);
+    ModelKernels file_kernels(manifest, INPUT_SCALE);
+    ring_kernels.preprocess(slot, ring_input.data());
+    file_kernels.preprocess(slot, wrong_input.data());
+    frame_ring_release(ring);
+    frame_ring_destroy(ring);
+
+    // The same picture from a file: BGR, the kernels of the files
+    vector<uint8_t> bgr(rgb.size());
+    for (size_t i = 0; i < rgb.size(); i += 3) {
+        bgr[i] = rgb[i + 2];
+        bgr[i + 1] = rgb[i + 1];
+        bgr[i + 2] = rgb[i];
+    }
+    file_kernels.preprocess(bgr.data(), file_input.data());
+
+    // The first value of the input is R of the first pixel for an RGB model
+    float r = (rgb[0] / 255.0f - manifest.mean[0]) / manifest.std[0] * INPUT_SCALE;
+    int8_t expected = (int8_t)max(-128.0f, min(127.0f, nearbyintf(r)));
+    bool same = ring_input == file_input;
+    bool red_first = ring_input[0] == expected && file_input[0] == expected;
+    printf("Ring frame: %s the input of the file, first channel %d (R expected %d)\n", same ? "same as" : "differs from",
+           ring_input[0], expected);
+    printf("Ring frame with the kernels of the files: %s\n", wrong_input == file_input ? "same input" : "R and B swapped");
+    if (!same || !red_first || wrong_input == file_input) {
+        printf("[ERROR] Wrong channel order from the ring to the DPU input\n");
+        return 1;
+    }
+    printf("[SUCCESS] Same channel order from the ring and from the files\n");
+    return 0;
+}
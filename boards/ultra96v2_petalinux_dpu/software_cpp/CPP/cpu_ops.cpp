@@ -0,0 +1,278 @@
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <numeric>
+
+#include "cpu_ops.h"
+
+using namespace std;
+
+static const char* copy_ops[] = {"reshape", "reshape-fix", "flatten", "squeeze", "identity", "upload", "download", "fix2float"};
+static const char* quantize_ops[] = {"fix", "float2fix"};
+static const char* activation_ops[] = {"relu", "relu6", "leaky-relu", "sigmoid"};
+static const char* constant_ops[] = {"const", "const-fix"};
+static const char* placeholder_ops[] = {"data", "data-fix"};
+
+static bool is_one_of(const string& type, const char* const* types, size_t n) {
+    return find_if(types, types + n, [&](const char* t) { return type == t; }) != types + n;
+}
+
+template <size_t N>
+static bool is_one_of(const string& type, const char* const (&types)[N]) {
+    return is_one_of(type, types, N);
+}
+
+static size_t element_num(const vector<int>& shape) {
+    return accumulate(shape.begin(), shape.end(), (size_t)1, [](size_t a, int b) { return a * b; });
+}
+
+static int positive_axis(int axis, size_t rank) {
+    return axis < 0 ? axis + (int)rank : axis;
+}
+
+static float quantize(float x, int fix_point, int bit_width, const string& round_mode) {
+    // Rounded to the fix point like the DPU, saturated, back to float
+    float v = ldexpf(x, fix_point);
+    if (round_mode == "PY3_ROUND") {
+        v = nearbyintf(v);
+    } else if (round_mode == "STD_ROUND") {
+        v = roundf(v);
+    } else {
+        v = floorf(v + 0.5f);      // DPU_ROUND: halves up
+    }
+    float high = (float)((1 << (bit_width - 1)) - 1);
+    return ldexpf(max(-high - 1, min(high, v)), -fix_point);
+}
+
+bool cpu_op_is_source(const xir::Op* op) {
+    string type = op->get_type();
+    return is_one_of(type, constant_ops) || is_one_of(type, placeholder_ops);
+}
+
+bool cpu_op_is_constant(const xir::Op* op) {
+    return is_one_of(op->get_type(), constant_ops);
+}
+
+bool cpu_op_supported(const xir::Op* op, string* reason) {
+    string type = op->get_type();
+    if (is_one_of(type, constant_ops)) {
+        if (!op->has_attr("data")) {
+            *reason = "constant without data";
+            return false;
+        }
+        return true;
+    }
+    if (is_one_of(type, placeholder_ops)) {
+        return true;
+    }
+    // The other ops read at least one tensor
+    auto op_inputs = op->get_input_tensors("input");
+    if (op_inputs.empty()) {
+        *reason = "no input";
+        return false;
+    }
+    auto out_shape = op->get_output_tensor()->get_shape();
+    if (type == "add" || type == "mul") {
+        // No broadcasting: each input has the shape of the output or one value
+        for (auto tensor : op_inputs) {
+            size_t n = element_num(tensor->get_shape());
+            if (n != 1 && n != element_num(out_shape)) {
+                *reason = "inputs of different shapes (broadcasting not supported)";
+                return false;
+            }
+        }
+        return true;
+    }
+    if (type == "concat") {
+        // The inputs only differ on the axis, and their slices add up to the output
+        int axis = positive_axis(op->has_attr("axis") ? op->get_attr<int>("axis") : 0, out_shape.size());
+        if (axis < 0 || axis >= (int)out_shape.size()) {
+            *reason = "concat axis out of the shape";
+            return false;
+        }
+        int axis_sum = 0;
+        for (auto tensor : op_inputs) {
+            auto shape = tensor->get_shape();
+            if (shape.size() != out_shape.size()) {
+                *reason = "concat of inputs of another rank than the output";
+                return false;
+            }
+            for (size_t d = 0; d < shape.size(); d++) {
+                if ((int)d != axis && shape[d] != out_shape[d]) {
+                    *reason = "concat of inputs of different shapes outside the axis";
+                    return false;
+                }
+            }
+            axis_sum += shape[axis];
+        }
+        if (axis_sum != out_shape[axis]) {
+            *reason = "concat inputs do not add up to the output";
+            return false;
+        }
+        return true;
+    }
+    if (is_one_of(type, copy_ops) || is_one_of(type, activation_ops) || type == "transpose") {
+        return true;
+    }
+    if (is_one_of(type, quantize_ops)) {
+        if (!op->has_attr("fix_point")) {
+            *reason = "no fix_point";
+            return false;
+        }
+        return true;
+    }
+    auto in_shape = op_inputs[0]->get_shape();
+    if (type == "softmax") {
+        int axis = op->has_attr("axis") ? op->get_attr<int>("axis") : -1;
+        if (positive_axis(axis, in_shape.size()) != (int)in_shape.size() - 1) {
+            *reason = "softmax on another axis than the last one";
+            return false;
+        }
+        return true;
+    }
+    if (type == "avgpool2d" || type == "reduction_mean") {
+        // Global pooling only: NHWC to N11C or NC
+        if (in_shape.size() != 4 || element_num(out_shape) != (size_t)in_shape[0] * in_shape[3]) {
+            *reason = "only the global average pooling is supported";
+            return false;
+        }
+        return true;
+    }
+    *reason = "op type not supported on the CPU";
+    return false;
+}
+
+static void softmax_last_axis(const CpuTensor& in, CpuTensor& out) {
+    size_t n = in.shape.back(), rows = element_num(in.shape) / n;
+    for (size_t r = 0; r < rows; r++) {
+        const float* x = in.data + r * n;
+        float* y = out.data + r * n;
+        float largest = *max_element(x, x + n), sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            y[i] = expf(x[i] - largest);
+            sum += y[i];
+        }
+        for (size_t i = 0; i < n; i++) {
+            y[i] /= sum;
+        }
+    }
+}
+
+static void concat(const vector<CpuTensor>& inputs, int axis, CpuTensor& out) {
+    // Outer blocks before the axis, each input gives its slice of the axis and the dimensions after it
+    size_t outer = 1;
+    for (int i = 0; i < axis; i++) {
+        outer *= out.shape[i];
+    }
+    float* y = out.data;
+    for (size_t o = 0; o < outer; o++) {
+        for (const CpuTensor& in : inputs) {
+            size_t block = element_num(in.shape) / outer;
+            memcpy(y, in.data + o * block, block * sizeof(float));
+            y += block;
+        }
+    }
+}
+
+static void transpose(const CpuTensor& in, const vector<int>& order, CpuTensor& out, FrameArena& arena) {
+    size_t rank = in.shape.size(), n = element_num(in.shape);
+    size_t* in_strides = arena.alloc_array<size_t>(rank);
+    int* index = arena.alloc_array<int>(rank);
+    for (size_t d = 0; d < rank; d++) {
+        in_strides[d] = 1;
+        index[d] = 0;
+    }
+    for (int i = (int)rank - 2; i >= 0; i--) {
+        in_strides[i] = in_strides[i + 1] * in.shape[i + 1];
+    }
+    for (size_t o = 0; o < n; o++) {
+        // index walks the output in order, dimension d of the output is dimension order[d] of the input
+        size_t offset = 0;
+        for (size_t d = 0; d < rank; d++) {
+            offset += index[d] * in_strides[order[d]];
+        }
+        out.data[o] = in.data[offset];
+        for (int d = (int)rank - 1; d >= 0 && ++index[d] == out.shape[d]; d--) {
+            index[d] = 0;
+        }
+    }
+}
+
+CpuOp cpu_op_prepare(const xir::Op* op) {
+    CpuOp prepared;
+    prepared.op = op;
+    prepared.type = op->get_type();
+    prepared.fix_point = op->has_attr("fix_point") ? op->get_attr<int>("fix_point") : 0;
+    prepared.bit_width = op->has_attr("bit_width") ? op->get_attr<int>("bit_width") : 8;
+    prepared.round_mode = op->has_attr("round_mode") ? op->get_attr<string>("round_mode") : "DPU_ROUND";
+    prepared.alpha = op->has_attr("alpha") ? op->get_attr<float>("alpha") : 0.01f;
+    prepared.axis = op->has_attr("axis") ? op->get_attr<int>("axis") : 0;
+    if (prepared.type == "transpose") {
+        prepared.order = op->get_attr<vector<int>>("order");
+    }
+    return prepared;
+}
+
+void cpu_op_run(const CpuOp& op, const vector<CpuTensor>& inputs, CpuTensor& output, FrameArena& arena) {
+    const string& type = op.type;
+    const CpuTensor& in = inputs[0];
+    size_t n = element_num(output.shape);
+    if (is_one_of(type, copy_ops)) {
+        memmove(output.data, in.data, n * sizeof(float));
+    } else if (is_one_of(type, quantize_ops)) {
+        for (size_t i = 0; i < n; i++) {
+            output.data[i] = quantize(in.data[i], op.fix_point, op.bit_width, op.round_mode);
+        }
+    } else if (type == "relu") {
+        for (size_t i = 0; i < n; i++) {
+            output.data[i] = max(0.0f, in.data[i]);
+        }
+    } else if (type == "relu6") {
+        for (size_t i = 0; i < n; i++) {
+            output.data[i] = min(6.0f, max(0.0f, in.data[i]));
+        }
+    } else if (type == "leaky-relu") {
+        for (size_t i = 0; i < n; i++) {
+            output.data[i] = in.data[i] < 0 ? in.data[i] * op.alpha : in.data[i];
+        }
+    } else if (type == "sigmoid") {
+        for (size_t i = 0; i < n; i++) {
+            output.data[i] = 1.0f / (1.0f + expf(-in.data[i]));
+        }
+    } else if (type == "add" || type == "mul") {
+        // Same shapes, or an input of one value (checked by cpu_op_supported), the first one too
+        float* result = arena.alloc_array<float>(n);
+        if (element_num(in.shape) == 1) {
+            fill(result, result + n, in.data[0]);
+        } else {
+            memcpy(result, in.data, n * sizeof(float));
+        }
+        bool add = type == "add";
+        for (size_t k = 1; k < inputs.size(); k++) {
+            bool scalar = element_num(inputs[k].shape) == 1;
+            for (size_t i = 0; i < n; i++) {
+                float v = inputs[k].data[scalar ? 0 : i];
+                result[i] = add ? result[i] + v : result[i] * v;
+            }
+        }
+        memcpy(output.data, result, n * sizeof(float));
+    } else if (type == "softmax") {
+        softmax_last_axis(in, output);
+    } else if (type == "concat") {
+        concat(inputs, positive_axis(op.axis, output.shape.size()), output);
+    } else if (type == "transpose") {
+        transpose(in, op.order, output, arena);
+    } else if (type == "avgpool2d" || type == "reduction_mean") {
+        int batch = in.shape[0], pixels = in.shape[1] * in.shape[2], channels = in.shape[3];
+        for (int b = 0; b < batch; b++) {
+            for (int c = 0; c < channels; c++) {
+                float sum = 0;
+                for (int p = 0; p < pixels; p++) {
+                    sum += in.data[((size_t)b * pixels + p) * channels + c];
+                }
+                output.data[b * channels + c] = sum / pixels;
+            }
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef CPU_OPS_H
+#define CPU_OPS_H
+
+#include <string>
+#include <vector>
+
+#ifdef MOCK_VART
+#include "mock_vart.h"
+#else
+#include "common.h"
+#endif
+#include "frame_arena.h"
+
+/*
+    The ops that the Vitis AI compiler leaves on the CPU, run in C++ on
+    float tensors (NHWC like XIR): the conversions between the DPU and the
+    CPU (fix, float2fix, fix2float, upload, download), reshapes, softmax,
+    activations, add, mul, concat, transpose and the global average pooling.
+    Quantized tensors are converted to and from float by the caller.
+    The constants (const, const-fix) and the placeholders of the input
+    (data, data-fix) are sources: they are not run, the caller gives their
+    tensor from the data attribute or from the input of the model.
+*/
+
+typedef struct {
+    std::vector<int> shape;
+    float* data;
+} CpuTensor;
+
+// An op with its attributes, read once from the graph instead of for every image
+typedef struct {
+    const xir::Op* op;
+    std::string type;
+    int fix_point, bit_width;       // fix, float2fix
+    std::string round_mode;
+    float alpha;                    // leaky-relu
+    int axis;                       // concat
+    std::vector<int> order;         // transpose
+} CpuOp;
+
+// True if the op can run on the CPU, otherwise false with the reason
+bool cpu_op_supported(const xir::Op* op, std::string* reason);
+
+// Constant or placeholder of the input: a tensor without an op to run
+bool cpu_op_is_source(const xir::Op* op);
+// Constant, with its tensor in the data attribute
+bool cpu_op_is_constant(const xir::Op* op);
+
+// The attributes of a supported op
+CpuOp cpu_op_prepare(const xir::Op* op);
+
+// Run the op, inputs in the order of op->get_input_tensors("input"), the temporary buffers in arena
+void cpu_op_run(const CpuOp& op, const std::vector<CpuTensor>& inputs, CpuTensor& output, FrameArena& arena);
+
+#endif // CPU_OPS_H
@@ -0,0 +1,282 @@
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "deadline_scheduler.h"
+
+using namespace std;
+using namespace chrono;
+
+#define AVERAGE_WEIGHT  0.1     // Of the last job in the averages of the job times
+
+DeadlineScheduler::DeadlineScheduler(const SchedulerOptions& options, int n_workers, function<void(const int*, int)> on_dropped)
+    : options(options), n_workers(max(1, n_workers)), on_dropped(on_dropped), lanes(max(1, options.n_lanes)) {}
+
+static int latency_bucket(double ms) {
+    // Bucket 0 under LATENCY_MIN_MS, then bucket i up to LATENCY_MIN_MS * LATENCY_RATIO^i
+    if (ms < LATENCY_MIN_MS) {
+        return 0;
+    }
+    int bucket = (int)ceil(log(ms / LATENCY_MIN_MS) / log(LATENCY_RATIO));
+    return min(max(bucket, 1), LATENCY_BUCKETS - 1);
+}
+
+bool DeadlineScheduler::submit(int index, int lane, double deadline_ms) {
+    lock_guard<mutex> lock(scheduler_mutex);
+    lane = min(max(lane, 0), (int)lanes.size() - 1);
+    Lane& l = lanes[lane];
+    l.submitted++;
+    if (options.shed_ms > 0 && lane >= options.shed_from && estimated_wait(lane) * 1000 > options.shed_ms) {
+        l.shed++;
+        return false;
+    }
+
+    Item item;
+    item.index = index;
+    item.lane = lane;
+    item.submitted = Clock::now();
+    item.deadline = deadline_ms > 0 ? item.submitted + duration_cast<Clock::duration>(duration<double, milli>(deadline_ms))
+                                     : Clock::time_point::max();
+    item.degraded = false;
+    l.queue.emplace(Key(options.fifo ? item.submitted : item.deadline, sequence++), item);
+    changed.notify_all();
+    return true;
+}
+
+void DeadlineScheduler::close() {
+    lock_guard<mutex> lock(scheduler_mutex);
+    closed = true;
+    changed.notify_all();
+}
+
+double DeadlineScheduler::estimated_wait(int lane) const {
+    // The items queued in this lane and the ones before it, shared by the runners
+    size_t ahead = 0;
+    for (int i = 0; i < (int)lanes.size(); i++) {
+        if (i <= lane || options.fifo) {
+            ahead += lanes[i].queue.size();
+        }
+    }
+    return ahead * item_seconds / n_workers;
+}
+
+double DeadlineScheduler::queue_latency_ms(int lane) {
+    lock_guard<mutex> lock(scheduler_mutex);
+    return estimated_wait(min(max(lane, 0), (int)lanes.size() - 1)) * 1000;
+}
+
+bool DeadlineScheduler::empty() const {
+    for (const Lane& lane : lanes) {
+        if (!lane.queue.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int DeadlineScheduler::take(Item* items, int max_n, Clock::time_point now) {
+    /*
+        The first lane with items, or the oldest item of all the lanes in fifo
+        mode. An item expires when its deadline comes before the end of a job
+        started now.
+    */
+    auto expiry = now + duration_cast<Clock::duration>(duration<double>(job_seconds));
+    int n = 0;
+    while (n < max_n) {
+        Lane* lane = nullptr;
+        for (Lane& l : lanes) {
+            if (!l.queue.empty() && (lane == nullptr || (options.fifo && l.queue.begin()->first < lane->queue.begin()->first))) {
+                lane = &l;
+                if (!options.fifo) {
+                    break;
+                }
+            }
+        }
+        if (lane == nullptr) {
+            break;
+        }
+        Item item = lane->queue.begin()->second;
+        lane->queue.erase(lane->queue.begin());
+        if (item.deadline < expiry && options.expired == EXPIRED_DROP) {
+            lane->dropped++;
+            if (on_dropped) {
+                on_dropped(&item.index, 1);
+            }
+            continue;
+        }
+        if (item.deadline < expiry && options.expired == EXPIRED_DEGRADE) {
+            item.degraded = true;
+            degraded.push_back(item);
+            changed.notify_all();
+            continue;
+        }
+        items[n++] = item;
+    }
+    return n;
+}
+
+int DeadlineScheduler::take_degraded(int* indices, int max_n, Clock::time_point now) {
+    // The expired items at the head of the lanes, without waiting for the runners to reach them
+    auto expiry = now + duration_cast<Clock::duration>(duration<double>(job_seconds));
+    for (Lane& lane : lanes) {
+        while (options.expired == EXPIRED_DEGRADE && !lane.queue.empty() && lane.queue.begin()->second.deadline < expiry) {
+            Item item = lane.queue.begin()->second;
+            lane.queue.erase(lane.queue.begin());
+            item.degraded = true;
+            degraded.push_back(item);
+        }
+    }
+    int n = 0;
+    while (n < max_n && !degraded.empty()) {
+        Item& item = degraded.front();
+        Lane& lane = lanes[item.lane];
+        lane.degraded++;
+        lane.wait_seconds += duration<double>(now - item.submitted).count();
+        lane.n_waits++;
+        item.dispatched = now;
+        in_flight[item.index] = item;
+        indices[n++] = item.index;
+        degraded.pop_front();
+    }
+    return n;
+}
+
+int DeadlineScheduler::pop(int* indices, int max_n) {
+    unique_lock<mutex> lock(scheduler_mutex);
+    while (true) {
+        changed.wait(lock, [&]() { return !empty() || closed; });
+        auto now = Clock::now();
+        // Used until the lock is released below: shared by the runners, allocated once
+        if ((int)taken.size() < max_n) {
+            taken.resize(max_n);
+        }
+        Item* items = taken.data();
+        int n = take(items, max_n, now);
+        if (n > 0) {
+            for (int i = 0; i < n; i++) {
+                Lane& lane = lanes[items[i].lane];
+                lane.wait_seconds += duration<double>(now - items[i].submitted).count();
+                lane.n_waits++;
+                items[i].dispatched = now;
+                in_flight[items[i].index] = items[i];
+                indices[i] = items[i].index;
+            }
+            return n;
+        }
+        if (closed && empty()) {
+            changed.notify_all();
+            return 0;
+        }
+    }
+}
+
+int DeadlineScheduler::pop_degraded(int* indices, int max_n) {
+    unique_lock<mutex> lock(scheduler_mutex);
+    while (true) {
+        int n = take_degraded(indices, max_n, Clock::now());
+        if (n > 0) {
+            return n;
+        }
+        if (closed && empty()) {
+            return 0;
+        }
+        if (options.expired != EXPIRED_DEGRADE) {
+            // Nothing expires into this queue, wait for the close
+            changed.wait(lock);
+            continue;
+        }
+        // Until the next head of a lane expires, or an item comes
+        auto wake = Clock::time_point::max();
+        for (Lane& lane : lanes) {
+            if (!lane.queue.empty()) {
+                wake = min(wake, lane.queue.begin()->second.deadline);
+            }
+        }
+        if (wake == Clock::time_point::max()) {
+            changed.wait(lock);
+        } else {
+            changed.wait_until(lock, wake - duration_cast<Clock::duration>(duration<double>(job_seconds)));
+        }
+    }
+}
+
+void DeadlineScheduler::done(const int* indices, int n) {
+    lock_guard<mutex> lock(scheduler_mutex);
+    auto now = Clock::now();
+    bool runners = false;
+    double seconds = 0;
+    for (int i = 0; i < n; i++) {
+        auto found = in_flight.find(indices[i]);
+        if (found == in_flight.end()) {
+            continue;
+        }
+        const Item& item = found->second;
+        Lane& lane = lanes[item.lane];
+        lane.completed++;
+        if (now > item.deadline) {
+            lane.late++;
+        }
+        double latency_ms = duration<double, milli>(now - item.submitted).count();
+        lane.latency_counts[latency_bucket(latency_ms)]++;
+        lane.n_latencies++;
+        lane.max_latency_ms = max(lane.max_latency_ms, latency_ms);
+        if (!item.degraded) {
+            runners = true;
+            seconds = duration<double>(now - item.dispatched).count();
+        }
+        in_flight.erase(found);
+    }
+    if (runners) {
+        // The degraded items run elsewhere and do not count in the times of the runners
+        job_seconds = job_seconds == 0 ? seconds : (1 - AVERAGE_WEIGHT) * job_seconds + AVERAGE_WEIGHT * seconds;
+        item_seconds = item_seconds == 0 ? seconds / n : (1 - AVERAGE_WEIGHT) * item_seconds + AVERAGE_WEIGHT * seconds / n;
+    }
+}
+
+double DeadlineScheduler::percentile_ms(const Lane& lane, double fraction) {
+    // Upper bound of the bucket of the percentile, at most the largest latency
+    long rank = max(1L, (long)ceil(fraction * lane.n_latencies)), seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += lane.latency_counts[i];
+        if (seen >= rank) {
+            return min(lane.max_latency_ms, LATENCY_MIN_MS * pow(LATENCY_RATIO, i));
+        }
+    }
+    return lane.max_latency_ms;
+}
+
+LaneStats DeadlineScheduler::lane_stats(int lane) {
+    lock_guard<mutex> lock(scheduler_mutex);
+    Lane& l = lanes[min(max(lane, 0), (int)lanes.size() - 1)];
+    LaneStats stats;
+    stats.submitted = l.submitted;
+    stats.shed = l.shed;
+    stats.dropped = l.dropped;
+    stats.degraded = l.degraded;
+    stats.completed = l.completed;
+    stats.late = l.late;
+    stats.wait_ms = l.n_waits > 0 ? l.wait_seconds * 1000 / l.n_waits : 0;
+    stats.p50_ms = stats.p99_ms = stats.max_ms = 0;
+    if (l.n_latencies > 0) {
+        stats.p50_ms = percentile_ms(l, 0.50);
+        stats.p99_ms = percentile_ms(l, 0.99);
+        stats.max_ms = l.max_latency_ms;
+    }
+    return stats;
+}
+
+void DeadlineScheduler::print_stats(const char* const* lane_names) {
+    printf("%-8s %9s %7s %7s %8s %9s %6s %8s %8s %8s %8s %7s\n", "Lane", "Submitted", "Shed", "Dropped", "Degraded", "Completed",
+           "Late", "Wait ms", "p50 ms", "p99 ms", "Max ms", "Missed");
+    for (int i = 0; i < (int)lanes.size(); i++) {
+        LaneStats s = lane_stats(i);
+        // Missed: dropped, or completed after the deadline, out of the admitted items
+        long admitted = s.submitted - s.shed;
+        double missed = admitted > 0 ? 100.0 * (s.dropped + s.late) / admitted : 0;
+        char name[16];
+        snprintf(name, sizeof(name), "%d", i);
+        printf("%-8s %9ld %7ld %7ld %8ld %9ld %6ld %8.2f %8.2f %8.2f %8.2f %6.1f%%\n", lane_names ? lane_names[i] : name,
+               s.submitted, s.shed, s.dropped, s.degraded, s.completed, s.late, s.wait_ms, s.p50_ms, s.p99_ms, s.max_ms, missed);
+    }
+}
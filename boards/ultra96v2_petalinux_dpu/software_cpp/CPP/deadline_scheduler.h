@@ -0,0 +1,135 @@
+#ifndef DEADLINE_SCHEDULER_H
+#define DEADLINE_SCHEDULER_H
+
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#define EXPIRED_RUN     0   // Run the expired items anyway
+#define EXPIRED_DROP    1   // Drop them, they count as missed
+#define EXPIRED_DEGRADE 2   // Give them to pop_degraded, for a cheaper path (the small model of a cascade...)
+
+// Histogram of the latencies of a lane: buckets 7% wide from 10 us, up to about 5 minutes
+#define LATENCY_BUCKETS     256
+#define LATENCY_MIN_MS      0.01
+#define LATENCY_RATIO       1.07
+
+/*
+    Scheduler in front of a pool of runners, for a mix of latency-critical
+    work (the crops of a camera) and bulk work (stored captures to classify
+    again). Each item is submitted in a lane with a deadline. The lanes are
+    served in priority order, lane 0 first, and the items of a lane in the
+    order of their deadlines. An item that cannot finish before its deadline
+    (the deadline is closer than the average time of a job) is run anyway,
+    dropped or degraded depending on the options.
+
+    Admission control: the time an item would wait is estimated from the
+    items queued ahead of it and the average time per item of the runners.
+    The items of the shed lanes are refused when it is over shed_ms, so that
+    bulk work does not pile up behind the live work under overload.
+
+    pop and done have the signature of the next and done functions of
+    RunnerPool::run (cascade.h), so that the pool runs the scheduled items:
+        pool.run(input, scale, [&](int* indices, int max) { return scheduler.pop(indices, max); },
+                 output, [&](const int* indices, int n) { scheduler.done(indices, n); });
+    The items dropped with EXPIRED_DROP never reach the runners: on_dropped
+    gives their indices, to free their buffers or mark their outputs.
+
+    The metrics keep a fixed histogram of the latencies per lane, so a long
+    run does not grow them; the percentiles are within a bucket (7%).
+*/
+
+typedef struct {
+    int n_lanes;            // Lane 0 has the highest priority
+    int shed_from;          // Lanes from this one are shed (1: all but lane 0)
+    double shed_ms;         // Shed when the estimated queue latency is over this, 0 for never
+    int expired;            // EXPIRED_RUN, EXPIRED_DROP or EXPIRED_DEGRADE
+    bool fifo;              // One queue in arrival order over all lanes, as the drivers did, to compare
+} SchedulerOptions;
+
+// Metrics of a lane, latencies from the submission to done
+typedef struct {
+    long submitted, shed, dropped, degraded, completed;
+    long late;              // Completed after their deadline
+    double wait_ms;         // Average time in the queue
+    double p50_ms, p99_ms, max_ms;
+} LaneStats;
+
+class DeadlineScheduler {
+public:
+    // on_dropped is called by pop with the indices of the dropped items, with the lock of the
+    // scheduler held: it must not call the scheduler
+    DeadlineScheduler(const SchedulerOptions& options, int n_workers,
+                      std::function<void(const int*, int)> on_dropped = nullptr);
+
+    // Queue the item index in lane, to finish in deadline_ms (0 for no deadline); false if it
+    // was shed. The indices of the items in the scheduler must be different.
+    bool submit(int index, int lane, double deadline_ms);
+    // No more items after this
+    void close();
+
+    // Wait for an item and take up to max of them, for the runners; 0 when closed and empty
+    int pop(int* indices, int max);
+    // Same for the expired items with EXPIRED_DEGRADE
+    int pop_degraded(int* indices, int max);
+    // The items are done, after pop or pop_degraded
+    void done(const int* indices, int n);
+
+    // Estimated time in the queue of an item of lane submitted now
+    double queue_latency_ms(int lane);
+    LaneStats lane_stats(int lane);
+    void print_stats(const char* const* lane_names = nullptr);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    typedef struct {
+        int index, lane;
+        Clock::time_point submitted, deadline, dispatched;
+        bool degraded;
+    } Item;
+
+    // Order of the items of a lane: deadline (arrival in fifo mode), then arrival
+    typedef std::pair<Clock::time_point, uint64_t> Key;
+
+    typedef struct {
+        std::map<Key, Item> queue;
+        long submitted = 0, shed = 0, dropped = 0, degraded = 0, completed = 0, late = 0;
+        double wait_seconds = 0;
+        long n_waits = 0;
+        std::vector<long> latency_counts = std::vector<long>(LATENCY_BUCKETS, 0);
+        long n_latencies = 0;
+        double max_latency_ms = 0;
+    } Lane;
+
+    double estimated_wait(int lane) const;
+    int take(Item* items, int max, Clock::time_point now);
+    int take_degraded(int* indices, int max, Clock::time_point now);
+    bool empty() const;
+    static double percentile_ms(const Lane& lane, double fraction);
+
+    SchedulerOptions options;
+    int n_workers;
+    std::function<void(const int*, int)> on_dropped;
+    std::vector<Lane> lanes;
+    std::vector<Item> taken;    // Of pop, reused
+    std::deque<Item> degraded;
+    std::unordered_map<int, Item> in_flight;
+    uint64_t sequence = 0;
+    double item_seconds = 0;    // Averages of the jobs: time per item for the runners
+    double job_seconds = 0;     // and time of a job, for the deadlines
+    bool closed = false;
+
+    std::mutex scheduler_mutex;
+    std::condition_variable changed;
+};
+
+#endif // DEADLINE_SCHEDULER_H
@@ -0,0 +1,145 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <new>
+#include <utility>
+#include <vector>
+
+/*
+    Memory of the hot loops, taken once so that, after the first images, an
+    image is processed without a heap allocation (see alloc_counter.h).
+    - FrameArena: memory of a thread for the objects and buffers of one
+      frame, given in order from a block and freed all at once by reset after
+      the frame. The objects made by create are destroyed by reset. A frame
+      larger than the block gets extra blocks; the next reset replaces them
+      by one block of the size of that frame, so the arena settles at the
+      size of the largest frame.
+    - IndexRing: queue of indices of a fixed capacity, for the queues between
+      the stages.
+*/
+
+class FrameArena {
+public:
+    explicit FrameArena(size_t capacity = 16 * 1024) : block_size(capacity) { block = checked_malloc(block_size); }
+    ~FrameArena() {
+        reset();
+        free(block);
+    }
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(max_align_t)) {
+        size_t start = (offset + align - 1) & ~(align - 1);
+        if (start + size <= block_size) {
+            offset = start + size;
+            return block + start;
+        }
+        // Over the block: an extra block for this frame
+        extra.push_back(checked_malloc(size + align));
+        extra_bytes += size + align;
+        return (void*)(((uintptr_t)extra.back() + align - 1) & ~(uintptr_t)(align - 1));
+    }
+
+    // n values of T, not initialized
+    template <typename T>
+    T* alloc_array(size_t n) {
+        return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+    }
+
+    // An object destroyed at the next reset
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        Destructor* d = static_cast<Destructor*>(allocate(sizeof(Destructor), alignof(Destructor)));
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        d->destroy = [](void* p) { static_cast<T*>(p)->~T(); };
+        d->object = object;
+        d->next = destructors;
+        destructors = d;
+        return object;
+    }
+
+    // Destroy the objects and free the memory of the frame
+    void reset() {
+        for (Destructor* d = destructors; d != nullptr; d = d->next) {
+            d->destroy(d->object);
+        }
+        destructors = nullptr;
+        if (!extra.empty()) {
+            for (char* b : extra) {
+                free(b);
+            }
+            extra.clear();
+            free(block);
+            size_t size = offset + extra_bytes;
+            // Empty until the new block is there, in case it throws
+            block = nullptr;
+            block_size = offset = extra_bytes = 0;
+            block = checked_malloc(size);
+            block_size = size;
+        }
+        offset = 0;
+    }
+
+    size_t capacity() const { return block_size; }
+    size_t used() const { return offset + extra_bytes; }
+
+private:
+    static char* checked_malloc(size_t size) {
+        // A block that cannot be allocated throws, like new
+        char* p = (char*)malloc(size);
+        if (p == nullptr && size > 0) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    typedef struct Destructor {
+        void (*destroy)(void*);
+        void* object;
+        struct Destructor* next;
+    } Destructor;
+
+    char* block;
+    size_t block_size, offset = 0;
+    std::vector<char*> extra;
+    size_t extra_bytes = 0;
+    Destructor* destructors = nullptr;
+};
+
+class IndexRing {
+public:
+    explicit IndexRing(size_t capacity = 0) : items(capacity) {}
+
+    size_t size() const { return count; }
+    size_t capacity() const { return items.size(); }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == items.size(); }
+
+    // false when full
+    bool push(int index) {
+        if (full()) {
+            return false;
+        }
+        items[(head + count) % items.size()] = index;
+        count++;
+        return true;
+    }
+
+    // The oldest index, the ring must not be empty
+    int pop() {
+        int index = items[head];
+        head = (head + 1) % items.size();
+        count--;
+        return index;
+    }
+
+private:
+    std::vector<int> items;
+    size_t head = 0, count = 0;
+};
+
+#endif // FRAME_ARENA_H
@@ -0,0 +1,307 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "governor.h"
+
+using namespace std;
+using namespace chrono;
+
+#define SLOW_RETRY_STEPS    40      // Steps before a level too slow for the target is tried again
+#define FPS_LOW             0.97    // Under target_fps * FPS_LOW: one level up, else try one level down
+#define WATTS_ROOM          0.90    // Up again under max_watts * WATTS_ROOM
+#define CELSIUS_ROOM        3.0     // Up again under max_celsius - CELSIUS_ROOM
+
+static string read_line(const string& path) {
+    char line[512] = "";
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        return "";
+    }
+    if (fgets(line, sizeof(line), file) == NULL) {
+        line[0] = '\0';
+    }
+    fclose(file);
+    line[strcspn(line, "\r\n")] = '\0';
+    return line;
+}
+
+static bool write_line(const string& path, const string& value) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == NULL) {
+        return false;
+    }
+    bool written = fputs(value.c_str(), file) >= 0;
+    return fclose(file) == 0 && written;
+}
+
+static vector<string> list_dir(const string& path, const char* prefix) {
+    // Entries of path starting with prefix, sorted
+    vector<string> entries;
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL) {
+        return entries;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.' && strncmp(entry->d_name, prefix, strlen(prefix)) == 0) {
+            entries.push_back(path + "/" + entry->d_name);
+        }
+    }
+    closedir(dir);
+    sort(entries.begin(), entries.end());
+    return entries;
+}
+
+GovernorOptions default_governor_options() {
+    GovernorOptions options;
+    options.max_watts = 0;
+    options.max_celsius = 0;
+    options.target_fps = 0;
+    options.period_ms = 250;
+    options.max_runners = 4;
+    options.max_decoders = 4;
+    options.power = "hwmon";
+    options.sysfs = "/sys";
+    return options;
+}
+
+Governor::Governor(const GovernorOptions& governor_options)
+    : options(governor_options), meter(governor_options.power, governor_options.sysfs + "/class/hwmon") {
+    options.max_runners = max(options.max_runners, 1);
+    options.max_decoders = max(options.max_decoders, 1);
+
+    // Temperatures: the thermal zones, or the temperature inputs of hwmon
+    for (const string& zone : list_dir(options.sysfs + "/class/thermal", "thermal_zone")) {
+        if (!read_line(zone + "/temp").empty()) {
+            temperature_inputs.push_back(zone + "/temp");
+        }
+    }
+    if (temperature_inputs.empty()) {
+        for (const string& device : list_dir(options.sysfs + "/class/hwmon", "hwmon")) {
+            for (const string& input : list_dir(device, "temp")) {
+                if (input.find("_input") != string::npos) {
+                    temperature_inputs.push_back(input);
+                }
+            }
+        }
+    }
+
+    // Frequencies of the first policy, set on all of them
+    policies = list_dir(options.sysfs + "/devices/system/cpu/cpufreq", "policy");
+    if (!policies.empty()) {
+        stringstream available(read_line(policies[0] + "/scaling_available_frequencies"));
+        long khz;
+        while (available >> khz) {
+            frequencies.push_back(khz);
+        }
+        if (frequencies.empty()) {
+            long low = atol(read_line(policies[0] + "/cpuinfo_min_freq").c_str());
+            long high = atol(read_line(policies[0] + "/cpuinfo_max_freq").c_str());
+            if (low > 0 && high > low) {
+                frequencies = {low, high};
+            }
+        }
+        sort(frequencies.begin(), frequencies.end());
+        frequencies.erase(unique(frequencies.begin(), frequencies.end()), frequencies.end());
+    }
+    for (const string& policy : policies) {
+        original_max.push_back(read_line(policy + "/scaling_max_freq"));
+    }
+
+    top = options.max_runners - 1 + max(0, (int)frequencies.size() - 1);
+    slow_until.assign(top + 1, 0);
+    limits[GOVERN_RUNNERS] = n_runners_level = options.max_runners;
+    limits[GOVERN_DECODERS] = n_decoders_level = options.max_decoders;
+    frequency_index = max(0, (int)frequencies.size() - 1);
+    level = top;
+}
+
+Governor::~Governor() {
+    stop();
+}
+
+void Governor::set_level(int new_level) {
+    /*
+        Runners first, then the frequency: level r - 1 is r runners at the
+        lowest frequency, the levels above raise the frequency.
+    */
+    new_level = max(0, min(top, new_level));
+    if (new_level != level) {
+        level_changes++;
+    }
+    level = new_level;
+    int n_runners = min(options.max_runners, level + 1);
+    int index = max(0, level - (options.max_runners - 1));
+    if (!frequencies.empty() && index != frequency_index) {
+        bool written = true;
+        for (const string& policy : policies) {
+            written &= write_line(policy + "/scaling_max_freq", to_string(frequencies[index]));
+        }
+        if (written) {
+            frequency_index = index;
+        } else {
+            // Not allowed (not root): only the runners from now on
+            cerr << "[WARNING] Cannot write scaling_max_freq, the CPU frequency is left as is" << endl;
+            frequencies.clear();
+            frequency_index = 0;
+            top = options.max_runners - 1;
+            slow_until.resize(top + 1);
+            level = min(level, top);
+            n_runners = min(options.max_runners, level + 1);
+        }
+    }
+    int n_decoders = max(1, (n_runners * options.max_decoders + options.max_runners - 1) / options.max_runners);
+    n_runners_level = n_runners;
+    n_decoders_level = n_decoders;
+    lock_guard<mutex> lock(slot_mutex);
+    limits[GOVERN_RUNNERS] = n_runners;
+    limits[GOVERN_DECODERS] = n_decoders;
+    slot_changed.notify_all();
+}
+
+double Governor::read_celsius() const {
+    double hottest = 0;
+    for (const string& input : temperature_inputs) {
+        hottest = max(hottest, atof(read_line(input).c_str()) / 1000.0);
+    }
+    return hottest;
+}
+
+void Governor::step() {
+    /*
+        One period: the readings, then one level at most. A ceiling acts at
+        once; the other moves wait for one period after a change, for the
+        FPS of the new level to be measured on a whole period.
+    */
+    auto now = steady_clock::now();
+    double elapsed = duration<double>(now - last_step).count();
+    last_step = now;
+    long done = images.exchange(0);
+    if (n_steps == 0 || elapsed <= 0) {
+        // The first call only starts the first period
+        n_steps++;
+        return;
+    }
+    last_fps = done / elapsed;
+    double watts = meter.available() ? meter.read() : 0;
+    last_watts = n_steps == 1 || last_watts == 0 ? watts : 0.5 * last_watts + 0.5 * watts;
+    last_celsius = read_celsius();
+
+    seconds += elapsed;
+    joules += watts * elapsed;
+    images_seen += done;
+    max_celsius_seen = max(max_celsius_seen, last_celsius.load());
+    periods++;
+
+    bool over = (options.max_watts > 0 && last_watts > options.max_watts) ||
+                (options.max_celsius > 0 && last_celsius > options.max_celsius);
+    bool room = (options.max_watts <= 0 || last_watts < options.max_watts * WATTS_ROOM) &&
+                (options.max_celsius <= 0 || last_celsius < options.max_celsius - CELSIUS_ROOM);
+    periods_over += over;
+
+    int next = level;
+    if (over) {
+        next = level - 1;
+    } else if (hold > 0) {
+        hold--;
+    } else if (options.target_fps > 0) {
+        if (last_fps < options.target_fps * FPS_LOW) {
+            slow_until[level] = n_steps + SLOW_RETRY_STEPS;
+            if (room) {
+                next = level + 1;
+            }
+        } else if (level > 0 && slow_until[level - 1] <= n_steps) {
+            next = level - 1;
+        }
+    } else if (room) {
+        next = level + 1;
+    }
+    if (next != level && next >= 0 && next <= top) {
+        set_level(next);
+        hold = 1;
+    }
+    n_steps++;
+}
+
+void Governor::run() {
+    unique_lock<mutex> lock(stop_mutex);
+    while (running) {
+        stop_changed.wait_for(lock, milliseconds(options.period_ms), [&]() { return !running; });
+        if (running) {
+            lock.unlock();
+            step();
+            lock.lock();
+        }
+    }
+}
+
+void Governor::start() {
+    if (running) {
+        return;
+    }
+    set_level(top);
+    level_changes = 0;
+    step();
+    running = true;
+    controller = thread([this]() { run(); });
+}
+
+void Governor::stop() {
+    if (running) {
+        {
+            lock_guard<mutex> lock(stop_mutex);
+            running = false;
+        }
+        stop_changed.notify_all();
+        controller.join();
+    }
+    for (size_t i = 0; i < policies.size() && i < original_max.size(); i++) {
+        if (!original_max[i].empty() && !frequencies.empty()) {
+            write_line(policies[i] + "/scaling_max_freq", original_max[i]);
+        }
+    }
+    // No limit once stopped, nobody waits for a slot
+    lock_guard<mutex> lock(slot_mutex);
+    limits[GOVERN_RUNNERS] = limits[GOVERN_DECODERS] = INT32_MAX;
+    slot_changed.notify_all();
+}
+
+void Governor::acquire(int pool) {
+    unique_lock<mutex> lock(slot_mutex);
+    slot_changed.wait(lock, [&]() { return in_use[pool] < limits[pool]; });
+    in_use[pool]++;
+}
+
+void Governor::release(int pool, int n_images) {
+    images += n_images;
+    lock_guard<mutex> lock(slot_mutex);
+    in_use[pool]--;
+    slot_changed.notify_all();
+}
+
+void Governor::print_summary() const {
+    double fps = seconds > 0 ? images_seen / seconds : 0;
+    double watts = seconds > 0 ? joules / seconds : 0;
+    cout << "Governor: " << fixed << setprecision(2) << fps << " FPS, " << watts << " W";
+    if (images_seen > 0 && joules > 0) {
+        cout << ", " << setprecision(1) << 1000 * joules / images_seen << " mJ/image";
+    }
+    if (!temperature_inputs.empty()) {
+        cout << ", up to " << setprecision(1) << max_celsius_seen << " C";
+    }
+    cout << ", " << level_changes << " changes, over the ceiling " << setprecision(1)
+         << (periods > 0 ? 100.0 * periods_over / periods : 0.0) << "% of the time" << endl;
+    cout << "Last level: " << n_runners_level.load() << " runners, " << n_decoders_level.load() << " decoders";
+    if (!frequencies.empty()) {
+        cout << ", " << frequencies[frequency_index.load()] / 1000 << " MHz";
+    }
+    cout << endl;
+}
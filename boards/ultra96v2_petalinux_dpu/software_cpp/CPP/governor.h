@@ -0,0 +1,121 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "power_meter.h"
+
+#define GOVERN_RUNNERS  0
+#define GOVERN_DECODERS 1
+
+/*
+    Thread that adapts the work of the driver to a power or temperature
+    ceiling, or to the lowest energy per image at a target FPS. Every period
+    it reads the power (power_meter.h), the hottest thermal zone (or the
+    temperature inputs of hwmon when there is none) and the images completed,
+    then moves one step on a ladder of configurations, from 1 runner at the
+    lowest CPU frequency to all the runners at the highest one:
+    - the runners are added first: they mostly wait for the DPU, the CPU
+      clock is the cheaper thing to keep low;
+    - then the CPU frequency, by writing scaling_max_freq of the cpufreq
+      policies (root needed; without it the ladder has only the runners);
+    - the decoders follow the runners in proportion.
+    Over a ceiling, it goes one step down at once. Under it with some room,
+    it goes up again. With a target FPS, it goes down while the FPS holds
+    (the frames of a camera come at that rate), and up when it does not; a
+    level too slow is not retried for a while.
+
+    The runners and decoders ask for a slot before each job and give it back
+    after, so the number running is limited without stopping threads:
+
+        governor.acquire(GOVERN_RUNNERS);
+        ... run a batch ...
+        governor.release(GOVERN_RUNNERS, batch_size);
+*/
+
+typedef struct {
+    double max_watts;           // Power ceiling, 0 for none
+    double max_celsius;         // Temperature ceiling, 0 for none
+    double target_fps;          // Lowest energy per image at this FPS, 0 for the highest FPS under the ceilings
+    int period_ms;              // Between two steps
+    int max_runners;
+    int max_decoders;
+    std::string power;          // Source of the power meter (see power_meter.h)
+    std::string sysfs;          // Root of sysfs: /sys, or a fake tree for the tests
+} GovernorOptions;
+
+GovernorOptions default_governor_options();
+
+class Governor {
+public:
+    explicit Governor(const GovernorOptions& options);
+    ~Governor();
+    Governor(const Governor&) = delete;
+    Governor& operator=(const Governor&) = delete;
+
+    // Start the control thread; stop it and restore the CPU frequency
+    void start();
+    void stop();
+
+    // Slot of a runner or decoder (GOVERN_*): wait while all the allowed ones are taken
+    void acquire(int pool);
+    // Give it back, with the number of images completed for the FPS
+    void release(int pool, int images = 0);
+
+    int runners() const { return n_runners_level.load(); }
+    int decoders() const { return n_decoders_level.load(); }
+    long frequency_khz() const { return frequencies.empty() ? 0 : frequencies[frequency_index.load()]; }
+    // Last readings, 0 when not available
+    double watts() const { return last_watts.load(); }
+    double celsius() const { return last_celsius.load(); }
+    double fps() const { return last_fps.load(); }
+
+    // Averages since start: power, energy per image, hottest temperature, steps
+    void print_summary() const;
+
+private:
+    double read_celsius() const;
+    void step();
+    void set_level(int level);
+    void run();
+
+    GovernorOptions options;
+    PowerMeter meter;
+    std::vector<std::string> temperature_inputs;
+    std::vector<std::string> policies;         // cpufreq policy directories
+    std::vector<std::string> original_max;     // scaling_max_freq of each policy before start
+    std::vector<long> frequencies;             // kHz, ascending
+    // Set by the control thread, read by the others
+    std::atomic<int> frequency_index{0};
+
+    int level = 0, top = 0;
+    std::atomic<int> n_runners_level{0}, n_decoders_level{0};
+    long n_steps = 0;
+    std::chrono::steady_clock::time_point last_step;
+    std::vector<long> slow_until;              // Step until which a level is not retried
+    int hold = 0;
+
+    std::mutex slot_mutex;
+    std::condition_variable slot_changed;
+    int limits[2];
+    int in_use[2] = {0, 0};
+    std::atomic<long> images{0};
+
+    std::thread controller;
+    std::atomic<bool> running{false};
+    std::mutex stop_mutex;
+    std::condition_variable stop_changed;
+
+    std::atomic<double> last_watts{0}, last_celsius{0}, last_fps{0};
+    // Since start
+    double seconds = 0, joules = 0, max_celsius_seen = 0;
+    long images_seen = 0, level_changes = 0, periods_over = 0, periods = 0;
+};
+
+#endif // GOVERNOR_H
@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "governor.h"
+
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -o governor_bench governor_bench.cpp governor.cpp power_meter.cpp -lpthread
+
+#define MAX_KHZ         1199999
+#define QUEUE_SIZE      8       // Decoded images waiting for a runner
+
+/*
+    A board simulated on a fake sysfs tree: the governor reads the power of
+    an hwmon device and the temperature of a thermal zone written by the
+    model of the board, and sets the CPU frequency in scaling_max_freq, read
+    by the model. The frequencies are those of the Ultra96v2.
+    - decoders: decode_ms of CPU per image at the highest frequency, longer
+      at a lower one;
+    - runners: cpu_ms of CPU per image, then dpu_ms on the DPU, which runs
+      one job at a time;
+    - power: static + clock (scales with the frequency) + busy cores (with
+      the square of the frequency, for the voltage) + busy DPU;
+    - temperature: first order, ambient + thermal resistance * power, with a
+      time constant.
+*/
+typedef struct {
+    double decode_ms, cpu_ms, dpu_ms;
+    double static_w, clock_w, core_w, dpu_w;
+    double ambient_c, c_per_w, tau_s;
+} BoardModel;
+
+class FakeBoard {
+public:
+    FakeBoard(const string& root, const BoardModel& model) : root(root), model(model) {
+        for (const char* dir : {"/class", "/class/thermal", "/class/thermal/thermal_zone0", "/class/hwmon",
+                                "/class/hwmon/hwmon0", "/devices", "/devices/system", "/devices/system/cpu",
+                                "/devices/system/cpu/cpufreq", "/devices/system/cpu/cpufreq/policy0"}) {
+            mkdir((root + dir).c_str(), 0755);
+        }
+        write("/class/hwmon/hwmon0/name", "ina260");
+        write("/devices/system/cpu/cpufreq/policy0/scaling_available_frequencies", "299999 399999 599999 1199999 ");
+        write("/devices/system/cpu/cpufreq/policy0/cpuinfo_min_freq", "299999");
+        write("/devices/system/cpu/cpufreq/policy0/cpuinfo_max_freq", to_string(MAX_KHZ));
+        reset();
+    }
+
+    ~FakeBoard() {
+        for (const char* file : {"/class/hwmon/hwmon0/name", "/class/hwmon/hwmon0/power1_input",
+                                 "/class/thermal/thermal_zone0/temp",
+                                 "/devices/system/cpu/cpufreq/policy0/scaling_available_frequencies",
+                                 "/devices/system/cpu/cpufreq/policy0/cpuinfo_min_freq",
+                                 "/devices/system/cpu/cpufreq/policy0/cpuinfo_max_freq",
+                                 "/devices/system/cpu/cpufreq/policy0/scaling_max_freq"}) {
+            unlink((root + file).c_str());
+        }
+        for (const char* dir : {"/devices/system/cpu/cpufreq/policy0", "/devices/system/cpu/cpufreq",
+                                "/devices/system/cpu", "/devices/system", "/devices", "/class/hwmon/hwmon0",
+                                "/class/hwmon", "/class/thermal/thermal_zone0", "/class/thermal", "/class", ""}) {
+            rmdir((root + dir).c_str());
+        }
+    }
+
+    void reset() {
+        write("/devices/system/cpu/cpufreq/policy0/scaling_max_freq", to_string(MAX_KHZ));
+        celsius = 45;
+        frequency = 1;
+        write("/class/thermal/thermal_zone0/temp", to_string((long)(celsius * 1000)));
+        write("/class/hwmon/hwmon0/power1_input", to_string((long)(model.static_w * 1e6)));
+        cpu_busy_us = dpu_busy_us = 0;
+        images = 0;
+    }
+
+    // Replaced atomically, the governor never reads a half written file
+    void write(const char* file, const string& value) {
+        string path = root + file, temp = path + ".new";
+        FILE* f = fopen(temp.c_str(), "w");
+        if (f != NULL) {
+            fputs(value.c_str(), f);
+            fclose(f);
+            rename(temp.c_str(), path.c_str());
+        }
+    }
+
+    void update(double dt) {
+        // The frequency set by the governor, then the power and temperature of the last dt seconds
+        FILE* f = fopen((root + "/devices/system/cpu/cpufreq/policy0/scaling_max_freq").c_str(), "r");
+        long khz = MAX_KHZ;
+        if (f != NULL) {
+            if (fscanf(f, "%ld", &khz) != 1) {
+                khz = MAX_KHZ;
+            }
+            fclose(f);
+        }
+        frequency = (double)khz / MAX_KHZ;
+        double cores = cpu_busy_us.exchange(0) * 1e-6 / dt;
+        double dpu = min(1.0, dpu_busy_us.exchange(0) * 1e-6 / dt);
+        watts = model.static_w + model.clock_w * frequency + model.core_w * cores * frequency * frequency +
+                model.dpu_w * dpu;
+        celsius += dt / model.tau_s * (model.ambient_c + model.c_per_w * watts - celsius);
+        write("/class/hwmon/hwmon0/power1_input", to_string((long)(watts * 1e6)));
+        write("/class/thermal/thermal_zone0/temp", to_string((long)(celsius * 1000)));
+    }
+
+    // Work of the threads, at the frequency of the moment
+    void cpu_work(double ms_at_max) {
+        long us = (long)(ms_at_max * 1000 / frequency);
+        this_thread::sleep_for(microseconds(us));
+        cpu_busy_us += us;
+    }
+    void dpu_work() {
+        lock_guard<mutex> lock(dpu_mutex);
+        long us = (long)(model.dpu_ms * 1000);
+        this_thread::sleep_for(microseconds(us));
+        dpu_busy_us += us;
+    }
+
+    string root;
+    BoardModel model;
+    atomic<double> frequency{1};
+    double watts = 0, celsius = 0;
+    atomic<long> cpu_busy_us{0}, dpu_busy_us{0}, images{0};
+    mutex dpu_mutex;
+};
+
+typedef struct {
+    double fps, watts, mj_per_image, max_celsius;
+    int runners, decoders;
+    long mhz;
+} Result;
+
+static Result run_mode(const char* name, FakeBoard& board, GovernorOptions options, bool govern, double input_fps,
+                       int seconds) {
+    /*
+        Decoders and runners for seconds, with or without the governor, on
+        frames that come at input_fps like those of a camera (dropped when
+        the decoders are late), or as fast as they are taken with 0. The
+        figures are those of the second half, once settled.
+    */
+    board.reset();
+    Governor governor(options);
+    if (govern) {
+        governor.start();
+    }
+    atomic<bool> stopping(false);
+    mutex queue_mutex;
+    condition_variable queue_changed;
+    int ready = 0, frames = 0;
+
+    vector<thread> threads;
+    if (input_fps > 0) {
+        threads.emplace_back([&]() {
+            auto next = steady_clock::now();
+            auto period = duration_cast<steady_clock::duration>(duration<double>(1 / input_fps));
+            while (!stopping) {
+                next += period;
+                this_thread::sleep_until(next);
+                lock_guard<mutex> lock(queue_mutex);
+                frames = min(frames + 1, QUEUE_SIZE);
+                queue_changed.notify_all();
+            }
+        });
+    }
+    for (int i = 0; i < options.max_decoders; i++) {
+        threads.emplace_back([&]() {
+            while (!stopping) {
+                governor.acquire(GOVERN_DECODERS);
+                {
+                    unique_lock<mutex> lock(queue_mutex);
+                    queue_changed.wait(lock, [&]() {
+                        return (ready < QUEUE_SIZE && (input_fps <= 0 || frames > 0)) || stopping;
+                    });
+                    if (input_fps > 0) {
+                        frames--;
+                    }
+                }
+                board.cpu_work(board.model.decode_ms);
+                {
+                    lock_guard<mutex> lock(queue_mutex);
+                    ready++;
+                }
+                queue_changed.notify_all();
+                governor.release(GOVERN_DECODERS);
+            }
+        });
+    }
+    for (int i = 0; i < options.max_runners; i++) {
+        threads.emplace_back([&]() {
+            while (!stopping) {
+                governor.acquire(GOVERN_RUNNERS);
+                {
+                    unique_lock<mutex> lock(queue_mutex);
+                    queue_changed.wait(lock, [&]() { return ready > 0 || stopping; });
+                    if (stopping) {
+                        governor.release(GOVERN_RUNNERS);
+                        break;
+                    }
+                    ready--;
+                }
+                queue_changed.notify_all();
+                board.cpu_work(board.model.cpu_ms);
+                board.dpu_work();
+                board.images++;
+                governor.release(GOVERN_RUNNERS, 1);
+            }
+        });
+    }
+
+    // The model of the board, every 10 ms; measured over the second half
+    double joules = 0, max_celsius = 0, measured = 0;
+    long images_start = 0;
+    auto start = steady_clock::now(), last = start;
+    while (true) {
+        this_thread::sleep_for(milliseconds(10));
+        auto now = steady_clock::now();
+        double t = duration<double>(now - start).count();
+        if (t >= seconds) {
+            break;
+        }
+        double dt = duration<double>(now - last).count();
+        last = now;
+        board.update(dt);
+        if (t >= seconds / 2.0) {
+            if (measured == 0) {
+                images_start = board.images;
+            }
+            joules += board.watts * dt;
+            measured += dt;
+            max_celsius = max(max_celsius, board.celsius);
+        }
+    }
+    long n_images = board.images - images_start;
+    Result result;
+    result.runners = governor.runners();
+    result.decoders = governor.decoders();
+    result.mhz = govern ? governor.frequency_khz() / 1000 : MAX_KHZ / 1000;
+
+    stopping = true;
+    governor.stop();
+    queue_changed.notify_all();
+    for (auto& t : threads) {
+        t.join();
+    }
+    result.fps = n_images / measured;
+    result.watts = joules / measured;
+    result.mj_per_image = n_images > 0 ? 1000 * joules / n_images : 0;
+    result.max_celsius = max_celsius;
+    printf("%-34s %7.1f %7.2f %9.1f %7.1f %8d %8d %6ld\n", name, result.fps, result.watts, result.mj_per_image,
+           result.max_celsius, result.runners, result.decoders, result.mhz);
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    int seconds = argc > 1 ? atoi(argv[1]) : 8;
+    double max_watts = argc > 2 ? atof(argv[2]) : 6;
+    double max_celsius = argc > 3 ? atof(argv[3]) : 60;
+    double target_fps = argc > 4 ? atof(argv[4]) : 120;
+    // Under the power of 4 runners at the lowest frequency: the governor must remove runners
+    double low_watts = argc > 5 ? atof(argv[5]) : 4;
+    if (seconds < 2 || max_watts <= 0 || max_celsius <= 0 || target_fps <= 0 || low_watts <= 0) {
+        printf("Usage: %s [seconds per mode >= 2] [max watts] [max celsius] [target fps] [low max watts]\n", argv[0]);
+        return 1;
+    }
+    char root[] = "/tmp/fake_sysfs_XXXXXX";
+    if (mkdtemp(root) == NULL) {
+        printf("[ERROR] Cannot create the fake sysfs\n");
+        return 1;
+    }
+    BoardModel model = {6, 1, 4, 2.5, 1.0, 0.6, 2.5, 30, 6, 2};
+    FakeBoard board(root, model);
+
+    GovernorOptions options = default_governor_options();
+    options.sysfs = root;
+    options.period_ms = 100;
+    options.power = "hwmon:ina260";
+    printf("Fake sysfs in %s, %d s per mode, DPU %.0f ms per image (up to %.0f FPS)\n", root, seconds, model.dpu_ms,
+           1000 / model.dpu_ms);
+    printf("%-34s %7s %7s %9s %7s %8s %8s %6s\n", "Mode", "FPS", "W", "mJ/image", "Max C", "Runners", "Decoders", "MHz");
+
+    run_mode("Fixed: 4 runners, highest frequency", board, options, false, 0, seconds);
+    char name[64];
+    GovernorOptions power = options;
+    power.max_watts = max_watts;
+    snprintf(name, sizeof(name), "Power ceiling %.1f W", max_watts);
+    Result power_result = run_mode(name, board, power, true, 0, seconds);
+    GovernorOptions low_power = options;
+    low_power.max_watts = low_watts;
+    snprintf(name, sizeof(name), "Power ceiling %.1f W", low_watts);
+    Result low_power_result = run_mode(name, board, low_power, true, 0, seconds);
+
+    GovernorOptions thermal = options;
+    thermal.max_celsius = max_celsius;
+    snprintf(name, sizeof(name), "Temperature ceiling %.0f C", max_celsius);
+    Result thermal_result = run_mode(name, board, thermal, true, 0, seconds);
+
+    // A camera at target_fps: the fixed configuration waits at the highest frequency
+    snprintf(name, sizeof(name), "Fixed, camera at %.0f FPS", target_fps);
+    Result paced = run_mode(name, board, options, false, target_fps, seconds);
+    GovernorOptions energy = options;
+    energy.target_fps = target_fps;
+    snprintf(name, sizeof(name), "Lowest energy, camera at %.0f FPS", target_fps);
+    Result energy_result = run_mode(name, board, energy, true, target_fps, seconds);
+
+    int errors = 0;
+    if (power_result.watts > max_watts * 1.05) {
+        printf("[ERROR] %.2f W over the ceiling of %.1f W\n", power_result.watts, max_watts);
+        errors++;
+    }
+    if (low_power_result.watts > low_watts * 1.05 || low_power_result.runners >= options.max_runners) {
+        printf("[ERROR] %.2f W with %d runners for a ceiling of %.1f W, fewer than %d runners expected\n",
+               low_power_result.watts, low_power_result.runners, low_watts, options.max_runners);
+        errors++;
+    }
+    if (thermal_result.max_celsius > max_celsius + 1.5) {
+        printf("[ERROR] %.1f C over the ceiling of %.0f C\n", thermal_result.max_celsius, max_celsius);
+        errors++;
+    }
+    if (energy_result.fps < target_fps * 0.95 || energy_result.mj_per_image >= paced.mj_per_image) {
+        printf("[ERROR] %.1f FPS for a target of %.0f, %.1f mJ/image (%.1f fixed)\n", energy_result.fps, target_fps,
+               energy_result.mj_per_image, paced.mj_per_image);
+        errors++;
+    }
+    if (errors == 0) {
+        printf("[SUCCESS] Ceilings held (%d runners under %.1f W), %.0f%% less energy per image at %.0f FPS\n",
+               low_power_result.runners, low_watts, 100 * (1 - energy_result.mj_per_image / paced.mj_per_image),
+               target_fps);
+    }
+    return errors == 0 ? 0 : 1;
+}
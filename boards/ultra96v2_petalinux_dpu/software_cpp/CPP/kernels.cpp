@@ -0,0 +1,54 @@
+#include <math.h>
+
+#include <algorithm>
+
+#include "kernels.h"
+
+using namespace std;
+
+ModelKernels::ModelKernels(const ModelManifest& manifest, float input_scale, bool rgb_input) {
+    /*
+        The table has the values of the OpenCV preprocessing: (x / 255 - mean)
+        / std in float, times the input scale, rounded to the nearest even
+        and saturated.
+    */
+    n_pixels = manifest.width * manifest.height;
+    channels = manifest.channels;
+    classes = manifest.classes.size();
+    // R and B swapped when the model and the images do not have the same order
+    swap_rb = manifest.rgb != rgb_input;
+    for (int c = 0; c < channels; c++) {
+        for (int x = 0; x < 256; x++) {
+            float v = (x / 255.0f - manifest.mean[c]) / manifest.std[c];
+            table.values[c][x] = (int8_t)max(-128.0f, min(127.0f, nearbyintf(v * input_scale)));
+        }
+    }
+
+    preprocess_kernel = NULL;
+    if (manifest.width == 224 && manifest.height == 224 && channels == 3) {
+        preprocess_kernel = swap_rb ? preprocess_fixed<224, 224, 3, true> : preprocess_fixed<224, 224, 3, false>;
+    }
+    classify_kernel = NULL;
+    if (classes == 12) {
+        classify_kernel = classify_fixed<12>;
+    } else if (classes == 1000) {
+        classify_kernel = classify_fixed<1000>;
+    }
+}
+
+void ModelKernels::preprocess(const uint8_t* image, int8_t* input) const {
+    if (preprocess_kernel != NULL) {
+        preprocess_kernel(image, input, table);
+    } else if (swap_rb) {
+        preprocess_image<true>(image, input, n_pixels, channels, table);
+    } else {
+        preprocess_image<false>(image, input, n_pixels, channels, table);
+    }
+}
+
+int ModelKernels::classify(const int8_t* logits, float scale, float* probability) const {
+    if (classify_kernel != NULL) {
+        return classify_kernel(logits, scale, probability);
+    }
+    return classify_logits(logits, classes, scale, probability);
+}
@@ -0,0 +1,87 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include "model_manifest.h"
+
+/*
+    Preprocessing and postprocessing of the images of a model. The kernels
+    are templates on the dimensions: the common ones (224x224x3, 12 and 1000
+    classes) are instantiated in kernels.cpp with the dimensions as
+    constants, like when they were #defines, and the other models of a
+    manifest use the same code with the dimensions at run time.
+*/
+
+// int8 input of each byte value of each channel: the normalization of the manifest at the input
+// scale of the model, computed once
+typedef struct {
+    int8_t values[MANIFEST_MAX_CHANNELS][256];
+} PreprocessTable;
+
+template <bool SWAP_RB>
+inline void preprocess_image(const uint8_t* image, int8_t* input, int n_pixels, int channels, const PreprocessTable& table) {
+    for (int p = 0; p < n_pixels; p++) {
+        const uint8_t* pixel = image + p * channels;
+        int8_t* out = input + p * channels;
+        for (int c = 0; c < channels; c++) {
+            out[c] = table.values[c][pixel[SWAP_RB ? channels - 1 - c : c]];
+        }
+    }
+}
+
+template <int WIDTH, int HEIGHT, int CHANNELS, bool SWAP_RB>
+void preprocess_fixed(const uint8_t* image, int8_t* input, const PreprocessTable& table) {
+    preprocess_image<SWAP_RB>(image, input, WIDTH * HEIGHT, CHANNELS, table);
+}
+
+inline int classify_logits(const int8_t* logits, int n_classes, float scale, float* probability) {
+    // The best class is the largest logit; its softmax probability shifted by it
+    int best = 0;
+    for (int i = 1; i < n_classes; i++) {
+        if (logits[i] > logits[best]) {
+            best = i;
+        }
+    }
+    if (probability != NULL) {
+        float sum = 0;
+        for (int i = 0; i < n_classes; i++) {
+            sum += expf((logits[i] - logits[best]) * scale);
+        }
+        *probability = 1.0f / sum;
+    }
+    return best;
+}
+
+template <int N_CLASSES>
+int classify_fixed(const int8_t* logits, float scale, float* probability) {
+    return classify_logits(logits, N_CLASSES, scale, probability);
+}
+
+// The kernels of a manifest, the instantiated ones if they fit it
+class ModelKernels {
+public:
+    // For images in BGR (OpenCV), or in RGB with rgb_input (the frames of a frame ring)
+    ModelKernels(const ModelManifest& manifest, float input_scale, bool rgb_input = false);
+
+    // input_size() int8 values from an image of the manifest size, in the channel order given above
+    void preprocess(const uint8_t* image, int8_t* input) const;
+    // Class of the n_classes() logits, and its probability if not NULL
+    int classify(const int8_t* logits, float scale, float* probability = NULL) const;
+
+    int input_size() const { return n_pixels * channels; }
+    int n_classes() const { return classes; }
+    // Instantiated for the dimensions, or at run time
+    bool fixed_preprocess() const { return preprocess_kernel != NULL; }
+    bool fixed_classify() const { return classify_kernel != NULL; }
+
+private:
+    PreprocessTable table;
+    int n_pixels, channels, classes;
+    bool swap_rb;
+    void (*preprocess_kernel)(const uint8_t*, int8_t*, const PreprocessTable&);
+    int (*classify_kernel)(const int8_t*, float, float*);
+};
+
+#endif // KERNELS_H
@@ -1,6 +1,9 @@
+#include <dirent.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <climits>
 #include <chrono>
 #include <cmath>
 #include <fstream>
@@ -8,6 +11,7 @@
 #include <mutex>
 #include <opencv2/opencv.hpp>
 #include <queue>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
@@ -18,12 +22,29 @@
 #include <numeric>
 
 #include "common.h"
+#include "color_correction.h"
+#include "tar_dataset.h"
+#include "prefetch_reader.h"
+#include "frame_ring.h"
+#include "cascade.h"
+#include "xmodel_pipeline.h"
+#include "zero_copy.h"
+#include "model_manifest.h"
+#include "kernels.h"
+#include "alloc_counter.h"
+#include "governor.h"
+#include "autotune.h"
+#include "deadline_scheduler.h"
 
-#define IMAGE_WIDTH         224
-#define IMAGE_HEIGHT        224
-#define IMAGE_CHANNELS      3
-#define IMAGE_TOTAL_PIXELS  (IMAGE_WIDTH * IMAGE_HEIGHT * IMAGE_CHANNELS)
-#define N_CLASSES           12
+#define PREFETCH_WINDOW     32
+#define PREFETCH_THREADS    4
+#define TUNE_SAMPLE         500     // Images of a calibration pass
+#define LIVE_SLOTS          32      // Inputs of the live frames waiting for the runners
+#define LIVE_POLL_MS        100
+#define RING_OPEN_MS        30000   // For the producer to create the frame ring
+#define RING_POLL_MS        1000    // Between the checks that the producer is alive
+#define LANE_LIVE           0
+#define LANE_BULK           1
 
 GraphInfo shapes;
 using namespace std;
@@ -32,88 +53,181 @@ using namespace cv;
 
 typedef int8_t dpu_type;
 
+// The model, from the manifest given on the command line or the defaults
+static ModelManifest manifest = default_model_manifest();
+
+static int image_size() {
+    return manifest.width * manifest.height * manifest.channels;
+}
+
+static int n_classes() {
+    return manifest.classes.size();
+}
+
 static const char* lookup(int index) {
-  static const char* table[] = {
-#include "../resnet50_pt/words.inc"
-  };
-
-  if (index < 0) {
-    return "";
-  } else {
-    return table[index];
-  }
+    if (index < 0) {
+        return "";
+    } else {
+        return manifest.classes[index].c_str();
+    }
 };
 
-void load_images_from_folder(const string& folder_path, int max_images, uint8_t* images, uint8_t* labels) {
-    int n_images = 0;   
-    // Iterate through the lookup table of the class
-    for (int i = 0; i < N_CLASSES; i++) {
-        if (n_images >= max_images) {
-            break;
-        }
+typedef struct {
+    string path;
+    uint16_t label;
+    ino_t inode;
+} DatasetFile;
+
+vector<DatasetFile> list_images_in_folder(const string& folder_path) {
+    // Walk the class subfolders once, readdir gives the inode without a stat per file
+    vector<DatasetFile> files;
+    for (int i = 0; i < n_classes(); i++) {
         string class_folder = folder_path + "/" + lookup(i);
-        int n_images_class = 0;
-        for (const auto& entry : filesystem::directory_iterator(class_folder)) {
-            if (entry.is_regular_file()) {
-                string image_path = entry.path();
-                Mat image = imread(image_path);
-                if (image.empty()) {
-                    cout << "Could not read image: " << image_path << endl;
-                    continue;
-                }
-                resize(image, image, Size(IMAGE_WIDTH, IMAGE_HEIGHT));
-                memcpy(images + n_images * IMAGE_TOTAL_PIXELS, image.data, IMAGE_TOTAL_PIXELS);
-                memcpy(labels + n_images, (uint8_t*)&i, sizeof(uint8_t));
-                n_images++;
-                n_images_class++;
-            }
-            if (n_images >= max_images) {
-                break;
+        DIR* dir = opendir(class_folder.c_str());
+        if (dir == NULL) {
+            cout << "Could not open folder: " << class_folder << endl;
+            continue;
+        }
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            string image_path = class_folder + "/" + entry->d_name;
+            if (entry->d_type == DT_REG || (entry->d_type == DT_UNKNOWN && filesystem::is_regular_file(image_path))) {
+                files.push_back({image_path, (uint16_t)i, entry->d_ino});
             }
         }
-        cout << "Found " << n_images_class << " images for class " << lookup(i) << endl;
+        closedir(dir);
+
+        cout << "class_folder " << class_folder << endl;
+    }
+    // Read the files in inode order, which is close to their order on the card
+    stable_sort(files.begin(), files.end(), [](const DatasetFile& a, const DatasetFile& b) { return a.inode < b.inode; });
+    return files;
+}
+
+int load_images_from_folder(const vector<DatasetFile>& files, uint8_t* images, uint16_t* labels, int prefetch_window, const ColorCorrectionParams* color_correction) {
+    vector<string> paths;
+    for (const auto& file : files) {
+        paths.push_back(file.path);
+    }
+    // The files are read ahead while the previous ones are decoded
+    PrefetchReader reader(paths, prefetch_window, PREFETCH_THREADS);
+    vector<uint8_t> data;
+    vector<int> n_images_class(n_classes(), 0);
+    int n_images = 0;
+    double read_wait = 0, decode = 0;
+    // Reused from one image to the next, reallocated only for another size
+    Mat image, resized;
+
+    for (size_t f = 0; f < files.size(); f++) {
+        auto read_start = high_resolution_clock::now();
+        reader.next(data);
+        auto decode_start = high_resolution_clock::now();
+
+        image.release();
+        if (!data.empty()) {
+            imdecode(Mat(1, data.size(), CV_8UC1, data.data()), IMREAD_COLOR, &image);
+        }
+        if (image.empty()) {
+            cout << "Could not read image: " << files[f].path << endl;
+            continue;
+        }
+        resize(image, resized, Size(manifest.width, manifest.height));
+        if (color_correction != NULL) {
+            correct_colors(resized.data, manifest.width, manifest.height, color_correction);
+        }
+        memcpy(images + n_images * image_size(), resized.data, image_size());
+        labels[n_images] = files[f].label;
+        n_images_class[files[f].label]++;
+        n_images++;
+
+        auto decode_stop = high_resolution_clock::now();
+        read_wait += duration_cast<duration<double>>(decode_start - read_start).count();
+        decode += duration_cast<duration<double>>(decode_stop - decode_start).count();
+    }
+
+    for (int i = 0; i < n_classes(); i++) {
+        cout << "Found " << n_images_class[i] << " images for class " << lookup(i) << endl;
     }
     cout << "Found " << n_images << " images in total" << endl;
+    cout << "Waiting for reads: " << fixed << setprecision(2) << read_wait << " seconds, decode + resize: " << decode
+         << " seconds (" << (reader.using_io_uring() ? "io_uring" : "thread pool") << ", window " << prefetch_window << ")" << endl;
+    return n_images;
 }
 
-void preprocessImages(uint8_t* images, dpu_type* processed_image_buffer, int n_images, float scale) {
+void preprocessImages(const ModelKernels& kernels, uint8_t* images, dpu_type* processed_image_buffer, int n_images) {
+    // Written in place in the buffer, which can be the mapped input of the DPU
     for (int i = 0; i < n_images; i++) {
-        Mat processed_image = Mat(IMAGE_HEIGHT, IMAGE_WIDTH, CV_8UC3, images + i * IMAGE_TOTAL_PIXELS);
-        processed_image.convertTo(processed_image, CV_32FC3);
-        cvtColor(processed_image, processed_image, COLOR_BGR2RGB);
-        processed_image = processed_image / 255.0f;
-        float mean[3] = {0.485f, 0.456f, 0.406f};
-        float std[3] = {0.229f, 0.224f, 0.225f};
-        subtract(processed_image, Scalar(mean[0], mean[1], mean[2]), processed_image);
-        divide(processed_image, Scalar(std[0], std[1], std[2]), processed_image);
-        processed_image.convertTo(processed_image, CV_8SC3, scale);
-        memcpy(processed_image_buffer + i * IMAGE_TOTAL_PIXELS, processed_image.data, IMAGE_TOTAL_PIXELS*sizeof(dpu_type));
+        kernels.preprocess(images + (size_t)i * image_size(), processed_image_buffer + (size_t)i * image_size());
     }
 }
 
-static vector<float> softmax(const vector<float>& input) {
-    auto output = vector<float>(input.size());
-    transform(input.begin(), input.end(), output.begin(), expf);
-    auto sum = accumulate(output.begin(), output.end(), 0.0f);
-    transform(output.begin(), output.end(), output.begin(),
-                   [sum](float v) { return v / sum; });
-    return output;
+bool preprocessFrame(uint8_t* slot, const FrameRingInfo& info, const ModelKernels& kernels, const ColorCorrectionParams* color_correction, dpu_type* input) {
+    /*
+        A frame of a ring, preprocessed from the slot. The frames are RGB
+        (frame_to_rgb of the UART receiver): kernels must be made with
+        rgb_input.
+    */
+    if (info.size != info.width * info.height * manifest.channels) {
+        cout << "Skipping a frame of " << info.size << " bytes" << endl;
+        return false;
+    }
+    Mat image(info.height, info.width, CV_8UC3, slot);
+    if (info.width != (uint32_t)manifest.width || info.height != (uint32_t)manifest.height) {
+        resize(image, image, Size(manifest.width, manifest.height));
+    }
+    if (color_correction != NULL) {
+        correct_colors(image.data, manifest.width, manifest.height, color_correction);
+    }
+    preprocessImages(kernels, image.data, input, 1);
+    return true;
 }
 
-static vector<float> int8ToFloat(const int8_t* input, int size, float scale) {
-    auto output = vector<float>(size);
-    for (int i = 0; i < size; i++) {
-        output[i] = input[i] * scale;
+int load_images_from_ring(const string& ring_name, vector<dpu_type>& input, vector<uint16_t>& labels, const ModelKernels& kernels, const ColorCorrectionParams* color_correction) {
+    /*
+        Read the frames of a shared-memory frame ring until the producer closes it,
+        or exits. Each slot is preprocessed in place into the DPU input, without
+        a copy of the image, and released right away for the producer.
+    */
+    FrameRing* ring = frame_ring_open_wait(ring_name.c_str(), RING_OPEN_MS);
+    if (ring == NULL) {
+        return -1;
     }
-    return output;
+    FrameRingInfo info;
+    uint8_t* slot;
+    int n_images = 0;
+    while (true) {
+        slot = frame_ring_read_slot(ring, &info, RING_POLL_MS);
+        if (slot == NULL) {
+            bool closed = frame_ring_closed(ring), exited = frame_ring_peer_alive(ring) == 0;
+            if (!closed && !exited) {
+                continue;
+            }
+            // The frames committed before the end are still read
+            if ((slot = frame_ring_read_slot(ring, &info, 0)) == NULL) {
+                if (!closed) {
+                    cerr << "[WARNING] The producer of the frame ring " << ring_name << " exited without closing it" << endl;
+                }
+                break;
+            }
+        }
+        input.resize((n_images + 1) * image_size());
+        bool preprocessed = preprocessFrame(slot, info, kernels, color_correction, input.data() + n_images * image_size());
+        frame_ring_release(ring);
+        if (!preprocessed) {
+            continue;
+        }
+
+        labels.push_back(info.label < (uint32_t)n_classes() ? info.label : UINT16_MAX);
+        n_images++;
+    }
+    frame_ring_destroy(ring);
+    return n_images;
 }
 
-void displayResult(int8_t* result, int n_classes) {
-    vector<float> output = int8ToFloat(result, n_classes, 0.5);
-    vector<float> probs = softmax(output);
-    auto max_it = max_element(probs.begin(), probs.end());
-    auto max_index = distance(probs.begin(), max_it);
-    cout << "Predicted class: " << lookup(max_index) << " with probability: " << *max_it << endl;
+void displayResult(const ModelKernels& kernels, int8_t* result, float scale) {
+    float probability;
+    int best = kernels.classify(result, scale, &probability);
+    cout << "Predicted class: " << lookup(best) << " with probability: " << probability << endl;
 }
 
 void printAccuracyBars(const vector<float>& accuracies) {
@@ -132,176 +246,727 @@ void printAccuracyBars(const vector<float>& accuracies) {
     }
 }
 
-void printAccuracy(dpu_type* outputBuffer, uint8_t* labels, int n_images, float scale) {
-    vector<int> correct_classes(N_CLASSES, 0);
+static void printClassAccuracy(const vector<int>& predicted, uint16_t* labels, int n_images) {
+    vector<int> correct_classes(n_classes(), 0);
     int correct = 0;
-    vector<float> output, probs;
     for (int i = 0; i < n_images; i++) {
-        output = int8ToFloat(outputBuffer + i * N_CLASSES, N_CLASSES, scale);
-        probs = softmax(output);
-        auto max_it = max_element(probs.begin(), probs.end());
-        auto max_index = distance(probs.begin(), max_it);
-
-        if (max_index == labels[i]) {
+        if (predicted[i] == labels[i]) {
             int class_index = labels[i];
             correct_classes[class_index]++;
             correct++;
         }
     }
-    vector<float> class_accuracy(N_CLASSES, 0);
-    for (int i = 0; i < N_CLASSES; i++) {
+    vector<float> class_accuracy(n_classes(), 0);
+    for (int i = 0; i < n_classes(); i++) {
         class_accuracy[i] = (float)correct_classes[i] / count(labels, labels + n_images, i);
         // cout << "Accuracy for class " << lookup(i) << ": " << class_accuracy[i] << endl;
     }
     printAccuracyBars(class_accuracy);
     cout << "Global accuracy: " << 100.0*correct/n_images << "%" << endl;
+}
 
-
+void printAccuracy(const ModelKernels& kernels, dpu_type* outputBuffer, uint16_t* labels, int n_images, float scale) {
+    vector<int> predicted(n_images);
+    for (int i = 0; i < n_images; i++) {
+        predicted[i] = kernels.classify(outputBuffer + (size_t)i * n_classes(), scale);
+    }
+    printClassAccuracy(predicted, labels, n_images);
 }
 
+void printAccuracy(const float* scores, int n_scores, uint16_t* labels, int n_images) {
+    // Float outputs of a pipeline (logits or probabilities), the classes are the first n_classes()
+    vector<int> predicted(n_images);
+    for (int i = 0; i < n_images; i++) {
+        const float* image_scores = scores + (size_t)i * n_scores;
+        predicted[i] = max_element(image_scores, image_scores + n_classes()) - image_scores;
+    }
+    printClassAccuracy(predicted, labels, n_images);
+}
 
-void runDPU(vart::Runner* runner, dpu_type* inputBuffer, dpu_type* outputBuffer, int n_images) {
-    char spinner[] = {'|', '/', '-', '\\'};
-    int spinner_length = sizeof(spinner) / sizeof(spinner[0]);
-    int spinner_index = 0;
-
-    // init out data
-    float mean[3] = {104, 117, 123};
-    vector<unique_ptr<vart::TensorBuffer>> inputs, outputs;
-    vector<vart::TensorBuffer*> inputsPtr, outputsPtr;
-    
-    // get in/out tensor
-    auto outputTensors = cloneTensorBuffer(runner->get_output_tensors());
-    auto inputTensors = cloneTensorBuffer(runner->get_input_tensors());
 
-    // get tensor shape info
-    int outHeight = shapes.outTensorList[0].height;
-    int outWidth = shapes.outTensorList[0].width;
-    int inHeight = shapes.inTensorList[0].height;
-    int inWidth = shapes.inTensorList[0].width;
+// Heap allocations of the DPU threads after their first image
+static atomic<long> dpu_allocations(0);
 
-    int inSize = shapes.inTensorList[0].size;
-    int outSize = shapes.outTensorList[0].size;
+void printMemory(long allocations, int n_images) {
+    if (alloc_count() < 0) {
+        cout << "Heap allocations: not counted (COUNT_ALLOCATIONS=1 ./build.sh), peak RSS: " << fixed << setprecision(1)
+             << peak_rss_kb() / 1024.0 << " MB" << endl;
+        return;
+    }
+    cout << "Heap allocations: " << allocations << " (" << fixed << setprecision(3) << (double)allocations / max(n_images, 1)
+         << " per image), peak RSS: " << setprecision(1) << peak_rss_kb() / 1024.0 << " MB" << endl;
+}
 
-    dpu_type *loc_inputBuffer = inputBuffer;
-    dpu_type *loc_outputBuffer = outputBuffer;
+void runDPU(vart::Runner* runner, dpu_type* inputBuffer, dpu_type* outputBuffer, int n_images) {
+    /*
+        The images one at a time on this runner, with the loop that
+        alloc_bench checks (run_on_runner). The first image warms up the
+        runner, the allocations are counted after it.
+    */
+    run_on_runner(runner, inputBuffer, outputBuffer, 0, min(n_images, 1));
+    long allocations = thread_alloc_count();
+    run_on_runner(runner, inputBuffer, outputBuffer, 1, n_images);
+    if (n_images > 1) {
+        dpu_allocations += thread_alloc_count() - allocations;
+    }
 
-    auto start = high_resolution_clock::now();
+    cout << "All images processed" << endl;
+}
 
-    for (int i = 0; i < n_images; i++) {
-        loc_inputBuffer = inputBuffer + i * inSize;
-        loc_outputBuffer = outputBuffer + i * outSize;
+int tuneRunners(const string& objective, const xir::Subgraph* subgraph, const vector<unique_ptr<vart::Runner>>& runners,
+                const ModelKernels& kernels, uint8_t* images, const dpu_type* input, int n_sample, float input_scale,
+                const string& power, TuneProfile* best) {
+    /*
+        Calibration passes over the first n_sample images, timed like the
+        run: with the host buffers, the preprocessing of the sample on one
+        thread then the runners (a pool, which balances them); in zero-copy,
+        the rings preprocessing into their buffers. images is NULL for the
+        frames of a ring, already preprocessed in input: only the host
+        buffers are tried then.
+    */
+    PowerMeter meter(power);
+    if (objective == "fpsw" && !meter.available()) {
+        cout << "No power meter for " << power << ", needed to tune for FPS/W" << endl;
+        return -1;
+    }
+    vector<dpu_type> sample_input(images != NULL ? (size_t)n_sample * image_size() : 0);
+    vector<dpu_type> output((size_t)n_sample * n_classes());
+    auto pass = [&](int threads, int depth, double* fps, double* watts) {
+        vector<unique_ptr<ZeroCopyRunner>> rings;
+        for (int i = 0; i < threads && depth > 0; i++) {
+            rings.push_back(ZeroCopyRunner::create(subgraph, depth));
+            if (!rings.back()) {
+                return -1;
+            }
+        }
+        atomic<int> next_image(0);
+        auto next = [&](int* indices, int max_n) {
+            int first = next_image.fetch_add(max_n);
+            int n = max(0, min(max_n, n_sample - first));
+            for (int i = 0; i < n; i++) {
+                indices[i] = first + i;
+            }
+            return n;
+        };
+        meter.start();
+        auto start = high_resolution_clock::now();
+        if (depth == 0) {
+            const dpu_type* pass_input = input;
+            if (images != NULL) {
+                preprocessImages(kernels, images, sample_input.data(), n_sample);
+                pass_input = sample_input.data();
+            }
+            vector<vart::Runner*> pool_runners;
+            for (int i = 0; i < threads; i++) {
+                pool_runners.push_back(runners[i].get());
+            }
+            RunnerPool pool(pool_runners);
+            pool.run(pass_input, input_scale, next, output.data());
+        } else {
+            auto fill = [&](int index, int8_t* ring_input) {
+                preprocessImages(kernels, images + (size_t)index * image_size(), ring_input, 1);
+            };
+            vector<thread> workers;
+            for (auto& ring : rings) {
+                workers.emplace_back([&, runner = ring.get()]() { runner->run(next, fill, output.data()); });
+            }
+            for (auto& w : workers) {
+                w.join();
+            }
+        }
+        double seconds = duration<double>(high_resolution_clock::now() - start).count();
+        *watts = meter.stop();
+        *fps = n_sample / max(seconds, 1e-6);
+        return 0;
+    };
 
-        // tensor buffer prepare
-        inputs.push_back(make_unique<CpuFlatTensorBuffer>(
-                loc_inputBuffer, inputTensors[0].get()));
-        outputs.push_back(make_unique<CpuFlatTensorBuffer>(
-                loc_outputBuffer, outputTensors[0].get()));
+    // A first pass warms up the runners and the caches
+    double fps, watts;
+    pass(1, 0, &fps, &watts);
+    TuneOptions options = default_tune_options();
+    options.objective = objective;
+    options.max_threads = runners.size();
+    if (images == NULL) {
+        options.max_depth = 0;
+    }
+    cout << "Auto-tuning for the highest " << (objective == "fpsw" ? "FPS/W" : "FPS") << " on " << n_sample << " images" << endl;
+    int n_passes = autotune(options, pass, best);
+    if (n_passes < 0) {
+        cout << "No configuration could run" << endl;
+        return -1;
+    }
+    cout << "Best of " << n_passes << " passes: " << best->threads << " threads, "
+         << (best->zero_copy_depth > 0 ? "zero-copy rings of " + to_string(best->zero_copy_depth) : string("host buffers"))
+         << endl;
+    return 0;
+}
 
-        inputsPtr.clear();
-        outputsPtr.clear();
-        inputsPtr.push_back(inputs[0].get());
-        outputsPtr.push_back(outputs[0].get());
+int runScheduled(const vector<vart::Runner*>& pool_runners, vector<dpu_type>& input, float input_scale, int n_images,
+                 const string& ring_name, double deadline_ms, const SchedulerOptions& options, const ModelKernels& kernels,
+                 const ModelKernels& ring_kernels, float output_scale, const ColorCorrectionParams* color_correction,
+                 dpu_type* output) {
+    /*
+        The images of the dataset are the bulk lane of a deadline scheduler,
+        and the frames of a ring the live lane, with deadline_ms from their
+        commit in the ring. The runners take the items of the scheduler.
+        The live frames are preprocessed into LIVE_SLOTS inputs after the
+        images, given back once their job is done or dropped. A shed image
+        is submitted again when the queue has room, so that the whole
+        dataset is classified; the live frames are read until then.
+    */
+    FrameRing* ring = frame_ring_open_wait(ring_name.c_str(), RING_OPEN_MS);
+    if (ring == NULL) {
+        return -1;
+    }
+    input.resize((size_t)(n_images + LIVE_SLOTS) * image_size());
+    vector<dpu_type> outputs((size_t)(n_images + LIVE_SLOTS) * n_classes());
+    vector<uint16_t> live_labels(LIVE_SLOTS);
 
-        // run
-        auto job_id = runner->execute_async(inputsPtr, outputsPtr);
-        runner->wait(job_id.first, -1);
+    mutex state_mutex;
+    condition_variable state_changed;
+    IndexRing free_slots(LIVE_SLOTS);
+    for (int i = 0; i < LIVE_SLOTS; i++) {
+        free_slots.push(i);
+    }
+    int bulk_done = 0;
+    long live_read = 0, live_classified = 0, live_correct = 0, live_labelled = 0;
+    bool stop = false;
+    auto finished = [&](const int* indices, int n, bool run) {
+        lock_guard<mutex> lock(state_mutex);
+        for (int i = 0; i < n; i++) {
+            if (indices[i] < n_images) {
+                bulk_done++;
+                continue;
+            }
+            int slot = indices[i] - n_images;
+            if (run) {
+                int best = kernels.classify(outputs.data() + (size_t)indices[i] * n_classes(), output_scale);
+                live_classified++;
+                if (live_labels[slot] != UINT16_MAX) {
+                    live_labelled++;
+                    live_correct += best == live_labels[slot];
+                }
+            }
+            free_slots.push(slot);
+        }
+        state_changed.notify_all();
+    };
+    DeadlineScheduler scheduler(options, pool_runners.size(), [&](const int* indices, int n) { finished(indices, n, false); });
+    RunnerPool pool(pool_runners);
 
-        // Read the output tensor
-        // displayResult(loc_outputBuffer, outSize);
-        
-        // Clean up
-        inputs.clear();
-        outputs.clear();
+    thread live_reader([&]() {
+        FrameRingInfo info;
+        while (true) {
+            uint8_t* frame = frame_ring_read_slot(ring, &info, LIVE_POLL_MS);
+            bool closed = false;
+            if (frame == NULL && (frame_ring_closed(ring) || frame_ring_peer_alive(ring) == 0)) {
+                // The producer closed the ring or exited: the frames committed before are still read
+                frame = frame_ring_read_slot(ring, &info, 0);
+                closed = frame == NULL;
+            }
+            if (frame == NULL) {
+                lock_guard<mutex> lock(state_mutex);
+                if (stop || closed) {
+                    break;
+                }
+                continue;
+            }
+            int slot;
+            {
+                unique_lock<mutex> lock(state_mutex);
+                state_changed.wait(lock, [&]() { return !free_slots.empty() || stop; });
+                if (stop) {
+                    frame_ring_release(ring);
+                    break;
+                }
+                slot = free_slots.pop();
+                live_read++;
+            }
+            bool preprocessed = preprocessFrame(frame, info, ring_kernels, color_correction,
+                                                input.data() + (size_t)(n_images + slot) * image_size());
+            frame_ring_release(ring);
+            live_labels[slot] = info.label < (uint32_t)n_classes() ? info.label : UINT16_MAX;
+            // The deadline runs from the commit in the ring (CLOCK_MONOTONIC, like steady_clock)
+            double age_ms = duration<double, milli>(steady_clock::now().time_since_epoch()).count() - info.timestamp_ns / 1e6;
+            int index = n_images + slot;
+            if (!preprocessed || !scheduler.submit(index, LANE_LIVE, max(deadline_ms - age_ms, 0.001))) {
+                finished(&index, 1, false);
+            }
+        }
+    });
 
-        // if ((i % 100) == 0 && (i != 0)) {
-        //     cout << "Processed " << i << " images" << endl;
-        // }
+    thread bulk_feeder([&]() {
+        for (int i = 0; i < n_images; i++) {
+            while (!scheduler.submit(i, LANE_BULK, 0)) {
+                this_thread::sleep_for(milliseconds(1));
+            }
+        }
+    });
 
-        // cout << "\r" << spinner[i % spinner_length] << flush;
+    auto start = high_resolution_clock::now();
+    thread runners([&]() {
+        pool.run(input.data(), input_scale, [&](int* indices, int max_n) { return scheduler.pop(indices, max_n); },
+                 outputs.data(), [&](const int* indices, int n) {
+                     scheduler.done(indices, n);
+                     finished(indices, n, true);
+                 });
+    });
+    bulk_feeder.join();
+    {
+        unique_lock<mutex> lock(state_mutex);
+        state_changed.wait(lock, [&]() { return bulk_done == n_images; });
+        stop = true;
+        state_changed.notify_all();
     }
+    live_reader.join();
+    scheduler.close();
+    runners.join();
+    auto run_duration = duration_cast<milliseconds>(high_resolution_clock::now() - start);
+    frame_ring_destroy(ring);
 
-    auto stop = high_resolution_clock::now();
-    auto duration = duration_cast<milliseconds>(stop - start);
-    // cout << "DPU execution time: " << duration.count() / 1000.0 << " seconds" << endl;
-    // cout << "DPU FPS: " << 1000.0*n_images / duration.count() << endl;
-
-    cout << "All images processed" << endl;
+    memcpy(output, outputs.data(), (size_t)n_images * n_classes());
+    static const char* lane_names[] = {"live", "bulk"};
+    cout << "Scheduled run: " << fixed << setprecision(2) << run_duration.count() / 1000.0 << " seconds, bulk FPS "
+         << 1000.0 * n_images / max<long>(run_duration.count(), 1) << ", " << live_read << " live frames, " << live_classified
+         << " classified" << endl;
+    if (live_labelled > 0) {
+        cout << "Live accuracy: " << 100.0 * live_correct / live_labelled << "% of " << live_labelled << " labelled frames" << endl;
+    }
+    scheduler.print_stats(lane_names);
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
     if (argc < 3) {
-        cout << "Usage: " << argv[0] << " <folder_path> <n_threads>" << endl;
+        cout << "Usage: " << argv[0] << " <folder_path | dataset.tar | shm:ring_name> <n_threads | auto> [color_correction] [prefetch_window]"
+             << " [cascade=small.xmodel] [threshold=t] [gate=prob|margin] [sweep=t1,t2,...] [power=hwmon[:name] | watts]"
+             << " [zerocopy=ring_depth] [manifest=model.manifest] [governor=watts:W,celsius:C,fps:F]"
+             << " [autotune=fps|fpsw] [profile=file.profile] [live=shm:ring_name] [deadline=ms] [shed=ms] [expired=drop|run]" << endl;
         cout << "Example: ./debug_data ../resnet50_mt_py/test_tipu12/ 4" << endl;
         return 1;
     }
     cout << "\n\nStart of program" << endl;
     
     string folder_path = argv[1];
-    int n_thds = atoi(argv[2]);
-    const int n_threads = n_thds;
+    // auto: the threads of the profile of the board, tuned first if there is none
+    bool auto_threads = string(argv[2]) == "auto";
+    int n_threads = auto_threads ? 4 : atoi(argv[2]);
 
-    // Get the number of images in the folder
-    int n_images = 0;
-    for (int i = 0; i < N_CLASSES; i++) {
-        string class_folder = folder_path + "/" + lookup(i);
-        for (const auto& entry : filesystem::directory_iterator(class_folder)) {
-            if (entry.is_regular_file()) {
-                n_images++;
+    // Optional arguments: color_correction and prefetch_window in this order, then the options of the cascade and zero-copy
+    vector<string> optional;
+    int zero_copy_depth = 0;
+    string cascade_xmodel;
+    CascadeOptions cascade = {0.8f, GATE_MAX_PROB, {}, "hwmon"};
+    GovernorOptions governor_options = default_governor_options();
+    bool governed = false;
+    string tune_objective, profile_file;
+    // Live frames of a ring in a lane of their own, before the images, with a deadline
+    string live_ring;
+    double live_deadline_ms = 30;
+    SchedulerOptions scheduler_options = {2, LANE_BULK, 50, EXPIRED_DROP, false};
+    for (int i = 3; i < argc; i++) {
+        string arg = argv[i];
+        size_t equal = arg.find('=');
+        if (equal == string::npos) {
+            optional.push_back(arg);
+            continue;
+        }
+        string key = arg.substr(0, equal), value = arg.substr(equal + 1);
+        if (key == "cascade") {
+            cascade_xmodel = value;
+        } else if (key == "threshold") {
+            cascade.threshold = atof(value.c_str());
+        } else if (key == "gate") {
+            cascade.gate = value == "margin" ? GATE_MARGIN : GATE_MAX_PROB;
+        } else if (key == "sweep") {
+            stringstream thresholds(value);
+            string threshold;
+            while (getline(thresholds, threshold, ',')) {
+                cascade.sweep.push_back(atof(threshold.c_str()));
+            }
+        } else if (key == "power") {
+            cascade.power = value;
+        } else if (key == "zerocopy") {
+            zero_copy_depth = atoi(value.c_str());
+        } else if (key == "governor") {
+            // Ceilings and target, separated by commas: watts:6,celsius:70 or fps:120
+            stringstream settings(value);
+            string setting;
+            while (getline(settings, setting, ',')) {
+                size_t colon = setting.find(':');
+                string name = setting.substr(0, colon);
+                double amount = colon == string::npos ? 0 : atof(setting.c_str() + colon + 1);
+                if (name == "watts") {
+                    governor_options.max_watts = amount;
+                } else if (name == "celsius") {
+                    governor_options.max_celsius = amount;
+                } else if (name == "fps") {
+                    governor_options.target_fps = amount;
+                } else {
+                    cout << "Unknown governor setting " << setting << endl;
+                    return 1;
+                }
+            }
+            governed = true;
+        } else if (key == "autotune") {
+            if (value != "fps" && value != "fpsw") {
+                cout << "Auto-tune for fps or fpsw" << endl;
+                return 1;
+            }
+            tune_objective = value;
+        } else if (key == "profile") {
+            profile_file = value;
+        } else if (key == "live") {
+            if (value.rfind("shm:", 0) != 0) {
+                cout << "The live frames come from a frame ring: live=shm:ring_name" << endl;
+                return 1;
             }
+            live_ring = "/" + value.substr(4);
+        } else if (key == "deadline") {
+            live_deadline_ms = atof(value.c_str());
+        } else if (key == "shed") {
+            scheduler_options.shed_ms = atof(value.c_str());
+        } else if (key == "expired") {
+            if (value != "drop" && value != "run") {
+                cout << "Expired live frames are dropped or run (expired=drop|run)" << endl;
+                return 1;
+            }
+            scheduler_options.expired = value == "drop" ? EXPIRED_DROP : EXPIRED_RUN;
+        } else if (key == "manifest") {
+            if (load_model_manifest(value, &manifest) != 0) {
+                return 1;
+            }
+            cout << "Manifest " << value << ": " << manifest.xmodel << ", input " << manifest.width << "x" << manifest.height
+                 << "x" << manifest.channels << ", " << n_classes() << " classes" << endl;
+        } else {
+            cout << "Unknown option " << arg << endl;
+            return 1;
         }
-
-        cout << "class_folder " << class_folder << endl;
     }
-    cout << "Found " << n_images << " images in subfolders" << endl;
 
-    // Allocate memory for the images and labels
-    uint8_t* images = new uint8_t[n_images * IMAGE_TOTAL_PIXELS];
-    uint8_t* labels = new uint8_t[n_images];
-    dpu_type* inputBuffer = new dpu_type[n_images * IMAGE_TOTAL_PIXELS];
-    dpu_type* outputBuffer = new dpu_type[n_images * N_CLASSES];
+    // Colour correction of the captures (AWB, contrast, brightness) before preprocessing
+    ColorCorrectionParams color_correction;
+    color_correction_captures(&color_correction);
+    bool use_color_correction = optional.size() > 0 && atoi(optional[0].c_str());
 
-    // Load the images and labels into the buffers
-    auto load_preprocess_start = high_resolution_clock::now();
-    load_images_from_folder(folder_path, n_images, images, labels);
-    cout << "Images and labels loaded" << endl;
+    // Number of files read ahead of the decoding
+    int prefetch_window = optional.size() > 1 ? atoi(optional[1].c_str()) : PREFETCH_WINDOW;
 
     // DPU initializations
-    string xmodel_file = "/home/root/Vitis-AI/demo/VART/resnet50_mt_py/ultra96v2_tipu12.xmodel";
+    auto load_preprocess_start = high_resolution_clock::now();
+    if (manifest.channels != 3) {
+        cout << "The images are decoded in BGR, the model must take 3 channels" << endl;
+        return 1;
+    }
+    string xmodel_file = manifest.xmodel;
     auto graph = xir::Graph::deserialize(xmodel_file);
     auto subgraph = get_dpu_subgraph(graph.get());
-    CHECK_EQ(subgraph.size(), 1u)
-        << "Subgraph should have one and only one dpu subgraph.";
-    // LOG(INFO) << "create running for subgraph: " << subgraph[0]->get_name();
-
-    // Create runner
-    auto runner0 = vart::Runner::create_runner(subgraph[0], "run");
-    auto runner1 = vart::Runner::create_runner(subgraph[0], "run");
-    auto runner2 = vart::Runner::create_runner(subgraph[0], "run");
-    auto runner3 = vart::Runner::create_runner(subgraph[0], "run");
-
-    // In/out tensors
-    auto inputTensors = runner0->get_input_tensors();
-    auto outputTensors = runner0->get_output_tensors();
-    auto input_scale = get_input_scale(runner0->get_input_tensors()[0]);
-    auto output_scale = get_output_scale(runner0->get_output_tensors()[0]);
-    int inputCnt = inputTensors.size();
-    int outputCnt = outputTensors.size();
-    cout << "Input scale: " << input_scale << ". Output scale: " << output_scale << endl;
-
-    // Get in/out tensor shape
-    TensorShape inshapes[inputCnt];
-    TensorShape outshapes[outputCnt];
-    shapes.inTensorList = inshapes;
-    shapes.outTensorList = outshapes;
-    getTensorShape(runner0.get(), &shapes, inputCnt, outputCnt);
-    cout << "DPUs created" << endl;
-
-    // Preprocess the images
-    preprocessImages(images, inputBuffer, n_images, input_scale);
-    delete[] images;
+
+    // A model split by the compiler (several DPU subgraphs, ops on the CPU) runs as a pipeline of all its subgraphs
+    unique_ptr<XmodelPipeline> pipeline;
+    vector<unique_ptr<vart::Runner>> runners;
+    vector<TensorShape> inshapes, outshapes;
+    float input_scale, output_scale;
+    int n_cpu_subgraphs = xmodel_subgraph_count(graph.get(), "CPU");
+    bool split_model = subgraph.size() != 1 || n_cpu_subgraphs > 0;
+
+    // Configuration tuned on this board for this model: the profile, or tuned after loading the images.
+    // The runs that cannot be tuned take the default number of threads.
+    if (profile_file.empty()) {
+        profile_file = default_profile_path(manifest.xmodel);
+    }
+    TuneProfile profile;
+    bool tunable = !split_model && cascade_xmodel.empty() && !governed && live_ring.empty();
+    if (auto_threads && tune_objective.empty() && !tunable) {
+        cout << "[WARNING] Auto-tuning needs a model of one DPU subgraph, without cascade, governor or live lane: "
+             << n_threads << " threads" << endl;
+    } else if (auto_threads && tune_objective.empty()) {
+        if (load_profile(profile_file, manifest.xmodel, &profile) == 0) {
+            n_threads = profile.threads;
+            zero_copy_depth = folder_path.rfind("shm:", 0) == 0 ? 0 : profile.zero_copy_depth;
+            cout << "Profile " << profile_file << " (" << profile.objective << "): " << n_threads << " threads, "
+                 << (zero_copy_depth > 0 ? "zero-copy rings of " + to_string(zero_copy_depth) : string("host buffers")) << endl;
+        } else {
+            tune_objective = "fps";
+            cout << "No profile " << profile_file << ", the configuration is tuned first" << endl;
+        }
+    }
+
+    if (split_model) {
+        pipeline = XmodelPipeline::create(xmodel_file, max(n_threads, 1));
+        if (!pipeline) {
+            return 1;
+        }
+        if (pipeline->input_size() != image_size() || pipeline->output_size() < n_classes()) {
+            cout << "The model takes " << pipeline->input_size() << " values and gives " << pipeline->output_size()
+                 << ", expected " << image_size() << " and at least " << n_classes() << endl;
+            return 1;
+        }
+        if (!cascade_xmodel.empty()) {
+            cout << "The cascade needs models of one DPU subgraph" << endl;
+            return 1;
+        }
+        input_scale = pipeline->input_scale();
+        output_scale = 1;
+        cout << "Model of " << subgraph.size() << " DPU and " << n_cpu_subgraphs << " CPU subgraphs: pipeline of "
+             << pipeline->n_stages() << " stages. Input scale: " << input_scale << endl;
+    } else {
+        // LOG(INFO) << "create running for subgraph: " << subgraph[0]->get_name();
+
+        // Create runner
+        for (int i = 0; i < 4; i++) {
+            runners.push_back(vart::Runner::create_runner(subgraph[0], "run"));
+        }
+
+        // In/out tensors
+        auto inputTensors = runners[0]->get_input_tensors();
+        auto outputTensors = runners[0]->get_output_tensors();
+        input_scale = get_input_scale(runners[0]->get_input_tensors()[0]);
+        output_scale = manifest.output_scale > 0 ? manifest.output_scale : get_output_scale(runners[0]->get_output_tensors()[0]);
+        int inputCnt = inputTensors.size();
+        int outputCnt = outputTensors.size();
+        cout << "Input scale: " << input_scale << ". Output scale: " << output_scale << endl;
+
+        // Get in/out tensor shape
+        inshapes.resize(inputCnt);
+        outshapes.resize(outputCnt);
+        shapes.inTensorList = inshapes.data();
+        shapes.outTensorList = outshapes.data();
+        getTensorShape(runners[0].get(), &shapes, inputCnt, outputCnt);
+        if (shapes.inTensorList[0].size != image_size() || shapes.outTensorList[0].size != n_classes()) {
+            cout << "The model takes " << shapes.inTensorList[0].size << " values and gives " << shapes.outTensorList[0].size
+                 << ", the manifest " << image_size() << " and " << n_classes() << endl;
+            return 1;
+        }
+        cout << "DPUs created" << endl;
+    }
+
+    // Preprocessing and postprocessing kernels of the manifest, at the input scale of the model
+    auto kernels = make_unique<ModelKernels>(manifest, input_scale);
+    cout << "Kernels: preprocessing " << (kernels->fixed_preprocess() ? "instantiated" : "at run time") << " for "
+         << manifest.width << "x" << manifest.height << "x" << manifest.channels << ", classification "
+         << (kernels->fixed_classify() ? "instantiated" : "at run time") << " for " << n_classes() << " classes" << endl;
+
+    // Zero-copy: a ring of runners per thread, the images preprocessed into their buffers. The rings are made
+    // after loading the images, once the configuration is tuned.
+    if (zero_copy_depth > 0 && (pipeline || !cascade_xmodel.empty() || folder_path.rfind("shm:", 0) == 0)) {
+        cout << "Zero-copy needs a model of one DPU subgraph, no cascade, and images from files or a tar archive" << endl;
+        return 1;
+    }
+    if (!tune_objective.empty() && (pipeline || !cascade_xmodel.empty() || governed)) {
+        cout << "The auto-tuner needs a model of one DPU subgraph, no cascade and no governor" << endl;
+        return 1;
+    }
+
+    // Cascade: the small model on every crop, the runners above for the crops it is unsure of
+    unique_ptr<RunnerPool> small_pool, large_pool;
+    if (!cascade_xmodel.empty()) {
+        vector<vart::Runner*> large_runners = {runners[0].get(), runners[1].get(), runners[2].get(), runners[3].get()};
+        large_runners.resize(min(max(n_threads, 1), 4));
+        large_pool = make_unique<RunnerPool>(large_runners);
+        small_pool = make_unique<RunnerPool>(cascade_xmodel, max(n_threads, 1));
+        cout << "Cascade: " << cascade_xmodel << " first, escalated crops in batches of " << large_pool->batch_size() << endl;
+    }
+    if (governed && (pipeline || zero_copy_depth > 0 || small_pool)) {
+        cout << "The governor needs a model of one DPU subgraph, no cascade and no zero-copy" << endl;
+        return 1;
+    }
+    if (!live_ring.empty() && (pipeline || zero_copy_depth > 0 || small_pool || governed || !tune_objective.empty())) {
+        cout << "The live lane needs a model of one DPU subgraph, without zero-copy, cascade, governor or auto-tuning" << endl;
+        return 1;
+    }
+
+    // Load the images and labels, from a frame ring, a tar archive or the class subfolders.
+    // The frames of a ring are preprocessed as they are read, the files after loading.
+    vector<uint8_t> images;
+    vector<uint16_t> labels;
+    vector<dpu_type> input_data;
+    int n_images = 0;
+    bool from_ring = folder_path.rfind("shm:", 0) == 0;
+    auto load_start = high_resolution_clock::now();
+    if (from_ring) {
+        ModelKernels ring_kernels(manifest, input_scale, true);
+        n_images = load_images_from_ring("/" + folder_path.substr(4), input_data, labels, ring_kernels,
+                                         use_color_correction ? &color_correction : NULL);
+        if (n_images <= 0) {
+            cout << "No frames received from " << folder_path << endl;
+            return 1;
+        }
+    } else if (is_tar_file(folder_path)) {
+        vector<string> class_names;
+        for (int i = 0; i < n_classes(); i++) {
+            class_names.push_back(lookup(i));
+        }
+        n_images = load_images_from_tar(folder_path, class_names, manifest.width, manifest.height, INT_MAX,
+                                        images, labels, use_color_correction ? &color_correction : NULL);
+        if (n_images <= 0) {
+            cout << "No images found in " << folder_path << endl;
+            return 1;
+        }
+    } else {
+        // List the images of the class subfolders
+        vector<DatasetFile> files = list_images_in_folder(folder_path);
+        cout << "Found " << files.size() << " images in subfolders" << endl;
+
+        images.resize(files.size() * image_size());
+        labels.resize(files.size());
+        n_images = load_images_from_folder(files, images.data(), labels.data(), prefetch_window, use_color_correction ? &color_correction : NULL);
+    }
+    auto load_duration = duration_cast<milliseconds>(high_resolution_clock::now() - load_start);
+    cout << "Images and labels loaded in " << fixed << setprecision(2) << load_duration.count()/1000.0 << " seconds ("
+         << 1000.0*n_images / max<long>(load_duration.count(), 1) << " images/s)" << endl;
+
+    if (!tune_objective.empty()) {
+        if (tuneRunners(tune_objective, subgraph[0], runners, *kernels, from_ring ? NULL : images.data(), input_data.data(),
+                        min(n_images, TUNE_SAMPLE), input_scale, cascade.power, &profile) != 0) {
+            return 1;
+        }
+        n_threads = profile.threads;
+        zero_copy_depth = profile.zero_copy_depth;
+        if (save_profile(profile_file, manifest.xmodel, profile) == 0) {
+            cout << "Profile saved in " << profile_file << ", used with " << argv[0] << " <images> auto" << endl;
+        }
+    }
+    vector<unique_ptr<ZeroCopyRunner>> zero_copy_runners;
+    if (zero_copy_depth > 0) {
+        for (int i = 0; i < max(n_threads, 1); i++) {
+            zero_copy_runners.push_back(ZeroCopyRunner::create(subgraph[0], zero_copy_depth));
+            if (!zero_copy_runners.back()) {
+                return 1;
+            }
+        }
+        cout << "Zero-copy: " << zero_copy_runners.size() << " threads, rings of " << zero_copy_depth << " runners" << endl;
+    }
+
+    // Preprocess the images, in zero-copy right before each job
+    if (!from_ring && zero_copy_runners.empty()) {
+        input_data.resize(n_images * image_size());
+        preprocessImages(*kernels, images.data(), input_data.data(), n_images);
+        vector<uint8_t>().swap(images);
+    }
     cout << "Images preprocessed" << endl;
 
+    // DPU buffers
+    dpu_type* inputBuffer = input_data.data();
+
+    if (!zero_copy_runners.empty()) {
+        vector<dpu_type> output((size_t)n_images * n_classes());
+        atomic<int> next_image(0);
+        auto next = [&](int* indices, int max_n) {
+            int first = next_image.fetch_add(max_n);
+            int n = max(0, min(max_n, n_images - first));
+            for (int i = 0; i < n; i++) {
+                indices[i] = first + i;
+            }
+            return n;
+        };
+        auto fill = [&](int index, int8_t* input) {
+            preprocessImages(*kernels, images.data() + (size_t)index * image_size(), input, 1);
+        };
+        auto dpu_start = high_resolution_clock::now();
+        long allocations = alloc_count();
+        vector<thread> workers;
+        for (auto& zero_copy_runner : zero_copy_runners) {
+            workers.emplace_back([&, runner = zero_copy_runner.get()]() { runner->run(next, fill, output.data()); });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+        auto dpu_duration = duration_cast<milliseconds>(high_resolution_clock::now() - dpu_start);
+        allocations = alloc_count() - allocations;
+        cout << "Preprocess + DPU execution time (zero-copy): " << fixed << setprecision(2) << dpu_duration.count()/1000.0 << " seconds" << endl;
+        cout << "Preprocess + DPU FPS (zero-copy, " << n_threads << " threads): " << 1000.0*n_images / max<long>(dpu_duration.count(), 1) << endl;
+        printMemory(allocations, n_images);
+        if (count(labels.begin(), labels.end(), UINT16_MAX) == 0) {
+            printAccuracy(*kernels, output.data(), labels.data(), n_images, output_scale);
+        }
+        return 0;
+    }
+
+    if (pipeline) {
+        vector<float> scores((size_t)n_images * pipeline->output_size());
+        long allocations = alloc_count();
+        pipeline->run(inputBuffer, n_images, scores.data());
+        allocations = alloc_count() - allocations;
+        pipeline->print_stats();
+        printMemory(allocations, n_images);
+        auto total_duration = duration_cast<milliseconds>(high_resolution_clock::now() - load_preprocess_start);
+        cout << "Load + preprocess + pipeline FPS (" << n_threads << " runners per DPU subgraph): " << fixed << setprecision(2)
+             << 1000.0*n_images / total_duration.count() << endl;
+        if (count(labels.begin(), labels.end(), UINT16_MAX) == 0) {
+            printAccuracy(scores.data(), pipeline->output_size(), labels.data(), n_images);
+        }
+        return 0;
+    }
+    dpu_type* outputBuffer = new dpu_type[n_images * n_classes()];
+
+    if (small_pool) {
+        int result = run_cascade(*small_pool, *large_pool, inputBuffer, input_scale, labels.data(), n_images, n_classes(), cascade, outputBuffer);
+        cout << "Peak RSS: " << fixed << setprecision(1) << peak_rss_kb() / 1024.0 << " MB" << endl;
+        if (result == 0 && count(labels.begin(), labels.end(), UINT16_MAX) == 0) {
+            printAccuracy(*kernels, outputBuffer, labels.data(), n_images, output_scale);
+        }
+        delete[] outputBuffer;
+        return result == 0 ? 0 : 1;
+    }
+
+    if (!live_ring.empty()) {
+        // The runners take the images and the live frames from the deadline scheduler
+        vector<vart::Runner*> pool_runners;
+        for (int i = 0; i < min(max(n_threads, 1), 4); i++) {
+            pool_runners.push_back(runners[i].get());
+        }
+        ModelKernels ring_kernels(manifest, input_scale, true);
+        int result = runScheduled(pool_runners, input_data, input_scale, n_images, live_ring, live_deadline_ms, scheduler_options,
+                                  *kernels, ring_kernels, output_scale, use_color_correction ? &color_correction : NULL,
+                                  outputBuffer);
+        if (result == 0 && count(labels.begin(), labels.end(), UINT16_MAX) == 0) {
+            printAccuracy(*kernels, outputBuffer, labels.data(), n_images, output_scale);
+        }
+        delete[] outputBuffer;
+        return result == 0 ? 0 : 1;
+    }
+
+    if (governed) {
+        // The runners take the images one batch at a time, as many at once as the governor allows
+        vector<vart::Runner*> governed_runners;
+        for (int i = 0; i < min(max(n_threads, 1), 4); i++) {
+            governed_runners.push_back(runners[i].get());
+        }
+        RunnerPool pool(governed_runners);
+        governor_options.max_runners = governed_runners.size();
+        governor_options.max_decoders = 1;  // The images are decoded before the run
+        governor_options.power = cascade.power;
+        Governor governor(governor_options);
+        atomic<int> next_image(0);
+        auto next = [&](int* indices, int max_n) {
+            governor.acquire(GOVERN_RUNNERS);
+            int first = next_image.fetch_add(max_n);
+            int n = max(0, min(max_n, n_images - first));
+            for (int i = 0; i < n; i++) {
+                indices[i] = first + i;
+            }
+            if (n == 0) {
+                governor.release(GOVERN_RUNNERS);
+            }
+            return n;
+        };
+        auto dpu_start = high_resolution_clock::now();
+        governor.start();
+        pool.run(inputBuffer, input_scale, next, outputBuffer,
+                 [&](const int* indices, int n) { governor.release(GOVERN_RUNNERS, n); });
+        governor.stop();
+        auto dpu_duration = duration_cast<milliseconds>(high_resolution_clock::now() - dpu_start);
+        cout << "DPU FPS (governed, up to " << governed_runners.size() << " runners): " << fixed << setprecision(2)
+             << 1000.0*n_images / max<long>(dpu_duration.count(), 1) << endl;
+        governor.print_summary();
+        if (count(labels.begin(), labels.end(), UINT16_MAX) == 0) {
+            printAccuracy(*kernels, outputBuffer, labels.data(), n_images, output_scale);
+        }
+        delete[] outputBuffer;
+        return 0;
+    }
+
     // Buffer division
     int n_images_1 = n_images / n_threads;
     int n_images_0 = n_images - (n_images_1 * (n_threads-1));
@@ -316,16 +981,16 @@ int main(int argc, char* argv[]) {
         outputBuffer0 = outputBuffer;
     }
     if (n_threads >= 2) {
-        inputBuffer1 = inputBuffer + IMAGE_TOTAL_PIXELS * n_images_0;
-        outputBuffer1 = outputBuffer + N_CLASSES * n_images_0;
+        inputBuffer1 = inputBuffer + image_size() * n_images_0;
+        outputBuffer1 = outputBuffer + n_classes() * n_images_0;
     }
     if (n_threads >= 3) {
-        inputBuffer2 = inputBuffer + IMAGE_TOTAL_PIXELS * (n_images_0 + n_images_1);
-        outputBuffer2 = outputBuffer + N_CLASSES * (n_images_0 + n_images_1);
+        inputBuffer2 = inputBuffer + image_size() * (n_images_0 + n_images_1);
+        outputBuffer2 = outputBuffer + n_classes() * (n_images_0 + n_images_1);
     }
     if (n_threads >= 4) {
-        inputBuffer3 = inputBuffer + IMAGE_TOTAL_PIXELS * (n_images_0 + n_images_1 + n_images_2);
-        outputBuffer3 = outputBuffer + N_CLASSES * (n_images_0 + n_images_1 + n_images_2);
+        inputBuffer3 = inputBuffer + image_size() * (n_images_0 + n_images_1 + n_images_2);
+        outputBuffer3 = outputBuffer + n_classes() * (n_images_0 + n_images_1 + n_images_2);
     }
 
     // Create threads
@@ -333,13 +998,13 @@ int main(int argc, char* argv[]) {
     thread workers[n_threads];
     for (auto i = 0; i < n_threads; i++) {
         if (i == 0)
-        workers[i] = thread(runDPU, runner0.get(), ref(inputBuffer0), ref(outputBuffer0), n_images_0);
+        workers[i] = thread(runDPU, runners[0].get(), ref(inputBuffer0), ref(outputBuffer0), n_images_0);
         if (i == 1)
-        workers[i] = thread(runDPU, runner1.get(), ref(inputBuffer1), ref(outputBuffer1), n_images_1);
+        workers[i] = thread(runDPU, runners[1].get(), ref(inputBuffer1), ref(outputBuffer1), n_images_1);
         if (i == 2)
-        workers[i] = thread(runDPU, runner2.get(), ref(inputBuffer2), ref(outputBuffer2), n_images_2);
+        workers[i] = thread(runDPU, runners[2].get(), ref(inputBuffer2), ref(outputBuffer2), n_images_2);
         if (i == 3)
-        workers[i] = thread(runDPU, runner3.get(), ref(inputBuffer3), ref(outputBuffer3), n_images_3);
+        workers[i] = thread(runDPU, runners[3].get(), ref(inputBuffer3), ref(outputBuffer3), n_images_3);
     }
 
     // Release thread resources.
@@ -356,14 +1021,18 @@ int main(int argc, char* argv[]) {
     cout << "Load + preprocess + DPU FPS (" << n_threads << " threads): " << fixed << setprecision(2) << 1000.0*n_images / total_duration.count() << endl;
     cout << "DPU execution time: " << fixed << setprecision(2) << dpu_duration.count()/1000.0 << " seconds (" << dpu_duration.count()/1000.0/60.0 << " minutes)" << endl;
     cout << "DPU FPS (" << n_threads << " threads): " << fixed << setprecision(2) << 1000.0*n_images / dpu_duration.count() << endl;
+    cout << "After the first image of each thread: ";
+    printMemory(dpu_allocations, n_images);
 
 
-    printAccuracy(outputBuffer, labels, n_images, output_scale);
+    if (count(labels.begin(), labels.end(), UINT16_MAX) == 0) {
+        printAccuracy(*kernels, outputBuffer, labels.data(), n_images, output_scale);
+    } else {
+        cout << "No labels for some of the frames, accuracy not computed" << endl;
+    }
 
     cout << "End of program" << endl;
 
-    delete[] labels;
-    delete[] inputBuffer;
     delete[] outputBuffer;
 
     return 0;
@@ -0,0 +1,365 @@
+#ifndef MOCK_VART_H
+#define MOCK_VART_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <any>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+    Mock of the part of XIR and VART used by zero_copy.cpp, to run it on the
+    host (-DMOCK_VART). A runner has its own buffers in "device" memory. Like
+    the runtime, it copies the host buffers that it is given (CpuFlatTensorBuffer)
+    into its buffers before the job and copies the outputs back after it, and
+    counts these copies. The DPU is a thread of the runner that takes
+    latency_us for a job, with a checksum of the input as the class (or the
+    model of the subgraph); like the hot loops, it does not allocate once
+    started.
+    For xmodel_pipeline.cpp, a Graph holds the subgraphs of an xmodel (USER,
+    DPU and CPU with their ops), and Graph::deserialize gives the graph that
+    the test registered under the file name in mock_xmodels().
+*/
+
+struct MockVartCounters {
+    std::atomic<long> copies{0};            // Copies between host and device buffers
+    std::atomic<long> copied_bytes{0};
+    std::atomic<long> syncs{0};             // Explicit cache syncs
+    std::atomic<long> unsynced_jobs{0};     // Jobs on device buffers without a sync_for_write since the last one
+    std::atomic<long> jobs{0};
+
+    void reset() {
+        copies = copied_bytes = syncs = unsynced_jobs = jobs = 0;
+    }
+};
+
+inline MockVartCounters& mock_vart_counters() {
+    static MockVartCounters counters;
+    return counters;
+}
+
+namespace xir {
+
+struct DataType {
+    enum Type { INT, UINT, XINT, XUINT, FLOAT, UNKNOWN };
+    Type type;
+    int bit_width;
+};
+
+class Tensor {
+public:
+    // int8 at the fix point
+    Tensor(const std::string& name, const std::vector<int32_t>& shape, int fix_point)
+        : name(name), shape(shape), fix_point(fix_point), data_type{DataType::XINT, 8} {}
+    // float32, without fix point
+    Tensor(const std::string& name, const std::vector<int32_t>& shape)
+        : name(name), shape(shape), fix_point(0), data_type{DataType::FLOAT, 32} {}
+    const std::string get_name() const { return name; }
+    const std::vector<int32_t> get_shape() const { return shape; }
+    int64_t get_element_num() const {
+        int64_t n = 1;
+        for (int32_t d : shape) {
+            n *= d;
+        }
+        return n;
+    }
+    const DataType& get_data_type() const { return data_type; }
+    bool has_attr(const std::string& key) const { return key == "fix_point" && data_type.type != DataType::FLOAT; }
+    template <typename T>
+    T get_attr(const std::string&) const { return fix_point; }
+
+private:
+    std::string name;
+    std::vector<int32_t> shape;
+    int fix_point;
+    DataType data_type;
+};
+
+// An op of a CPU subgraph, named after its output
+class Op {
+public:
+    Op(const std::string& type, const std::vector<const Tensor*>& inputs, const Tensor* output,
+       const std::map<std::string, std::any>& attrs = {})
+        : type(type), inputs(inputs), output(output), attrs(attrs) {}
+    const std::string get_name() const { return output->get_name(); }
+    const std::string get_type() const { return type; }
+    std::vector<const Tensor*> get_input_tensors(const std::string&) const { return inputs; }
+    const Tensor* get_output_tensor() const { return output; }
+    bool has_attr(const std::string& key) const { return attrs.count(key) > 0; }
+    template <typename T>
+    T get_attr(const std::string& key) const { return std::any_cast<T>(attrs.at(key)); }
+
+private:
+    std::string type;
+    std::vector<const Tensor*> inputs;
+    const Tensor* output;
+    std::map<std::string, std::any> attrs;
+};
+
+// A DPU subgraph: one input, one output, the time of a job
+class Subgraph {
+public:
+    Subgraph(const std::string& name, const Tensor& input, const Tensor& output, int latency_us)
+        : name(name), input(input), output(output), latency_us(latency_us), device("DPU") {}
+    // A USER subgraph (output is the input of the model), a CPU subgraph (its ops) or the root of a graph
+    Subgraph(const std::string& name, const std::string& device, const Tensor& output, const std::vector<const Op*>& ops = {})
+        : name(name), input(output), output(output), latency_us(0), device(device), ops(ops) {}
+    const std::string get_name() const { return name; }
+    bool has_attr(const std::string& key) const { return key == "device" && !device.empty(); }
+    template <typename T>
+    T get_attr(const std::string&) const { return device; }
+    std::set<const Tensor*> get_output_tensors() const { return {&output}; }
+    std::vector<const Op*> topological_sort() const { return ops; }
+    std::vector<const Subgraph*> children_topological_sort() const { return children; }
+
+    std::string name;
+    Tensor input, output;
+    int latency_us;
+    // Outputs of one image from its input, a checksum when not set
+    std::function<void(const int8_t* input, int8_t* output)> model;
+    std::string device;
+    std::vector<const Op*> ops;
+    std::vector<const Subgraph*> children;      // In topological order
+};
+
+// The subgraphs of an xmodel, with the tensors and ops they point to
+class Graph {
+public:
+    Graph() : root("root", "", Tensor("root", {1}, 0)) {}
+    const Subgraph* get_root_subgraph() const { return &root; }
+    static std::unique_ptr<Graph> deserialize(const std::string& file);
+
+    const Tensor* add_tensor(const Tensor& tensor) {
+        tensors.emplace_back(new Tensor(tensor));
+        return tensors.back().get();
+    }
+    const Op* add_op(const Op& op) {
+        ops.emplace_back(new Op(op));
+        return ops.back().get();
+    }
+    // Appended to the children of the root, so in topological order when added in order
+    Subgraph* add_subgraph(const Subgraph& subgraph) {
+        subgraphs.emplace_back(new Subgraph(subgraph));
+        root.children.push_back(subgraphs.back().get());
+        return subgraphs.back().get();
+    }
+
+private:
+    Subgraph root;
+    std::vector<std::unique_ptr<Tensor>> tensors;
+    std::vector<std::unique_ptr<Op>> ops;
+    std::vector<std::unique_ptr<Subgraph>> subgraphs;
+};
+
+}  // namespace xir
+
+// The graphs that Graph::deserialize returns, by file name
+inline std::map<std::string, std::function<std::unique_ptr<xir::Graph>()>>& mock_xmodels() {
+    static std::map<std::string, std::function<std::unique_ptr<xir::Graph>()>> xmodels;
+    return xmodels;
+}
+
+inline std::unique_ptr<xir::Graph> xir::Graph::deserialize(const std::string& file) {
+    auto found = mock_xmodels().find(file);
+    return found != mock_xmodels().end() ? found->second() : std::unique_ptr<Graph>(new Graph());
+}
+
+namespace vart {
+
+class TensorBuffer {
+public:
+    enum class location_t { HOST_VIRT = 0, HOST_PHY = 1, DEVICE_0 = 2 };
+
+    explicit TensorBuffer(const xir::Tensor* tensor) : tensor(tensor) {}
+    virtual ~TensorBuffer() = default;
+    const xir::Tensor* get_tensor() const { return tensor; }
+    virtual location_t get_location() const = 0;
+    virtual std::pair<uint64_t, size_t> data(const std::vector<int> idx = {}) = 0;
+    virtual void sync_for_read(uint64_t, size_t) {}
+    virtual void sync_for_write(uint64_t, size_t) {}
+
+protected:
+    size_t offset(const std::vector<int>& idx) const {
+        // Row-major offset of the index, the whole buffer for an empty one
+        if (idx.empty()) {
+            return 0;
+        }
+        auto shape = tensor->get_shape();
+        size_t offset = 0;
+        for (size_t d = 0; d < idx.size(); d++) {
+            offset = offset * shape[d] + idx[d];
+        }
+        for (size_t d = idx.size(); d < shape.size() && !idx.empty(); d++) {
+            offset *= shape[d];
+        }
+        return offset;
+    }
+
+    const xir::Tensor* tensor;
+};
+
+// Buffer of a runner, in memory the mock DPU reads and writes
+class MockDeviceBuffer : public TensorBuffer {
+public:
+    explicit MockDeviceBuffer(const xir::Tensor* tensor) : TensorBuffer(tensor), memory(tensor->get_element_num()) {}
+    location_t get_location() const override { return location_t::HOST_PHY; }
+    std::pair<uint64_t, size_t> data(const std::vector<int> idx = {}) override {
+        size_t o = offset(idx);
+        return {reinterpret_cast<uint64_t>(memory.data() + o), memory.size() - o};
+    }
+    void sync_for_read(uint64_t, size_t) override { mock_vart_counters().syncs++; }
+    void sync_for_write(uint64_t, size_t) override {
+        mock_vart_counters().syncs++;
+        synced = true;
+    }
+
+    std::vector<int8_t> memory;
+    bool synced = false;
+};
+
+class Runner {
+public:
+    explicit Runner(const xir::Subgraph* subgraph)
+        : subgraph(subgraph), input(&subgraph->input), output(&subgraph->output), batch(subgraph->input.get_shape()[0]) {
+        dpu = std::thread([this]() { run_jobs(); });
+    }
+    virtual ~Runner() {
+        {
+            std::lock_guard<std::mutex> lock(job_mutex);
+            stopping = true;
+        }
+        job_changed.notify_all();
+        dpu.join();
+    }
+
+    static std::unique_ptr<Runner> create_runner(const xir::Subgraph* subgraph, const std::string&);
+
+    std::vector<const xir::Tensor*> get_input_tensors() { return {&subgraph->input}; }
+    std::vector<const xir::Tensor*> get_output_tensors() { return {&subgraph->output}; }
+
+    std::pair<uint32_t, int> execute_async(const std::vector<TensorBuffer*>& inputs, const std::vector<TensorBuffer*>& outputs) {
+        // The job runs in the thread of the runner until wait
+        MockVartCounters& counters = mock_vart_counters();
+        counters.jobs++;
+        if (inputs[0] != &input) {
+            copy(inputs[0], input.memory.data(), true);
+        } else if (!input.synced) {
+            counters.unsynced_jobs++;
+        }
+        input.synced = false;
+        std::lock_guard<std::mutex> lock(job_mutex);
+        host_output = outputs[0] != &output ? outputs[0] : nullptr;
+        job_pending = true;
+        job_changed.notify_all();
+        return {0, 0};
+    }
+    int wait(int, int) {
+        std::unique_lock<std::mutex> lock(job_mutex);
+        job_changed.wait(lock, [this]() { return !job_pending; });
+        return 0;
+    }
+
+protected:
+    void copy(TensorBuffer* host, int8_t* device, bool to_device) {
+        MockVartCounters& counters = mock_vart_counters();
+        auto region = host->data();
+        int8_t* data = reinterpret_cast<int8_t*>(region.first);
+        if (to_device) {
+            memcpy(device, data, region.second);
+        } else {
+            memcpy(data, device, region.second);
+        }
+        counters.copies++;
+        counters.copied_bytes += region.second;
+    }
+
+    void run_jobs() {
+        std::unique_lock<std::mutex> lock(job_mutex);
+        while (true) {
+            job_changed.wait(lock, [this]() { return job_pending || stopping; });
+            if (stopping) {
+                return;
+            }
+            // The class is a checksum of the input, the other outputs are 0
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::microseconds(subgraph->latency_us));
+            size_t in_size = input.memory.size() / batch, out_size = output.memory.size() / batch;
+            for (int b = 0; b < batch; b++) {
+                if (subgraph->model) {
+                    subgraph->model(input.memory.data() + b * in_size, output.memory.data() + b * out_size);
+                    continue;
+                }
+                uint32_t sum = 0;
+                for (size_t i = 0; i < in_size; i += 97) {
+                    sum += (uint8_t)input.memory[b * in_size + i];
+                }
+                memset(output.memory.data() + b * out_size, 0, out_size);
+                output.memory[b * out_size + sum % out_size] = 100;
+            }
+            if (host_output != nullptr) {
+                copy(host_output, output.memory.data(), false);
+            }
+            lock.lock();
+            job_pending = false;
+            job_changed.notify_all();
+        }
+    }
+
+    const xir::Subgraph* subgraph;
+    MockDeviceBuffer input, output;
+    int batch;
+    TensorBuffer* host_output = nullptr;
+    bool job_pending = false, stopping = false;
+    std::mutex job_mutex;
+    std::condition_variable job_changed;
+    std::thread dpu;
+};
+
+class RunnerExt : public Runner {
+public:
+    using Runner::Runner;
+    std::vector<TensorBuffer*> get_inputs() { return {&input}; }
+    std::vector<TensorBuffer*> get_outputs() { return {&output}; }
+};
+
+inline std::unique_ptr<Runner> Runner::create_runner(const xir::Subgraph* subgraph, const std::string&) {
+    return std::unique_ptr<Runner>(new RunnerExt(subgraph));
+}
+
+}  // namespace vart
+
+// The helpers of common.h
+class CpuFlatTensorBuffer : public vart::TensorBuffer {
+public:
+    CpuFlatTensorBuffer(void* data, const xir::Tensor* tensor) : TensorBuffer(tensor), host(reinterpret_cast<int8_t*>(data)) {}
+    location_t get_location() const override { return location_t::HOST_VIRT; }
+    std::pair<uint64_t, size_t> data(const std::vector<int> idx = {}) override {
+        size_t o = offset(idx);
+        return {reinterpret_cast<uint64_t>(host + o), tensor->get_element_num() - o};
+    }
+
+private:
+    int8_t* host;
+};
+
+inline float get_input_scale(const xir::Tensor* tensor) {
+    return exp2f(tensor->get_attr<int>("fix_point"));
+}
+
+inline float get_output_scale(const xir::Tensor* tensor) {
+    return exp2f(-1.0f * tensor->get_attr<int>("fix_point"));
+}
+
+#endif // MOCK_VART_H
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "model_manifest.h"
+
+using namespace std;
+
+ModelManifest default_model_manifest() {
+    ModelManifest manifest;
+    manifest.xmodel = "/home/root/Vitis-AI/demo/VART/resnet50_mt_py/ultra96v2_tipu12.xmodel";
+    manifest.width = 224;
+    manifest.height = 224;
+    manifest.channels = 3;
+    manifest.rgb = true;
+    manifest.mean = {0.485f, 0.456f, 0.406f};
+    manifest.std = {0.229f, 0.224f, 0.225f};
+    manifest.output_scale = 0;
+    manifest.classes = {"Coleoptera", "Diptera", "Hemiptera", "Hymenoptera", "Lepidoptera", "Mantodea",
+                        "Megaloptera", "Neuroptera", "Odonata", "Orthoptera", "Phasmida", "Trichoptera"};
+    return manifest;
+}
+
+static string trim(const string& s) {
+    size_t first = s.find_first_not_of(" \t\r\n");
+    size_t last = s.find_last_not_of(" \t\r\n");
+    return first == string::npos ? "" : s.substr(first, last - first + 1);
+}
+
+static vector<string> split_list(const string& value) {
+    // Comma-separated, or space-separated if there is no comma
+    vector<string> items;
+    char separator = value.find(',') != string::npos ? ',' : ' ';
+    stringstream stream(value);
+    string item;
+    while (getline(stream, item, separator)) {
+        item = trim(item);
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+static string relative_to(const string& manifest_path, const string& path) {
+    size_t slash = manifest_path.rfind('/');
+    if (path.empty() || path[0] == '/' || slash == string::npos) {
+        return path;
+    }
+    return manifest_path.substr(0, slash + 1) + path;
+}
+
+int load_model_manifest(const string& path, ModelManifest* manifest) {
+    ifstream file(path);
+    if (!file) {
+        cerr << "[ERROR] Could not open the manifest " << path << endl;
+        return -1;
+    }
+    string line;
+    int line_number = 0;
+    while (getline(file, line)) {
+        line_number++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) {
+            continue;
+        }
+        size_t equal = line.find('=');
+        if (equal == string::npos) {
+            cerr << "[ERROR] " << path << ":" << line_number << ": expected key = value" << endl;
+            return -1;
+        }
+        string key = trim(line.substr(0, equal)), value = trim(line.substr(equal + 1));
+        if (key == "xmodel") {
+            manifest->xmodel = relative_to(path, value);
+        } else if (key == "input") {
+            if (sscanf(value.c_str(), "%dx%dx%d", &manifest->width, &manifest->height, &manifest->channels) != 3) {
+                cerr << "[ERROR] " << path << ":" << line_number << ": input is width x height x channels" << endl;
+                return -1;
+            }
+        } else if (key == "channel_order") {
+            manifest->rgb = value == "rgb";
+        } else if (key == "mean" || key == "std") {
+            vector<float>& values = key == "mean" ? manifest->mean : manifest->std;
+            values.clear();
+            for (const string& item : split_list(value)) {
+                values.push_back(atof(item.c_str()));
+            }
+        } else if (key == "output_scale") {
+            manifest->output_scale = value == "model" ? 0 : atof(value.c_str());
+        } else if (key == "classes") {
+            manifest->classes = split_list(value);
+        } else if (key == "classes_file") {
+            ifstream classes(relative_to(path, value));
+            if (!classes) {
+                cerr << "[ERROR] Could not open the classes file " << relative_to(path, value) << endl;
+                return -1;
+            }
+            manifest->classes.clear();
+            string name;
+            while (getline(classes, name)) {
+                if (!trim(name).empty()) {
+                    manifest->classes.push_back(trim(name));
+                }
+            }
+        } else {
+            cerr << "[ERROR] " << path << ":" << line_number << ": unknown key " << key << endl;
+            return -1;
+        }
+    }
+
+    if (manifest->width <= 0 || manifest->height <= 0 || manifest->channels <= 0 || manifest->channels > MANIFEST_MAX_CHANNELS) {
+        cerr << "[ERROR] " << path << ": input of " << manifest->width << "x" << manifest->height << "x" << manifest->channels << endl;
+        return -1;
+    }
+    if ((int)manifest->mean.size() != manifest->channels || (int)manifest->std.size() != manifest->channels) {
+        cerr << "[ERROR] " << path << ": mean and std need " << manifest->channels << " values" << endl;
+        return -1;
+    }
+    for (float s : manifest->std) {
+        if (s == 0) {
+            cerr << "[ERROR] " << path << ": std of 0" << endl;
+            return -1;
+        }
+    }
+    if (manifest->classes.empty() || manifest->classes.size() > MANIFEST_MAX_CLASSES) {
+        cerr << "[ERROR] " << path << ": " << manifest->classes.size() << " classes" << endl;
+        return -1;
+    }
+    if (manifest->rgb && manifest->channels != 3) {
+        // Only BGR images have their channels swapped
+        manifest->rgb = false;
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef MODEL_MANIFEST_H
+#define MODEL_MANIFEST_H
+
+#include <string>
+#include <vector>
+
+/*
+    Description of a classification model, read at startup instead of being
+    built in the program: a text file of "key = value" lines, # for comments.
+
+        xmodel = ultra96v2_tipu12.xmodel        relative to the manifest
+        input = 224x224x3                       width x height x channels
+        channel_order = rgb                     of the model input, the images are decoded in BGR
+        mean = 0.485, 0.456, 0.406              per channel, on the pixel / 255
+        std = 0.229, 0.224, 0.225
+        output_scale = model                    or the scale of the int8 outputs
+        classes = Coleoptera, Diptera, ...      or classes_file = words.txt, one per line
+*/
+
+#define MANIFEST_MAX_CHANNELS   4
+#define MANIFEST_MAX_CLASSES    65535       // Labels are 16 bits, UINT16_MAX for unknown
+
+typedef struct {
+    std::string xmodel;
+    int width, height, channels;
+    bool rgb;                           // Model input in RGB, the images are decoded in BGR
+    std::vector<float> mean, std;
+    float output_scale;                 // 0 for the scale of the output tensor
+    std::vector<std::string> classes;
+} ModelManifest;
+
+// TIPU12 on the Ultra96v2: the model the program was built for before the manifests
+ModelManifest default_model_manifest();
+
+// Read the manifest at path over the defaults, 0 on success, -1 with an error message
+int load_model_manifest(const std::string& path, ModelManifest* manifest);
+
+#endif // MODEL_MANIFEST_H
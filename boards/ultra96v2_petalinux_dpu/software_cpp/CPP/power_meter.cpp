@@ -0,0 +1,101 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "power_meter.h"
+
+using namespace std;
+
+static string read_line(const string& path) {
+    char line[128] = "";
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        return "";
+    }
+    if (fgets(line, sizeof(line), file) == NULL) {
+        line[0] = '\0';
+    }
+    fclose(file);
+    line[strcspn(line, "\r\n")] = '\0';
+    return line;
+}
+
+PowerMeter::PowerMeter(const string& source, const string& hwmon_root) {
+    if (source.rfind("hwmon", 0) != 0) {
+        constant = atof(source.c_str());
+        return;
+    }
+    string name = source.size() > 6 ? source.substr(6) : "";
+    DIR* root = opendir(hwmon_root.c_str());
+    if (root == NULL) {
+        return;
+    }
+    struct dirent* device;
+    while ((device = readdir(root)) != NULL) {
+        if (device->d_name[0] == '.') {
+            continue;
+        }
+        string path = hwmon_root + "/" + device->d_name;
+        if (!name.empty() && read_line(path + "/name") != name) {
+            continue;
+        }
+        DIR* dir = opendir(path.c_str());
+        if (dir == NULL) {
+            continue;
+        }
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (strncmp(entry->d_name, "power", 5) == 0 && strstr(entry->d_name, "_input") != NULL) {
+                inputs.push_back(path + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+    closedir(root);
+    sort(inputs.begin(), inputs.end());
+}
+
+PowerMeter::~PowerMeter() {
+    if (running) {
+        stop();
+    }
+}
+
+double PowerMeter::read() const {
+    if (constant > 0) {
+        return constant;
+    }
+    double watts = 0;
+    for (const string& input : inputs) {
+        watts += atof(read_line(input).c_str()) * 1e-6;
+    }
+    return watts;
+}
+
+void PowerMeter::start(int period_ms) {
+    sum = 0;
+    n_samples = 0;
+    if (!available() || running) {
+        return;
+    }
+    running = true;
+    sampler = thread([this, period_ms]() {
+        while (running) {
+            sum += read();
+            n_samples++;
+            this_thread::sleep_for(chrono::milliseconds(period_ms));
+        }
+    });
+}
+
+double PowerMeter::stop() {
+    if (running) {
+        running = false;
+        sampler.join();
+    }
+    return n_samples > 0 ? sum / n_samples : read();
+}
@@ -0,0 +1,41 @@
+#ifndef POWER_METER_H
+#define POWER_METER_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    Power of the board, read from the power sensors of hwmon (power*_input,
+    in microwatts) and averaged over a run by a sampling thread. The source
+    is one of:
+    - "hwmon": the sum of all the power inputs of hwmon_root
+    - "hwmon:<name>": the sum of the power inputs of the devices of this name
+      (the name file of the device, irps5401 for the regulators of the
+      Ultra96v2 or ina260-u14 on the KV260 for example)
+    - a constant in watts, measured with an external meter
+*/
+class PowerMeter {
+public:
+    explicit PowerMeter(const std::string& source, const std::string& hwmon_root = "/sys/class/hwmon");
+    ~PowerMeter();
+
+    // False when no sensor matches the source
+    bool available() const { return constant > 0 || !inputs.empty(); }
+    // Instantaneous power in watts, 0 if not available
+    double read() const;
+    // Average power between start and stop, sampled every period_ms
+    void start(int period_ms = 20);
+    double stop();
+
+private:
+    std::vector<std::string> inputs;
+    double constant = 0;
+    std::thread sampler;
+    std::atomic<bool> running{false};
+    double sum = 0;
+    long n_samples = 0;
+};
+
+#endif // POWER_METER_H
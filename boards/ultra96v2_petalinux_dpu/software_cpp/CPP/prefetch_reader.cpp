@@ -0,0 +1,188 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "prefetch_reader.h"
+
+using namespace std;
+
+PrefetchReader::PrefetchReader(const vector<string>& paths, int window, int n_threads)
+    : paths(paths), slots(max(window, 1)) {
+#ifdef USE_IO_URING
+    // Fall back to the thread pool if the kernel has no io_uring
+    uring_ready = io_uring_queue_init(slots.size(), &ring, 0) == 0;
+#endif
+    if (!uring_ready) {
+        for (int i = 0; i < max(n_threads, 1); i++) {
+            workers.push_back(thread(&PrefetchReader::worker, this));
+        }
+    }
+}
+
+PrefetchReader::~PrefetchReader() {
+#ifdef USE_IO_URING
+    if (uring_ready) {
+        // The kernel may still write into the buffers of the files in flight
+        for (size_t i = consumed; i < submitted; i++) {
+            while (!slot(i).ready && uring_wait()) {
+            }
+        }
+        io_uring_queue_exit(&ring);
+    }
+#endif
+    {
+        lock_guard<mutex> lock(slots_mutex);
+        stopping = true;
+    }
+    slot_free.notify_all();
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+bool PrefetchReader::open_file(size_t index) {
+    /*
+        Open the file and size the slot buffer. The buffer keeps its capacity
+        between files, so it is only reallocated for a larger file.
+    */
+    Slot& s = slot(index);
+    s.offset = 0;
+    s.fd = open(paths[index].c_str(), O_RDONLY);
+    struct stat st;
+    if (s.fd < 0 || fstat(s.fd, &st) != 0) {
+        if (s.fd >= 0) {
+            close(s.fd);
+        }
+        s.fd = -1;
+        s.data.clear();
+        return false;
+    }
+    s.data.resize(st.st_size);
+    return true;
+}
+
+void PrefetchReader::worker() {
+    for (;;) {
+        size_t index;
+        {
+            unique_lock<mutex> lock(slots_mutex);
+            slot_free.wait(lock, [this] {
+                return stopping || submitted >= paths.size() || submitted < consumed + slots.size();
+            });
+            if (stopping || submitted >= paths.size()) {
+                return;
+            }
+            index = submitted++;
+        }
+
+        // The slot belongs to this thread until it is marked ready
+        Slot& s = slot(index);
+        if (open_file(index)) {
+            while (s.offset < s.data.size()) {
+                ssize_t n = pread(s.fd, s.data.data() + s.offset, s.data.size() - s.offset, s.offset);
+                if (n <= 0) {
+                    // Error, or the file got shorter since fstat
+                    s.data.resize(n < 0 ? 0 : s.offset);
+                    break;
+                }
+                s.offset += n;
+            }
+            close(s.fd);
+            s.fd = -1;
+        }
+
+        {
+            lock_guard<mutex> lock(slots_mutex);
+            s.ready = true;
+        }
+        slot_ready.notify_all();
+    }
+}
+
+#ifdef USE_IO_URING
+bool PrefetchReader::uring_submit(size_t index) {
+    Slot& s = slot(index);
+    if (!open_file(index) || s.data.empty()) {
+        if (s.fd >= 0) {
+            close(s.fd);
+            s.fd = -1;
+        }
+        s.ready = true;
+        return false;
+    }
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_read(sqe, s.fd, s.data.data(), s.data.size(), 0);
+    io_uring_sqe_set_data(sqe, (void*)(uintptr_t)index);
+    return true;
+}
+
+bool PrefetchReader::uring_wait() {
+    struct io_uring_cqe* cqe;
+    if (io_uring_wait_cqe(&ring, &cqe) != 0) {
+        return false;
+    }
+    size_t index = (uintptr_t)io_uring_cqe_get_data(cqe);
+    int res = cqe->res;
+    io_uring_cqe_seen(&ring, cqe);
+
+    Slot& s = slot(index);
+    if (res > 0) {
+        s.offset += res;
+    }
+    if (res > 0 && s.offset < s.data.size()) {
+        // Short read, queue the rest of the file
+        struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_read(sqe, s.fd, s.data.data() + s.offset, s.data.size() - s.offset, s.offset);
+        io_uring_sqe_set_data(sqe, (void*)(uintptr_t)index);
+        io_uring_submit(&ring);
+        return true;
+    }
+    s.data.resize(res < 0 ? 0 : s.offset);
+    close(s.fd);
+    s.fd = -1;
+    s.ready = true;
+    return true;
+}
+#endif
+
+bool PrefetchReader::next(vector<uint8_t>& data) {
+    if (consumed >= paths.size()) {
+        return false;
+    }
+
+#ifdef USE_IO_URING
+    if (uring_ready) {
+        // Keep the window full, with a single submission for all the new reads
+        bool queued = false;
+        while (submitted < paths.size() && submitted < consumed + slots.size()) {
+            queued |= uring_submit(submitted++);
+        }
+        if (queued) {
+            io_uring_submit(&ring);
+        }
+        while (!slot(consumed).ready) {
+            if (!uring_wait()) {
+                return false;
+            }
+        }
+        Slot& s = slot(consumed);
+        data.swap(s.data);
+        s.ready = false;
+        consumed++;
+        return true;
+    }
+#endif
+
+    {
+        unique_lock<mutex> lock(slots_mutex);
+        slot_ready.wait(lock, [this] { return slot(consumed).ready; });
+        Slot& s = slot(consumed);
+        data.swap(s.data);
+        s.ready = false;
+        consumed++;
+    }
+    slot_free.notify_all();
+    return true;
+}
@@ -0,0 +1,65 @@
+#ifndef PREFETCH_READER_H
+#define PREFETCH_READER_H
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef USE_IO_URING
+#include <liburing.h>
+#endif
+
+/*
+    Reads whole files ahead of the consumer, so that storage latency overlaps
+    with the decoding of the previous files. Up to window files are in flight.
+    Files are read with io_uring when built with -DUSE_IO_URING and supported
+    by the kernel, otherwise with a pool of threads doing pread.
+    next() returns the files in the order of paths: sort the paths beforehand
+    (directory order or inode) to get a sequential access pattern on the card.
+*/
+class PrefetchReader {
+public:
+    PrefetchReader(const std::vector<std::string>& paths, int window, int n_threads);
+    ~PrefetchReader();
+
+    // Swap the content of the next file into data. Returns false when all files were returned.
+    // data is empty if the file could not be read.
+    bool next(std::vector<uint8_t>& data);
+
+    bool using_io_uring() const { return uring_ready; }
+
+private:
+    struct Slot {
+        std::vector<uint8_t> data;
+        bool ready = false;
+        int fd = -1;
+        size_t offset = 0;
+    };
+
+    Slot& slot(size_t index) { return slots[index % slots.size()]; }
+    bool open_file(size_t index);
+    void worker();
+
+#ifdef USE_IO_URING
+    bool uring_submit(size_t index);
+    bool uring_wait();
+    struct io_uring ring;
+#endif
+
+    std::vector<std::string> paths;
+    std::vector<Slot> slots;
+    size_t consumed = 0;    // Files already returned by next()
+    size_t submitted = 0;   // Files whose read has started
+    bool uring_ready = false;
+    bool stopping = false;
+
+    std::mutex slots_mutex;
+    std::condition_variable slot_ready, slot_free;
+    std::vector<std::thread> workers;
+};
+
+#endif // PREFETCH_READER_H
@@ -0,0 +1,308 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include "cascade.h"
+#include "kernels.h"
+#include "model_manifest.h"
+#include "power_meter.h"
+#include "tar_dataset.h"
+
+namespace py = pybind11;
+using namespace std;
+
+/*
+    Python module tipu_dpu: the loader, preprocessing, runners and metrics of
+    the C++ driver for the PYNQ notebooks and scripts (build_python.sh).
+    The arrays are taken without conversion, so that the C++ code works in
+    the memory of numpy: an array of another type or not C-contiguous is
+    refused with a TypeError instead of being copied. The GIL is released
+    while the images are loaded, preprocessed and run, so that the other
+    Python threads keep running.
+*/
+
+typedef py::array_t<uint8_t, py::array::c_style> ImageArray;
+typedef py::array_t<int8_t, py::array::c_style> TensorArray;
+
+static int count_images(const ImageArray& images, const ModelManifest& manifest) {
+    // [N, height, width, channels] or a single [height, width, channels] image, in BGR
+    int offset = images.ndim() == 4 ? 1 : 0;
+    if ((images.ndim() != 3 && images.ndim() != 4) || images.shape(offset) != manifest.height ||
+        images.shape(offset + 1) != manifest.width || images.shape(offset + 2) != manifest.channels) {
+        throw invalid_argument("images must be [N, " + to_string(manifest.height) + ", " + to_string(manifest.width) + ", " +
+                               to_string(manifest.channels) + "] uint8");
+    }
+    return offset ? images.shape(0) : 1;
+}
+
+static TensorArray output_array(optional<TensorArray>& out, int n, int size) {
+    // The array given by the caller, or a new one
+    if (!out) {
+        return TensorArray({n, size});
+    }
+    if (out->size() != (py::ssize_t)n * size || !out->writeable()) {
+        throw invalid_argument("out must be a writeable int8 array of " + to_string(n) + " x " + to_string(size) + " values");
+    }
+    return *out;
+}
+
+static void parallel_for(int n, int n_threads, const function<void(int, int)>& range) {
+    // Contiguous ranges of [0, n), one per thread
+    n_threads = max(1, min(n, n_threads > 0 ? n_threads : (int)thread::hardware_concurrency()));
+    vector<thread> threads;
+    for (int t = 0; t < n_threads; t++) {
+        threads.emplace_back(range, (long)n * t / n_threads, (long)n * (t + 1) / n_threads);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+class Preprocessor {
+public:
+    Preprocessor(const ModelManifest& manifest, float input_scale) : manifest(manifest), kernels(manifest, input_scale) {}
+
+    TensorArray preprocess(const ImageArray& images, optional<TensorArray> out, int n_threads) const {
+        int n = count_images(images, manifest);
+        TensorArray input = output_array(out, n, kernels.input_size());
+        const uint8_t* src = images.data();
+        int8_t* dst = input.mutable_data();
+        size_t size = kernels.input_size();
+        {
+            py::gil_scoped_release release;
+            parallel_for(n, n_threads, [&](int first, int last) {
+                for (int i = first; i < last; i++) {
+                    kernels.preprocess(src + i * size, dst + i * size);
+                }
+            });
+        }
+        return input;
+    }
+
+    py::tuple classify(const TensorArray& logits, float scale) const {
+        // Class and probability of each row of n_classes logits
+        if (logits.size() % kernels.n_classes() != 0) {
+            throw invalid_argument("logits must be [N, " + to_string(kernels.n_classes()) + "] int8");
+        }
+        int n = logits.size() / kernels.n_classes();
+        py::array_t<int32_t> classes(n);
+        py::array_t<float> probabilities(n);
+        const int8_t* src = logits.data();
+        int32_t* best = classes.mutable_data();
+        float* probability = probabilities.mutable_data();
+        {
+            py::gil_scoped_release release;
+            for (int i = 0; i < n; i++) {
+                best[i] = kernels.classify(src + (size_t)i * kernels.n_classes(), scale, probability + i);
+            }
+        }
+        return py::make_tuple(classes, probabilities);
+    }
+
+    const ModelManifest manifest;
+    const ModelKernels kernels;
+};
+
+class PythonRunnerPool {
+public:
+    PythonRunnerPool(const string& xmodel_file, int n_runners) : pool(xmodel_file, n_runners) {}
+
+    TensorArray run(const TensorArray& inputs, optional<TensorArray> out) {
+        // inputs are [N, input_size] int8 at input_scale, the outputs [N, output_size]
+        if (inputs.size() % pool.input_size() != 0) {
+            throw invalid_argument("inputs must be [N, " + to_string(pool.input_size()) + "] int8");
+        }
+        int n = inputs.size() / pool.input_size();
+        TensorArray outputs = output_array(out, n, pool.output_size());
+        const int8_t* src = inputs.data();
+        int8_t* dst = outputs.mutable_data();
+        {
+            py::gil_scoped_release release;
+            run_pool(src, n, dst);
+        }
+        return outputs;
+    }
+
+    py::tuple classify_images(const ImageArray& images, const Preprocessor& preprocessor, int n_threads) {
+        /*
+            Preprocessing, DPU and classification of the images in one call,
+            without the GIL. Returns the classes, their probabilities and the
+            time of each step in seconds.
+        */
+        int n = count_images(images, preprocessor.manifest);
+        if (preprocessor.kernels.input_size() != pool.input_size() || preprocessor.kernels.n_classes() != pool.output_size()) {
+            throw invalid_argument("the manifest of the preprocessor does not match the model");
+        }
+        vector<int8_t> inputs((size_t)n * pool.input_size()), outputs((size_t)n * pool.output_size());
+        py::array_t<int32_t> classes(n);
+        py::array_t<float> probabilities(n);
+        const uint8_t* src = images.data();
+        int32_t* best = classes.mutable_data();
+        float* probability = probabilities.mutable_data();
+        double preprocess_seconds, run_seconds, classify_seconds;
+        {
+            py::gil_scoped_release release;
+            const ModelKernels& kernels = preprocessor.kernels;
+            size_t in_size = pool.input_size(), out_size = pool.output_size();
+            float output_scale = preprocessor.manifest.output_scale > 0 ? preprocessor.manifest.output_scale : pool.output_scale();
+            auto start = chrono::steady_clock::now();
+            parallel_for(n, n_threads, [&](int first, int last) {
+                for (int i = first; i < last; i++) {
+                    kernels.preprocess(src + i * in_size, inputs.data() + i * in_size);
+                }
+            });
+            auto preprocessed = chrono::steady_clock::now();
+            run_pool(inputs.data(), n, outputs.data());
+            auto ran = chrono::steady_clock::now();
+            for (int i = 0; i < n; i++) {
+                best[i] = kernels.classify(outputs.data() + i * out_size, output_scale, probability + i);
+            }
+            auto classified = chrono::steady_clock::now();
+            preprocess_seconds = chrono::duration<double>(preprocessed - start).count();
+            run_seconds = chrono::duration<double>(ran - preprocessed).count();
+            classify_seconds = chrono::duration<double>(classified - ran).count();
+        }
+        py::dict times;
+        times["preprocess"] = preprocess_seconds;
+        times["run"] = run_seconds;
+        times["classify"] = classify_seconds;
+        return py::make_tuple(classes, probabilities, times);
+    }
+
+    RunnerPool pool;
+
+private:
+    void run_pool(const int8_t* inputs, int n, int8_t* outputs) {
+        // The images in order, a batch at a time for each runner
+        atomic<int> next_image{0};
+        pool.run(inputs, pool.input_scale(), [&](int* indices, int max_n) {
+            int first = next_image.fetch_add(max_n);
+            int count = max(0, min(max_n, n - first));
+            for (int i = 0; i < count; i++) {
+                indices[i] = first + i;
+            }
+            return count;
+        }, outputs);
+    }
+};
+
+static py::tuple load_tar(const string& tar_path, const ModelManifest& manifest, int max_images) {
+    // The images of the archive in BGR at the size of the manifest, and their labels
+    auto images = new vector<uint8_t>();
+    auto labels = new vector<uint16_t>();
+    int n;
+    {
+        py::gil_scoped_release release;
+        n = load_images_from_tar(tar_path, manifest.classes, manifest.width, manifest.height, max_images, *images, *labels, NULL);
+    }
+    py::capsule own_images(images, [](void* p) { delete reinterpret_cast<vector<uint8_t>*>(p); });
+    py::capsule own_labels(labels, [](void* p) { delete reinterpret_cast<vector<uint16_t>*>(p); });
+    if (n < 0) {
+        throw runtime_error("could not read the archive " + tar_path);
+    }
+    // The arrays keep the vectors, without a copy
+    py::array_t<uint8_t> image_array({(py::ssize_t)n, (py::ssize_t)manifest.height, (py::ssize_t)manifest.width, (py::ssize_t)3},
+                                     images->data(), own_images);
+    py::array_t<uint16_t> label_array({(py::ssize_t)n}, labels->data(), own_labels);
+    return py::make_tuple(image_array, label_array);
+}
+
+static py::tuple accuracy(py::array_t<int32_t, py::array::c_style | py::array::forcecast> predicted,
+                          py::array_t<int32_t, py::array::c_style | py::array::forcecast> labels, int n_classes) {
+    // Global accuracy and accuracy of each class, as printed by the driver
+    if (predicted.size() != labels.size()) {
+        throw invalid_argument("predicted and labels must have the same size");
+    }
+    vector<int> correct(n_classes, 0), total(n_classes, 0);
+    int n_correct = 0;
+    for (py::ssize_t i = 0; i < labels.size(); i++) {
+        int label = labels.data()[i];
+        if (label < 0 || label >= n_classes) {
+            continue;
+        }
+        total[label]++;
+        if (predicted.data()[i] == label) {
+            correct[label]++;
+            n_correct++;
+        }
+    }
+    py::array_t<float> per_class(n_classes);
+    for (int i = 0; i < n_classes; i++) {
+        per_class.mutable_data()[i] = total[i] > 0 ? (float)correct[i] / total[i] : 0;
+    }
+    return py::make_tuple(labels.size() > 0 ? (double)n_correct / labels.size() : 0.0, per_class);
+}
+
+PYBIND11_MODULE(tipu_dpu, m) {
+    m.doc() = "Loader, preprocessing, DPU runners and metrics of the C++ driver";
+
+    py::class_<ModelManifest>(m, "Manifest")
+        .def_readwrite("xmodel", &ModelManifest::xmodel)
+        .def_readwrite("width", &ModelManifest::width)
+        .def_readwrite("height", &ModelManifest::height)
+        .def_readwrite("channels", &ModelManifest::channels)
+        .def_readwrite("rgb", &ModelManifest::rgb)
+        .def_readwrite("mean", &ModelManifest::mean)
+        .def_readwrite("std", &ModelManifest::std)
+        .def_readwrite("output_scale", &ModelManifest::output_scale)
+        .def_readwrite("classes", &ModelManifest::classes);
+    m.def("default_manifest", &default_model_manifest, "The manifest of TIPU12");
+    m.def("load_manifest", [](const string& path) {
+        ModelManifest manifest = default_model_manifest();
+        if (load_model_manifest(path, &manifest) != 0) {
+            throw runtime_error("could not load the manifest " + path);
+        }
+        return manifest;
+    }, py::arg("path"), "Read a manifest over the defaults (see model_manifest.h)");
+
+    m.def("load_tar", &load_tar, py::arg("tar_path"), py::arg("manifest"), py::arg("max_images") = 0,
+          "Decode and resize the images of a class/image.jpg archive: (images [N, H, W, 3] uint8 BGR, labels [N] uint16)");
+
+    py::class_<Preprocessor>(m, "Preprocessor")
+        .def(py::init<const ModelManifest&, float>(), py::arg("manifest"), py::arg("input_scale"))
+        .def("preprocess", &Preprocessor::preprocess, py::arg("images").noconvert(), py::arg("out").noconvert() = py::none(),
+             py::arg("threads") = 0, "int8 inputs [N, input_size] of uint8 BGR images [N, H, W, C], in out if given")
+        .def("classify", &Preprocessor::classify, py::arg("logits").noconvert(), py::arg("scale"),
+             "(classes [N] int32, probabilities [N] float32) of int8 logits [N, n_classes]")
+        .def_property_readonly("input_size", [](const Preprocessor& p) { return p.kernels.input_size(); })
+        .def_property_readonly("n_classes", [](const Preprocessor& p) { return p.kernels.n_classes(); })
+        .def_property_readonly("fixed_kernels", [](const Preprocessor& p) {
+            return p.kernels.fixed_preprocess() && p.kernels.fixed_classify();
+        });
+
+    py::class_<PythonRunnerPool>(m, "RunnerPool")
+        .def(py::init<const string&, int>(), py::arg("xmodel"), py::arg("n_runners"),
+             "n_runners runners of the DPU subgraph of the xmodel, one thread each")
+        .def("run", &PythonRunnerPool::run, py::arg("inputs").noconvert(), py::arg("out").noconvert() = py::none(),
+             "int8 outputs [N, output_size] of int8 inputs [N, input_size], in out if given")
+        .def("classify_images", &PythonRunnerPool::classify_images, py::arg("images").noconvert(), py::arg("preprocessor"),
+             py::arg("threads") = 0, "(classes, probabilities, times) of uint8 BGR images [N, H, W, C]")
+        .def_property_readonly("batch_size", [](PythonRunnerPool& p) { return p.pool.batch_size(); })
+        .def_property_readonly("input_size", [](PythonRunnerPool& p) { return p.pool.input_size(); })
+        .def_property_readonly("output_size", [](PythonRunnerPool& p) { return p.pool.output_size(); })
+        .def_property_readonly("input_scale", [](PythonRunnerPool& p) { return p.pool.input_scale(); })
+        .def_property_readonly("output_scale", [](PythonRunnerPool& p) { return p.pool.output_scale(); });
+
+    m.def("accuracy", &accuracy, py::arg("predicted"), py::arg("labels"), py::arg("n_classes"),
+          "(global accuracy, accuracy of each class [n_classes]); labels out of range are ignored");
+
+    py::class_<PowerMeter>(m, "PowerMeter")
+        .def(py::init<const string&, const string&>(), py::arg("source"), py::arg("hwmon_root") = "/sys/class/hwmon",
+             "Power of the board (see power_meter.h): \"hwmon\", \"hwmon:<name>\" or a constant in watts")
+        .def("available", &PowerMeter::available)
+        .def("read", &PowerMeter::read, "Instantaneous power in watts")
+        .def("start", &PowerMeter::start, py::arg("period_ms") = 20, py::call_guard<py::gil_scoped_release>())
+        .def("stop", &PowerMeter::stop, "Average power since start", py::call_guard<py::gil_scoped_release>());
+}
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "deadline_scheduler.h"
+#include "mock_vart.h"
+
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -DMOCK_VART -o scheduler_bench scheduler_bench.cpp deadline_scheduler.cpp -lpthread
+
+#define LANE_LIVE   0
+#define LANE_BULK   1
+
+#define MAX_LIVE_MISSED 0.05    // Of the live crops, with the priority lanes
+#define MAX_SHED_WAIT   2.0     // Average wait of the shed bulk lane, in shed_ms
+
+typedef struct {
+    int seconds;
+    int n_runners;
+    int latency_us;         // Of a job of the large model
+    int burst_size;         // Live crops every burst_ms
+    int burst_ms;
+    double live_deadline_ms;
+    int bulk_per_second;
+    double bulk_deadline_ms;
+} Workload;
+
+typedef struct {
+    LaneStats live, bulk;
+    long reported_drops;    // Given to on_dropped
+} Result;
+
+static double missed(const LaneStats& s) {
+    // Dropped, or completed after the deadline, out of the admitted items
+    long admitted = s.submitted - s.shed;
+    return admitted > 0 ? (double)(s.dropped + s.late) / admitted : 0;
+}
+
+static bool all_accounted(const LaneStats& s) {
+    // Each admitted item is completed (by the runners or degraded) or dropped
+    return s.submitted - s.shed == s.completed + s.dropped;
+}
+
+static Result run_mode(const char* name, const SchedulerOptions& options, const Workload& w) {
+    /*
+        A camera gives bursts of crops with a short deadline in the live lane
+        while stored captures are submitted at a constant rate in the bulk
+        lane, more than the runners can do with the bursts. The runners are
+        mock DPUs; the degraded crops run on a mock small model 4 times
+        faster, in its own thread.
+    */
+    xir::Subgraph large("large", xir::Tensor("input", {1, 32, 32, 3}, 6), xir::Tensor("output", {1, 12}, 2), w.latency_us);
+    xir::Subgraph small("small", xir::Tensor("input", {1, 32, 32, 3}, 6), xir::Tensor("output", {1, 12}, 2), w.latency_us / 4);
+    vector<int8_t> crop(32 * 32 * 3, 1);
+    atomic<long> reported_drops(0);
+    DeadlineScheduler scheduler(options, w.n_runners, [&](const int*, int n) { reported_drops += n; });
+
+    auto worker = [&](const xir::Subgraph* subgraph, bool degraded) {
+        auto runner = vart::Runner::create_runner(subgraph, "run");
+        vector<int8_t> output(12);
+        int index;
+        while ((degraded ? scheduler.pop_degraded(&index, 1) : scheduler.pop(&index, 1)) > 0) {
+            CpuFlatTensorBuffer input_buffer(crop.data(), runner->get_input_tensors()[0]);
+            CpuFlatTensorBuffer output_buffer(output.data(), runner->get_output_tensors()[0]);
+            vector<vart::TensorBuffer*> inputs = {&input_buffer}, outputs = {&output_buffer};
+            auto job_id = runner->execute_async(inputs, outputs);
+            runner->wait(job_id.first, -1);
+            scheduler.done(&index, 1);
+        }
+    };
+    vector<thread> threads;
+    for (int i = 0; i < w.n_runners; i++) {
+        threads.emplace_back(worker, &large, false);
+    }
+    threads.emplace_back(worker, &small, true);
+
+    // Submissions on a fixed schedule: a bulk item every 1/bulk_per_second, a burst every burst_ms
+    auto start = steady_clock::now();
+    auto end = start + seconds(w.seconds);
+    auto next_bulk = start, next_burst = start;
+    auto bulk_period = duration_cast<steady_clock::duration>(duration<double>(1.0 / w.bulk_per_second));
+    int index = 0;
+    while (true) {
+        auto now = min(next_bulk, next_burst);
+        if (now >= end) {
+            break;
+        }
+        this_thread::sleep_until(now);
+        if (next_burst <= next_bulk) {
+            for (int i = 0; i < w.burst_size; i++) {
+                scheduler.submit(index++, LANE_LIVE, w.live_deadline_ms);
+            }
+            next_burst += milliseconds(w.burst_ms);
+        } else {
+            scheduler.submit(index++, LANE_BULK, w.bulk_deadline_ms);
+            next_bulk += bulk_period;
+        }
+    }
+    scheduler.close();
+    for (auto& t : threads) {
+        t.join();
+    }
+    double elapsed = duration<double>(steady_clock::now() - start).count();
+
+    static const char* lane_names[] = {"live", "bulk"};
+    Result result = {scheduler.lane_stats(LANE_LIVE), scheduler.lane_stats(LANE_BULK), reported_drops};
+    printf("\n%s: %.1f s, %.1f crops/s completed\n", name, elapsed, (result.live.completed + result.bulk.completed) / elapsed);
+    scheduler.print_stats(lane_names);
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    Workload w;
+    w.seconds = argc > 1 ? atoi(argv[1]) : 5;
+    w.n_runners = argc > 2 ? atoi(argv[2]) : 2;
+    w.latency_us = argc > 3 ? atoi(argv[3]) : 2000;
+    w.burst_size = argc > 4 ? atoi(argv[4]) : 16;
+    w.burst_ms = 100;
+    w.live_deadline_ms = argc > 5 ? atof(argv[5]) : 30;
+    w.bulk_per_second = argc > 6 ? atoi(argv[6]) : 1000;
+    w.bulk_deadline_ms = 2000;
+    double shed_ms = argc > 7 ? atof(argv[7]) : 50;
+    if (w.seconds <= 0 || w.n_runners <= 0 || w.latency_us <= 0 || w.burst_size < 0 || w.bulk_per_second <= 0) {
+        printf("Usage: %s [seconds] [n_runners] [DPU latency in us] [live burst size] [live deadline ms] [bulk per second] "
+               "[shed ms]\n", argv[0]);
+        return 1;
+    }
+    double capacity = w.n_runners * 1e6 / w.latency_us;
+    double offered = w.burst_size * 1000.0 / w.burst_ms + w.bulk_per_second;
+    printf("%d runners of %d us: %.0f crops/s, offered %.0f crops/s (live bursts of %d every %d ms, deadline %.0f ms; "
+           "bulk %d/s, deadline %.0f ms)\n", w.n_runners, w.latency_us, capacity, offered, w.burst_size, w.burst_ms,
+           w.live_deadline_ms, w.bulk_per_second, w.bulk_deadline_ms);
+
+    SchedulerOptions options;
+    options.n_lanes = 2;
+    options.shed_from = LANE_BULK;
+    options.shed_ms = 0;
+    options.expired = EXPIRED_RUN;
+    options.fifo = true;
+    Result fifo = run_mode("FIFO (the drivers)", options, w);
+
+    options.fifo = false;
+    Result lanes = run_mode("Priority lanes", options, w);
+
+    options.shed_ms = shed_ms;
+    options.expired = EXPIRED_DROP;
+    Result drop = run_mode("Priority lanes, shed bulk, drop expired", options, w);
+
+    options.expired = EXPIRED_DEGRADE;
+    Result degrade = run_mode("Priority lanes, shed bulk, degrade expired", options, w);
+
+    /*
+        The claims of the README. When a burst fits in the live deadline,
+        the live crops meet it with the lanes (at most MAX_LIVE_MISSED of
+        them missed, and fewer than with one FIFO). When it does not, the
+        live crops that are run are still in time, the others dropped. The
+        shed bulk lane waits about shed_ms, and every item is completed or
+        dropped, the drops being given to on_dropped.
+    */
+    bool live_fits = w.burst_size * w.latency_us / 1000.0 / w.n_runners <= w.live_deadline_ms;
+    bool ok = true;
+    auto check = [&](bool condition, const char* claim) {
+        if (!condition) {
+            printf("[ERROR] %s\n", claim);
+            ok = false;
+        }
+    };
+    printf("\nLive crops missed: FIFO %.1f%%, lanes %.1f%%, shed and drop %.1f%%, shed and degrade %.1f%%\n",
+           100 * missed(fifo.live), 100 * missed(lanes.live), 100 * missed(drop.live), 100 * missed(degrade.live));
+    if (live_fits) {
+        check(missed(lanes.live) <= MAX_LIVE_MISSED && missed(lanes.live) < missed(fifo.live),
+              "The priority lanes do not keep the live crops within their deadline");
+        check(missed(drop.live) <= MAX_LIVE_MISSED, "Shedding the bulk lane misses live crops");
+    }
+    check(drop.live.late <= MAX_LIVE_MISSED * drop.live.completed, "The live crops run after dropping are late");
+    check(shed_ms <= 0 || drop.bulk.wait_ms <= MAX_SHED_WAIT * shed_ms, "Shedding does not bound the bulk queue");
+    for (const Result* r : {&fifo, &lanes, &drop, &degrade}) {
+        check(all_accounted(r->live) && all_accounted(r->bulk), "Admitted items neither completed nor dropped");
+        check(r->reported_drops == r->live.dropped + r->bulk.dropped, "Dropped items not given to on_dropped");
+    }
+    if (ok) {
+        printf("[SUCCESS] Live crops within their deadline%s, bulk queue bounded, drops reported\n",
+               live_fits ? "" : " or dropped");
+    }
+    return ok ? 0 : 1;
+}
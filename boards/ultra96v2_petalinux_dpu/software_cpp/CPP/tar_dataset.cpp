@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <unordered_map>
+
+#include "tar_dataset.h"
+
+using namespace std;
+using namespace cv;
+
+#define TAR_BLOCK_SIZE      512
+#define TAR_READ_BUFFER     (4 << 20)
+
+// Offsets in the ustar header block
+#define TAR_NAME_OFFSET     0
+#define TAR_NAME_SIZE       100
+#define TAR_SIZE_OFFSET     124
+#define TAR_SIZE_SIZE       12
+#define TAR_TYPE_OFFSET     156
+#define TAR_MAGIC_OFFSET    257
+#define TAR_PREFIX_OFFSET   345
+#define TAR_PREFIX_SIZE     155
+
+static uint64_t parse_size(const uint8_t* field) {
+    // Octal, or base-256 (high bit set) for members larger than 8 GB
+    uint64_t size = 0;
+    if (field[0] & 0x80) {
+        for (int i = 1; i < TAR_SIZE_SIZE; i++) {
+            size = (size << 8) | field[i];
+        }
+        return size;
+    }
+    for (int i = 0; i < TAR_SIZE_SIZE && field[i] >= '0' && field[i] <= '7'; i++) {
+        size = (size << 3) | (field[i] - '0');
+    }
+    return size;
+}
+
+static string parse_string(const uint8_t* field, int size) {
+    return string((const char*)field, strnlen((const char*)field, size));
+}
+
+static string parse_pax_path(const vector<uint8_t>& data) {
+    // Records are "<length> <key>=<value>\n"
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t length = strtoul((const char*)data.data() + pos, NULL, 10);
+        if (length == 0 || pos + length > data.size()) {
+            break;
+        }
+        string record((const char*)data.data() + pos, length);
+        size_t space = record.find(' ');
+        if (space != string::npos && record.compare(space + 1, 5, "path=") == 0) {
+            return record.substr(space + 6, record.size() - space - 7);
+        }
+        pos += length;
+    }
+    return "";
+}
+
+static string parent_directory(const string& path) {
+    size_t end = path.find_last_of('/');
+    if (end == string::npos) {
+        return "";
+    }
+    size_t start = path.find_last_of('/', end - 1);
+    start = start == string::npos ? 0 : start + 1;
+    return path.substr(start, end - start);
+}
+
+static bool read_exactly(FILE* file, void* data, size_t size) {
+    return fread(data, 1, size, file) == size;
+}
+
+static bool skip(FILE* file, uint64_t size, vector<uint8_t>& scratch) {
+    // No fseek, the archive can be a pipe
+    scratch.resize(TAR_BLOCK_SIZE * 16);
+    while (size > 0) {
+        size_t chunk = size < scratch.size() ? size : scratch.size();
+        if (!read_exactly(file, scratch.data(), chunk)) {
+            return false;
+        }
+        size -= chunk;
+    }
+    return true;
+}
+
+static uint64_t padding(uint64_t size) {
+    return (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+}
+
+bool is_tar_file(const string& path) {
+    return path == "-" || (path.size() > 4 && path.compare(path.size() - 4, 4, ".tar") == 0);
+}
+
+int load_images_from_tar(const string& tar_path, const vector<string>& class_names,
+                         int width, int height, int max_images,
+                         vector<uint8_t>& images, vector<uint16_t>& labels,
+                         const ColorCorrectionParams* color_correction) {
+    FILE* file = tar_path == "-" ? stdin : fopen(tar_path.c_str(), "rb");
+    if (file == NULL) {
+        cout << "Could not open archive: " << tar_path << endl;
+        return -1;
+    }
+    // Large sequential reads, the archive is never seeked
+    vector<char> read_buffer(TAR_READ_BUFFER);
+    if (file != stdin) {
+        setvbuf(file, read_buffer.data(), _IOFBF, read_buffer.size());
+    }
+
+    unordered_map<string, int> class_index;
+    for (size_t i = 0; i < class_names.size(); i++) {
+        class_index[class_names[i]] = i;
+    }
+    vector<int> n_images_class(class_names.size(), 0);
+
+    const size_t image_size = (size_t)width * height * 3;
+    uint8_t header[TAR_BLOCK_SIZE];
+    vector<uint8_t> data, scratch;
+    string long_name;
+    int n_images = 0;
+    bool error = false;
+
+    while (n_images < max_images) {
+        if (!read_exactly(file, header, TAR_BLOCK_SIZE)) {
+            break;
+        }
+        // An empty block marks the end of the archive
+        if (header[TAR_NAME_OFFSET] == 0) {
+            break;
+        }
+
+        uint64_t size = parse_size(header + TAR_SIZE_OFFSET);
+        char type = header[TAR_TYPE_OFFSET];
+
+        // GNU long name or pax header: the payload names the next member
+        if (type == 'L' || type == 'x') {
+            data.resize(size);
+            if (!read_exactly(file, data.data(), size) || !skip(file, padding(size), scratch)) {
+                error = true;
+                break;
+            }
+            long_name = type == 'L' ? parse_string(data.data(), size) : parse_pax_path(data);
+            continue;
+        }
+
+        string path = long_name;
+        long_name.clear();
+        if (path.empty()) {
+            path = parse_string(header + TAR_NAME_OFFSET, TAR_NAME_SIZE);
+            if (memcmp(header + TAR_MAGIC_OFFSET, "ustar", 5) == 0 && header[TAR_PREFIX_OFFSET] != 0) {
+                path = parse_string(header + TAR_PREFIX_OFFSET, TAR_PREFIX_SIZE) + "/" + path;
+            }
+        }
+
+        // Only regular files in a known class directory are images
+        auto label = class_index.find(parent_directory(path));
+        if ((type != '0' && type != '\0') || label == class_index.end()) {
+            if (!skip(file, size + padding(size), scratch)) {
+                error = true;
+                break;
+            }
+            continue;
+        }
+
+        data.resize(size);
+        if (!read_exactly(file, data.data(), size) || !skip(file, padding(size), scratch)) {
+            error = true;
+            break;
+        }
+
+        Mat image = imdecode(Mat(1, size, CV_8UC1, data.data()), IMREAD_COLOR);
+        if (image.empty()) {
+            cout << "Could not decode image: " << path << endl;
+            continue;
+        }
+        resize(image, image, Size(width, height));
+        if (color_correction != NULL) {
+            correct_colors(image.data, width, height, color_correction);
+        }
+        images.insert(images.end(), image.data, image.data + image_size);
+        labels.push_back(label->second);
+        n_images_class[label->second]++;
+        n_images++;
+    }
+
+    if (file != stdin) {
+        fclose(file);
+    }
+    if (error) {
+        cout << "Truncated archive: " << tar_path << endl;
+    }
+    for (size_t i = 0; i < class_names.size(); i++) {
+        cout << "Found " << n_images_class[i] << " images for class " << class_names[i] << endl;
+    }
+    cout << "Found " << n_images << " images in total" << endl;
+    return n_images;
+}
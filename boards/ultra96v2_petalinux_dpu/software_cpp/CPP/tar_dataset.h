@@ -0,0 +1,28 @@
+#ifndef TAR_DATASET_H
+#define TAR_DATASET_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "color_correction.h"
+
+/*
+    Dataset source reading a tar archive of the class/image.jpg tree in one
+    forward pass, instead of opening every image of the dataset folder.
+    The archive is created with:
+        tar cf test_tipu12.tar -C test_tipu12 .
+    The label of an image is the index of its parent directory in class_names.
+    Use "-" as tar_path to read the archive from stdin.
+*/
+
+// Decode, resize and append every image of the archive to images (width x height x 3)
+// and its label to labels. Returns the number of images loaded, or -1 on error.
+int load_images_from_tar(const std::string& tar_path, const std::vector<std::string>& class_names,
+                         int width, int height, int max_images,
+                         std::vector<uint8_t>& images, std::vector<uint16_t>& labels,
+                         const ColorCorrectionParams* color_correction);
+
+bool is_tar_file(const std::string& path);
+
+#endif // TAR_DATASET_H
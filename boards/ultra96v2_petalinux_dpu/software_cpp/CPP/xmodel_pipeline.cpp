@@ -0,0 +1,403 @@
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "cpu_ops.h"
+#include "xmodel_pipeline.h"
+
+using namespace std;
+using namespace chrono;
+
+void ImageQueue::push(int index) {
+    unique_lock<mutex> lock(queue_mutex);
+    changed.wait(lock, [&]() { return !indices.full(); });
+    indices.push(index);
+    changed.notify_all();
+}
+
+void ImageQueue::close() {
+    lock_guard<mutex> lock(queue_mutex);
+    closed = true;
+    changed.notify_all();
+}
+
+int ImageQueue::pop() {
+    unique_lock<mutex> lock(queue_mutex);
+    changed.wait(lock, [&]() { return !indices.empty() || closed; });
+    if (indices.empty()) {
+        return -1;
+    }
+    int index = indices.pop();
+    changed.notify_all();
+    return index;
+}
+
+static string device_of(const xir::Subgraph* subgraph) {
+    return subgraph->has_attr("device") ? subgraph->get_attr<string>("device") : "";
+}
+
+int xmodel_subgraph_count(const xir::Graph* graph, const string& device) {
+    auto children = graph->get_root_subgraph()->children_topological_sort();
+    return count_if(children.begin(), children.end(), [&](const xir::Subgraph* s) { return device_of(s) == device; });
+}
+
+unique_ptr<XmodelPipeline> XmodelPipeline::create(const string& xmodel_file, int n_runners, int window) {
+    unique_ptr<XmodelPipeline> pipeline(new XmodelPipeline());
+    if (pipeline->load(xmodel_file, n_runners, window) != 0) {
+        return nullptr;
+    }
+    return pipeline;
+}
+
+int XmodelPipeline::tensor_index(const xir::Tensor* tensor) {
+    // Tensors are shared by name: the runners have their own copies of the tensors of the graph
+    for (size_t i = 0; i < tensors.size(); i++) {
+        if (tensors[i].tensor->get_name() == tensor->get_name()) {
+            return i;
+        }
+    }
+    auto shape = tensor->get_shape();
+    auto type = tensor->get_data_type();
+    bool quantized = (type.type == xir::DataType::XINT || type.type == xir::DataType::INT) && type.bit_width == 8;
+    float scale = tensor->has_attr("fix_point") ? exp2f(tensor->get_attr<int>("fix_point")) : 1.0f;
+    tensors.push_back({tensor, vector<int>(shape.begin(), shape.end()), (int)tensor->get_element_num(), quantized, scale, {}});
+    return tensors.size() - 1;
+}
+
+int XmodelPipeline::load(const string& xmodel_file, int n_runners, int window) {
+    /*
+        A stage per DPU or CPU subgraph, in topological order (the USER
+        subgraph gives the input of the model). The tensors of the DPU are
+        int8 at their fix point; a tensor is checked to come from the input
+        or from an earlier stage before it is used. The constants of the CPU
+        subgraphs are read once, and a placeholder of the input (data-fix)
+        is the input of the model.
+    */
+    graph = xir::Graph::deserialize(xmodel_file);
+    vector<bool> produced;
+    auto mark_produced = [&](int t) {
+        produced.resize(tensors.size(), false);
+        produced[t] = true;
+    };
+    auto check_produced = [&](int t, const xir::Subgraph* subgraph) {
+        produced.resize(tensors.size(), false);
+        if (input_tensor < 0 && stages.empty()) {
+            // No USER subgraph: the first input of the first stage
+            input_tensor = t;
+            produced[t] = true;
+        }
+        if (!produced[t]) {
+            cerr << "[ERROR] Tensor " << tensors[t].tensor->get_name() << " of subgraph " << subgraph->get_name()
+                 << " does not come from an earlier subgraph" << endl;
+            return false;
+        }
+        return true;
+    };
+
+    for (auto subgraph : graph->get_root_subgraph()->children_topological_sort()) {
+        string device = device_of(subgraph);
+        if (device == "USER") {
+            for (auto tensor : subgraph->get_output_tensors()) {
+                input_tensor = tensor_index(tensor);
+                mark_produced(input_tensor);
+            }
+            continue;
+        }
+        if (device != "DPU" && device != "CPU") {
+            cerr << "[ERROR] Subgraph " << subgraph->get_name() << " is on the device \"" << device << "\"" << endl;
+            return -1;
+        }
+        unique_ptr<Stage> stage(new Stage());
+        stage->subgraph = subgraph;
+        stage->dpu = device == "DPU";
+        stage->busy_seconds = 0;
+        if (stage->dpu) {
+            for (int i = 0; i < n_runners; i++) {
+                stage->runners.push_back(vart::Runner::create_runner(subgraph, "run"));
+            }
+            auto runner = stage->runners[0].get();
+            if (runner->get_input_tensors()[0]->get_shape()[0] != 1) {
+                cerr << "[ERROR] Subgraph " << subgraph->get_name() << " has a batch of "
+                     << runner->get_input_tensors()[0]->get_shape()[0] << ", the pipeline runs one image at a time" << endl;
+                return -1;
+            }
+            auto set_scale = [&](int t, const xir::Tensor* tensor) {
+                tensors[t].quantized = true;
+                tensors[t].scale = exp2f(tensor->get_attr<int>("fix_point"));
+            };
+            for (auto tensor : runner->get_input_tensors()) {
+                int t = tensor_index(tensor);
+                if (!check_produced(t, subgraph)) {
+                    return -1;
+                }
+                set_scale(t, tensor);
+                stage->inputs.push_back(t);
+            }
+            for (auto tensor : runner->get_output_tensors()) {
+                int t = tensor_index(tensor);
+                set_scale(t, tensor);
+                mark_produced(t);
+                stage->outputs.push_back(t);
+            }
+        } else {
+            for (auto op : subgraph->topological_sort()) {
+                string reason;
+                if (!cpu_op_supported(op, &reason)) {
+                    cerr << "[ERROR] CPU op " << op->get_name() << " (" << op->get_type() << ") of subgraph " << subgraph->get_name()
+                         << ": " << reason << endl;
+                    return -1;
+                }
+                if (cpu_op_is_source(op)) {
+                    int t = tensor_index(op->get_output_tensor());
+                    if (!cpu_op_is_constant(op)) {
+                        if (!check_produced(t, subgraph)) {
+                            return -1;
+                        }
+                        continue;
+                    }
+                    TensorInfo& info = tensors[t];
+                    info.constant = op->get_attr<vector<char>>("data");
+                    if (info.constant.size() != (size_t)info.size * (info.quantized ? 1 : sizeof(float))) {
+                        cerr << "[ERROR] Constant " << op->get_name() << " of subgraph " << subgraph->get_name() << " has "
+                             << info.constant.size() << " bytes for " << info.size << " values" << endl;
+                        return -1;
+                    }
+                    mark_produced(t);
+                    continue;
+                }
+                stage->op_inputs.emplace_back();
+                for (auto tensor : op->get_input_tensors("input")) {
+                    int t = tensor_index(tensor);
+                    if (!check_produced(t, subgraph)) {
+                        return -1;
+                    }
+                    stage->op_inputs.back().push_back(t);
+                }
+                stage->op_outputs.push_back(tensor_index(op->get_output_tensor()));
+                mark_produced(stage->op_outputs.back());
+                stage->ops.push_back(cpu_op_prepare(op));
+            }
+        }
+        stages.push_back(move(stage));
+    }
+
+    if (stages.empty()) {
+        cerr << "[ERROR] No DPU or CPU subgraph in " << xmodel_file << endl;
+        return -1;
+    }
+    if (!tensors[input_tensor].quantized) {
+        cerr << "[ERROR] The input of " << xmodel_file << " is not quantized" << endl;
+        return -1;
+    }
+    const Stage& last = *stages.back();
+    output_tensor = last.dpu ? last.outputs[0] : last.op_outputs.back();
+
+    int n_threads = 0;
+    for (auto& stage : stages) {
+        n_threads += stage->dpu ? stage->runners.size() : 1;
+    }
+    slots.resize(window > 0 ? window : 2 * n_threads);
+    for (Slot& slot : slots) {
+        slot.quantized.resize(tensors.size());
+        slot.real.resize(tensors.size());
+        for (size_t t = 0; t < tensors.size(); t++) {
+            if ((int)t == input_tensor || !tensors[t].constant.empty()) {
+                continue;
+            }
+            if (tensors[t].quantized) {
+                slot.quantized[t].resize(tensors[t].size);
+            } else {
+                slot.real[t].resize(tensors[t].size);
+            }
+        }
+    }
+    return 0;
+}
+
+int8_t* XmodelPipeline::quantized_data(int tensor, int image, Slot& slot) {
+    // The input of the model is read in place
+    if (tensor == input_tensor) {
+        return const_cast<int8_t*>(input + (size_t)image * tensors[tensor].size);
+    }
+    if (!tensors[tensor].constant.empty()) {
+        return (int8_t*)tensors[tensor].constant.data();
+    }
+    return slot.quantized[tensor].data();
+}
+
+const float* XmodelPipeline::real_data(int tensor, int image, Slot& slot, vector<float>& scratch) {
+    const TensorInfo& info = tensors[tensor];
+    if (!info.quantized) {
+        return info.constant.empty() ? slot.real[tensor].data() : (const float*)info.constant.data();
+    }
+    const int8_t* q = quantized_data(tensor, image, slot);
+    scratch.resize(info.size);
+    for (int i = 0; i < info.size; i++) {
+        scratch[i] = q[i] / info.scale;
+    }
+    return scratch.data();
+}
+
+void XmodelPipeline::run_dpu(Stage& stage, vart::Runner* runner, int image, Slot& slot, Worker& worker) {
+    // The tensor buffers of the image in the arena of the thread
+    worker.arena.reset();
+    for (size_t k = 0; k < stage.inputs.size(); k++) {
+        worker.inputs[k] = worker.arena.create<CpuFlatTensorBuffer>(quantized_data(stage.inputs[k], image, slot), worker.input_tensors[k]);
+    }
+    for (size_t k = 0; k < stage.outputs.size(); k++) {
+        worker.outputs[k] = worker.arena.create<CpuFlatTensorBuffer>(quantized_data(stage.outputs[k], image, slot), worker.output_tensors[k]);
+    }
+    auto job_id = runner->execute_async(worker.inputs, worker.outputs);
+    runner->wait(job_id.first, -1);
+}
+
+void XmodelPipeline::run_cpu(Stage& stage, int image, Slot& slot, Worker& worker) {
+    /*
+        The ops on float data: the quantized inputs are converted in the
+        scratch buffers, and a quantized output is computed in the last one
+        and rounded to its fix point. The buffers and tensors of the worker
+        keep their capacity from one image to the next.
+    */
+    vector<vector<float>>& scratch = worker.scratch;
+    for (size_t o = 0; o < stage.ops.size(); o++) {
+        const vector<int>& op_inputs = stage.op_inputs[o];
+        scratch.resize(max(scratch.size(), op_inputs.size() + 1));
+        vector<CpuTensor>& inputs = worker.op_inputs;
+        inputs.resize(op_inputs.size());
+        for (size_t k = 0; k < op_inputs.size(); k++) {
+            int t = op_inputs[k];
+            inputs[k].shape = tensors[t].shape;
+            inputs[k].data = const_cast<float*>(real_data(t, image, slot, scratch[k]));
+        }
+        int out = stage.op_outputs[o];
+        const TensorInfo& info = tensors[out];
+        vector<float>& result = scratch[op_inputs.size()];
+        if (info.quantized) {
+            result.resize(info.size);
+        }
+        CpuTensor& output = worker.op_output;
+        output.shape = info.shape;
+        output.data = info.quantized ? result.data() : slot.real[out].data();
+        worker.arena.reset();
+        cpu_op_run(stage.ops[o], inputs, output, worker.arena);
+        if (info.quantized) {
+            int8_t* q = slot.quantized[out].data();
+            for (int i = 0; i < info.size; i++) {
+                q[i] = (int8_t)max(-128.0f, min(127.0f, floorf(result[i] * info.scale + 0.5f)));
+            }
+        }
+    }
+}
+
+void XmodelPipeline::run(const int8_t* input, int n_images, float* output) {
+    /*
+        A thread feeds the images to the first stage as slots get free; each
+        stage has a thread per runner (one for a CPU stage) and hands the
+        images to the next one, and the last stage writes the output and
+        frees the slot.
+    */
+    this->input = input;
+    size_t n = stages.size();
+    vector<unique_ptr<ImageQueue>> queues;
+    vector<unique_ptr<atomic<int>>> active;
+    for (size_t s = 0; s < n; s++) {
+        // An image in a queue has a slot, so a queue never has more images than slots
+        queues.emplace_back(new ImageQueue(slots.size()));
+        active.emplace_back(new atomic<int>(stages[s]->dpu ? stages[s]->runners.size() : 1));
+        stages[s]->busy_seconds = 0;
+    }
+    ImageQueue free_slots(slots.size());
+    for (size_t i = 0; i < slots.size(); i++) {
+        free_slots.push(i);
+    }
+    vector<int> slot_of(n_images);
+
+    auto worker = [&](size_t s, vart::Runner* runner) {
+        Stage& stage = *stages[s];
+        Worker state;
+        if (runner != nullptr) {
+            state.input_tensors = runner->get_input_tensors();
+            state.output_tensors = runner->get_output_tensors();
+            state.inputs.resize(stage.inputs.size());
+            state.outputs.resize(stage.outputs.size());
+        }
+        double busy = 0;
+        int image;
+        while ((image = queues[s]->pop()) >= 0) {
+            Slot& slot = slots[slot_of[image]];
+            auto start = steady_clock::now();
+            if (stage.dpu) {
+                run_dpu(stage, runner, image, slot, state);
+            } else {
+                run_cpu(stage, image, slot, state);
+            }
+            if (s + 1 < n) {
+                queues[s + 1]->push(image);
+            } else {
+                const float* result = real_data(output_tensor, image, slot, state.converted);
+                memcpy(output + (size_t)image * output_size(), result, output_size() * sizeof(float));
+                free_slots.push(slot_of[image]);
+            }
+            busy += duration<double>(steady_clock::now() - start).count();
+        }
+        {
+            lock_guard<mutex> lock(stage.stats_mutex);
+            stage.busy_seconds += busy;
+        }
+        if (--*active[s] == 0 && s + 1 < n) {
+            queues[s + 1]->close();
+        }
+    };
+
+    auto start = steady_clock::now();
+    vector<thread> threads;
+    threads.emplace_back([&]() {
+        for (int i = 0; i < n_images; i++) {
+            slot_of[i] = free_slots.pop();
+            queues[0]->push(i);
+        }
+        queues[0]->close();
+    });
+    for (size_t s = 0; s < n; s++) {
+        if (stages[s]->dpu) {
+            for (auto& runner : stages[s]->runners) {
+                threads.emplace_back(worker, s, runner.get());
+            }
+        } else {
+            threads.emplace_back(worker, s, nullptr);
+        }
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    run_seconds = duration<double>(steady_clock::now() - start).count();
+    run_images = n_images;
+}
+
+void XmodelPipeline::print_stats() const {
+    /*
+        The busy time of a stage is split over its threads: the stage with
+        the highest time per image bounds the FPS of the pipeline.
+    */
+    cout << "Pipeline of " << stages.size() << " stages, " << slots.size() << " images in flight: " << fixed << setprecision(2)
+         << run_seconds << " seconds, FPS " << run_images / run_seconds << endl;
+    for (size_t s = 0; s < stages.size(); s++) {
+        const Stage& stage = *stages[s];
+        int n_threads = stage.dpu ? stage.runners.size() : 1;
+        double per_image = stage.busy_seconds / n_threads / max(1, run_images);
+        cout << "  " << s << " " << (stage.dpu ? "DPU" : "CPU") << " " << stage.subgraph->get_name();
+        if (stage.dpu) {
+            cout << " (" << n_threads << " runners)";
+        } else {
+            cout << " (" << stage.ops.size() << " ops)";
+        }
+        cout << ": " << setprecision(3) << per_image * 1000 << " ms per image, busy " << setprecision(1)
+             << 100 * stage.busy_seconds / n_threads / run_seconds << "%" << endl;
+    }
+}
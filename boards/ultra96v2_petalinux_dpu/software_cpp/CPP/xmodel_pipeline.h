@@ -0,0 +1,125 @@
+#ifndef XMODEL_PIPELINE_H
+#define XMODEL_PIPELINE_H
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef MOCK_VART
+#include "mock_vart.h"
+#else
+#include "common.h"
+#endif
+#include "cpu_ops.h"
+#include "frame_arena.h"
+
+/*
+    Runs every subgraph of an xmodel in topological order: the DPU subgraphs
+    on runners and the CPU subgraphs with the ops of cpu_ops.h, for the
+    models which the compiler splits (a softmax tail, an op the DPU does not
+    have in the middle...). Each subgraph is a stage with its own threads,
+    and the images go from one stage to the next through queues, so that the
+    DPU works on the next images while the CPU finishes the previous ones.
+    The tensors of the images in flight are in a window of slots.
+*/
+
+// Indices of the images waiting for a stage, up to capacity (push waits for room)
+class ImageQueue {
+public:
+    explicit ImageQueue(int capacity) : indices(capacity) {}
+    void push(int index);
+    // No more images after this
+    void close();
+    // Wait for an image and take it, return -1 when closed and empty
+    int pop();
+
+private:
+    IndexRing indices;
+    bool closed = false;
+    std::mutex queue_mutex;
+    std::condition_variable changed;
+};
+
+// Number of subgraphs of the graph on the device ("DPU", "CPU", "USER")
+int xmodel_subgraph_count(const xir::Graph* graph, const std::string& device);
+
+class XmodelPipeline {
+public:
+    // Pipeline of the xmodel with n_runners runners per DPU subgraph and window images in flight
+    // (0 for 2 per thread), NULL with an error message if a subgraph cannot run
+    static std::unique_ptr<XmodelPipeline> create(const std::string& xmodel_file, int n_runners, int window = 0);
+
+    // Run n_images inputs of input_size() int8 values, quantized with input_scale(), and write
+    // output_size() floats per image: the first output of the last subgraph
+    void run(const int8_t* input, int n_images, float* output);
+
+    // Time of each stage in the last run
+    void print_stats() const;
+
+    int input_size() const { return tensors[input_tensor].size; }
+    int output_size() const { return tensors[output_tensor].size; }
+    float input_scale() const { return tensors[input_tensor].scale; }
+    int n_stages() const { return stages.size(); }
+
+private:
+    typedef struct {
+        const xir::Tensor* tensor;
+        std::vector<int> shape;
+        int size;
+        bool quantized;             // int8 with scale, otherwise float
+        float scale;
+        std::vector<char> constant; // Data of a constant, the same for all the images
+    } TensorInfo;
+
+    typedef struct {
+        const xir::Subgraph* subgraph;
+        bool dpu;
+        std::vector<std::unique_ptr<vart::Runner>> runners;
+        std::vector<CpuOp> ops;
+        std::vector<int> inputs, outputs;   // Tensors of the runners, in their order
+        std::vector<std::vector<int>> op_inputs;
+        std::vector<int> op_outputs;
+        double busy_seconds;
+        std::mutex stats_mutex;
+    } Stage;
+
+    // Buffers of the tensors of one image in flight
+    typedef struct {
+        std::vector<std::vector<int8_t>> quantized;
+        std::vector<std::vector<float>> real;
+    } Slot;
+
+    // State of a thread of a stage, reused from one image to the next
+    typedef struct {
+        std::vector<const xir::Tensor*> input_tensors, output_tensors;
+        std::vector<vart::TensorBuffer*> inputs, outputs;
+        std::vector<std::vector<float>> scratch;
+        std::vector<CpuTensor> op_inputs;
+        CpuTensor op_output;
+        std::vector<float> converted;
+        FrameArena arena;               // Tensor buffers of the image
+    } Worker;
+
+    XmodelPipeline() = default;
+    int tensor_index(const xir::Tensor* tensor);
+    int load(const std::string& xmodel_file, int n_runners, int window);
+    void run_dpu(Stage& stage, vart::Runner* runner, int image, Slot& slot, Worker& worker);
+    void run_cpu(Stage& stage, int image, Slot& slot, Worker& worker);
+    const float* real_data(int tensor, int image, Slot& slot, std::vector<float>& scratch);
+    int8_t* quantized_data(int tensor, int image, Slot& slot);
+
+    std::unique_ptr<xir::Graph> graph;
+    std::vector<TensorInfo> tensors;
+    std::vector<std::unique_ptr<Stage>> stages;
+    std::vector<Slot> slots;
+    int input_tensor = -1, output_tensor = -1;
+    const int8_t* input = nullptr;
+    double run_seconds = 0;
+    int run_images = 0;
+};
+
+#endif // XMODEL_PIPELINE_H
@@ -0,0 +1,310 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cpu_ops.h"
+#include "xmodel_pipeline.h"
+
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -DMOCK_VART -o xmodel_pipeline_bench xmodel_pipeline_bench.cpp xmodel_pipeline.cpp cpu_ops.cpp -lpthread
+
+#define XMODEL      "split.xmodel"
+#define N_CLASSES   10
+
+/*
+    The CPU ops alone on known values, then a model split by the compiler
+    (mock graph, -DMOCK_VART): DPU -> CPU -> DPU -> CPU, run by the pipeline
+    and one image at a time by a serial loop over the subgraphs. The outputs
+    of both must be the same.
+*/
+
+static int8_t saturate(int v) {
+    return (int8_t)max(-128, min(127, v));
+}
+
+// First DPU subgraph: 4x4x3 -> 2x2x4, some values negative for the relu
+static void conv_model(const int8_t* x, int8_t* y) {
+    for (int k = 0; k < 16; k++) {
+        y[k] = saturate(x[k * 3] + x[k * 3 + 1] / 2 - 20);
+    }
+}
+
+// Second DPU subgraph: 16 -> N_CLASSES
+static void fc_model(const int8_t* x, int8_t* y) {
+    for (int c = 0; c < N_CLASSES; c++) {
+        int sum = 0;
+        for (int k = 0; k < 16; k++) {
+            sum += k % (c + 1) == 0 ? x[k] : -x[k];
+        }
+        y[c] = saturate(sum / 4);
+    }
+}
+
+static vector<char> float_data(const vector<float>& values) {
+    vector<char> data(values.size() * sizeof(float));
+    memcpy(data.data(), values.data(), data.size());
+    return data;
+}
+
+static int expect(const char* name, const vector<float>& got, const vector<float>& expected) {
+    // 0 if the values match, otherwise 1 with the first difference
+    if (got.size() != expected.size()) {
+        printf("[ERROR] %s: %zu values, expected %zu\n", name, got.size(), expected.size());
+        return 1;
+    }
+    for (size_t i = 0; i < got.size(); i++) {
+        if (fabsf(got[i] - expected[i]) > 1e-5f) {
+            printf("[ERROR] %s: value %zu is %g, expected %g\n", name, i, got[i], expected[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static vector<float> run_op(const xir::Op& op, vector<vector<float>> values) {
+    // The op on the values of its inputs, like a CPU stage does
+    string reason;
+    if (!cpu_op_supported(&op, &reason)) {
+        printf("[ERROR] %s (%s) not supported: %s\n", op.get_name().c_str(), op.get_type().c_str(), reason.c_str());
+        return {};
+    }
+    CpuOp prepared = cpu_op_prepare(&op);
+    vector<CpuTensor> inputs;
+    auto tensors = op.get_input_tensors("input");
+    for (size_t k = 0; k < tensors.size(); k++) {
+        auto shape = tensors[k]->get_shape();
+        inputs.push_back({vector<int>(shape.begin(), shape.end()), values[k].data()});
+    }
+    auto out_shape = op.get_output_tensor()->get_shape();
+    vector<float> result(op.get_output_tensor()->get_element_num());
+    CpuTensor output = {vector<int>(out_shape.begin(), out_shape.end()), result.data()};
+    FrameArena arena;
+    cpu_op_run(prepared, inputs, output, arena);
+    return result;
+}
+
+static int check_ops() {
+    int errors = 0;
+    xir::Tensor row("row", {2, 3}), row_out("row_out", {2, 3});
+    float e = expf(1), e2 = expf(2);
+    errors += expect("softmax", run_op(xir::Op("softmax", {&row}, &row_out, {{"axis", -1}}), {{0, 1, 2, 5, 5, 5}}),
+                     {1 / (1 + e + e2), e / (1 + e + e2), e2 / (1 + e + e2), 1 / 3.0f, 1 / 3.0f, 1 / 3.0f});
+
+    xir::Tensor nhwc("nhwc", {1, 2, 3, 2}), nchw("nchw", {1, 2, 2, 3});
+    errors += expect("transpose",
+                     run_op(xir::Op("transpose", {&nhwc}, &nchw, {{"order", vector<int>{0, 3, 1, 2}}}),
+                            {{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}}),
+                     {0, 2, 4, 6, 8, 10, 1, 3, 5, 7, 9, 11});
+
+    xir::Tensor left("left", {2, 2}), right("right", {2, 3}), joined("joined", {2, 5});
+    errors += expect("concat", run_op(xir::Op("concat", {&left, &right}, &joined, {{"axis", -1}}), {{1, 2, 3, 4}, {5, 6, 7, 8, 9, 10}}),
+                     {1, 2, 5, 6, 7, 3, 4, 8, 9, 10});
+
+    // Halves at the fix point 1: DPU_ROUND rounds them up, PY3_ROUND to even; saturated to 8 bits
+    xir::Tensor real("real", {6}), fixed("fixed", {6});
+    vector<float> halves = {1.25f, -1.25f, 0.75f, -0.75f, 100, -100};
+    errors += expect("fix DPU_ROUND",
+                     run_op(xir::Op("fix", {&real}, &fixed, {{"fix_point", 1}, {"bit_width", 8}, {"round_mode", string("DPU_ROUND")}}), {halves}),
+                     {1.5f, -1, 1, -0.5f, 63.5f, -64});
+    errors += expect("float2fix PY3_ROUND",
+                     run_op(xir::Op("float2fix", {&real}, &fixed, {{"fix_point", 1}, {"round_mode", string("PY3_ROUND")}}), {halves}),
+                     {1, -1, 1, -1, 63.5f, -64});
+
+    xir::Tensor image("image", {1, 2, 2, 3}), pooled("pooled", {1, 1, 1, 3}), mean("mean", {1, 3});
+    vector<float> pixels = {1, 10, 100, 2, 20, 200, 3, 30, 300, 6, 60, 600};
+    errors += expect("avgpool2d", run_op(xir::Op("avgpool2d", {&image}, &pooled), {pixels}), {3, 30, 300});
+    errors += expect("reduction_mean", run_op(xir::Op("reduction_mean", {&image}, &mean), {pixels}), {3, 30, 300});
+
+    xir::Tensor one("one", {1}), values("values", {2, 3}), sum("sum", {2, 3});
+    vector<float> six = {1, 2, 3, 4, 5, 6};
+    errors += expect("add scalar first", run_op(xir::Op("add", {&one, &values}, &sum), {{10}, six}), {11, 12, 13, 14, 15, 16});
+    errors += expect("mul scalar", run_op(xir::Op("mul", {&values, &one}, &sum), {six, {2}}), {2, 4, 6, 8, 10, 12});
+    errors += expect("add same shapes", run_op(xir::Op("add", {&values, &row}, &sum), {six, six}), {2, 4, 6, 8, 10, 12});
+    errors += expect("mul same shapes", run_op(xir::Op("mul", {&values, &row}, &sum), {six, six}), {1, 4, 9, 16, 25, 36});
+
+    // Shapes the ops would read out of bounds
+    string reason;
+    xir::Tensor bias("bias", {3}), narrow("narrow", {3, 2});
+    xir::Op broadcast("add", {&values, &bias}, &sum), mismatch("concat", {&left, &narrow}, &joined, {{"axis", 1}}),
+        short_concat("concat", {&left, &left}, &joined, {{"axis", 1}});
+    for (const xir::Op* op : {&broadcast, &mismatch, &short_concat}) {
+        if (cpu_op_supported(op, &reason)) {
+            printf("[ERROR] %s of inputs of the wrong shapes accepted\n", op->get_type().c_str());
+            errors++;
+        }
+    }
+    return errors;
+}
+
+static unique_ptr<xir::Graph> split_graph() {
+    /*
+        USER -> DPU conv -> CPU (fix2float, transpose, relu, add of a
+        constant, float2fix) -> DPU fc -> CPU (fix2float, add of a bias, mul
+        by a const-fix scale, concat of constant logits, softmax)
+    */
+    unique_ptr<xir::Graph> graph(new xir::Graph());
+    xir::Tensor input("input", {1, 4, 4, 3}, 6), conv("conv", {1, 2, 2, 4}, 4), mid("mid", {1, 4, 2, 2}, 5),
+        logits("logits", {1, N_CLASSES}, 3);
+    graph->add_subgraph(xir::Subgraph("input", "USER", input));
+    graph->add_subgraph(xir::Subgraph("conv", input, conv, 200))->model = conv_model;
+
+    auto conv_in = graph->add_tensor(conv), mid_out = graph->add_tensor(mid);
+    auto conv_float = graph->add_tensor(xir::Tensor("conv_float", {1, 2, 2, 4}));
+    auto channels = graph->add_tensor(xir::Tensor("channels", {1, 4, 2, 2}));
+    auto relu = graph->add_tensor(xir::Tensor("relu", {1, 4, 2, 2}));
+    auto offset = graph->add_tensor(xir::Tensor("offset", {1}));
+    auto shifted = graph->add_tensor(xir::Tensor("shifted", {1, 4, 2, 2}));
+    graph->add_subgraph(xir::Subgraph(
+        "middle", "CPU", mid,
+        {graph->add_op(xir::Op("fix2float", {conv_in}, conv_float)),
+         graph->add_op(xir::Op("transpose", {conv_float}, channels, {{"order", vector<int>{0, 3, 1, 2}}})),
+         graph->add_op(xir::Op("relu", {channels}, relu)),
+         graph->add_op(xir::Op("const", {}, offset, {{"data", float_data({0.25f})}})),
+         graph->add_op(xir::Op("add", {offset, relu}, shifted)),
+         graph->add_op(xir::Op("float2fix", {shifted}, mid_out, {{"fix_point", 5}, {"round_mode", string("PY3_ROUND")}}))}));
+
+    graph->add_subgraph(xir::Subgraph("fc", mid, logits, 200))->model = fc_model;
+
+    auto logits_in = graph->add_tensor(logits);
+    auto logits_float = graph->add_tensor(xir::Tensor("logits_float", {1, N_CLASSES}));
+    auto bias = graph->add_tensor(xir::Tensor("bias", {1, N_CLASSES}));
+    auto biased = graph->add_tensor(xir::Tensor("biased", {1, N_CLASSES}));
+    auto scale = graph->add_tensor(xir::Tensor("scale", {1}, 2));
+    auto scaled = graph->add_tensor(xir::Tensor("scaled", {1, N_CLASSES}));
+    auto extra = graph->add_tensor(xir::Tensor("extra", {1, 2}));
+    auto all = graph->add_tensor(xir::Tensor("all", {1, N_CLASSES + 2}));
+    auto prob = graph->add_tensor(xir::Tensor("prob", {1, N_CLASSES + 2}));
+    vector<float> bias_values(N_CLASSES);
+    for (int c = 0; c < N_CLASSES; c++) {
+        bias_values[c] = 0.1f * c;
+    }
+    graph->add_subgraph(xir::Subgraph(
+        "tail", "CPU", *prob,
+        {graph->add_op(xir::Op("fix2float", {logits_in}, logits_float)),
+         graph->add_op(xir::Op("const", {}, bias, {{"data", float_data(bias_values)}})),
+         graph->add_op(xir::Op("add", {logits_float, bias}, biased)),
+         graph->add_op(xir::Op("const-fix", {}, scale, {{"data", vector<char>{6}}})),      // 1.5
+         graph->add_op(xir::Op("mul", {biased, scale}, scaled)),
+         graph->add_op(xir::Op("const", {}, extra, {{"data", float_data({-1, 2})}})),
+         graph->add_op(xir::Op("concat", {scaled, extra}, all, {{"axis", -1}})),
+         graph->add_op(xir::Op("softmax", {all}, prob, {{"axis", -1}}))}));
+    return graph;
+}
+
+static void run_serial(const xir::Graph* graph, const int8_t* input, float* output) {
+    /*
+        One image through the subgraphs in order: the quantized tensors by
+        name as int8, the others as float.
+    */
+    map<string, vector<int8_t>> quantized;
+    map<string, vector<float>> real;
+    auto as_float = [&](const xir::Tensor* tensor) {
+        if (tensor->get_data_type().type == xir::DataType::FLOAT) {
+            return real[tensor->get_name()];
+        }
+        const vector<int8_t>& q = quantized[tensor->get_name()];
+        vector<float> values(q.size());
+        for (size_t i = 0; i < q.size(); i++) {
+            values[i] = q[i] / exp2f(tensor->get_attr<int>("fix_point"));
+        }
+        return values;
+    };
+    const xir::Tensor* last = nullptr;
+    for (auto subgraph : graph->get_root_subgraph()->children_topological_sort()) {
+        if (subgraph->device == "USER") {
+            quantized[subgraph->output.get_name()].assign(input, input + subgraph->output.get_element_num());
+            continue;
+        }
+        if (subgraph->device == "DPU") {
+            vector<int8_t>& out = quantized[subgraph->output.get_name()];
+            out.resize(subgraph->output.get_element_num());
+            subgraph->model(quantized[subgraph->input.get_name()].data(), out.data());
+            last = &subgraph->output;
+            continue;
+        }
+        for (auto op : subgraph->topological_sort()) {
+            const xir::Tensor* tensor = op->get_output_tensor();
+            if (cpu_op_is_constant(op)) {
+                vector<char> data = op->get_attr<vector<char>>("data");
+                if (tensor->get_data_type().type == xir::DataType::FLOAT) {
+                    real[tensor->get_name()].resize(tensor->get_element_num());
+                    memcpy(real[tensor->get_name()].data(), data.data(), data.size());
+                } else {
+                    quantized[tensor->get_name()].assign(data.begin(), data.end());
+                }
+                continue;
+            }
+            vector<vector<float>> values;
+            for (auto in : op->get_input_tensors("input")) {
+                values.push_back(as_float(in));
+            }
+            vector<float> result = run_op(*op, values);
+            if (tensor->get_data_type().type == xir::DataType::FLOAT) {
+                real[tensor->get_name()] = result;
+            } else {
+                vector<int8_t>& q = quantized[tensor->get_name()];
+                q.resize(result.size());
+                for (size_t i = 0; i < result.size(); i++) {
+                    q[i] = saturate((int)floorf(result[i] * exp2f(tensor->get_attr<int>("fix_point")) + 0.5f));
+                }
+            }
+            last = tensor;
+        }
+    }
+    vector<float> values = as_float(last);
+    memcpy(output, values.data(), values.size() * sizeof(float));
+}
+
+int main(int argc, char* argv[]) {
+    int n_images = argc > 1 ? atoi(argv[1]) : 400;
+    int n_runners = argc > 2 ? atoi(argv[2]) : 2;
+    if (n_images < 1 || n_runners < 1) {
+        printf("Usage: %s [images] [runners per DPU subgraph]\n", argv[0]);
+        return 1;
+    }
+    int errors = check_ops();
+
+    mock_xmodels()[XMODEL] = split_graph;
+    auto pipeline = XmodelPipeline::create(XMODEL, n_runners);
+    if (!pipeline) {
+        printf("[ERROR] The pipeline of the split model could not be created\n");
+        return 1;
+    }
+    if (pipeline->n_stages() != 4 || pipeline->input_size() != 48 || pipeline->output_size() != N_CLASSES + 2) {
+        printf("[ERROR] %d stages, %d inputs and %d outputs per image, expected 4, 48 and %d\n", pipeline->n_stages(),
+               pipeline->input_size(), pipeline->output_size(), N_CLASSES + 2);
+        return 1;
+    }
+    mt19937 random(3);
+    vector<int8_t> input((size_t)n_images * pipeline->input_size());
+    for (auto& v : input) {
+        v = (int8_t)(random() % 256 - 128);
+    }
+    vector<float> output((size_t)n_images * pipeline->output_size()), serial(output.size());
+    pipeline->run(input.data(), n_images, output.data());
+    pipeline->print_stats();
+
+    auto graph = split_graph();
+    auto start = steady_clock::now();
+    for (int i = 0; i < n_images; i++) {
+        run_serial(graph.get(), input.data() + (size_t)i * pipeline->input_size(), serial.data() + (size_t)i * pipeline->output_size());
+    }
+    printf("Serial run: %.2f seconds, without the DPU latency\n", duration<double>(steady_clock::now() - start).count());
+    errors += expect("pipeline against the serial run", output, serial);
+
+    if (errors == 0) {
+        printf("[SUCCESS] CPU ops, and %d images through DPU -> CPU -> DPU -> CPU as in a serial run\n", n_images);
+    }
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include "zero_copy.h"
+
+using namespace std;
+
+static int8_t* mapped_data(vart::TensorBuffer* buffer) {
+    // Address of the first element, the buffer is contiguous from there
+    auto shape = buffer->get_tensor()->get_shape();
+    return reinterpret_cast<int8_t*>(buffer->data(vector<int>(shape.size(), 0)).first);
+}
+
+unique_ptr<ZeroCopyRunner> ZeroCopyRunner::create(const xir::Subgraph* subgraph, int depth) {
+    unique_ptr<ZeroCopyRunner> zero_copy(new ZeroCopyRunner());
+    zero_copy->ring.resize(max(depth, 1));
+    for (Entry& entry : zero_copy->ring) {
+        entry.runner = vart::Runner::create_runner(subgraph, "run");
+        entry.ext = dynamic_cast<vart::RunnerExt*>(entry.runner.get());
+        if (entry.ext == nullptr || entry.ext->get_inputs().size() != 1 || entry.ext->get_outputs().size() != 1) {
+            cerr << "[ERROR] The runner of " << subgraph->get_name() << " does not give one input and one output buffer" << endl;
+            return nullptr;
+        }
+        entry.inputs = entry.ext->get_inputs();
+        entry.outputs = entry.ext->get_outputs();
+        entry.input_buffer = entry.inputs[0];
+        entry.output_buffer = entry.outputs[0];
+        entry.input = mapped_data(entry.input_buffer);
+        entry.output = mapped_data(entry.output_buffer);
+        entry.n_images = 0;
+    }
+
+    // The first dimension of the tensors is the batch of the DPU
+    auto input_tensor = zero_copy->ring[0].input_buffer->get_tensor();
+    auto output_tensor = zero_copy->ring[0].output_buffer->get_tensor();
+    zero_copy->batch = input_tensor->get_shape()[0];
+    zero_copy->in_size = input_tensor->get_element_num() / zero_copy->batch;
+    zero_copy->out_size = output_tensor->get_element_num() / zero_copy->batch;
+    zero_copy->in_scale = get_input_scale(input_tensor);
+    zero_copy->out_scale = get_output_scale(output_tensor);
+    for (Entry& entry : zero_copy->ring) {
+        entry.images.resize(zero_copy->batch);
+    }
+    return zero_copy;
+}
+
+void ZeroCopyRunner::finish(Entry& entry, int8_t* output) {
+    // The DPU wrote the outputs in memory: invalidate the cache before reading them
+    entry.runner->wait(entry.job, -1);
+    entry.output_buffer->sync_for_read(0, (size_t)entry.n_images * out_size);
+    for (int i = 0; i < entry.n_images; i++) {
+        memcpy(output + (size_t)entry.images[i] * out_size, entry.output + (size_t)i * out_size, out_size);
+    }
+    entry.n_images = 0;
+}
+
+void ZeroCopyRunner::run(const function<int(int*, int)>& next, const function<void(int, int8_t*)>& fill, int8_t* output) {
+    /*
+        Goes around the ring: the job of an entry is finished before its
+        buffers are filled again, so with a depth of 2 or more the images of
+        an entry are preprocessed while the DPU runs the other entries.
+    */
+    size_t k = 0;
+    while (true) {
+        Entry& entry = ring[k];
+        if (entry.n_images > 0) {
+            finish(entry, output);
+        }
+        int n = next(entry.images.data(), batch);
+        if (n <= 0) {
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            fill(entry.images[i], entry.input + (size_t)i * in_size);
+        }
+        // Flush the preprocessed images from the cache for the DPU
+        entry.input_buffer->sync_for_write(0, (size_t)n * in_size);
+        entry.job = entry.runner->execute_async(entry.inputs, entry.outputs).first;
+        entry.n_images = n;
+        k = (k + 1) % ring.size();
+    }
+    for (Entry& entry : ring) {
+        if (entry.n_images > 0) {
+            finish(entry, output);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef ZERO_COPY_H
+#define ZERO_COPY_H
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#ifdef MOCK_VART
+#include "mock_vart.h"
+#else
+#include <vart/runner_ext.hpp>
+
+#include "common.h"
+#endif
+
+/*
+    Zero-copy execution: the runner gives its own input and output tensor
+    buffers, in memory the DPU reads and writes (RunnerExt::get_inputs and
+    get_outputs). The images are preprocessed directly into the mapped input
+    buffer and the caches are synced explicitly, instead of giving host
+    arrays (CpuFlatTensorBuffer) that the runtime copies for every job.
+
+    Each thread has a ring of runners, each with its buffers: the next image
+    is preprocessed into the next buffers of the ring while the DPU runs the
+    previous ones.
+*/
+
+class ZeroCopyRunner {
+public:
+    // Ring of depth runners of the DPU subgraph, NULL with an error message if the runners do not
+    // give their buffers
+    static std::unique_ptr<ZeroCopyRunner> create(const xir::Subgraph* subgraph, int depth);
+
+    // Run the images given by next, which fills up to max indices and returns how many (0 when
+    // there are no more). fill writes image index, input_size() values at input_scale(), in the
+    // input buffer of the DPU; the outputs are written at index * output_size().
+    void run(const std::function<int(int*, int)>& next, const std::function<void(int, int8_t*)>& fill, int8_t* output);
+
+    int depth() const { return ring.size(); }
+    int batch_size() const { return batch; }
+    int input_size() const { return in_size; }
+    int output_size() const { return out_size; }
+    float input_scale() const { return in_scale; }
+    float output_scale() const { return out_scale; }
+
+private:
+    typedef struct {
+        std::unique_ptr<vart::Runner> runner;
+        vart::RunnerExt* ext;
+        vart::TensorBuffer* input_buffer;
+        vart::TensorBuffer* output_buffer;
+        std::vector<vart::TensorBuffer*> inputs, outputs;     // For execute_async, taken once
+        int8_t* input;                  // Mapped buffers
+        int8_t* output;
+        std::vector<int> images;        // Images of the job in flight
+        int n_images;
+        uint32_t job;
+    } Entry;
+
+    ZeroCopyRunner() = default;
+    void finish(Entry& entry, int8_t* output);
+
+    std::vector<Entry> ring;
+    int batch, in_size, out_size;
+    float in_scale, out_scale;
+};
+
+#endif // ZERO_COPY_H
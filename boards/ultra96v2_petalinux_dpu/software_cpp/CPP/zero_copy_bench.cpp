@@ -0,0 +1,127 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "zero_copy.h"
+
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -DMOCK_VART -o zero_copy_bench zero_copy_bench.cpp zero_copy.cpp -lpthread
+
+#define IMAGE_TOTAL_PIXELS  (224 * 224 * 3)
+#define N_CLASSES           12
+
+static void preprocess(const uint8_t* image, int8_t* input, float scale) {
+    // The normalization of main.cpp, without OpenCV
+    static const float mean[3] = {0.485f, 0.456f, 0.406f};
+    static const float std[3] = {0.229f, 0.224f, 0.225f};
+    for (int i = 0; i < IMAGE_TOTAL_PIXELS; i++) {
+        int c = i % 3;
+        float v = roundf((image[i] / 255.0f - mean[c]) / std[c] * scale);
+        input[i] = (int8_t)max(-128.0f, min(127.0f, v));
+    }
+}
+
+static void print_counters(const char* name, int n_images, double seconds) {
+    MockVartCounters& counters = mock_vart_counters();
+    printf("%-10s %8.3f %8.1f %8ld %10.2f %10.2f %8ld %9ld\n", name, seconds, n_images / seconds, counters.copies.load(),
+           counters.copied_bytes / 1e6, (double)counters.copies / n_images, counters.syncs.load(), counters.unsynced_jobs.load());
+}
+
+int main(int argc, char* argv[]) {
+    /*
+        The same images classified by the mock DPU as runDPU does (host
+        arrays wrapped in CpuFlatTensorBuffer, preprocessed beforehand) and
+        with the zero-copy runners (preprocessed into the runner buffers).
+        The outputs must be the same, with no copy in zero-copy.
+    */
+    int n_images = argc > 1 ? atoi(argv[1]) : 2000;
+    int n_threads = argc > 2 ? atoi(argv[2]) : 2;
+    int depth = argc > 3 ? atoi(argv[3]) : 2;
+    int latency_us = argc > 4 ? atoi(argv[4]) : 500;
+    if (n_images <= 0 || n_threads <= 0 || depth <= 0) {
+        printf("Usage: %s [n_images] [n_threads] [ring depth] [DPU latency in us]\n", argv[0]);
+        return 1;
+    }
+
+    xir::Subgraph subgraph("subgraph_mock", xir::Tensor("input", {1, 224, 224, 3}, 6), xir::Tensor("output", {1, N_CLASSES}, 2), latency_us);
+    vector<uint8_t> images((size_t)n_images * IMAGE_TOTAL_PIXELS);
+    uint32_t state = 1;
+    for (auto& v : images) {
+        state = state * 1664525u + 1013904223u;
+        v = state >> 24;
+    }
+    float scale = get_input_scale(&subgraph.input);
+    printf("%d images, %d threads, ring depth %d, DPU latency %d us\n", n_images, n_threads, depth, latency_us);
+    printf("%-10s %8s %8s %8s %10s %10s %8s %9s\n", "Mode", "Seconds", "FPS", "Copies", "MB copied", "Per image", "Syncs", "Unsynced");
+
+    // Host arrays, one range of images per thread
+    vector<int8_t> classic_output((size_t)n_images * N_CLASSES);
+    mock_vart_counters().reset();
+    auto start = steady_clock::now();
+    vector<int8_t> input((size_t)n_images * IMAGE_TOTAL_PIXELS);
+    for (int i = 0; i < n_images; i++) {
+        preprocess(images.data() + (size_t)i * IMAGE_TOTAL_PIXELS, input.data() + (size_t)i * IMAGE_TOTAL_PIXELS, scale);
+    }
+    vector<thread> threads;
+    for (int t = 0; t < n_threads; t++) {
+        threads.emplace_back([&, t]() {
+            auto runner = vart::Runner::create_runner(&subgraph, "run");
+            for (int i = t; i < n_images; i += n_threads) {
+                CpuFlatTensorBuffer input_buffer(input.data() + (size_t)i * IMAGE_TOTAL_PIXELS, runner->get_input_tensors()[0]);
+                CpuFlatTensorBuffer output_buffer(classic_output.data() + (size_t)i * N_CLASSES, runner->get_output_tensors()[0]);
+                auto job_id = runner->execute_async({&input_buffer}, {&output_buffer});
+                runner->wait(job_id.first, -1);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    print_counters("host", n_images, duration<double>(steady_clock::now() - start).count());
+
+    // Zero-copy runners, the images taken in turn by the threads
+    vector<int8_t> zero_copy_output((size_t)n_images * N_CLASSES);
+    vector<unique_ptr<ZeroCopyRunner>> runners;
+    for (int t = 0; t < n_threads; t++) {
+        runners.push_back(ZeroCopyRunner::create(&subgraph, depth));
+    }
+    mock_vart_counters().reset();
+    start = steady_clock::now();
+    atomic<int> next(0);
+    threads.clear();
+    for (int t = 0; t < n_threads; t++) {
+        threads.emplace_back([&, t]() {
+            runners[t]->run(
+                [&](int* indices, int max_n) {
+                    int first = next.fetch_add(max_n);
+                    int n = max(0, min(max_n, n_images - first));
+                    for (int i = 0; i < n; i++) {
+                        indices[i] = first + i;
+                    }
+                    return n;
+                },
+                [&](int index, int8_t* input) { preprocess(images.data() + (size_t)index * IMAGE_TOTAL_PIXELS, input, scale); },
+                zero_copy_output.data());
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    print_counters("zero-copy", n_images, duration<double>(steady_clock::now() - start).count());
+
+    if (classic_output != zero_copy_output) {
+        printf("[ERROR] The outputs of the two modes are different\n");
+        return 1;
+    }
+    printf("[SUCCESS] Same outputs in both modes\n");
+    return 0;
+}
@@ -9,7 +9,12 @@ using namespace std;
 std::unique_ptr<vart::Runner> initialize_dpu_runner(const string& xmodel_file) {
     auto graph = xir::Graph::deserialize(xmodel_file);
     auto subgraph = get_dpu_subgraph(graph.get());
-    CHECK_EQ(subgraph.size(), 1u) << "Subgraph should have one and only one dpu subgraph.";
+    if (subgraph.size() != 1 || !get_subgraphs(graph.get(), "CPU").empty()) {
+        // Split models run with the pipeline of the CPP driver (xmodel_pipeline.h)
+        cerr << "[ERROR] " << xmodel_file << " has " << subgraph.size() << " DPU subgraphs and "
+             << get_subgraphs(graph.get(), "CPU").size() << " CPU subgraphs, this runner takes a single DPU subgraph" << endl;
+        return nullptr;
+    }
     return vart::Runner::create_runner(subgraph[0], "run");
 }
 
@@ -14,8 +14,18 @@ string lookup(int index) {
     return class_map[index];
 }
 
-std::vector<vart::TensorBuffer*> get_dpu_subgraph(const xir::Graph* graph) {
-    return xir::Subgraph::get_leaf_subgraphs(graph)[0]->get_op("dpu")->
+std::vector<const xir::Subgraph*> get_subgraphs(const xir::Graph* graph, const std::string& device) {
+    std::vector<const xir::Subgraph*> subgraphs;
+    for (auto subgraph : graph->get_root_subgraph()->children_topological_sort()) {
+        if (subgraph->has_attr("device") && subgraph->get_attr<std::string>("device") == device) {
+            subgraphs.push_back(subgraph);
+        }
+    }
+    return subgraphs;
+}
+
+std::vector<const xir::Subgraph*> get_dpu_subgraph(const xir::Graph* graph) {
+    return get_subgraphs(graph, "DPU");
 }
 
 TensorShape shapes;
@@ -4,9 +4,12 @@
 #include <string>
 #include <vector>
 #include <vart/tensor_buffer.hpp>
+#include <xir/graph/graph.hpp>
 
 std::string lookup(int index);
-std::vector<vart::TensorBuffer*> get_dpu_subgraph(const xir::Graph* graph);
+// Leaf subgraphs of the graph on the device ("DPU", "CPU", "USER"), in topological order
+std::vector<const xir::Subgraph*> get_subgraphs(const xir::Graph* graph, const std::string& device);
+std::vector<const xir::Subgraph*> get_dpu_subgraph(const xir::Graph* graph);
 
 struct TensorShape {
     vart::TensorShape inTensorList;
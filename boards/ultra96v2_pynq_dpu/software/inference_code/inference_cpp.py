@@ -0,0 +1,67 @@
+import os
+import time
+
+import cv2
+import numpy as np
+
+import tipu_dpu
+
+from preprocess import *
+from inference import is_image_file
+
+def load_crops(image_folder, crop_height = 224, crop_width = 224):
+    # Resized and cropped like preprocess_fn, in BGR uint8: the normalization is done in C++
+    crops = []
+    for image_name in os.listdir(image_folder):
+        image_path = os.path.join(image_folder, image_name)
+        if not is_image_file(image_path):
+            continue
+        image = cv2.imread(image_path)
+        if image is None:
+            raise ValueError(f"Error reading image at {image_path}")
+        image = resize_shortest_edge(image, 256)
+        crops.append(central_crop(image, crop_height, crop_width))
+    return np.ascontiguousarray(np.stack(crops))
+
+def test_accuracy_cpp(manifest_file, xmodel_file, image_folder, num_thread, show_all_info, inference_result):
+    """
+    test_accuracy with the C++ driver (tipu_dpu module, built by
+    build_python.sh): the images are preprocessed and run on num_thread
+    runners in C++, without the GIL. The overlay must be loaded before.
+    The manifest is shared by the boards, xmodel_file is the one of the board.
+    """
+    print(f"Number of threads: {num_thread} \n")
+
+    manifest = tipu_dpu.load_manifest(manifest_file)
+    pool = tipu_dpu.RunnerPool(xmodel_file, num_thread)
+    preprocessor = tipu_dpu.Preprocessor(manifest, pool.input_scale)
+
+    time_start = time.time()
+
+    # Loading
+    time_start_load = time.time()
+    images = load_crops(image_folder, manifest.height, manifest.width)
+    time_end_load = time.time()
+    if show_all_info==True:
+        print(f"Total time load: {time_end_load-time_start_load:.2f} seconds")
+
+    # Preprocessing, inference and classification
+    classes, probabilities, times = pool.classify_images(images, preprocessor, num_thread)
+    if show_all_info==True:
+        print(f"Total time preprocess: {times['preprocess']:.2f} seconds")
+
+    print(f"Inference Done. \n")
+
+    time_end = time.time()
+    timetotal = time_end - time_start
+    cnt = len(classes)
+
+    np.savetxt(inference_result, classes, fmt='%d', delimiter=',')
+
+    print("Total processed images: ", cnt)
+    print(f"Total time: {timetotal:.2f} seconds")
+    print(f"FPS total: {cnt/timetotal:.2f}")
+    print(f"FPS during inference: {cnt/times['run']:.2f}")
+    print(f"FPS during preprocess + inference: {cnt/(times['run']+times['preprocess']):.2f}")
+
+    return list(classes)
@@ -10,6 +10,8 @@
 
 #include <opencv2/opencv.hpp>
 
+#include "color_correction.h"
+
 using namespace cv;
 using namespace std;
 
@@ -24,30 +26,7 @@ typedef struct {
     uint8_t *data;
 } Buffer;
 
-void applyAWB(Mat& img) {
-    // Calculate the average of each channel
-    Scalar avg = mean(img);
-
-    // Average of the three channels
-    double avgGray = (avg[0] + avg[1] + avg[2]) / 3.0;
-
-    // Calculate scale factors
-    double scaleB = avgGray / avg[0];
-    double scaleG = avgGray / avg[1];
-    double scaleR = avgGray / avg[2];
-
-    // Apply scale factors to each channel
-    vector<Mat> channels;
-    split(img, channels);
-
-    channels[0] *= scaleB;
-    channels[1] *= scaleG;
-    channels[2] *= scaleR;
-
-    merge(channels, img);
-}
-
-void binary_to_images(const char *binary_file, char *directory, int image_width, int image_height) {
+void binary_to_images(const char *binary_file, char *directory, int image_width, int image_height, bool color_correction) {
     /*
         Read the binary file and save the images WITHOUT labels in the output directory.
     */
@@ -87,6 +66,9 @@ void binary_to_images(const char *binary_file, char *directory, int image_width,
     fclose(bin_file);
     printf("File readed\n");
 
+    ColorCorrectionParams params;
+    color_correction_captures(&params);
+
     // Read the images from the binary file
     for (int i = 0; i < n_images; ++i) {
         printf("Image %d\n", i);
@@ -96,14 +78,11 @@ void binary_to_images(const char *binary_file, char *directory, int image_width,
         memcpy(img.data, ptr, TOTAL_PIXELS); // copy the image data to the Mat object
         cvtColor(img, img, COLOR_BGR2RGB); // convert the image to RGB format
 
-        // // Apply auto white balance
-        // applyAWB(img);
+        // Apply auto white balance, brightness and contrast in a single pass
+        if (color_correction) {
+            correct_colors(img.data, image_width, image_height, &params);
+        }
 
-        // // Apply brightness and contrast
-        // int brightness = -35;
-        // double contrast = 1.25;
-        // img.convertTo(img, -1, contrast, brightness);
-        
         imwrite(format("%s/%d.png", directory, i), img); // save the image in the folder
 
         ptr += TOTAL_PIXELS;
@@ -113,9 +92,9 @@ void binary_to_images(const char *binary_file, char *directory, int image_width,
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 5) {
-        fprintf(stderr, "Usage: %s <binary_file> <output_directory> <image_width> <image_height>\n", argv[0]);
-        // g++ binary_to_images.cpp -o binary_to_images `pkg-config --cflags --libs opencv4`
+    if (argc != 5 && argc != 6) {
+        fprintf(stderr, "Usage: %s <binary_file> <output_directory> <image_width> <image_height> [color_correction]\n", argv[0]);
+        // g++ binary_to_images.cpp color_correction.cpp -o binary_to_images `pkg-config --cflags --libs opencv4`
         // ./binary_to_images image.bin . 1920 1080
         return 1;
     }
@@ -124,8 +103,9 @@ int main(int argc, char *argv[]) {
     char *output_directory = argv[2];
     int image_width = atoi(argv[3]);
     int image_height = atoi(argv[4]);
+    bool color_correction = argc == 6 ? atoi(argv[5]) : false;
 
-    binary_to_images(binary_file, output_directory, image_width, image_height);
+    binary_to_images(binary_file, output_directory, image_width, image_height, color_correction);
 
     return 0;
 }
@@ -0,0 +1,124 @@
+#include <math.h>
+#include <string.h>
+
+#include "color_correction.h"
+
+// 48 bytes = 16 pixels, a multiple of both the pixel size and the vector width
+#define BLOCK_BYTES 48
+
+void color_correction_defaults(ColorCorrectionParams *params) {
+    params->awb = 0;
+    params->gains[0] = params->gains[1] = params->gains[2] = 1.0f;
+    params->contrast = 1.0f;
+    params->brightness = 0.0f;
+    params->gamma = 1.0f;
+    params->stats_step = 1;
+}
+
+void color_correction_captures(ColorCorrectionParams *params) {
+    color_correction_defaults(params);
+    params->awb = 1;
+    params->contrast = 1.25f;
+    params->brightness = -35.0f;
+    params->stats_step = 4;
+}
+
+static void row_sums_full(const uint8_t *row, int width, uint64_t sums[3]) {
+    /*
+        Sum the channels of a full row.
+        Accumulating per byte position over 48-byte blocks keeps the inner loop
+        contiguous so that it is vectorised, each position then belongs to
+        channel position % 3. The accumulators are reset for each row, so
+        an uint32_t cannot overflow for any realistic width.
+    */
+    uint32_t acc[BLOCK_BYTES];
+    memset(acc, 0, sizeof(acc));
+    size_t n_bytes = (size_t)width * 3;
+    size_t n_full = n_bytes - n_bytes % BLOCK_BYTES;
+    for (size_t i = 0; i < n_full; i += BLOCK_BYTES) {
+        for (int k = 0; k < BLOCK_BYTES; ++k) {
+            acc[k] += row[i + k];
+        }
+    }
+    for (int k = 0; k < BLOCK_BYTES; ++k) {
+        sums[k % 3] += acc[k];
+    }
+    for (size_t i = n_full; i < n_bytes; ++i) {
+        sums[i % 3] += row[i];
+    }
+}
+
+void channel_means(const uint8_t *image, int width, int height, size_t stride, int step, double means[3]) {
+    uint64_t sums[3] = {0, 0, 0};
+    uint64_t n_pixels = 0;
+    if (step < 1) {
+        step = 1;
+    }
+
+    for (int y = 0; y < height; y += step) {
+        const uint8_t *row = image + y * stride;
+        if (step == 1) {
+            row_sums_full(row, width, sums);
+            n_pixels += width;
+        } else {
+            for (int x = 0; x < width; x += step) {
+                sums[0] += row[3 * x];
+                sums[1] += row[3 * x + 1];
+                sums[2] += row[3 * x + 2];
+                n_pixels++;
+            }
+        }
+    }
+
+    for (int c = 0; c < 3; ++c) {
+        means[c] = n_pixels ? (double)sums[c] / n_pixels : 0.0;
+    }
+}
+
+void awb_gains(const double means[3], float gains[3]) {
+    double avg_gray = (means[0] + means[1] + means[2]) / 3.0;
+    for (int c = 0; c < 3; ++c) {
+        gains[c] = means[c] > 0.0 ? avg_gray / means[c] : 1.0f;
+    }
+}
+
+static uint8_t saturate(double value) {
+    // Round half to even like cvRound, then clamp like saturate_cast<uchar>
+    long v = lrint(value);
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+void build_color_lut(const float gains[3], float contrast, float brightness, float gamma, uint8_t lut[3][256]) {
+    for (int c = 0; c < 3; ++c) {
+        for (int v = 0; v < 256; ++v) {
+            uint8_t balanced = saturate(v * (double)gains[c]);
+            uint8_t adjusted = saturate(balanced * (double)contrast + brightness);
+            if (gamma != 1.0f) {
+                adjusted = saturate(255.0 * pow(adjusted / 255.0, 1.0 / gamma));
+            }
+            lut[c][v] = adjusted;
+        }
+    }
+}
+
+void apply_color_lut(uint8_t *image, size_t n_pixels, const uint8_t lut[3][256]) {
+    for (size_t i = 0; i < n_pixels; ++i) {
+        image[0] = lut[0][image[0]];
+        image[1] = lut[1][image[1]];
+        image[2] = lut[2][image[2]];
+        image += 3;
+    }
+}
+
+void correct_colors(uint8_t *image, int width, int height, const ColorCorrectionParams *params) {
+    float gains[3] = {params->gains[0], params->gains[1], params->gains[2]};
+    if (params->awb) {
+        double means[3];
+        channel_means(image, width, height, (size_t)width * 3, params->stats_step, means);
+        awb_gains(means, gains);
+    }
+
+    uint8_t lut[3][256];
+    build_color_lut(gains, params->contrast, params->brightness, params->gamma, lut);
+    apply_color_lut(image, (size_t)width * height, lut);
+}
@@ -0,0 +1,44 @@
+#ifndef COLOR_CORRECTION_H
+#define COLOR_CORRECTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Colour correction of 8-bit, 3-channel interleaved images (RGB or BGR).
+
+    Auto white balance, contrast/brightness and gamma are all per-channel
+    functions of the pixel value, so they are folded into one 256-entry table
+    per channel and applied in a single pass, in place. The table reproduces
+    the rounding and saturation of the OpenCV steps it replaces
+    (channel scaling, then convertTo(contrast, brightness)).
+*/
+
+typedef struct {
+    int awb;            // Compute the white balance gains from the image
+    float gains[3];     // Per-channel gains, used as is when awb is 0
+    float contrast;     // Multiplier, 1 to keep the contrast
+    float brightness;   // Offset added after the contrast, 0 to keep the brightness
+    float gamma;        // Output = 255 * (input / 255)^(1 / gamma), 1 to disable
+    int stats_step;     // Sample one pixel every stats_step pixels and rows for the AWB, 1 for all
+} ColorCorrectionParams;
+
+// Identity correction: no AWB, gains 1, contrast 1, brightness 0, gamma 1
+void color_correction_defaults(ColorCorrectionParams *params);
+
+// Settings tuned on the Zybo Z7 captures
+void color_correction_captures(ColorCorrectionParams *params);
+
+// Mean of each channel in one pass. stride is the row size in bytes.
+void channel_means(const uint8_t *image, int width, int height, size_t stride, int step, double means[3]);
+
+// Gray world white balance: scale each channel to the average of the three means
+void awb_gains(const double means[3], float gains[3]);
+
+void build_color_lut(const float gains[3], float contrast, float brightness, float gamma, uint8_t lut[3][256]);
+void apply_color_lut(uint8_t *image, size_t n_pixels, const uint8_t lut[3][256]);
+
+// Statistics pass (if AWB is enabled), then the fused correction pass
+void correct_colors(uint8_t *image, int width, int height, const ColorCorrectionParams *params);
+
+#endif // COLOR_CORRECTION_H
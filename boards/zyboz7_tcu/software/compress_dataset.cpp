@@ -0,0 +1,130 @@
+// 64-bit file sizes on the 32-bit ARM of the boards
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <chrono>
+
+#include "compressed_dataset.h"
+
+using namespace std;
+using namespace chrono;
+
+#define IMAGE_WIDTH 224
+#define IMAGE_HEIGHT 224
+#define IMAGE_TOTAL_PIXELS (IMAGE_WIDTH * IMAGE_HEIGHT * 3)
+
+typedef struct {
+    int codec;
+    int quality;
+} BenchConfig;
+
+static off_t file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
+static double read_all_records(const char *compressed_file, uint8_t *image, int *n_images) {
+    /*
+        Decode every record of the compressed dataset into the same buffer.
+        Returns the elapsed time in seconds, or -1 on error.
+    */
+    CompressedDataset dataset;
+    auto start = high_resolution_clock::now();
+    if (compressed_dataset_open(&dataset, compressed_file) != 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < dataset.header.n_records; ++i) {
+        if (compressed_dataset_read(&dataset, i, image, NULL) != 0) {
+            fprintf(stderr, "[ERROR] Failed to decode record %u of %s.\n", i, compressed_file);
+            compressed_dataset_close(&dataset);
+            return -1;
+        }
+    }
+    *n_images = dataset.header.n_records;
+    compressed_dataset_close(&dataset);
+    return duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+}
+
+static void bench(const char *binary_file) {
+    /*
+        Compress the raw dataset with several codecs and compare the file size
+        with the time needed to decode all records into one preallocated buffer.
+        Run it once to warm the page cache, or drop caches between runs
+        (echo 3 > /proc/sys/vm/drop_caches) to include the storage bandwidth.
+    */
+    const BenchConfig configs[] = {
+        {CODEC_RAW, 0}, {CODEC_LZ4, 0}, {CODEC_LZ4, 9},
+        {CODEC_PNG, 1}, {CODEC_PNG, 9}, {CODEC_JPEG, 95}, {CODEC_JPEG, 85},
+    };
+    off_t raw_size = file_size(binary_file);
+    uint8_t *image = (uint8_t *)malloc(IMAGE_TOTAL_PIXELS);
+    if (image == NULL) {
+        fprintf(stderr, "[ERROR] Failed to allocate an image of %d bytes.\n", IMAGE_TOTAL_PIXELS);
+        return;
+    }
+
+    printf("%-10s %12s %8s %12s %12s\n", "codec", "size (MB)", "ratio", "decode MB/s", "images/s");
+    for (const BenchConfig &config : configs) {
+        if (!codec_available(config.codec)) {
+            printf("%-10s (not available in this build)\n", codec_name(config.codec));
+            continue;
+        }
+        char compressed_file[300];
+        if (snprintf(compressed_file, sizeof(compressed_file), "%s.%s-%d.tcds", binary_file, codec_name(config.codec),
+                     config.quality) >= (int)sizeof(compressed_file)) {
+            fprintf(stderr, "[ERROR] Path too long for the compressed files of %s.\n", binary_file);
+            break;
+        }
+        if (compress_binary_dataset(binary_file, compressed_file, IMAGE_WIDTH, IMAGE_HEIGHT, config.codec, config.quality) < 0) {
+            continue;
+        }
+
+        int n_images = 0;
+        double seconds = read_all_records(compressed_file, image, &n_images);
+        if (seconds < 0) {
+            continue;
+        }
+        off_t size = file_size(compressed_file);
+        char name[32];
+        snprintf(name, sizeof(name), "%s-%d", codec_name(config.codec), config.quality);
+        printf("%-10s %12.2f %8.2f %12.1f %12.1f\n", name, size / 1e6, (double)raw_size / size,
+               n_images * (double)IMAGE_TOTAL_PIXELS / 1e6 / seconds, n_images / seconds);
+    }
+    free(image);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[1], "bench") == 0) {
+        bench(argv[2]);
+        return 0;
+    }
+    if (argc != 5) {
+        fprintf(stderr, "Usage: %s <binary_file> <compressed_file> <codec> <quality>\n", argv[0]);
+        fprintf(stderr, "       %s bench <binary_file>\n", argv[0]);
+        fprintf(stderr, "Codecs: raw, lz4 (quality > 0 for LZ4-HC), png (quality is the compression level), jpeg\n");
+        // g++ compress_dataset.cpp compressed_dataset.cpp -o compress_dataset `pkg-config --cflags --libs opencv4`
+        // ./compress_dataset tipu12.bin tipu12.tcds png 1
+        return 1;
+    }
+
+    const char *binary_file = argv[1];
+    const char *compressed_file = argv[2];
+    int codec = codec_from_name(argv[3]);
+    int quality = atoi(argv[4]);
+    if (codec < 0) {
+        fprintf(stderr, "[ERROR] Unknown codec %s.\n", argv[3]);
+        return 1;
+    }
+
+    if (compress_binary_dataset(binary_file, compressed_file, IMAGE_WIDTH, IMAGE_HEIGHT, codec, quality) < 0) {
+        return 1;
+    }
+    printf("[SUCCESS] Compressed dataset written to %s\n", compressed_file);
+    return 0;
+}
@@ -0,0 +1,285 @@
+// 64-bit file offsets on the 32-bit ARM of the boards: the datasets can be over 2 GB
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#ifdef USE_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+
+#include "compressed_dataset.h"
+
+using namespace cv;
+using namespace std;
+
+const char *codec_name(int codec) {
+    switch (codec) {
+        case CODEC_RAW:  return "raw";
+        case CODEC_LZ4:  return "lz4";
+        case CODEC_PNG:  return "png";
+        case CODEC_JPEG: return "jpeg";
+        default:         return "unknown";
+    }
+}
+
+int codec_from_name(const char *name) {
+    for (int codec = CODEC_RAW; codec <= CODEC_JPEG; ++codec) {
+        if (strcmp(name, codec_name(codec)) == 0) {
+            return codec;
+        }
+    }
+    return -1;
+}
+
+int codec_available(int codec) {
+#ifndef USE_LZ4
+    if (codec == CODEC_LZ4) {
+        return 0;
+    }
+#endif
+    return codec >= CODEC_RAW && codec <= CODEC_JPEG;
+}
+
+static int mat_type(int channels) {
+    return channels == 1 ? CV_8UC1 : CV_8UC3;
+}
+
+static int encode_record(const uint8_t *image, int image_width, int image_height, int image_channels, int codec, int quality, vector<uint8_t> &payload) {
+    /*
+        Compress one image into payload.
+        The images are stored in RGB order; OpenCV takes them as BGR, which is fine as long as they are decoded the same way.
+    */
+    uint32_t image_size = image_width * image_height * image_channels;
+    switch (codec) {
+        case CODEC_RAW:
+            payload.assign(image, image + image_size);
+            return 0;
+#ifdef USE_LZ4
+        case CODEC_LZ4: {
+            payload.resize(LZ4_compressBound(image_size));
+            int size;
+            if (quality > 0) {
+                size = LZ4_compress_HC((const char *)image, (char *)payload.data(), image_size, payload.size(), quality);
+            } else {
+                size = LZ4_compress_default((const char *)image, (char *)payload.data(), image_size, payload.size());
+            }
+            if (size <= 0) {
+                return -1;
+            }
+            payload.resize(size);
+            return 0;
+        }
+#endif
+        case CODEC_PNG:
+        case CODEC_JPEG: {
+            Mat img(image_height, image_width, mat_type(image_channels), (void *)image);
+            vector<int> params;
+            if (codec == CODEC_PNG) {
+                params = {IMWRITE_PNG_COMPRESSION, quality};
+            } else {
+                params = {IMWRITE_JPEG_QUALITY, quality};
+            }
+            return imencode(codec == CODEC_PNG ? ".png" : ".jpg", img, payload, params) ? 0 : -1;
+        }
+        default:
+            return -1;
+    }
+}
+
+int compress_binary_dataset(const char *binary_file, const char *compressed_file, int image_width, int image_height, int codec, int quality) {
+    /*
+        Read the raw binary dataset record by record, compress each image and write
+        the payloads followed by the index. The header is written last, once the
+        index offset and the largest record size are known.
+    */
+    if (!codec_available(codec)) {
+        fprintf(stderr, "[ERROR] Codec %s is not available in this build.\n", codec_name(codec));
+        return -1;
+    }
+
+    FILE *bin_file = fopen(binary_file, "rb");
+    if (bin_file == NULL) {
+        fprintf(stderr, "[ERROR] Failed to open the binary file %s.\n", binary_file);
+        return -1;
+    }
+    FILE *out_file = fopen(compressed_file, "wb");
+    if (out_file == NULL) {
+        fprintf(stderr, "[ERROR] Failed to open the output file %s.\n", compressed_file);
+        fclose(bin_file);
+        return -1;
+    }
+
+    CompressedDatasetHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COMPRESSED_DATASET_MAGIC, 4);
+    header.version = COMPRESSED_DATASET_VERSION;
+    header.codec = codec;
+    header.image_width = image_width;
+    header.image_height = image_height;
+    header.image_channels = 3;
+    header.quality = quality;
+    fwrite(&header, sizeof(header), 1, out_file); // Placeholder, rewritten at the end
+
+    uint32_t image_size = image_width * image_height * header.image_channels;
+    uint8_t *record = (uint8_t *)malloc(sizeof(uint16_t) + image_size);
+    if (record == NULL) {
+        fprintf(stderr, "[ERROR] Failed to allocate a record of %u bytes.\n", image_size);
+        fclose(bin_file);
+        fclose(out_file);
+        return -1;
+    }
+    vector<uint8_t> payload;
+    vector<CompressedRecordIndex> index;
+    uint64_t offset = sizeof(header);
+    uint64_t raw_bytes = 0;
+
+    while (fread(record, 1, sizeof(uint16_t) + image_size, bin_file) == sizeof(uint16_t) + image_size) {
+        CompressedRecordIndex entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.label = record[0] | (record[1] << 8);
+        if (encode_record(record + sizeof(uint16_t), image_width, image_height, header.image_channels, codec, quality, payload) != 0) {
+            fprintf(stderr, "[ERROR] Failed to compress record %zu.\n", index.size());
+            free(record);
+            fclose(bin_file);
+            fclose(out_file);
+            return -1;
+        }
+        entry.offset = offset;
+        entry.size = payload.size();
+        fwrite(payload.data(), 1, payload.size(), out_file);
+
+        offset += payload.size();
+        raw_bytes += sizeof(uint16_t) + image_size;
+        if (entry.size > header.max_record_size) {
+            header.max_record_size = entry.size;
+        }
+        index.push_back(entry);
+    }
+    free(record);
+    fclose(bin_file);
+
+    header.n_records = index.size();
+    header.index_offset = offset;
+    fwrite(index.data(), sizeof(CompressedRecordIndex), index.size(), out_file);
+    fseeko(out_file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, out_file);
+    fclose(out_file);
+
+    uint64_t total_bytes = offset + index.size() * sizeof(CompressedRecordIndex);
+    printf("[INFO] %u records compressed with %s: %.2f MB -> %.2f MB (ratio %.2f)\n",
+           header.n_records, codec_name(codec), raw_bytes / 1e6, total_bytes / 1e6,
+           total_bytes ? (double)raw_bytes / total_bytes : 0.0);
+    return header.n_records;
+}
+
+int compressed_dataset_open(CompressedDataset *dataset, const char *compressed_file) {
+    memset(dataset, 0, sizeof(*dataset));
+    dataset->file = fopen(compressed_file, "rb");
+    if (dataset->file == NULL) {
+        fprintf(stderr, "[ERROR] Failed to open the compressed dataset %s.\n", compressed_file);
+        return -1;
+    }
+
+    CompressedDatasetHeader *header = &dataset->header;
+    if (fread(header, sizeof(*header), 1, dataset->file) != 1 || memcmp(header->magic, COMPRESSED_DATASET_MAGIC, 4) != 0) {
+        fprintf(stderr, "[ERROR] %s is not a compressed dataset.\n", compressed_file);
+        compressed_dataset_close(dataset);
+        return -1;
+    }
+    if (header->version != COMPRESSED_DATASET_VERSION || !codec_available(header->codec)) {
+        fprintf(stderr, "[ERROR] Unsupported version %d or codec %s in %s.\n", header->version, codec_name(header->codec), compressed_file);
+        compressed_dataset_close(dataset);
+        return -1;
+    }
+
+    // Load the whole index, it is small (16 bytes per record)
+    dataset->index = (CompressedRecordIndex *)malloc((size_t)header->n_records * sizeof(CompressedRecordIndex));
+    if (dataset->index == NULL && header->n_records > 0) {
+        fprintf(stderr, "[ERROR] Failed to allocate the index of %u records of %s.\n", header->n_records, compressed_file);
+        compressed_dataset_close(dataset);
+        return -1;
+    }
+    if (fseeko(dataset->file, (off_t)header->index_offset, SEEK_SET) != 0 ||
+        fread(dataset->index, sizeof(CompressedRecordIndex), header->n_records, dataset->file) != header->n_records) {
+        fprintf(stderr, "[ERROR] Truncated index in %s.\n", compressed_file);
+        compressed_dataset_close(dataset);
+        return -1;
+    }
+
+    // Raw records are read straight into the caller's buffer, no scratch needed
+    if (header->codec != CODEC_RAW) {
+        dataset->scratch = (uint8_t *)malloc(header->max_record_size);
+        if (dataset->scratch == NULL) {
+            fprintf(stderr, "[ERROR] Failed to allocate a record of %u bytes for %s.\n", header->max_record_size, compressed_file);
+            compressed_dataset_close(dataset);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void compressed_dataset_close(CompressedDataset *dataset) {
+    if (dataset->file != NULL) {
+        fclose(dataset->file);
+    }
+    free(dataset->index);
+    free(dataset->scratch);
+    memset(dataset, 0, sizeof(*dataset));
+}
+
+uint32_t compressed_dataset_image_size(const CompressedDataset *dataset) {
+    return dataset->header.image_width * dataset->header.image_height * dataset->header.image_channels;
+}
+
+int compressed_dataset_read(CompressedDataset *dataset, uint32_t i, uint8_t *image, uint16_t *label) {
+    const CompressedDatasetHeader *header = &dataset->header;
+    if (i >= header->n_records) {
+        return -1;
+    }
+    const CompressedRecordIndex *entry = &dataset->index[i];
+    uint32_t image_size = compressed_dataset_image_size(dataset);
+    if (label != NULL) {
+        *label = entry->label;
+    }
+
+    if (fseeko(dataset->file, (off_t)entry->offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    if (header->codec == CODEC_RAW) {
+        return fread(image, 1, image_size, dataset->file) == image_size ? 0 : -1;
+    }
+    if (fread(dataset->scratch, 1, entry->size, dataset->file) != entry->size) {
+        return -1;
+    }
+
+    switch (header->codec) {
+#ifdef USE_LZ4
+        case CODEC_LZ4:
+            return LZ4_decompress_safe((const char *)dataset->scratch, (char *)image, entry->size, image_size) == (int)image_size ? 0 : -1;
+#endif
+        case CODEC_PNG:
+        case CODEC_JPEG: {
+            // imdecode reuses dst when its size and type already match, so it decodes in place
+            Mat dst(header->image_height, header->image_width, mat_type(header->image_channels), image);
+            Mat decoded = imdecode(Mat(1, entry->size, CV_8UC1, dataset->scratch), header->image_channels == 1 ? IMREAD_GRAYSCALE : IMREAD_COLOR, &dst);
+            if (decoded.empty() || decoded.rows != header->image_height || decoded.cols != header->image_width) {
+                return -1;
+            }
+            if (decoded.data != image) {
+                memcpy(image, decoded.data, image_size);
+            }
+            return 0;
+        }
+        default:
+            return -1;
+    }
+}
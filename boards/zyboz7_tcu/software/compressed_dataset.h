@@ -0,0 +1,78 @@
+#ifndef COMPRESSED_DATASET_H
+#define COMPRESSED_DATASET_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+    Compressed variant of the binary dataset (see dataset_to_binary.cpp).
+
+    The raw dataset stores each sample as 2 bytes of label followed by the
+    raw image. Here, each record is compressed on its own and an index is
+    written at the end of the file, so any record can be decoded without
+    reading the ones before it:
+
+    - CompressedDatasetHeader (32 bytes)
+    - n_records payloads, back to back
+    - n_records CompressedRecordIndex entries, starting at index_offset
+
+    All fields are little endian, like the raw dataset.
+*/
+
+#define COMPRESSED_DATASET_MAGIC    "TCDS"
+#define COMPRESSED_DATASET_VERSION  1
+
+typedef enum {
+    CODEC_RAW  = 0, // No compression, same bytes as the raw dataset
+    CODEC_LZ4  = 1, // Lossless, fastest decode (needs -DUSE_LZ4 -llz4)
+    CODEC_PNG  = 2, // Lossless, best ratio, slow decode
+    CODEC_JPEG = 3, // Lossy, small files, decode cost close to PNG
+} CompressionCodec;
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t codec;
+    uint16_t image_width;
+    uint16_t image_height;
+    uint16_t image_channels;
+    uint16_t quality;       // JPEG quality or PNG compression level, 0 otherwise
+    uint32_t n_records;
+    uint32_t max_record_size;
+    uint64_t index_offset;
+} CompressedDatasetHeader;
+
+typedef struct {
+    uint64_t offset;
+    uint32_t size;
+    uint16_t label;
+    uint16_t reserved;
+} CompressedRecordIndex;
+
+typedef struct {
+    FILE *file;
+    CompressedDatasetHeader header;
+    CompressedRecordIndex *index;
+    uint8_t *scratch;       // Holds one compressed record, sized by max_record_size
+} CompressedDataset;
+
+const char *codec_name(int codec);
+int codec_from_name(const char *name);
+int codec_available(int codec);
+
+// Compress a raw binary dataset (label + image records) into a compressed dataset.
+// Returns the number of records written, or -1 on error.
+int compress_binary_dataset(const char *binary_file, const char *compressed_file, int image_width, int image_height, int codec, int quality);
+
+// Open a compressed dataset and load its index. Returns 0 on success, -1 on error.
+int compressed_dataset_open(CompressedDataset *dataset, const char *compressed_file);
+void compressed_dataset_close(CompressedDataset *dataset);
+
+// Size in bytes of one decoded image
+uint32_t compressed_dataset_image_size(const CompressedDataset *dataset);
+
+// Decode the record i straight into image, which must hold compressed_dataset_image_size() bytes.
+// The label is written into label if not NULL. Returns 0 on success, -1 on error.
+int compressed_dataset_read(CompressedDataset *dataset, uint32_t i, uint8_t *image, uint16_t *label);
+
+#endif // COMPRESSED_DATASET_H
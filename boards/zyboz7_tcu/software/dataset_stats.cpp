@@ -0,0 +1,433 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <math.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+using namespace chrono;
+
+#define IMAGE_WIDTH 224
+#define IMAGE_HEIGHT 224
+#define IMAGE_TOTAL_PIXELS (IMAGE_WIDTH * IMAGE_HEIGHT * 3)
+#define RECORD_SIZE (IMAGE_TOTAL_PIXELS + sizeof(uint16_t))
+#define HISTOGRAM_BARS 16
+
+typedef struct {
+    string path;        // Empty for a binary dataset
+    uint16_t label;
+} Sample;
+
+typedef struct {
+    uint64_t sum[3];
+    uint64_t sum_squares[3];
+    uint64_t histogram[3][256];
+    uint64_t n_pixels;
+    map<pair<int, int>, int> sizes;
+    int n_failed;
+} Stats;
+
+// Calibration subset, kept as the images are decoded for the statistics
+typedef struct {
+    vector<size_t> subset;      // Indices of the samples
+    vector<int> slot;           // Position of each sample in the subset, -1 if not in it
+    uint8_t *images;            // The decoded images of the subset, NULL for a binary dataset
+    vector<uint8_t> loaded;     // Per position, the image was decoded
+} Calibration;
+
+static void stats_init(Stats *stats) {
+    memset(stats->sum, 0, sizeof(stats->sum));
+    memset(stats->sum_squares, 0, sizeof(stats->sum_squares));
+    memset(stats->histogram, 0, sizeof(stats->histogram));
+    stats->n_pixels = 0;
+    stats->sizes.clear();
+    stats->n_failed = 0;
+}
+
+static void stats_merge(Stats *into, const Stats *from) {
+    for (int c = 0; c < 3; ++c) {
+        into->sum[c] += from->sum[c];
+        into->sum_squares[c] += from->sum_squares[c];
+        for (int v = 0; v < 256; ++v) {
+            into->histogram[c][v] += from->histogram[c][v];
+        }
+    }
+    into->n_pixels += from->n_pixels;
+    for (const auto &size : from->sizes) {
+        into->sizes[size.first] += size.second;
+    }
+    into->n_failed += from->n_failed;
+}
+
+static void accumulate_image(Stats *stats, const uint8_t *rgb) {
+    /*
+        Accumulate one RGB image. The histogram holds everything needed:
+        the sums are computed from it at the end of the image, so the inner
+        loop is only three increments per pixel.
+    */
+    uint32_t histogram[3][256];
+    memset(histogram, 0, sizeof(histogram));
+    for (int i = 0; i < IMAGE_WIDTH * IMAGE_HEIGHT; ++i) {
+        histogram[0][rgb[0]]++;
+        histogram[1][rgb[1]]++;
+        histogram[2][rgb[2]]++;
+        rgb += 3;
+    }
+    for (int c = 0; c < 3; ++c) {
+        for (int v = 0; v < 256; ++v) {
+            stats->histogram[c][v] += histogram[c][v];
+            stats->sum[c] += (uint64_t)histogram[c][v] * v;
+            stats->sum_squares[c] += (uint64_t)histogram[c][v] * v * v;
+        }
+    }
+    stats->n_pixels += IMAGE_WIDTH * IMAGE_HEIGHT;
+}
+
+static bool load_image(const string &path, uint8_t *rgb, int *width, int *height) {
+    /*
+        Load an image the way dataset_to_binary does: BGR to RGB, resized to 224x224.
+    */
+    Mat img = imread(path);
+    if (img.empty()) {
+        return false;
+    }
+    *width = img.cols;
+    *height = img.rows;
+    if (img.channels() == 1) {
+        cvtColor(img, img, COLOR_GRAY2BGR);
+    }
+    cv::resize(img, img, Size(IMAGE_WIDTH, IMAGE_HEIGHT));
+    Mat out(IMAGE_HEIGHT, IMAGE_WIDTH, CV_8UC3, rgb);
+    cvtColor(img, out, COLOR_BGR2RGB);
+    return true;
+}
+
+static int list_folder_dataset(const char *dataset_path, vector<string> &class_names, vector<Sample> &samples) {
+    /*
+        List the images of the dataset, one subfolder per class.
+        The classes are sorted in alphabetical order, like in dataset_to_binary.
+    */
+    DIR *dir = opendir(dataset_path);
+    if (dir == NULL) {
+        fprintf(stderr, "[ERROR] Failed to open the directory %s.\n", dataset_path);
+        return -1;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_type == DT_DIR && strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            class_names.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+    sort(class_names.begin(), class_names.end());
+
+    for (size_t label = 0; label < class_names.size(); ++label) {
+        string class_path = string(dataset_path) + "/" + class_names[label];
+        DIR *class_dir = opendir(class_path.c_str());
+        if (class_dir == NULL) {
+            continue;
+        }
+        while ((entry = readdir(class_dir)) != NULL) {
+            if (entry->d_type == DT_REG) {
+                samples.push_back({class_path + "/" + entry->d_name, (uint16_t)label});
+            }
+        }
+        closedir(class_dir);
+    }
+    return samples.size();
+}
+
+static uint8_t *read_binary_dataset(const char *binary_file, vector<Sample> &samples, long *size) {
+    FILE *bin_file = fopen(binary_file, "rb");
+    if (bin_file == NULL) {
+        fprintf(stderr, "[ERROR] Failed to open the binary file %s.\n", binary_file);
+        return NULL;
+    }
+    fseek(bin_file, 0, SEEK_END);
+    *size = ftell(bin_file);
+    fseek(bin_file, 0, SEEK_SET);
+
+    uint8_t *data = (uint8_t *)malloc(*size);
+    if (fread(data, 1, *size, bin_file) != (size_t)*size) {
+        fprintf(stderr, "[ERROR] Failed to read the binary file %s.\n", binary_file);
+        free(data);
+        fclose(bin_file);
+        return NULL;
+    }
+    fclose(bin_file);
+
+    int n_images = *size / RECORD_SIZE;
+    for (int i = 0; i < n_images; ++i) {
+        const uint8_t *record = data + (size_t)i * RECORD_SIZE;
+        samples.push_back({"", (uint16_t)(record[0] | (record[1] << 8))});
+    }
+    return data;
+}
+
+static void scan_worker(const vector<Sample> *samples, const uint8_t *binary_data, atomic<size_t> *next, Stats *stats,
+                        Calibration *calibration) {
+    uint8_t *rgb = (uint8_t *)malloc(IMAGE_TOTAL_PIXELS);
+    size_t i;
+    while ((i = next->fetch_add(1)) < samples->size()) {
+        const Sample &sample = (*samples)[i];
+        if (binary_data != NULL) {
+            accumulate_image(stats, binary_data + i * RECORD_SIZE + sizeof(uint16_t));
+            stats->sizes[make_pair(IMAGE_WIDTH, IMAGE_HEIGHT)]++;
+            continue;
+        }
+        // The images of the calibration subset are decoded straight to their place in it
+        int slot = calibration->images != NULL ? calibration->slot[i] : -1;
+        uint8_t *image = slot >= 0 ? calibration->images + (size_t)slot * IMAGE_TOTAL_PIXELS : rgb;
+        int width, height;
+        if (!load_image(sample.path, image, &width, &height)) {
+            stats->n_failed++;
+            continue;
+        }
+        if (slot >= 0) {
+            calibration->loaded[slot] = 1;
+        }
+        accumulate_image(stats, image);
+        stats->sizes[make_pair(width, height)]++;
+    }
+    free(rgb);
+}
+
+static void print_histogram(const Stats *stats) {
+    const char *channels[3] = {"R", "G", "B"};
+    const int max_bar_length = 50;
+    for (int c = 0; c < 3; ++c) {
+        uint64_t bins[HISTOGRAM_BARS] = {0};
+        uint64_t max_bin = 1;
+        for (int v = 0; v < 256; ++v) {
+            bins[v * HISTOGRAM_BARS / 256] += stats->histogram[c][v];
+        }
+        for (int b = 0; b < HISTOGRAM_BARS; ++b) {
+            max_bin = max(max_bin, bins[b]);
+        }
+        printf("Histogram %s:\n", channels[c]);
+        for (int b = 0; b < HISTOGRAM_BARS; ++b) {
+            int bar_length = bins[b] * max_bar_length / max_bin;
+            printf("  [%3d-%3d] %5.2f%% : %s\n", b * 256 / HISTOGRAM_BARS, (b + 1) * 256 / HISTOGRAM_BARS - 1,
+                   100.0 * bins[b] / max<uint64_t>(stats->n_pixels, 1), string(bar_length, '#').c_str());
+        }
+    }
+}
+
+static void print_stats(const Stats *stats, const vector<string> &class_names, const vector<Sample> &samples) {
+    double mean[3], std[3];
+    for (int c = 0; c < 3; ++c) {
+        double m = (double)stats->sum[c] / stats->n_pixels;
+        double variance = (double)stats->sum_squares[c] / stats->n_pixels - m * m;
+        mean[c] = m / 255.0;
+        std[c] = sqrt(max(variance, 0.0)) / 255.0;
+    }
+
+    vector<int> class_counts(class_names.size(), 0);
+    for (const Sample &sample : samples) {
+        if (sample.label < class_counts.size()) {
+            class_counts[sample.label]++;
+        }
+    }
+    printf("[INFO] Images per class:\n");
+    for (size_t i = 0; i < class_names.size(); ++i) {
+        printf("  %-15s %6d\n", class_names[i].c_str(), class_counts[i]);
+    }
+
+    // Most frequent original sizes first
+    vector<pair<int, pair<int, int>>> sizes;
+    for (const auto &size : stats->sizes) {
+        sizes.push_back(make_pair(size.second, size.first));
+    }
+    sort(sizes.rbegin(), sizes.rend());
+    printf("[INFO] Image sizes (%zu different):\n", sizes.size());
+    for (size_t i = 0; i < sizes.size() && i < 10; ++i) {
+        printf("  %5dx%-5d %6d\n", sizes[i].second.first, sizes[i].second.second, sizes[i].first);
+    }
+
+    print_histogram(stats);
+
+    printf("[INFO] Normalisation constants (RGB, on the 224x224 images):\n");
+    printf("  float mean[3] = {%.3ff, %.3ff, %.3ff};\n", mean[0], mean[1], mean[2]);
+    printf("  float std[3] = {%.3ff, %.3ff, %.3ff};\n", std[0], std[1], std[2]);
+    if (stats->n_failed > 0) {
+        printf("[INFO] %d images could not be read\n", stats->n_failed);
+    }
+}
+
+static vector<size_t> stratified_subset(const vector<Sample> &samples, int n_classes, int n_calibration) {
+    /*
+        Pick n_calibration samples with the same class proportions as the dataset,
+        at least one per non-empty class. The seed is fixed so that the subset
+        only changes when the dataset changes.
+    */
+    vector<vector<size_t>> per_class(n_classes);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        per_class[samples[i].label].push_back(i);
+    }
+
+    mt19937 rng(0);
+    vector<size_t> subset;
+    for (int label = 0; label < n_classes; ++label) {
+        vector<size_t> &indices = per_class[label];
+        if (indices.empty()) {
+            continue;
+        }
+        size_t quota = max<size_t>(1, (size_t)llround((double)n_calibration * indices.size() / samples.size()));
+        quota = min(quota, indices.size());
+        shuffle(indices.begin(), indices.end(), rng);
+        subset.insert(subset.end(), indices.begin(), indices.begin() + quota);
+    }
+    shuffle(subset.begin(), subset.end(), rng);
+    return subset;
+}
+
+static int write_calibration_subset(const char *calibration_file, const vector<Sample> &samples, const uint8_t *binary_data,
+                                    const Calibration &calibration) {
+    /*
+        Write the subset in the binary dataset format, from the images decoded
+        by the scan (the records for a binary dataset):
+        - 2 bytes for the label (class) of the image (uint16_t)
+        - 224x224x3 bytes for the RGB image data in RGB order
+    */
+    FILE *bin_file = fopen(calibration_file, "wb");
+    if (bin_file == NULL) {
+        fprintf(stderr, "[ERROR] Failed to open the binary file %s.\n", calibration_file);
+        return -1;
+    }
+    int n_images = 0;
+    for (size_t k = 0; k < calibration.subset.size(); ++k) {
+        size_t i = calibration.subset[k];
+        const uint8_t *image;
+        if (binary_data != NULL) {
+            image = binary_data + i * RECORD_SIZE + sizeof(uint16_t);
+        } else if (calibration.loaded[k]) {
+            image = calibration.images + k * IMAGE_TOTAL_PIXELS;
+        } else {
+            continue;
+        }
+        fwrite(&samples[i].label, sizeof(uint16_t), 1, bin_file);
+        fwrite(image, 1, IMAGE_TOTAL_PIXELS, bin_file);
+        n_images++;
+    }
+    fclose(bin_file);
+    return n_images;
+}
+
+static bool is_directory(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3 && argc != 5) {
+        fprintf(stderr, "Usage: %s <dataset_path | binary_file> <n_threads> [<calibration_file> <calibration_images>]\n", argv[0]);
+        // g++ -O2 dataset_stats.cpp -o dataset_stats -lpthread `pkg-config --cflags --libs opencv4`
+        // ./dataset_stats Tipu-12/train/ 8 calib.bin 1000
+        return 1;
+    }
+
+    const char *dataset_path = argv[1];
+    int n_threads = max(1, atoi(argv[2]));
+    const char *calibration_file = argc == 5 ? argv[3] : NULL;
+    int n_calibration = argc == 5 ? atoi(argv[4]) : 0;
+
+    auto start = high_resolution_clock::now();
+
+    // List the samples: file paths for a folder, records for a binary dataset
+    vector<string> class_names;
+    vector<Sample> samples;
+    uint8_t *binary_data = NULL;
+    if (is_directory(dataset_path)) {
+        if (list_folder_dataset(dataset_path, class_names, samples) < 0) {
+            return 1;
+        }
+    } else {
+        long size;
+        binary_data = read_binary_dataset(dataset_path, samples, &size);
+        if (binary_data == NULL) {
+            return 1;
+        }
+        int n_classes = 0;
+        for (const Sample &sample : samples) {
+            n_classes = max(n_classes, sample.label + 1);
+        }
+        for (int i = 0; i < n_classes; ++i) {
+            class_names.push_back(to_string(i));
+        }
+    }
+    printf("[INFO] Found %zu images in %zu classes\n", samples.size(), class_names.size());
+    if (samples.empty()) {
+        return 1;
+    }
+
+    // The subset only depends on the labels: chosen before the scan, which keeps its images
+    Calibration calibration;
+    calibration.images = NULL;
+    if (calibration_file != NULL) {
+        calibration.subset = stratified_subset(samples, class_names.size(), n_calibration);
+        if (binary_data == NULL) {
+            calibration.slot.assign(samples.size(), -1);
+            for (size_t k = 0; k < calibration.subset.size(); ++k) {
+                calibration.slot[calibration.subset[k]] = k;
+            }
+            calibration.loaded.assign(calibration.subset.size(), 0);
+            calibration.images = (uint8_t *)malloc(calibration.subset.size() * IMAGE_TOTAL_PIXELS);
+            if (calibration.images == NULL) {
+                fprintf(stderr, "[ERROR] Failed to allocate %zu calibration images.\n", calibration.subset.size());
+                return 1;
+            }
+        }
+    }
+
+    // Each thread accumulates its own statistics, merged at the end
+    cv::setNumThreads(1);
+    vector<Stats> thread_stats(n_threads);
+    vector<thread> workers;
+    atomic<size_t> next(0);
+    for (int i = 0; i < n_threads; ++i) {
+        stats_init(&thread_stats[i]);
+        workers.push_back(thread(scan_worker, &samples, binary_data, &next, &thread_stats[i], &calibration));
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    Stats stats;
+    stats_init(&stats);
+    for (const Stats &s : thread_stats) {
+        stats_merge(&stats, &s);
+    }
+
+    double seconds = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+    printf("[INFO] Scanned %zu images in %.2f seconds (%.1f images/s, %d threads)\n", samples.size(), seconds, samples.size() / seconds, n_threads);
+    print_stats(&stats, class_names, samples);
+
+    if (calibration_file != NULL) {
+        int n_written = write_calibration_subset(calibration_file, samples, binary_data, calibration);
+        if (n_written < 0) {
+            free(calibration.images);
+            free(binary_data);
+            return 1;
+        }
+        printf("[SUCCESS] Wrote %d calibration images to %s\n", n_written, calibration_file);
+    }
+
+    free(calibration.images);
+    free(binary_data);
+    return 0;
+}
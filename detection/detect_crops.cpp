@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <chrono>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "detection.h"
+
+using namespace cv;
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -o detect_crops detect_crops.cpp detection.cpp `pkg-config --cflags --libs opencv4`
+
+static bool found_by(const Detection& reference, const vector<Detection>& detections, int margin) {
+    // The mass center of the full resolution detection is in the box of one of the others
+    for (const Detection& d : detections) {
+        if (reference.center_x >= d.x_min - margin && reference.center_x <= d.x_max + margin &&
+            reference.center_y >= d.y_min - margin && reference.center_y <= d.y_max + margin) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    /*
+        Detect the insects of trap images against the image of the empty
+        trap at a level of the pyramid, and save the crops, taken from the
+        full resolution images. Each image is also detected at full
+        resolution to print the time of both and the recall of the level
+        (the detections at full resolution that it finds too).
+    */
+    if (argc < 6) {
+        fprintf(stderr, "Usage: %s <background> <output_directory|-> <level> <refine> <image> [image...]\n", argv[0]);
+        // ./detect_crops background.jpeg crops 2 1 10.jpeg 20.jpeg
+        return 1;
+    }
+    const char* output_directory = argv[2];
+    bool save = strcmp(output_directory, "-") != 0;
+    DetectionParams params = default_detection_params();
+    DetectionParams full = params;
+    params.level = atoi(argv[3]);
+    params.refine = atoi(argv[4]);
+
+    Mat background = imread(argv[1], IMREAD_GRAYSCALE);
+    if (background.empty()) {
+        fprintf(stderr, "[ERROR] Could not read the background %s\n", argv[1]);
+        return 1;
+    }
+    int width = background.cols, height = background.rows;
+    Detector detector(width, height, params), full_detector(width, height, full);
+    detector.set_background(background.data);
+    full_detector.set_background(background.data);
+    if (save) {
+        struct stat st = {0};
+        if (stat(output_directory, &st) == -1) {
+            mkdir(output_directory, 0700);
+        }
+    }
+
+    vector<Detection> detections, full_detections;
+    double time_ms = 0, full_ms = 0;
+    int n_images = 0, n_full = 0, n_found = 0, n_crops = 0;
+    Mat gray;
+    for (int i = 5; i < argc; i++) {
+        Mat image = imread(argv[i], IMREAD_COLOR);
+        if (image.empty() || image.cols != width || image.rows != height) {
+            fprintf(stderr, "[ERROR] Could not read %s, or not the size of the background\n", argv[i]);
+            continue;
+        }
+        cvtColor(image, gray, COLOR_BGR2GRAY);
+
+        auto start = steady_clock::now();
+        full_detector.detect(gray.data, full_detections);
+        auto middle = steady_clock::now();
+        detector.detect(gray.data, detections);
+        auto stop = steady_clock::now();
+        double image_full_ms = duration<double, milli>(middle - start).count();
+        double image_ms = duration<double, milli>(stop - middle).count();
+        full_ms += image_full_ms;
+        time_ms += image_ms;
+
+        int found = 0;
+        for (const Detection& reference : full_detections) {
+            found += found_by(reference, detections, 1 << params.level);
+        }
+        printf("%s: %zu detections in %.2f ms at full resolution, %zu in %.2f ms at level %d (%d/%zu found)\n", argv[i],
+               full_detections.size(), image_full_ms, detections.size(), image_ms, params.level, found,
+               full_detections.size());
+        n_full += full_detections.size();
+        n_found += found;
+        n_images++;
+
+        if (save) {
+            for (size_t d = 0; d < detections.size(); d++) {
+                const Detection& det = detections[d];
+                imwrite(format("%s/%d_%zu.png", output_directory, i - 5, d), image(Rect(det.x, det.y, det.width, det.height)));
+                n_crops++;
+            }
+        }
+    }
+    if (n_images == 0) {
+        return 1;
+    }
+    printf("%d images: %.2f ms at full resolution, %.2f ms at level %d%s, recall %.1f%% (%d/%d)\n", n_images,
+           full_ms / n_images, time_ms / n_images, params.level, params.refine ? " with refine" : "",
+           n_full ? 100.0 * n_found / n_full : 100.0, n_found, n_full);
+    if (save) {
+        printf("%d crops saved in %s\n", n_crops, output_directory);
+    }
+    return 0;
+}
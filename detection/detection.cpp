@@ -0,0 +1,326 @@
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "detection.h"
+
+using namespace std;
+using namespace chrono;
+
+DetectionParams default_detection_params() {
+    DetectionParams params;
+    params.contrast = 50;
+    params.run_length = 7;
+    params.min_count = 3;
+    params.point_distance = 5;
+    params.cluster_distance = 50;
+    params.box = 112;
+    params.level = 0;
+    params.refine = false;
+    return params;
+}
+
+template <int F>
+static void downscale_block(const uint8_t* src, int width, int height, uint8_t* dst) {
+    /*
+        The lines of a block are summed in sums (at most 16 lines of 255 in a
+        uint16_t), then the columns, rounded to the nearest. The last columns
+        and lines that do not fill a block are dropped.
+    */
+    const int shift = F == 2 ? 2 : F == 4 ? 4 : F == 8 ? 6 : 8;
+    int out_w = width / F, out_h = height / F;
+    vector<uint16_t> sums(width);
+    for (int y = 0; y < out_h; y++) {
+        const uint8_t* line = src + (size_t)y * F * width;
+        for (int x = 0; x < width; x++) {
+            sums[x] = line[x];
+        }
+        for (int k = 1; k < F; k++) {
+            line += width;
+            for (int x = 0; x < width; x++) {
+                sums[x] += line[x];
+            }
+        }
+        uint8_t* out = dst + (size_t)y * out_w;
+        for (int x = 0; x < out_w; x++) {
+            unsigned sum = 0;
+            for (int k = 0; k < F; k++) {
+                sum += sums[x * F + k];
+            }
+            out[x] = (uint8_t)((sum + (1u << (shift - 1))) >> shift);
+        }
+    }
+}
+
+void downscale_box(const uint8_t* src, int width, int height, int factor, uint8_t* dst) {
+    switch (factor) {
+        case 2:  downscale_block<2>(src, width, height, dst); break;
+        case 4:  downscale_block<4>(src, width, height, dst); break;
+        case 8:  downscale_block<8>(src, width, height, dst); break;
+        case 16: downscale_block<16>(src, width, height, dst); break;
+        default: memcpy(dst, src, (size_t)width * height); break;
+    }
+}
+
+Detector::Detector(int width, int height, const DetectionParams& detection_params)
+    : params(detection_params), width(width), height(height) {
+    params.level = max(0, min(4, params.level));
+    factor = 1 << params.level;
+    level_w = width / factor;
+    level_h = height / factor;
+    background.assign((size_t)width * height, 255);
+    if (params.level > 0) {
+        background_level.assign((size_t)level_w * level_h, 255);
+        gray_level.resize((size_t)level_w * level_h);
+    }
+    memset(&last_times, 0, sizeof(last_times));
+}
+
+void Detector::set_background(const uint8_t* frame) {
+    memcpy(background.data(), frame, background.size());
+    if (params.level > 0) {
+        downscale_box(frame, width, height, factor, background_level.data());
+    }
+}
+
+void Detector::find_locations(const uint8_t* gray, const uint8_t* bg, int stride, int x0, int y0, int w, int h,
+                              int run_length, int min_count) {
+    /*
+        detectLocations on the region (x0, y0, w, h), appending the points in
+        the order of the lines like the loops of detection.m. The counts
+        along the lines slide with x; the counts along the columns, of the
+        run_length lines below the current one, slide with y.
+    */
+    if (w <= run_length || h <= run_length) {
+        return;
+    }
+    mask.resize((size_t)w * h);
+    for (int y = 0; y < h; y++) {
+        const uint8_t* g = gray + (size_t)(y0 + y) * stride + x0;
+        const uint8_t* b = bg + (size_t)(y0 + y) * stride + x0;
+        uint8_t* m = &mask[(size_t)y * w];
+        for (int x = 0; x < w; x++) {
+            m[x] = b[x] - g[x] >= params.contrast;
+        }
+    }
+    column_counts.assign(w, 0);
+    for (int y = 1; y <= run_length; y++) {
+        const uint8_t* m = &mask[(size_t)y * w];
+        for (int x = 0; x < w; x++) {
+            column_counts[x] += m[x];
+        }
+    }
+    for (int y = 0; y + run_length < h; y++) {
+        const uint8_t* m = &mask[(size_t)y * w];
+        int count = 0;
+        for (int x = 1; x <= run_length; x++) {
+            count += m[x];
+        }
+        for (int x = 0; x + run_length < w; x++) {
+            if (m[x] && count > min_count && column_counts[x] > min_count) {
+                points.push_back({x0 + x, y0 + y});
+            }
+            count += (x + run_length + 1 < w ? m[x + run_length + 1] : 0) - m[x + 1];
+        }
+        if (y + run_length + 1 < h) {
+            const uint8_t* leaving = &mask[(size_t)(y + 1) * w];
+            const uint8_t* entering = &mask[(size_t)(y + run_length + 1) * w];
+            for (int x = 0; x < w; x++) {
+                column_counts[x] += entering[x] - leaving[x];
+            }
+        }
+    }
+}
+
+void Detector::cluster(vector<Detection>& detections) {
+    /*
+        The two clusterings of detection.m, on the points of the level. In
+        the first one, a point takes the label of a close point unless its
+        own label was already given to others. detection.m compares every
+        pair of points; the points are in the order of the lines, so only
+        those of the lines closer than point_distance are compared here, in
+        the same order, which gives the same labels.
+    */
+    float distance = params.point_distance / factor;
+    float cluster_distance = params.cluster_distance / factor;
+    int k = points.size();
+    labels.resize(k);
+    used.assign(k, false);
+    for (int i = 0; i < k; i++) {
+        labels[i] = i;
+    }
+    row_first.assign(level_h + 1, k);
+    for (int i = k - 1; i >= 0; i--) {
+        row_first[points[i].y] = i;
+    }
+    for (int y = level_h - 1; y >= 0; y--) {
+        row_first[y] = min(row_first[y], row_first[y + 1]);
+    }
+    int dy = (int)ceilf(distance) - 1;
+    for (int i = 0; i < k; i++) {
+        int first = row_first[max(0, points[i].y - dy)];
+        int last = row_first[min(level_h, points[i].y + dy + 1)];
+        for (int j = first; j < last; j++) {
+            if (j != i && abs(points[j].x - points[i].x) < distance && abs(points[j].y - points[i].y) < distance) {
+                if (!used[labels[j]]) {
+                    labels[j] = labels[i];
+                    used[labels[i]] = true;
+                }
+            }
+        }
+    }
+
+    // Mass center and extent of each cluster, in the order of the labels
+    clusters.assign(k, Cluster{0, 0, 0, INT32_MAX, INT32_MAX, -1, -1});
+    for (int i = 0; i < k; i++) {
+        Cluster& c = clusters[labels[i]];
+        c.center_x += points[i].x;
+        c.center_y += points[i].y;
+        c.n++;
+        c.x_min = min(c.x_min, points[i].x);
+        c.y_min = min(c.y_min, points[i].y);
+        c.x_max = max(c.x_max, points[i].x);
+        c.y_max = max(c.y_max, points[i].y);
+    }
+    clusters.erase(remove_if(clusters.begin(), clusters.end(), [](const Cluster& c) { return c.n == 0; }),
+                   clusters.end());
+    for (Cluster& c : clusters) {
+        // Sums until here
+        c.center_x /= c.n;
+        c.center_y /= c.n;
+    }
+
+    // Groups of the clusters with close mass centers. As in detection.m, a cluster already grouped
+    // is skipped as the first of a group, but can still join the group of a later one.
+    int n_clusters = clusters.size();
+    used.assign(n_clusters, false);
+    float offset = (factor - 1) / 2.0f;
+    for (int i = 0; i < n_clusters; i++) {
+        if (used[i]) {
+            continue;
+        }
+        const Cluster& first = clusters[i];
+        double sum_x = first.center_x, sum_y = first.center_y;
+        int n_close = 1;
+        Detection d;
+        d.x_min = first.x_min;
+        d.y_min = first.y_min;
+        d.x_max = first.x_max;
+        d.y_max = first.y_max;
+        d.n_points = first.n;
+        for (int j = i + 1; j < n_clusters; j++) {
+            const Cluster& c = clusters[j];
+            if (fabs(c.center_x - first.center_x) < cluster_distance && fabs(c.center_y - first.center_y) < cluster_distance) {
+                used[j] = true;
+                sum_x += c.center_x;
+                sum_y += c.center_y;
+                n_close++;
+                d.x_min = min(d.x_min, c.x_min);
+                d.y_min = min(d.y_min, c.y_min);
+                d.x_max = max(d.x_max, c.x_max);
+                d.y_max = max(d.y_max, c.y_max);
+                d.n_points += c.n;
+            }
+        }
+        // Back to the full resolution: a point of the level is a block of the frame
+        d.center_x = sum_x / n_close * factor + offset;
+        d.center_y = sum_y / n_close * factor + offset;
+        d.x_min *= factor;
+        d.y_min *= factor;
+        d.x_max = d.x_max * factor + factor - 1;
+        d.y_max = d.y_max * factor + factor - 1;
+        detections.push_back(d);
+    }
+}
+
+void Detector::refine(const uint8_t* gray, Detection& d) {
+    /*
+        detectLocations at full resolution on the region of the detection,
+        with a margin of a block on each side and the run_length pixels that
+        the last points look at. The box and the mass center are those of
+        all the points found; without any (an insect too faint at full
+        resolution), the detection of the level is kept.
+    */
+    int margin = params.run_length + factor;
+    int x0 = max(0, d.x_min - margin), y0 = max(0, d.y_min - margin);
+    int x1 = min(width, d.x_max + margin + params.run_length + 1);
+    int y1 = min(height, d.y_max + margin + params.run_length + 1);
+    points.clear();
+    find_locations(gray, background.data(), width, x0, y0, x1 - x0, y1 - y0, params.run_length, params.min_count);
+    if (points.empty()) {
+        return;
+    }
+    double sum_x = 0, sum_y = 0;
+    d.x_min = d.y_min = INT32_MAX;
+    d.x_max = d.y_max = -1;
+    for (const Point& p : points) {
+        sum_x += p.x;
+        sum_y += p.y;
+        d.x_min = min(d.x_min, p.x);
+        d.y_min = min(d.y_min, p.y);
+        d.x_max = max(d.x_max, p.x);
+        d.y_max = max(d.y_max, p.y);
+    }
+    d.center_x = sum_x / points.size();
+    d.center_y = sum_y / points.size();
+}
+
+void Detector::set_crop(Detection& d) {
+    /*
+        cropImageCenter of detection.m with 0-based coordinates: a square of
+        2 * box around the mass center, cut at the borders of the frame.
+    */
+    if (d.x_max - d.x_min > params.box && d.y_max - d.y_min > params.box) {
+        d.x = d.x_min;
+        d.y = d.y_min;
+        d.width = d.x_max - d.x_min + 1;
+        d.height = d.y_max - d.y_min + 1;
+        return;
+    }
+    int x0 = max(0, (int)lroundf(d.center_x - params.box));
+    int y0 = max(0, (int)lroundf(d.center_y - params.box));
+    int x1 = min(width - 1, (int)lroundf(d.center_x + params.box - 1));
+    int y1 = min(height - 1, (int)lroundf(d.center_y + params.box - 1));
+    d.x = x0;
+    d.y = y0;
+    d.width = x1 - x0 + 1;
+    d.height = y1 - y0 + 1;
+}
+
+int Detector::detect(const uint8_t* gray, vector<Detection>& detections) {
+    detections.clear();
+    auto start = steady_clock::now();
+    const uint8_t* level_gray = gray;
+    const uint8_t* level_background = background.data();
+    if (params.level > 0) {
+        downscale_box(gray, width, height, factor, gray_level.data());
+        level_gray = gray_level.data();
+        level_background = background_level.data();
+    }
+    auto downscaled = steady_clock::now();
+
+    // The run is shortened with the level, at least one pixel
+    int run_length = max(1, (int)lroundf((float)params.run_length / factor));
+    points.clear();
+    find_locations(level_gray, level_background, level_w, 0, 0, level_w, level_h, run_length, params.min_count / factor);
+    auto located = steady_clock::now();
+
+    cluster(detections);
+    auto clustered = steady_clock::now();
+
+    for (Detection& d : detections) {
+        if (params.refine && params.level > 0) {
+            refine(gray, d);
+        }
+        set_crop(d);
+    }
+    auto refined = steady_clock::now();
+
+    last_times.downscale = duration<double, milli>(downscaled - start).count();
+    last_times.locations = duration<double, milli>(located - downscaled).count();
+    last_times.clustering = duration<double, milli>(clustered - located).count();
+    last_times.refine = duration<double, milli>(refined - clustered).count();
+    return detections.size();
+}
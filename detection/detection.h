@@ -0,0 +1,110 @@
+#ifndef DETECTION_H
+#define DETECTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/*
+    C++ version of detection.m: background subtraction, detectLocations, the
+    clustering of the locations and the crops around the insects.
+
+    A pixel belongs to an insect when it is darker than the background by at
+    least contrast (Ad - Bd + 100 <= 50 in detection.m). A location is an
+    insect pixel followed by more than min_count insect pixels among the
+    run_length next ones on its line, and also on its column. The locations
+    closer than point_distance are clustered, then the clusters with mass
+    centers closer than cluster_distance are grouped. A group larger than box
+    in both directions is cropped on its points, a smaller one on a square of
+    2 * box (the 224 px of the classifier) around its mass center.
+
+    The insects are large compared to a pixel, so the detection can run on a
+    level of a pyramid of the frame: level 1 is downscaled 2x, level 2 4x,
+    each pixel being the mean of a block of the frame (box filter). The
+    lengths and distances are divided by the factor, and the detections are
+    mapped back to the full resolution, where the crops are taken. With
+    refine, the points of each detection are searched again at full
+    resolution, only in its region (plus a margin), for a tighter box.
+*/
+
+typedef struct {
+    int contrast;               // Insect pixels are darker than the background by at least this
+    int run_length;             // num of detectLocations
+    int min_count;              // countmax of detectLocations
+    float point_distance;       // dist: clustering of the locations
+    float cluster_distance;     // clusVar: grouping of the clusters
+    int box;                    // Half size of the crops
+    int level;                  // 0 full resolution, 1 downscaled 2x, 2 downscaled 4x... up to 4
+    bool refine;                // Search the points again at full resolution in each region
+} DetectionParams;
+
+// The values of detection.m, at full resolution
+DetectionParams default_detection_params();
+
+typedef struct {
+    int x, y, width, height;    // Crop in the frame
+    int x_min, y_min, x_max, y_max; // Points of the insect, in the frame
+    float center_x, center_y;   // Mass center
+    int n_points;               // Locations, at the level they were found
+} Detection;
+
+// Timings of the last frame in ms
+typedef struct {
+    double downscale;
+    double locations;
+    double clustering;
+    double refine;
+} DetectionTimes;
+
+/*
+    Detection on the gray frames of one camera. The buffers of the levels
+    are kept from one frame to the next; the background is downscaled once.
+*/
+class Detector {
+public:
+    Detector(int width, int height, const DetectionParams& params);
+
+    // Gray background of width * height bytes, copied
+    void set_background(const uint8_t* background);
+
+    // Detections of a gray frame of width * height bytes, return their number
+    int detect(const uint8_t* gray, std::vector<Detection>& detections);
+
+    const DetectionTimes& times() const { return last_times; }
+    int level_width() const { return level_w; }
+    int level_height() const { return level_h; }
+
+private:
+    typedef struct {
+        int x, y;
+    } Point;
+    typedef struct {
+        double center_x, center_y;
+        int n;
+        int x_min, y_min, x_max, y_max;
+    } Cluster;
+
+    void find_locations(const uint8_t* gray, const uint8_t* background, int stride, int x0, int y0, int width,
+                        int height, int run_length, int min_count);
+    void cluster(std::vector<Detection>& detections);
+    void refine(const uint8_t* gray, Detection& detection);
+    void set_crop(Detection& detection);
+
+    DetectionParams params;
+    int width, height, factor, level_w, level_h;
+    std::vector<uint8_t> background, background_level, gray_level;
+    // Work buffers, kept from one frame to the next
+    std::vector<uint8_t> mask;
+    std::vector<uint16_t> column_counts;
+    std::vector<Point> points;
+    std::vector<Cluster> clusters;
+    std::vector<int> labels, row_first;
+    std::vector<bool> used;
+    DetectionTimes last_times;
+};
+
+// Mean of the factor x factor blocks of src (factor 2, 4, 8 or 16), dst is width / factor x height / factor
+void downscale_box(const uint8_t* src, int width, int height, int factor, uint8_t* dst);
+
+#endif // DETECTION_H
@@ -0,0 +1,311 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "detection.h"
+
+using namespace std;
+
+// g++ -O2 -std=c++17 -o detection_bench detection_bench.cpp detection.cpp
+
+#define N_SIZES 4
+static const char* size_names[N_SIZES] = {"tiny", "small", "medium", "large"};
+static const int size_radius[N_SIZES][2] = {{2, 4}, {5, 12}, {13, 40}, {41, 90}};
+
+typedef struct {
+    float x, y;                 // Center of the body
+    int x_min, y_min, x_max, y_max; // Box of the body, without the legs
+    int size;
+} Insect;
+
+static void make_background(int width, int height, mt19937& rng, vector<uint8_t>& paper) {
+    // Sticky trap: a light gradient with a fixed texture
+    paper.resize((size_t)width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            paper[(size_t)y * width + x] = 180 + 40 * x / width + 10 * y / height + rng() % 9;
+        }
+    }
+}
+
+static void capture(const vector<uint8_t>& paper, const vector<Insect>& insects, mt19937& rng, vector<uint8_t>& frame,
+                    int width, int height) {
+    /*
+        The paper with the sensor noise, and the insects: a dark ellipse for
+        the body and 6 legs of 1 px, lighter than the body.
+    */
+    frame.resize(paper.size());
+    for (size_t i = 0; i < paper.size(); i++) {
+        frame[i] = (uint8_t)max(0, min(255, paper[i] + (int)(rng() % 13) - 6));
+    }
+    for (const Insect& insect : insects) {
+        float rx = (insect.x_max - insect.x_min) / 2.0f, ry = (insect.y_max - insect.y_min) / 2.0f;
+        for (int y = insect.y_min; y <= insect.y_max; y++) {
+            for (int x = insect.x_min; x <= insect.x_max; x++) {
+                float dx = (x - insect.x) / rx, dy = (y - insect.y) / ry;
+                if (dx * dx + dy * dy <= 1) {
+                    frame[(size_t)y * width + x] = 40 + rng() % 30;
+                }
+            }
+        }
+        for (int leg = 0; leg < 6; leg++) {
+            float angle = (leg % 3 - 1) * 0.6f + (leg < 3 ? 0 : 3.14159f);
+            float length = 1.5f * max(rx, ry);
+            for (float t = 0.8f * max(rx, ry); t < length; t += 0.5f) {
+                int x = (int)(insect.x + t * cosf(angle)), y = (int)(insect.y + t * sinf(angle));
+                if (x >= 0 && x < width && y >= 0 && y < height) {
+                    frame[(size_t)y * width + x] = 110;
+                }
+            }
+        }
+    }
+}
+
+static vector<Insect> place_insects(int width, int height, int n_insects, mt19937& rng) {
+    // Sizes in turn, at random places away from the borders and from each other
+    vector<Insect> insects;
+    int attempts = 0;
+    while ((int)insects.size() < n_insects && attempts++ < 100000) {
+        Insect insect;
+        insect.size = insects.size() % N_SIZES;
+        int r = size_radius[insect.size][0] + rng() % (size_radius[insect.size][1] - size_radius[insect.size][0] + 1);
+        int rx = r, ry = max(2, r * 2 / 3);
+        int margin = 2 * r + 20;
+        if (width <= 2 * margin || height <= 2 * margin) {
+            continue;
+        }
+        insect.x = margin + rng() % (width - 2 * margin);
+        insect.y = margin + rng() % (height - 2 * margin);
+        insect.x_min = insect.x - rx;
+        insect.x_max = insect.x + rx;
+        insect.y_min = insect.y - ry;
+        insect.y_max = insect.y + ry;
+        bool apart = true;
+        for (const Insect& other : insects) {
+            float gap = 3 * (rx + other.x_max - other.x_min) + 60;
+            apart &= fabs(other.x - insect.x) > gap / 2 || fabs(other.y - insect.y) > gap / 2;
+        }
+        if (apart) {
+            insects.push_back(insect);
+        }
+    }
+    return insects;
+}
+
+static void reference_detection(const uint8_t* gray, const uint8_t* background, int width, int height,
+                                const DetectionParams& p, vector<Detection>& detections) {
+    /*
+        Line by line transcription of detection.m (0-based), comparing every
+        pair of points, used to check the Detector at full resolution.
+    */
+    vector<pair<int, int>> locations;
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            auto bin = [&](int y, int x) { return background[y * width + x] - gray[y * width + x] >= p.contrast; };
+            if (bin(i, j) && j + p.run_length < width && i + p.run_length < height) {
+                int count_h = 0, count_v = 0;
+                for (int k = 1; k <= p.run_length; k++) {
+                    count_h += bin(i, j + k);
+                    count_v += bin(i + k, j);
+                }
+                if (count_h > p.min_count && count_v > p.min_count) {
+                    locations.push_back({j, i});
+                }
+            }
+        }
+    }
+    int k = locations.size();
+    vector<int> idx(k);
+    vector<bool> used(k, false);
+    for (int i = 0; i < k; i++) {
+        idx[i] = i;
+    }
+    for (int i = 0; i < k; i++) {
+        for (int j = 0; j < k; j++) {
+            if (i != j && abs(locations[j].first - locations[i].first) < p.point_distance &&
+                abs(locations[j].second - locations[i].second) < p.point_distance && !used[idx[j]]) {
+                idx[j] = idx[i];
+                used[idx[i]] = true;
+            }
+        }
+    }
+    vector<int> unique_clusters(idx);
+    sort(unique_clusters.begin(), unique_clusters.end());
+    unique_clusters.erase(unique(unique_clusters.begin(), unique_clusters.end()), unique_clusters.end());
+    int n = unique_clusters.size();
+    vector<double> xm(n, 0), ym(n, 0);
+    for (int c = 0; c < n; c++) {
+        int count = 0;
+        for (int i = 0; i < k; i++) {
+            if (idx[i] == unique_clusters[c]) {
+                xm[c] += locations[i].first;
+                ym[c] += locations[i].second;
+                count++;
+            }
+        }
+        xm[c] /= count;
+        ym[c] /= count;
+    }
+    vector<bool> used_indices(n, false);
+    for (int i = 0; i < n; i++) {
+        if (used_indices[i]) {
+            continue;
+        }
+        vector<int> close = {i};
+        for (int j = i + 1; j < n; j++) {
+            if (fabs(xm[j] - xm[i]) < p.cluster_distance && fabs(ym[j] - ym[i]) < p.cluster_distance) {
+                close.push_back(j);
+                used_indices[j] = true;
+            }
+        }
+        Detection d;
+        double sum_x = 0, sum_y = 0;
+        for (int c : close) {
+            sum_x += xm[c];
+            sum_y += ym[c];
+        }
+        d.center_x = sum_x / close.size();
+        d.center_y = sum_y / close.size();
+        d.x_min = d.y_min = INT32_MAX;
+        d.x_max = d.y_max = -1;
+        d.n_points = 0;
+        for (int l = 0; l < k; l++) {
+            bool member = false;
+            for (int c : close) {
+                member |= idx[l] == unique_clusters[c];
+            }
+            if (member) {
+                d.x_min = min(d.x_min, locations[l].first);
+                d.x_max = max(d.x_max, locations[l].first);
+                d.y_min = min(d.y_min, locations[l].second);
+                d.y_max = max(d.y_max, locations[l].second);
+                d.n_points++;
+            }
+        }
+        detections.push_back(d);
+    }
+}
+
+static bool on_body(const Detection& d, const Insect& insect) {
+    return d.center_x >= insect.x_min && d.center_x <= insect.x_max && d.center_y >= insect.y_min && d.center_y <= insect.y_max;
+}
+
+int main(int argc, char** argv) {
+    /*
+        Detection on synthetic trap frames (1920x1080 by default, like the
+        captures of binary_to_images) at each level of the pyramid, with and
+        without refine: time per frame, recall of each size of insect (an
+        insect is found when the mass center of a detection is on its body),
+        detections on no insect, and detections per insect found (the
+        clustering of detection.m can split a large insect in several). The
+        Detector is first checked against the transcription of detection.m.
+    */
+    int width = argc > 1 ? atoi(argv[1]) : 1920;
+    int height = argc > 2 ? atoi(argv[2]) : 1080;
+    int n_frames = argc > 3 ? atoi(argv[3]) : 10;
+    int n_insects = argc > 4 ? atoi(argv[4]) : 16;
+    int max_level = argc > 5 ? atoi(argv[5]) : 2;
+    if (width < 64 || height < 64 || n_frames < 1 || n_insects < 1 || max_level < 0 || max_level > 4) {
+        printf("Usage: %s [width] [height] [n_frames] [n_insects] [max level <= 4]\n", argv[0]);
+        return 1;
+    }
+
+    mt19937 rng(1);
+    vector<uint8_t> paper, background, frame;
+
+    // Same detections as detection.m at full resolution, on a small frame
+    {
+        int w = 640, h = 480;
+        make_background(w, h, rng, paper);
+        vector<Insect> insects = place_insects(w, h, N_SIZES, rng);
+        capture(paper, {}, rng, background, w, h);
+        capture(paper, insects, rng, frame, w, h);
+        DetectionParams params = default_detection_params();
+        vector<Detection> reference, detections;
+        reference_detection(frame.data(), background.data(), w, h, params, reference);
+        Detector detector(w, h, params);
+        detector.set_background(background.data());
+        detector.detect(frame.data(), detections);
+        bool same = reference.size() == detections.size();
+        for (size_t i = 0; same && i < reference.size(); i++) {
+            const Detection& a = reference[i];
+            const Detection& b = detections[i];
+            same = a.x_min == b.x_min && a.y_min == b.y_min && a.x_max == b.x_max && a.y_max == b.y_max &&
+                   a.n_points == b.n_points && fabs(a.center_x - b.center_x) < 1e-3 && fabs(a.center_y - b.center_y) < 1e-3;
+        }
+        if (!same) {
+            printf("[ERROR] Not the detections of detection.m (%zu instead of %zu)\n", detections.size(), reference.size());
+            return 1;
+        }
+        printf("[INFO] Same %zu detections as detection.m on %dx%d\n", reference.size(), w, h);
+    }
+
+    make_background(width, height, rng, paper);
+    capture(paper, {}, rng, background, width, height);
+    vector<vector<Insect>> insects(n_frames);
+    vector<vector<uint8_t>> frames(n_frames);
+    for (int f = 0; f < n_frames; f++) {
+        insects[f] = place_insects(width, height, n_insects, rng);
+        capture(paper, insects[f], rng, frames[f], width, height);
+    }
+
+    printf("%dx%d, %d frames, %d insects each\n", width, height, n_frames, n_insects);
+    printf("%-5s %-6s %9s %9s %9s %9s %9s", "Level", "Refine", "Down ms", "Locate ms", "Group ms", "Refine ms", "Total ms");
+    for (int s = 0; s < N_SIZES; s++) {
+        printf(" %7s", size_names[s]);
+    }
+    printf(" %7s %8s\n", "Empty", "Per hit");
+    for (int level = 0; level <= max_level; level++) {
+        for (int refine = 0; refine <= (level > 0); refine++) {
+            DetectionParams params = default_detection_params();
+            params.level = level;
+            params.refine = refine;
+            Detector detector(width, height, params);
+            detector.set_background(background.data());
+            vector<Detection> detections;
+            DetectionTimes total = {0, 0, 0, 0};
+            int found[N_SIZES] = {0}, n_size[N_SIZES] = {0};
+            int empty = 0, on_insects = 0;
+            for (int f = 0; f < n_frames; f++) {
+                detector.detect(frames[f].data(), detections);
+                total.downscale += detector.times().downscale;
+                total.locations += detector.times().locations;
+                total.clustering += detector.times().clustering;
+                total.refine += detector.times().refine;
+                for (const Insect& insect : insects[f]) {
+                    n_size[insect.size]++;
+                    for (const Detection& d : detections) {
+                        if (on_body(d, insect)) {
+                            found[insect.size]++;
+                            break;
+                        }
+                    }
+                }
+                for (const Detection& d : detections) {
+                    bool hit = false;
+                    for (const Insect& insect : insects[f]) {
+                        hit |= on_body(d, insect);
+                    }
+                    empty += !hit;
+                    on_insects += hit;
+                }
+            }
+            double sum = total.downscale + total.locations + total.clustering + total.refine;
+            printf("%-5d %-6s %9.2f %9.2f %9.2f %9.2f %9.2f", level, refine ? "yes" : "no", total.downscale / n_frames,
+                   total.locations / n_frames, total.clustering / n_frames, total.refine / n_frames, sum / n_frames);
+            for (int s = 0; s < N_SIZES; s++) {
+                printf(" %6.1f%%", n_size[s] ? 100.0 * found[s] / n_size[s] : 0.0);
+            }
+            int n_found = 0;
+            for (int s = 0; s < N_SIZES; s++) {
+                n_found += found[s];
+            }
+            printf(" %7d %8.2f\n", empty, n_found ? (double)on_insects / n_found : 0.0);
+        }
+    }
+    return 0;
+}
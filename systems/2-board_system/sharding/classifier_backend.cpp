@@ -0,0 +1,117 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#ifdef USE_VART
+#include <opencv2/opencv.hpp>
+#include "common.h"
+#endif
+
+#include "classifier_backend.h"
+
+using namespace std;
+
+int emulated_class(const uint8_t* rgb, size_t size) {
+    // FNV-1a on one byte every 61, enough to tell the crops apart
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i += 61) {
+        hash = (hash ^ rgb[i]) * 16777619u;
+    }
+    return hash % N_CLASSES;
+}
+
+class EmulatedBackend : public ClassifierBackend {
+public:
+    explicit EmulatedBackend(double ms) : ms(ms) {}
+
+    int classify(const uint8_t* rgb, int width, int height, float* score) override {
+        this_thread::sleep_for(chrono::duration<double, milli>(ms));
+        *score = 1.0f;
+        return emulated_class(rgb, (size_t)width * height * 3);
+    }
+
+private:
+    double ms;
+};
+
+#ifdef USE_VART
+class DpuBackend : public ClassifierBackend {
+public:
+    explicit DpuBackend(const string& xmodel_file) {
+        graph = xir::Graph::deserialize(xmodel_file);
+        auto subgraph = get_dpu_subgraph(graph.get());
+        CHECK_EQ(subgraph.size(), 1u) << "Subgraph should have one and only one dpu subgraph.";
+        runner = vart::Runner::create_runner(subgraph[0], "run");
+        input_tensor = runner->get_input_tensors()[0];
+        output_tensor = runner->get_output_tensors()[0];
+        input_scale = get_input_scale(input_tensor);
+        output_scale = get_output_scale(output_tensor);
+        in_height = input_tensor->get_shape()[1];
+        in_width = input_tensor->get_shape()[2];
+        input.resize(input_tensor->get_element_num());
+        output.resize(output_tensor->get_element_num());
+    }
+
+    int classify(const uint8_t* rgb, int width, int height, float* score) override {
+        // Same preprocessing as the Petalinux C++ driver. The crops of the protocol are already RGB,
+        // the order of the model: no BGR2RGB as for the images decoded by OpenCV.
+        cv::Mat image(height, width, CV_8UC3, (void*)rgb), processed;
+        if (width != in_width || height != in_height) {
+            cv::resize(image, processed, cv::Size(in_width, in_height));
+        } else {
+            processed = image;
+        }
+        processed.convertTo(processed, CV_32FC3);
+        processed = processed / 255.0f;
+        cv::subtract(processed, cv::Scalar(0.485f, 0.456f, 0.406f), processed);
+        cv::divide(processed, cv::Scalar(0.229f, 0.224f, 0.225f), processed);
+        processed.convertTo(processed, CV_8SC3, input_scale);
+        memcpy(input.data(), processed.data, input.size());
+
+        CpuFlatTensorBuffer input_buffer(input.data(), input_tensor);
+        CpuFlatTensorBuffer output_buffer(output.data(), output_tensor);
+        vector<vart::TensorBuffer*> inputs = {&input_buffer}, outputs = {&output_buffer};
+        auto job_id = runner->execute_async(inputs, outputs);
+        runner->wait(job_id.first, -1);
+
+        // Softmax of the N_CLASSES outputs
+        vector<float> probs(N_CLASSES);
+        for (int i = 0; i < N_CLASSES; i++) {
+            probs[i] = expf(output[i] * output_scale);
+        }
+        float sum = accumulate(probs.begin(), probs.end(), 0.0f);
+        int best = max_element(probs.begin(), probs.end()) - probs.begin();
+        *score = probs[best] / sum;
+        return best;
+    }
+
+private:
+    unique_ptr<xir::Graph> graph;
+    unique_ptr<vart::Runner> runner;
+    const xir::Tensor* input_tensor;
+    const xir::Tensor* output_tensor;
+    float input_scale, output_scale;
+    int in_width, in_height;
+    vector<int8_t> input, output;
+};
+#endif
+
+unique_ptr<ClassifierBackend> create_backend(const string& spec) {
+    string name = spec.substr(0, spec.find(':'));
+    string arg = spec.find(':') == string::npos ? "" : spec.substr(spec.find(':') + 1);
+    if (name == "emulated") {
+        return make_unique<EmulatedBackend>(arg.empty() ? 10.0 : atof(arg.c_str()));
+    }
+#ifdef USE_VART
+    if (name == "dpu") {
+        return make_unique<DpuBackend>(arg);
+    }
+#endif
+    return NULL;
+}
@@ -0,0 +1,32 @@
+#ifndef CLASSIFIER_BACKEND_H
+#define CLASSIFIER_BACKEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#define N_CLASSES 12
+
+/*
+    What a worker runs on each crop. Backends:
+    - "emulated:<ms>": sleeps ms milliseconds per crop (the time of the DPU on
+      the board) and returns emulated_class(), to test the cluster on one host
+    - "dpu:<xmodel>": the model on the DPU with VART (build with -DUSE_VART)
+*/
+class ClassifierBackend {
+public:
+    virtual ~ClassifierBackend() {}
+    // Class of an RGB crop, with its probability in score
+    virtual int classify(const uint8_t* rgb, int width, int height, float* score) = 0;
+};
+
+// NULL if the backend is unknown or not built in
+std::unique_ptr<ClassifierBackend> create_backend(const std::string& spec);
+
+// Class returned by the emulated backend: a hash of the pixels, so that the
+// coordinator can check that each result comes back with the right crop
+int emulated_class(const uint8_t* rgb, size_t size);
+
+#endif // CLASSIFIER_BACKEND_H
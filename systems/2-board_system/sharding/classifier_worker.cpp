@@ -0,0 +1,114 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "classifier_backend.h"
+#include "cluster_protocol.h"
+
+using namespace std;
+
+// g++ -O2 -std=c++17 -o classifier_worker classifier_worker.cpp classifier_backend.cpp cluster_protocol.cpp -lpthread
+// DPU backend: add -DUSE_VART and the includes and libraries of build.sh in boards/ultra96v2_petalinux_dpu/software_cpp/CPP
+
+#define DEFAULT_CREDITS 4
+
+int main(int argc, char** argv) {
+    /*
+        Classifier worker: connects to the coordinator, announces how many
+        crops it accepts at once (credits), then classifies the crops it
+        receives and sends back the results. One thread receives the crops
+        while the other one classifies, so the next crop is already there when
+        the backend is done with the current one.
+        With max_crops, the worker leaves after this many crops (to test the
+        coordinator).
+    */
+    if (argc < 4) {
+        printf("Usage: %s <coordinator_host> <port> <backend> [credits] [name] [max_crops]\n", argv[0]);
+        printf("Backends: emulated:<ms per crop>, dpu:<xmodel> (with -DUSE_VART)\n");
+        return 1;
+    }
+    string host = argv[1];
+    int port = atoi(argv[2]);
+    int credits = argc > 4 ? atoi(argv[4]) : DEFAULT_CREDITS;
+    string name = argc > 5 ? argv[5] : "worker-" + to_string(getpid());
+    long max_crops = argc > 6 ? atol(argv[6]) : -1;
+
+    unique_ptr<ClassifierBackend> backend = create_backend(argv[3]);
+    if (!backend) {
+        fprintf(stderr, "[ERROR] Unknown backend %s\n", argv[3]);
+        return 1;
+    }
+    int fd = connect_to(host, port);
+    if (fd < 0) {
+        fprintf(stderr, "[ERROR] Failed to connect to %s:%d\n", host.c_str(), port);
+        return 1;
+    }
+    if (!send_message(fd, MSG_HELLO, 0, credits, name.data(), name.size())) {
+        fprintf(stderr, "[ERROR] Connection lost\n");
+        return 1;
+    }
+    printf("[INFO] %s connected to %s:%d with %d credits\n", name.c_str(), host.c_str(), port, credits);
+
+    // The coordinator sends at most credits crops ahead, so the queue stays small
+    deque<Message> crops;
+    bool done = false;
+    mutex crops_mutex;
+    condition_variable crop_ready;
+
+    thread receiver([&] {
+        Message message;
+        while (recv_message(fd, message) && message.header.type == MSG_CROP) {
+            lock_guard<mutex> lock(crops_mutex);
+            crops.push_back(move(message));
+            crop_ready.notify_one();
+        }
+        lock_guard<mutex> lock(crops_mutex);
+        done = true;
+        crop_ready.notify_one();
+    });
+
+    long n_crops = 0;
+    for (;;) {
+        Message crop;
+        {
+            unique_lock<mutex> lock(crops_mutex);
+            crop_ready.wait(lock, [&] { return done || !crops.empty(); });
+            if (crops.empty()) {
+                break;
+            }
+            crop = move(crops.front());
+            crops.pop_front();
+        }
+        int width = crop.header.arg >> 16;
+        int height = crop.header.arg & 0xFFFF;
+        if ((size_t)width * height * 3 != crop.payload.size()) {
+            fprintf(stderr, "[ERROR] Crop %" PRIu64 " has a wrong size\n", crop.header.id);
+            break;
+        }
+        float score;
+        int label = backend->classify(crop.payload.data(), width, height, &score);
+        if (!send_message(fd, MSG_RESULT, crop.header.id, label, &score, sizeof(score))) {
+            break;
+        }
+        n_crops++;
+        if (n_crops == max_crops) {
+            printf("[INFO] %s leaves after %ld crops\n", name.c_str(), n_crops);
+            break;
+        }
+    }
+
+    // Unblocks the receiver if it is still waiting for crops
+    shutdown(fd, SHUT_RDWR);
+    receiver.join();
+    close(fd);
+    printf("[SUCCESS] %s classified %ld crops\n", name.c_str(), n_crops);
+    return 0;
+}
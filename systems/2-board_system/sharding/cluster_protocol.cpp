@@ -0,0 +1,165 @@
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "cluster_protocol.h"
+
+using namespace std;
+
+static bool send_all(int fd, const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool recv_all(int fd, void* data, size_t size) {
+    uint8_t* p = (uint8_t*)data;
+    while (size > 0) {
+        ssize_t n = recv(fd, p, size, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool send_message(int fd, uint32_t type, uint64_t id, uint32_t arg, const void* payload, size_t size) {
+    MessageHeader header = {CLUSTER_MAGIC, type, id, arg, (uint32_t)size};
+    return send_all(fd, &header, sizeof(header)) && (size == 0 || send_all(fd, payload, size));
+}
+
+bool recv_message(int fd, Message& message) {
+    if (!recv_all(fd, &message.header, sizeof(MessageHeader))) {
+        return false;
+    }
+    if (message.header.magic != CLUSTER_MAGIC || message.header.size > MAX_MESSAGE_SIZE) {
+        return false;
+    }
+    message.payload.resize(message.header.size);
+    return message.header.size == 0 || recv_all(fd, message.payload.data(), message.header.size);
+}
+
+void MessageReader::feed(const uint8_t* data, size_t size) {
+    if (start > 0 && start >= buffer.size() / 2) {
+        buffer.erase(buffer.begin(), buffer.begin() + start);
+        start = 0;
+    }
+    buffer.insert(buffer.end(), data, data + size);
+}
+
+bool MessageReader::next(Message& message) {
+    size_t available = buffer.size() - start;
+    if (bad || available < sizeof(MessageHeader)) {
+        return false;
+    }
+    memcpy(&message.header, buffer.data() + start, sizeof(MessageHeader));
+    if (message.header.magic != CLUSTER_MAGIC || message.header.size > MAX_MESSAGE_SIZE) {
+        // TCP does not lose bytes, so this is not a worker: give up on the connection
+        bad = true;
+        return false;
+    }
+    if (available < sizeof(MessageHeader) + message.header.size) {
+        return false;
+    }
+    const uint8_t* payload = buffer.data() + start + sizeof(MessageHeader);
+    message.payload.assign(payload, payload + message.header.size);
+    start += sizeof(MessageHeader) + message.header.size;
+    return true;
+}
+
+void MessageWriter::push(uint32_t type, uint64_t id, uint32_t arg, const void* payload, size_t size) {
+    if (start > 0 && start >= buffer.size() / 2) {
+        buffer.erase(buffer.begin(), buffer.begin() + start);
+        start = 0;
+    }
+    MessageHeader header = {CLUSTER_MAGIC, type, id, arg, (uint32_t)size};
+    const uint8_t* h = (const uint8_t*)&header;
+    buffer.insert(buffer.end(), h, h + sizeof(header));
+    if (size > 0) {
+        buffer.insert(buffer.end(), (const uint8_t*)payload, (const uint8_t*)payload + size);
+    }
+}
+
+bool MessageWriter::flush(int fd) {
+    while (start < buffer.size()) {
+        ssize_t n = send(fd, buffer.data() + start, buffer.size() - start, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // The socket is full, the rest goes when poll reports POLLOUT
+            return true;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        start += n;
+    }
+    buffer.clear();
+    start = 0;
+    return true;
+}
+
+int connect_to(const string& host, int port) {
+    struct addrinfo hints = {}, *addresses;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &addresses) != 0) {
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo* a = addresses; a != NULL; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+            break;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        fd = -1;
+    }
+    freeaddrinfo(addresses);
+    if (fd >= 0) {
+        // Results are small messages, send them right away
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+int listen_on(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
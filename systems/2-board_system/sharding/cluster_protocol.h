@@ -0,0 +1,91 @@
+#ifndef CLUSTER_PROTOCOL_H
+#define CLUSTER_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/*
+    Messages between the coordinator and the classifier workers, over TCP.
+    Every message is a MessageHeader followed by size bytes of payload.
+    All the boards are little endian, the headers are sent as they are in memory.
+
+    worker -> coordinator   MSG_HELLO   arg = credits (crops the worker accepts at once), payload = name
+    coordinator -> worker   MSG_CROP    id, arg = width << 16 | height, payload = RGB image
+    worker -> coordinator   MSG_RESULT  id, arg = class, payload = float score
+    coordinator -> worker   MSG_BYE     no more crops, the worker can leave
+
+    Flow control: the coordinator never has more than credits crops in flight
+    on a worker, and each result gives one credit back.
+*/
+
+#define CLUSTER_MAGIC       0x534C4354u     // "TCLS"
+#define CLUSTER_PORT        5600
+
+#define MSG_HELLO           1
+#define MSG_CROP            2
+#define MSG_RESULT          3
+#define MSG_BYE             4
+
+#define MAX_MESSAGE_SIZE    (16 << 20)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t type;
+    uint64_t id;
+    uint32_t arg;
+    uint32_t size;
+} MessageHeader;
+
+typedef struct {
+    MessageHeader header;
+    std::vector<uint8_t> payload;
+} Message;
+
+// Send a whole message on a blocking socket. Returns false if the connection is lost.
+bool send_message(int fd, uint32_t type, uint64_t id, uint32_t arg, const void* payload, size_t size);
+
+// Read a whole message from a blocking socket. Returns false if the connection is lost or invalid.
+bool recv_message(int fd, Message& message);
+
+/*
+    Incremental reader for non-blocking sockets: feed() appends the bytes
+    received, next() extracts the complete messages one by one.
+*/
+class MessageReader {
+public:
+    void feed(const uint8_t* data, size_t size);
+    bool next(Message& message);
+    bool invalid() const { return bad; }
+
+private:
+    std::vector<uint8_t> buffer;
+    size_t start = 0;
+    bool bad = false;
+};
+
+/*
+    Outgoing messages for non-blocking sockets: push() queues a message,
+    flush() sends what the socket takes without waiting.
+*/
+class MessageWriter {
+public:
+    void push(uint32_t type, uint64_t id, uint32_t arg, const void* payload, size_t size);
+    // Returns false if the connection is lost
+    bool flush(int fd);
+    bool empty() const { return start == buffer.size(); }
+
+private:
+    std::vector<uint8_t> buffer;
+    size_t start = 0;
+};
+
+// Connect to host:port, returns the socket or -1
+int connect_to(const std::string& host, int port);
+
+// Listening socket on all interfaces, returns the socket or -1
+int listen_on(int port);
+
+#endif // CLUSTER_PROTOCOL_H
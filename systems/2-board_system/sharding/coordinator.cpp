@@ -0,0 +1,402 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "classifier_backend.h"
+#include "cluster_protocol.h"
+#include "frame_ring.h"
+
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -I../../frame_ring -o coordinator coordinator.cpp classifier_backend.cpp cluster_protocol.cpp ../../frame_ring/frame_ring.cpp -lpthread
+
+#define STATS_PERIOD    2.0     // Seconds between two prints of the worker throughputs
+#define RATE_SMOOTHING  0.2     // Weight of the last crop in the throughput of a worker
+#define RING_OPEN_MS    30000   // For the receiver to create the frame ring of the crops
+#define RING_POLL_MS    1000    // Between the checks that the receiver is alive
+#define HELLO_TIMEOUT_MS 5000   // For a new connection to introduce itself
+
+typedef struct {
+    int width;
+    int height;
+    vector<uint8_t> image;
+} Crop;
+
+typedef struct {
+    int fd;
+    string name;
+    uint32_t credits;
+    set<uint64_t> in_flight;    // Crops sent, result not received yet
+    MessageReader reader;
+    MessageWriter writer;       // Crops not taken by the socket yet
+    bool send_failed;
+    uint64_t n_results;
+    double rate;                // Crops per second, smoothed
+    steady_clock::time_point joined, last_result;
+} Worker;
+
+// Connection accepted, waiting for its HELLO
+typedef struct {
+    int fd;
+    MessageReader reader;
+    steady_clock::time_point accepted;
+} Connection;
+
+typedef struct {
+    int label;
+    float score;
+    string worker;
+} Result;
+
+/*
+    Source of the crops: a capture file of width x height RGB images, a
+    shared-memory frame ring filled by the receiver of the detection board, or
+    synthetic images.
+*/
+class CropSource {
+public:
+    CropSource(const string& spec, int width, int height) : width(width), height(height) {
+        if (spec.rfind("synthetic:", 0) == 0) {
+            n_synthetic = atol(spec.c_str() + 10);
+        } else if (spec.rfind("shm:", 0) == 0) {
+            ring = frame_ring_open_wait(("/" + spec.substr(4)).c_str(), RING_OPEN_MS);
+        } else {
+            file = fopen(spec.c_str(), "rb");
+        }
+    }
+
+    ~CropSource() {
+        if (file != NULL) {
+            fclose(file);
+        }
+        frame_ring_destroy(ring);
+    }
+
+    bool valid() const { return n_synthetic >= 0 || file != NULL || ring != NULL; }
+
+    // Next crop, false at the end
+    bool next(Crop& crop) {
+        crop.width = width;
+        crop.height = height;
+        crop.image.resize(width * height * 3);
+        if (n_synthetic >= 0) {
+            if (n_read >= n_synthetic) {
+                return false;
+            }
+            mt19937 rng(n_read);
+            for (auto& v : crop.image) {
+                v = rng();
+            }
+        } else if (file != NULL) {
+            if (fread(crop.image.data(), 1, crop.image.size(), file) != crop.image.size()) {
+                return false;
+            }
+        } else {
+            FrameRingInfo info;
+            uint8_t* slot;
+            while ((slot = frame_ring_read_slot(ring, &info, RING_POLL_MS)) == NULL) {
+                if (frame_ring_closed(ring) || frame_ring_peer_alive(ring) == 0) {
+                    // The frames committed before the end are still read
+                    if ((slot = frame_ring_read_slot(ring, &info, 0)) == NULL) {
+                        return false;
+                    }
+                    break;
+                }
+            }
+            crop.width = info.width;
+            crop.height = info.height;
+            crop.image.assign(slot, slot + info.size);
+            frame_ring_release(ring);
+        }
+        n_read++;
+        return true;
+    }
+
+private:
+    int width, height;
+    long n_synthetic = -1;
+    long n_read = 0;
+    FILE* file = NULL;
+    FrameRing* ring = NULL;
+};
+
+int main(int argc, char** argv) {
+    /*
+        Coordinator of the classifier workers: reads the crops from the source,
+        sends each one to a worker that has a credit left, and writes the
+        results in the order of the crops. Workers can join at any time; the
+        crops in flight on a worker that leaves go back to the queue.
+        Options:
+        - workers=<n>: wait for n workers before sending the first crop (1 by default)
+        - results=<file>: write "index class score worker" lines to the file
+        - check: check the classes against the emulated backend
+    */
+    if (argc < 5) {
+        printf("Usage: %s <port> <capture_file | shm:name | synthetic:n_crops> <width> <height> [workers=n] [results=file] [check]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    int width = atoi(argv[3]);
+    int height = atoi(argv[4]);
+    size_t min_workers = 1;
+    FILE* results_file = NULL;
+    bool check = false;
+    for (int i = 5; i < argc; i++) {
+        if (strncmp(argv[i], "workers=", 8) == 0) {
+            min_workers = atoi(argv[i] + 8);
+        } else if (strncmp(argv[i], "results=", 8) == 0) {
+            results_file = fopen(argv[i] + 8, "w");
+        } else if (strcmp(argv[i], "check") == 0) {
+            check = true;
+        } else {
+            fprintf(stderr, "[ERROR] Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    CropSource source(argv[2], width, height);
+    if (!source.valid()) {
+        fprintf(stderr, "[ERROR] Failed to open %s\n", argv[2]);
+        return 1;
+    }
+    int listen_fd = listen_on(port);
+    if (listen_fd < 0) {
+        fprintf(stderr, "[ERROR] Failed to listen on port %d\n", port);
+        return 1;
+    }
+    printf("[INFO] Waiting for %zu workers on port %d\n", min_workers, port);
+
+    vector<Worker> workers;
+    vector<Connection> connections;
+    map<uint64_t, Crop> crops;          // Crops read and not classified yet
+    deque<uint64_t> pending;            // Crops waiting for a worker, in order
+    map<uint64_t, Result> results;      // Results waiting for the previous ones
+    uint64_t next_id = 0, next_output = 0;
+    bool source_done = false, started = false;
+    int n_wrong = 0;
+    steady_clock::time_point start, last_stats = steady_clock::now();
+
+    while (!(source_done && next_output == next_id)) {
+        // Read ahead just enough crops to fill the credits of the workers
+        size_t total_credits = 0;
+        for (const auto& w : workers) {
+            total_credits += w.credits;
+        }
+        while (started && !source_done && pending.size() <= total_credits) {
+            Crop crop;
+            if (!source.next(crop)) {
+                source_done = true;
+                break;
+            }
+            crops[next_id] = move(crop);
+            pending.push_back(next_id++);
+        }
+
+        // Send the crops to the worker expected to finish them first
+        while (started && !pending.empty()) {
+            Worker* best = NULL;
+            double best_time = 0;
+            for (auto& w : workers) {
+                if (w.in_flight.size() >= w.credits) {
+                    continue;
+                }
+                double time = (w.in_flight.size() + 1) / max(w.rate, 1e-3);
+                if (best == NULL || time < best_time) {
+                    best = &w;
+                    best_time = time;
+                }
+            }
+            if (best == NULL) {
+                break;
+            }
+            uint64_t id = pending.front();
+            pending.pop_front();
+            const Crop& crop = crops[id];
+            best->in_flight.insert(id);
+            // Queued and sent as the socket takes it: a slow worker does not block the others
+            best->writer.push(MSG_CROP, id, crop.width << 16 | crop.height, crop.image.data(), crop.image.size());
+            if (!best->send_failed && !best->writer.flush(best->fd)) {
+                // Handled as a departure below
+                best->send_failed = true;
+            }
+        }
+
+        // The listening socket, the workers, then the connections waiting for their HELLO
+        vector<struct pollfd> fds(1 + workers.size() + connections.size());
+        fds[0] = {listen_fd, POLLIN, 0};
+        for (size_t i = 0; i < workers.size(); i++) {
+            fds[1 + i] = {workers[i].fd, (short)(POLLIN | (workers[i].writer.empty() ? 0 : POLLOUT)), 0};
+        }
+        for (size_t i = 0; i < connections.size(); i++) {
+            fds[1 + workers.size() + i] = {connections[i].fd, POLLIN, 0};
+        }
+        poll(fds.data(), fds.size(), 100);
+
+        // Results, and workers leaving
+        for (size_t i = 0; i < workers.size(); i++) {
+            Worker& w = workers[i];
+            bool lost = w.send_failed;
+            if ((fds[1 + i].revents & POLLOUT) && !w.writer.flush(w.fd)) {
+                lost = true;
+            }
+            if (fds[1 + i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                uint8_t buffer[4096];
+                ssize_t n = recv(w.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+                if (n > 0) {
+                    w.reader.feed(buffer, n);
+                } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    lost = true;
+                }
+            }
+            Message message;
+            while (w.reader.next(message)) {
+                uint64_t id = message.header.id;
+                if (message.header.type != MSG_RESULT || w.in_flight.erase(id) == 0) {
+                    continue;
+                }
+                auto now = steady_clock::now();
+                double interval = duration<double>(now - w.last_result).count();
+                w.rate = w.n_results == 0 ? 1.0 / interval : (1 - RATE_SMOOTHING) * w.rate + RATE_SMOOTHING / max(interval, 1e-6);
+                w.last_result = now;
+                w.n_results++;
+
+                float score = 0;
+                memcpy(&score, message.payload.data(), min(message.payload.size(), sizeof(score)));
+                if (check && (int)message.header.arg != emulated_class(crops[id].image.data(), crops[id].image.size())) {
+                    n_wrong++;
+                }
+                results[id] = {(int)message.header.arg, score, w.name};
+                crops.erase(id);
+            }
+            if (lost || w.reader.invalid()) {
+                // Back to the front of the queue, in order
+                pending.insert(pending.begin(), w.in_flight.begin(), w.in_flight.end());
+                sort(pending.begin(), pending.end());
+                printf("[INFO] %s left after %" PRIu64 " crops, %zu crops sent again (%zu workers)\n",
+                       w.name.c_str(), w.n_results, w.in_flight.size(), workers.size() - 1);
+                close(w.fd);
+                workers.erase(workers.begin() + i);
+                fds.erase(fds.begin() + 1 + i);
+                i--;
+            }
+        }
+
+        // HELLO of the new connections, without waiting for any of them
+        size_t first_connection = 1 + workers.size();
+        for (size_t i = 0; i < connections.size(); i++) {
+            Connection& c = connections[i];
+            bool lost = false;
+            if (fds[first_connection + i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                uint8_t buffer[4096];
+                ssize_t n = recv(c.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+                if (n > 0) {
+                    c.reader.feed(buffer, n);
+                } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    lost = true;
+                }
+            }
+            Message hello;
+            bool has_hello = c.reader.next(hello);
+            if (has_hello && hello.header.type == MSG_HELLO && hello.header.arg > 0) {
+                Worker w;
+                w.fd = c.fd;
+                w.name = string(hello.payload.begin(), hello.payload.end());
+                w.credits = hello.header.arg;
+                w.reader = move(c.reader);
+                w.send_failed = false;
+                w.n_results = 0;
+                w.rate = 0;
+                w.joined = w.last_result = steady_clock::now();
+                workers.push_back(move(w));
+                printf("[INFO] %s joined with %u credits (%zu workers)\n", workers.back().name.c_str(), hello.header.arg, workers.size());
+                if (!started && workers.size() >= min_workers) {
+                    started = true;
+                    start = steady_clock::now();
+                }
+            } else if (has_hello || lost || c.reader.invalid() ||
+                       duration<double, milli>(steady_clock::now() - c.accepted).count() > HELLO_TIMEOUT_MS) {
+                // Not a worker, or too slow to say so
+                close(c.fd);
+            } else {
+                continue;
+            }
+            connections.erase(connections.begin() + i);
+            fds.erase(fds.begin() + first_connection + i);
+            i--;
+        }
+
+        // New connection, a worker once its HELLO is received
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd >= 0) {
+                // The last segment of a crop must not wait for the ACK of the previous one
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                Connection c;
+                c.fd = fd;
+                c.accepted = steady_clock::now();
+                connections.push_back(move(c));
+            }
+        }
+
+        // Results in the order of the crops
+        for (auto it = results.find(next_output); it != results.end(); it = results.find(++next_output)) {
+            if (results_file != NULL) {
+                fprintf(results_file, "%" PRIu64 " %d %.4f %s\n", next_output, it->second.label, it->second.score, it->second.worker.c_str());
+            }
+            results.erase(it);
+        }
+
+        if (started && duration<double>(steady_clock::now() - last_stats).count() > STATS_PERIOD) {
+            last_stats = steady_clock::now();
+            printf("[INFO] %" PRIu64 " crops classified, %zu in the queue:", next_output, pending.size());
+            for (const auto& w : workers) {
+                printf(" %s %.1f/s", w.name.c_str(), w.rate);
+            }
+            printf("\n");
+        }
+    }
+    double seconds = duration<double>(steady_clock::now() - start).count();
+
+    for (auto& w : workers) {
+        // All the crops are answered, so the socket has room for it
+        w.writer.push(MSG_BYE, 0, 0, NULL, 0);
+        w.writer.flush(w.fd);
+        double active = duration<double>(w.last_result - w.joined).count();
+        printf("[INFO] %s: %" PRIu64 " crops, %.1f crops/s\n", w.name.c_str(), w.n_results, active > 0 ? w.n_results / active : 0.0);
+        close(w.fd);
+    }
+    for (auto& c : connections) {
+        close(c.fd);
+    }
+    close(listen_fd);
+    if (results_file != NULL) {
+        fclose(results_file);
+    }
+
+    printf("[SUCCESS] %" PRIu64 " crops classified in %.2f seconds (%.1f crops/s)\n", next_output, seconds, next_output / seconds);
+    if (check && n_wrong > 0) {
+        fprintf(stderr, "[ERROR] %d results do not match their crop\n", n_wrong);
+        return 1;
+    }
+    return 0;
+}
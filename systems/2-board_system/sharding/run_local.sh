@@ -0,0 +1,32 @@
+#!/bin/bash
+# Runs the coordinator and emulated workers on this host:
+# - the throughput with 1, 2 and 4 workers of 10 ms per crop
+# - a worker leaving after 100 crops and another one joining during the run
+# Usage: ./run_local.sh [n_crops]
+
+set -e
+N_CROPS=${1:-400}
+PORT=5600
+FRAME_RING=../../frame_ring
+
+g++ -O2 -std=c++17 -I$FRAME_RING -o coordinator coordinator.cpp classifier_backend.cpp cluster_protocol.cpp $FRAME_RING/frame_ring.cpp -lpthread
+g++ -O2 -std=c++17 -o classifier_worker classifier_worker.cpp classifier_backend.cpp cluster_protocol.cpp -lpthread
+
+for N in 1 2 4; do
+    echo "[INFO] $N workers"
+    ./coordinator $PORT synthetic:$N_CROPS 224 224 workers=$N check | grep SUCCESS &
+    sleep 0.3
+    for i in $(seq 1 $N); do
+        ./classifier_worker 127.0.0.1 $PORT emulated:10 4 worker-$i > /dev/null &
+    done
+    wait
+done
+
+echo "[INFO] Workers leaving and joining"
+./coordinator $PORT synthetic:$N_CROPS 224 224 workers=2 check results=results.txt &
+sleep 0.3
+./classifier_worker 127.0.0.1 $PORT emulated:10 4 steady > /dev/null &
+./classifier_worker 127.0.0.1 $PORT emulated:20 4 leaving 100 > /dev/null &
+sleep 1
+./classifier_worker 127.0.0.1 $PORT emulated:10 4 joining > /dev/null &
+wait
@@ -0,0 +1,393 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+
+#include "isp.h"
+#include "uart_link.h"
+
+using namespace std;
+using namespace chrono;
+
+static uint32_t crc_table[256];
+
+static bool init_crc_table() {
+    // Reflected CRC32 (polynomial 0xEDB88320), same as zlib
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+    return true;
+}
+
+static bool crc_table_ready = init_crc_table();
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc) {
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void put16(uint8_t* p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint16_t get16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void write_header(const FrameHeader& h, uint8_t* p) {
+    put32(p, h.magic);
+    p[4] = h.version;
+    p[5] = h.flags;
+    put16(p + 6, h.seq);
+    put16(p + 8, h.width);
+    put16(p + 10, h.height);
+    put16(p + 12, h.roi_x);
+    put16(p + 14, h.roi_y);
+    put16(p + 16, h.frame_width);
+    put16(p + 18, h.frame_height);
+    put32(p + 20, h.payload_size);
+    put32(p + 24, h.raw_size);
+    put32(p + 28, crc32(p, 28));
+}
+
+static void read_header(const uint8_t* p, FrameHeader& h) {
+    h.magic = get32(p);
+    h.version = p[4];
+    h.flags = p[5];
+    h.seq = get16(p + 6);
+    h.width = get16(p + 8);
+    h.height = get16(p + 10);
+    h.roi_x = get16(p + 12);
+    h.roi_y = get16(p + 14);
+    h.frame_width = get16(p + 16);
+    h.frame_height = get16(p + 18);
+    h.payload_size = get32(p + 20);
+    h.raw_size = get32(p + 24);
+    h.header_crc = get32(p + 28);
+}
+
+uint32_t frame_raw_size(const FrameHeader& header) {
+    if (header.flags & (FRAME_FLAG_RAW8 | FRAME_FLAG_RAW10)) {
+        size_t n_samples = (size_t)(header.width + (header.roi_x > 0)) * (header.height + (header.roi_y > 0));
+        return bayer_packed_size(header.flags & FRAME_FLAG_RAW10 ? BAYER_RAW10 : BAYER_RAW8, n_samples);
+    }
+    return (uint32_t)header.width * header.height * 3;
+}
+
+static void encode(FrameHeader& header, const uint8_t* image, bool compress, vector<uint8_t>& out) {
+    header.magic = FRAME_MAGIC;
+    header.version = FRAME_VERSION;
+    header.raw_size = frame_raw_size(header);
+    header.payload_size = header.raw_size;
+    out.resize(FRAME_HEADER_SIZE + header.raw_size + 4);
+    uint8_t* payload = out.data() + FRAME_HEADER_SIZE;
+
+#ifdef USE_LZ4
+    if (compress) {
+        vector<uint8_t> compressed(LZ4_compressBound(header.raw_size));
+        int size = LZ4_compress_default((const char*)image, (char*)compressed.data(), header.raw_size, compressed.size());
+        // Only worth it if it saves bytes on the wire
+        if (size > 0 && (uint32_t)size < header.raw_size) {
+            header.flags |= FRAME_FLAG_LZ4;
+            header.payload_size = size;
+            out.resize(FRAME_HEADER_SIZE + size + 4);
+            payload = out.data() + FRAME_HEADER_SIZE;
+            memcpy(payload, compressed.data(), size);
+        }
+    }
+#else
+    (void)compress;     // Sent uncompressed without lz4
+#endif
+    if (!(header.flags & FRAME_FLAG_LZ4)) {
+        memcpy(payload, image, header.raw_size);
+    }
+
+    write_header(header, out.data());
+    put32(payload + header.payload_size, crc32(payload, header.payload_size));
+}
+
+void encode_frame(const uint8_t* image, uint16_t width, uint16_t height, uint16_t seq,
+                  bool compress, vector<uint8_t>& out) {
+    FrameHeader header = {};
+    header.seq = seq;
+    header.width = width;
+    header.height = height;
+    header.frame_width = width;
+    header.frame_height = height;
+    encode(header, image, compress, out);
+}
+
+void encode_roi_frame(const uint8_t* frame, uint16_t frame_width, uint16_t frame_height,
+                      uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t seq,
+                      bool compress, vector<uint8_t>& out) {
+    // Only the region is sent, row by row
+    vector<uint8_t> roi(width * height * 3);
+    for (int row = 0; row < height; row++) {
+        memcpy(roi.data() + row * width * 3, frame + ((y + row) * frame_width + x) * 3, width * 3);
+    }
+    FrameHeader header = {};
+    header.flags = FRAME_FLAG_ROI;
+    header.seq = seq;
+    header.width = width;
+    header.height = height;
+    header.roi_x = x;
+    header.roi_y = y;
+    header.frame_width = frame_width;
+    header.frame_height = frame_height;
+    encode(header, roi.data(), compress, out);
+}
+
+void encode_bayer_frame(const uint16_t* frame, uint16_t frame_width, uint16_t frame_height,
+                        uint16_t x, uint16_t y, uint16_t width, uint16_t height, int format,
+                        uint16_t seq, bool compress, vector<uint8_t>& out) {
+    // The region with the column on the left and the line above needed by the demosaic
+    int x0 = x > 0 ? x - 1 : 0;
+    int y0 = y > 0 ? y - 1 : 0;
+    int bayer_width = x + width - x0;
+    int bayer_height = y + height - y0;
+    vector<uint16_t> samples(bayer_width * bayer_height);
+    for (int row = 0; row < bayer_height; row++) {
+        memcpy(&samples[row * bayer_width], frame + (y0 + row) * frame_width + x0, bayer_width * sizeof(uint16_t));
+    }
+    vector<uint8_t> packed(bayer_packed_size(format, samples.size()));
+    pack_bayer(samples.data(), samples.size(), format, packed.data());
+
+    FrameHeader header = {};
+    header.flags = format == BAYER_RAW10 ? FRAME_FLAG_RAW10 : FRAME_FLAG_RAW8;
+    if (width != frame_width || height != frame_height) {
+        header.flags |= FRAME_FLAG_ROI;
+    }
+    header.seq = seq;
+    header.width = width;
+    header.height = height;
+    header.roi_x = x;
+    header.roi_y = y;
+    header.frame_width = frame_width;
+    header.frame_height = frame_height;
+    encode(header, packed.data(), compress, out);
+}
+
+void frame_to_rgb(const Frame& frame, const uint8_t gamma_lut[1024], uint8_t* rgb, size_t stride) {
+    const FrameHeader& h = frame.header;
+    if (!(h.flags & (FRAME_FLAG_RAW8 | FRAME_FLAG_RAW10))) {
+        for (int row = 0; row < h.height; row++) {
+            memcpy(rgb + row * stride, frame.image.data() + row * h.width * 3, h.width * 3);
+        }
+        return;
+    }
+    // Unpacked samples, kept between calls
+    static thread_local vector<uint16_t> samples;
+    size_t n_samples = (size_t)(h.width + (h.roi_x > 0)) * (h.height + (h.roi_y > 0));
+    samples.resize(n_samples);
+    unpack_bayer(frame.image.data(), n_samples, h.flags & FRAME_FLAG_RAW10 ? BAYER_RAW10 : BAYER_RAW8, samples.data());
+    bayer_to_rgb(samples.data(), h.roi_x, h.roi_y, h.width, h.height, gamma_lut, rgb, stride);
+}
+
+FrameParser::FrameParser(function<void(Frame&)> on_frame) : on_frame(on_frame) {
+}
+
+void FrameParser::feed(const uint8_t* data, size_t size) {
+    // Drop the parsed bytes before appending, so the buffer stays about one frame long
+    if (start > 0 && start >= buffer.size() / 2) {
+        buffer.erase(buffer.begin(), buffer.begin() + start);
+        start = 0;
+    }
+    buffer.insert(buffer.end(), data, data + size);
+    link_stats.bytes += size;
+    while (parse_one()) {
+    }
+}
+
+bool FrameParser::parse_one() {
+    /*
+        Try to parse a frame at the start of the unparsed bytes.
+        Returns true if some bytes were consumed, false if more bytes are needed.
+    */
+    const uint8_t magic[4] = {FRAME_MAGIC & 0xFF, (FRAME_MAGIC >> 8) & 0xFF, (FRAME_MAGIC >> 16) & 0xFF, FRAME_MAGIC >> 24};
+    size_t available = buffer.size() - start;
+    const uint8_t* p = buffer.data() + start;
+
+    // Resynchronise on the magic
+    const uint8_t* found = (const uint8_t*)memmem(p, available, magic, 4);
+    if (found == NULL) {
+        // Keep the last 3 bytes, they can be the start of a magic
+        size_t skip = available > 3 ? available - 3 : 0;
+        link_stats.skipped_bytes += skip;
+        start += skip;
+        return false;
+    }
+    if (found != p) {
+        link_stats.skipped_bytes += found - p;
+        start += found - p;
+        return true;
+    }
+    if (available < FRAME_HEADER_SIZE) {
+        return false;
+    }
+
+    FrameHeader& header = frame.header;
+    read_header(p, header);
+    if (header.header_crc != crc32(p, 28) || header.version != FRAME_VERSION ||
+        header.payload_size > FRAME_MAX_PAYLOAD || header.raw_size != frame_raw_size(header)) {
+        link_stats.header_errors++;
+        link_stats.skipped_bytes++;
+        start++;
+        return true;
+    }
+    size_t frame_size = FRAME_HEADER_SIZE + header.payload_size + 4;
+    if (available < frame_size) {
+        return false;
+    }
+
+    const uint8_t* payload = p + FRAME_HEADER_SIZE;
+    bool valid = get32(payload + header.payload_size) == crc32(payload, header.payload_size);
+    if (valid) {
+        frame.image.resize(header.raw_size);
+        if (header.flags & FRAME_FLAG_LZ4) {
+#ifdef USE_LZ4
+            valid = LZ4_decompress_safe((const char*)payload, (char*)frame.image.data(), header.payload_size, header.raw_size) == (int)header.raw_size;
+#else
+            valid = false;
+#endif
+        } else {
+            memcpy(frame.image.data(), payload, header.raw_size);
+        }
+    }
+    if (!valid) {
+        // The next frame can start inside this one if bytes were dropped
+        link_stats.payload_errors++;
+        link_stats.skipped_bytes++;
+        start++;
+        return true;
+    }
+
+    if (has_seq && header.seq != next_seq) {
+        link_stats.lost_frames += (uint16_t)(header.seq - next_seq);
+    }
+    has_seq = true;
+    next_seq = header.seq + 1;
+    link_stats.frames++;
+    start += frame_size;
+    on_frame(frame);
+    return true;
+}
+
+void FrameQueue::push(Frame&& frame) {
+    unique_lock<mutex> lock(queue_mutex);
+    not_full.wait(lock, [this] { return closed || frames.size() < capacity; });
+    if (closed) {
+        return;
+    }
+    frames.push_back(move(frame));
+    not_empty.notify_one();
+}
+
+bool FrameQueue::pop(Frame& frame) {
+    unique_lock<mutex> lock(queue_mutex);
+    not_empty.wait(lock, [this] { return closed || !frames.empty(); });
+    if (frames.empty()) {
+        return false;
+    }
+    frame = move(frames.front());
+    frames.pop_front();
+    not_full.notify_one();
+    return true;
+}
+
+void FrameQueue::close() {
+    lock_guard<mutex> lock(queue_mutex);
+    closed = true;
+    not_empty.notify_all();
+    not_full.notify_all();
+}
+
+static speed_t baud_constant(int baudrate) {
+    switch (baudrate) {
+        case 9600:    return B9600;
+        case 19200:   return B19200;
+        case 38400:   return B38400;
+        case 57600:   return B57600;
+        case 115200:  return B115200;
+        case 230400:  return B230400;
+        case 460800:  return B460800;
+        case 921600:  return B921600;
+        case 1000000: return B1000000;
+        case 2000000: return B2000000;
+        case 3000000: return B3000000;
+        default:      return B0;
+    }
+}
+
+int open_serial(const char* port, int baudrate) {
+    int fd = open(port, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        fprintf(stderr, "[ERROR] Failed to open %s: %s\n", port, strerror(errno));
+        return -1;
+    }
+    struct termios tty;
+    if (tcgetattr(fd, &tty) != 0) {
+        fprintf(stderr, "[ERROR] %s is not a serial port\n", port);
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tty);
+    speed_t speed = baud_constant(baudrate);
+    if (speed != B0) {
+        cfsetispeed(&tty, speed);
+        cfsetospeed(&tty, speed);
+    }
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cc[VMIN] = 1;
+    tty.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tty);
+    return fd;
+}
+
+bool write_paced(int fd, const uint8_t* data, size_t size, int baudrate) {
+    // Chunks of about 10 ms at the given baudrate
+    size_t chunk = baudrate > 0 ? max<size_t>(baudrate / 1000, 1) : size;
+    auto start = steady_clock::now();
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t n = write(fd, data + sent, min(chunk, size - sent));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        sent += n;
+        if (baudrate > 0) {
+            this_thread::sleep_until(start + microseconds((uint64_t)sent * 10 * 1000000 / baudrate));
+        }
+    }
+    return true;
+}
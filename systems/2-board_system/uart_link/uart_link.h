@@ -0,0 +1,149 @@
+#ifndef UART_LINK_H
+#define UART_LINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/*
+    Framed protocol for the UART link between the detection board and the
+    classification board. Each crop is sent as:
+
+    - FrameHeader (32 bytes, little endian), starting with FRAME_MAGIC
+    - payload_size bytes of payload: RGB image, or Bayer samples with
+      FRAME_FLAG_RAW8 / FRAME_FLAG_RAW10 (then raw, or compressed if FRAME_FLAG_LZ4)
+    - CRC32 of the payload (4 bytes)
+
+    The header has its own CRC, so a corrupted length is detected before
+    waiting for the payload. After dropped or corrupted bytes, the receiver
+    looks for the next FRAME_MAGIC and carries on; the sequence numbers tell
+    how many frames were lost.
+*/
+
+#define FRAME_MAGIC         0x3CC35AA5u
+#define FRAME_VERSION       1
+#define FRAME_HEADER_SIZE   32
+#define FRAME_MAX_PAYLOAD   (16 << 20)
+
+// Payload flags
+#define FRAME_FLAG_LZ4      0x01    // Payload compressed with LZ4 (needs -DUSE_LZ4)
+#define FRAME_FLAG_ROI      0x02    // Payload is a region of a larger frame
+#define FRAME_FLAG_RAW8     0x04    // Payload is Bayer RAW8, demosaiced by the receiver
+#define FRAME_FLAG_RAW10    0x08    // Payload is Bayer RAW10 (MIPI packing), demosaiced by the receiver
+
+/*
+    A Bayer payload holds the samples needed by AXI_BayerToRGB for the region
+    (roi_x, roi_y, width, height): the region, plus one column on the left if
+    roi_x > 0 and one line above if roi_y > 0 (see bayer_to_rgb in isp.h).
+*/
+
+typedef struct {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t flags;
+    uint16_t seq;
+    uint16_t width;         // Size of the image in the payload
+    uint16_t height;
+    uint16_t roi_x;         // Position of the image in the captured frame (FRAME_FLAG_ROI)
+    uint16_t roi_y;
+    uint16_t frame_width;   // Size of the captured frame (FRAME_FLAG_ROI)
+    uint16_t frame_height;
+    uint32_t payload_size;  // Bytes on the wire
+    uint32_t raw_size;      // Bytes once decompressed: width * height * 3 for RGB
+    uint32_t header_crc;    // CRC32 of the 28 bytes before
+} FrameHeader;
+
+typedef struct {
+    FrameHeader header;
+    std::vector<uint8_t> image;     // Decompressed payload: RGB image or packed Bayer samples
+} Frame;
+
+typedef struct {
+    uint64_t bytes;             // Bytes received
+    uint64_t frames;            // Valid frames
+    uint64_t header_errors;     // Corrupted headers
+    uint64_t payload_errors;    // Corrupted payloads
+    uint64_t lost_frames;       // Gaps in the sequence numbers
+    uint64_t skipped_bytes;     // Bytes dropped while looking for a frame
+} LinkStats;
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+// Serialise an RGB image into out. With compress, the payload is LZ4 compressed
+// when it is smaller that way (and the build has LZ4).
+void encode_frame(const uint8_t* image, uint16_t width, uint16_t height, uint16_t seq,
+                  bool compress, std::vector<uint8_t>& out);
+
+// Copy the region (x, y, width, height) of an RGB frame and encode it as a ROI frame
+void encode_roi_frame(const uint8_t* frame, uint16_t frame_width, uint16_t frame_height,
+                      uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t seq,
+                      bool compress, std::vector<uint8_t>& out);
+
+// Send the region of a 10-bit Bayer frame as RAW8 or RAW10 (BAYER_RAW8 / BAYER_RAW10 of isp.h),
+// a third (RAW8) or 5/12 (RAW10) of the RGB bytes
+void encode_bayer_frame(const uint16_t* frame, uint16_t frame_width, uint16_t frame_height,
+                        uint16_t x, uint16_t y, uint16_t width, uint16_t height, int format,
+                        uint16_t seq, bool compress, std::vector<uint8_t>& out);
+
+// Size of the decompressed payload announced by a header
+uint32_t frame_raw_size(const FrameHeader& header);
+
+// Write the RGB image of a frame into rgb (rows of stride bytes): a copy for RGB
+// frames, demosaic and gamma (gamma_lut from build_gamma_lut) for Bayer frames
+void frame_to_rgb(const Frame& frame, const uint8_t gamma_lut[1024], uint8_t* rgb, size_t stride);
+
+/*
+    Streaming decoder: feed it the bytes as they arrive, in chunks of any size.
+    on_frame is called for each valid frame, in the order of arrival.
+*/
+class FrameParser {
+public:
+    explicit FrameParser(std::function<void(Frame&)> on_frame);
+    void feed(const uint8_t* data, size_t size);
+    const LinkStats& stats() const { return link_stats; }
+
+private:
+    bool parse_one();
+
+    std::function<void(Frame&)> on_frame;
+    std::vector<uint8_t> buffer;
+    size_t start = 0;           // First unparsed byte of buffer
+    bool has_seq = false;
+    uint16_t next_seq = 0;
+    LinkStats link_stats = {};
+    Frame frame;
+};
+
+/*
+    Bounded queue between the thread reading the link and the thread
+    classifying the frames, so that a frame is processed while the next ones
+    are still arriving.
+*/
+class FrameQueue {
+public:
+    explicit FrameQueue(size_t capacity) : capacity(capacity) {}
+    void push(Frame&& frame);   // Blocks while the queue is full
+    bool pop(Frame& frame);     // Blocks until a frame is available, false once closed and empty
+    void close();
+
+private:
+    size_t capacity;
+    bool closed = false;
+    std::deque<Frame> frames;
+    std::mutex queue_mutex;
+    std::condition_variable not_empty, not_full;
+};
+
+// Open a serial port in raw mode. Returns the file descriptor, or -1 on error.
+int open_serial(const char* port, int baudrate);
+
+// Write everything, sleeping so that the throughput stays below baudrate (10 bits per byte).
+// baudrate 0 writes at full speed.
+bool write_paced(int fd, const uint8_t* data, size_t size, int baudrate);
+
+#endif // UART_LINK_H
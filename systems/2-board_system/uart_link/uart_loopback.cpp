@@ -0,0 +1,247 @@
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "isp.h"
+#include "uart_link.h"
+
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -I../../isp -o uart_loopback uart_loopback.cpp uart_link.cpp ../../isp/isp.cpp -lpthread
+// (add -DUSE_LZ4 ... -llz4 for the lz4 option)
+
+#define GAMMA_REG GAMMA_2_2
+#define MIN_RECEIVED 0.5    // Fraction of the frames expected to get through the errors that must be received
+
+void hdl_bayer_to_rgb(const uint16_t* bayer, int width, int height, const uint8_t* lut, uint8_t* rgb) {
+    /*
+        Pixel by pixel transcription of AXI_BayerToRGB followed by the gamma
+        ROM, used as the reference for the frames received. P0 is the current
+        pixel, P1 the previous one on the line, P2 and P3 the same two pixels
+        on the line above (sPixel in the VHDL).
+    */
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int r = 512, g = 1024, b = 512;
+            if (x > 0 && y > 0) {
+                int p0 = bayer[y * width + x];
+                int p1 = bayer[y * width + x - 1];
+                int p2 = bayer[(y - 1) * width + x];
+                int p3 = bayer[(y - 1) * width + x - 1];
+                int position = ((y & 1) << 1) | (x & 1);
+                switch (position) {
+                    case 1: b = p1; g = p0 + p3; r = p2; break;
+                    case 0: b = p0; g = p1 + p2; r = p3; break;
+                    case 3: b = p3; g = p1 + p2; r = p0; break;
+                    case 2: b = p2; g = p0 + p3; r = p1; break;
+                }
+            }
+            uint8_t* out = &rgb[(y * width + x) * 3];
+            out[0] = lut[r];
+            out[1] = lut[g >> 1];
+            out[2] = lut[b];
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    /*
+        End-to-end test of the link on a pseudo-terminal pair: a thread sends
+        n_frames synthetic captures on the master side, paced at baudrate, and
+        corrupts the bytes with the given error rate (half are flipped, half
+        are dropped). The receiver reads the slave side and checks every frame
+        it gets against the image that was sent with this sequence number.
+
+        The captures are 10-bit Bayer frames. By default the sender converts
+        them to RGB as the bitstream does and sends RGB; with raw8 or raw10 it
+        sends the Bayer samples and the receiver does the conversion. The
+        latency is measured from the start of the sending of a frame to its
+        RGB image being ready on the receiver.
+    */
+    if (argc < 6) {
+        printf("Usage: %s <baudrate> <n_frames> <width> <height> <error_rate> [lz4] [raw8|raw10] [x,y,w,h]\n", argv[0]);
+        return 1;
+    }
+    int baudrate = atoi(argv[1]);
+    int n_frames = atoi(argv[2]);
+    int width = atoi(argv[3]);
+    int height = atoi(argv[4]);
+    double error_rate = atof(argv[5]);
+    bool compress = false;
+    int bayer_format = 0;
+    int roi[4] = {0, 0, width, height};
+    for (int i = 6; i < argc; i++) {
+        if (strcmp(argv[i], "lz4") == 0) {
+            compress = true;
+        } else if (strcmp(argv[i], "raw8") == 0) {
+            bayer_format = BAYER_RAW8;
+        } else if (strcmp(argv[i], "raw10") == 0) {
+            bayer_format = BAYER_RAW10;
+        } else if (sscanf(argv[i], "%d,%d,%d,%d", &roi[0], &roi[1], &roi[2], &roi[3]) != 4) {
+            fprintf(stderr, "[ERROR] Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (roi[0] + roi[2] > width || roi[1] + roi[3] > height) {
+        fprintf(stderr, "[ERROR] The ROI is outside of the %dx%d images\n", width, height);
+        return 1;
+    }
+    bool full_frame = roi[2] == width && roi[3] == height;
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        fprintf(stderr, "[ERROR] Failed to create a pseudo-terminal\n");
+        return 1;
+    }
+    int slave = open_serial(ptsname(master), baudrate);
+    if (slave < 0) {
+        return 1;
+    }
+    printf("[INFO] Pseudo-terminal %s, %d baud, error rate %g, %s\n", ptsname(master), baudrate, error_rate,
+           bayer_format == BAYER_RAW8 ? "RAW8" : bayer_format == BAYER_RAW10 ? "RAW10" : "RGB");
+
+    uint8_t gamma_lut[1024];
+    build_gamma_lut(GAMMA_REG, gamma_lut);
+
+    // Synthetic captures: gradients with some noise, so that compression has something to do
+    auto make_bayer = [&](int seq, vector<uint16_t>& bayer) {
+        bayer.resize(width * height);
+        mt19937 rng(seq);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                bayer[y * width + x] = ((x * 4 + y * 2 + seq * 8) & 1023) ^ (rng() & 15);
+            }
+        }
+    };
+    // Expected image: the region of the output of the bitstream (from 8-bit samples with RAW8)
+    auto make_expected = [&](int seq, vector<uint8_t>& expected) {
+        vector<uint16_t> bayer;
+        vector<uint8_t> rgb(width * height * 3);
+        make_bayer(seq, bayer);
+        if (bayer_format == BAYER_RAW8) {
+            for (uint16_t& s : bayer) {
+                s &= ~3;
+            }
+        }
+        hdl_bayer_to_rgb(bayer.data(), width, height, gamma_lut, rgb.data());
+        expected.resize(roi[2] * roi[3] * 3);
+        for (int row = 0; row < roi[3]; row++) {
+            memcpy(&expected[row * roi[2] * 3], &rgb[((roi[1] + row) * width + roi[0]) * 3], roi[2] * 3);
+        }
+    };
+
+    size_t bytes_sent = 0;
+    vector<atomic<int64_t>> send_times(n_frames);
+    auto start = steady_clock::now();
+    thread sender([&] {
+        mt19937 rng(1234);
+        uniform_real_distribution<double> uniform(0.0, 1.0);
+        vector<uint16_t> bayer;
+        vector<uint8_t> rgb(width * height * 3), frame, wire;
+        for (int seq = 0; seq < n_frames; seq++) {
+            send_times[seq] = duration_cast<microseconds>(steady_clock::now() - start).count();
+            make_bayer(seq, bayer);
+            if (bayer_format) {
+                encode_bayer_frame(bayer.data(), width, height, roi[0], roi[1], roi[2], roi[3], bayer_format, seq, compress, frame);
+            } else {
+                hdl_bayer_to_rgb(bayer.data(), width, height, gamma_lut, rgb.data());
+                if (full_frame) {
+                    encode_frame(rgb.data(), width, height, seq, compress, frame);
+                } else {
+                    encode_roi_frame(rgb.data(), width, height, roi[0], roi[1], roi[2], roi[3], seq, compress, frame);
+                }
+            }
+            wire.clear();
+            for (uint8_t b : frame) {
+                if (error_rate > 0 && uniform(rng) < error_rate) {
+                    if (rng() & 1) {
+                        continue;
+                    }
+                    b ^= 1 << (rng() & 7);
+                }
+                wire.push_back(b);
+            }
+            if (!write_paced(master, wire.data(), wire.size(), baudrate)) {
+                break;
+            }
+            bytes_sent += wire.size();
+        }
+        // Let the receiver drain the pty before hanging up
+        this_thread::sleep_for(milliseconds(200));
+        close(master);
+    });
+
+    // Pipelined receiver: the parser thread pushes, this thread converts and checks
+    FrameQueue queue(8);
+    FrameParser parser([&queue](Frame& frame) { queue.push(move(frame)); });
+    thread reader([&] {
+        vector<uint8_t> buffer(1 << 16);
+        for (;;) {
+            ssize_t n = read(slave, buffer.data(), buffer.size());
+            if (n <= 0) {
+                break;
+            }
+            parser.feed(buffer.data(), n);
+        }
+        queue.close();
+    });
+
+    int n_received = 0, n_mismatch = 0;
+    double total_latency = 0, max_latency = 0;
+    Frame frame;
+    vector<uint8_t> image, expected;
+    while (queue.pop(frame)) {
+        image.resize(frame.header.width * frame.header.height * 3);
+        frame_to_rgb(frame, gamma_lut, image.data(), frame.header.width * 3);
+        double latency = duration_cast<microseconds>(steady_clock::now() - start).count() - send_times[frame.header.seq];
+        total_latency += latency;
+        max_latency = max(max_latency, latency);
+
+        make_expected(frame.header.seq, expected);
+        if (image != expected) {
+            n_mismatch++;
+        }
+        n_received++;
+    }
+    double seconds = duration<double>(steady_clock::now() - start).count();
+    sender.join();
+    reader.join();
+    close(slave);
+
+    const LinkStats& stats = parser.stats();
+    printf("[INFO] %zu bytes sent (%.0f bytes/frame), %d frames received in %.2f seconds (%.0f bytes/s, %.2f frames/s)\n",
+           bytes_sent, (double)bytes_sent / n_frames, n_received, seconds, stats.bytes / seconds, n_received / seconds);
+    if (n_received > 0) {
+        printf("[INFO] Latency: %.2f ms mean, %.2f ms max\n", total_latency / n_received / 1000, max_latency / 1000);
+    }
+    printf("[INFO] Header errors: %" PRIu64 ", payload errors: %" PRIu64 ", lost frames: %" PRIu64 ", skipped bytes: %" PRIu64 "\n",
+           stats.header_errors, stats.payload_errors, stats.lost_frames, stats.skipped_bytes);
+    if (n_mismatch > 0) {
+        fprintf(stderr, "[ERROR] %d frames received with a wrong content\n", n_mismatch);
+        return 1;
+    }
+    if (error_rate == 0 && n_received != n_frames) {
+        fprintf(stderr, "[ERROR] %d frames sent but %d received without errors on the link\n", n_frames, n_received);
+        return 1;
+    }
+    // A frame gets through if none of its bytes is corrupted; nothing is checked without a frame
+    double expected_frames = n_frames * pow(1 - error_rate, (double)bytes_sent / max(n_frames, 1));
+    if (n_received < max(1, (int)(MIN_RECEIVED * expected_frames))) {
+        fprintf(stderr, "[ERROR] %d frames received of %d sent, %.1f expected with an error rate of %g\n", n_received,
+                n_frames, expected_frames, error_rate);
+        return 1;
+    }
+    printf("[SUCCESS] All the %d frames received are correct\n", n_received);
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_ring.h"
+#include "isp.h"
+#include "uart_link.h"
+
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -I../../isp -I../../frame_ring -o uart_receiver uart_receiver.cpp uart_link.cpp ../../isp/isp.cpp ../../frame_ring/frame_ring.cpp -lpthread
+// (add -DUSE_LZ4 ... -llz4 to receive compressed frames)
+
+#define QUEUE_SIZE      8
+#define RING_SLOTS      16
+#define RING_SLOT_SIZE  (224 * 224 * 3)
+#define RING_TIMEOUT_MS 1000            // Between the checks that the consumer is alive
+#define RING_ATTACH_MS  30000           // For the consumer to open the ring
+
+int main(int argc, char** argv) {
+    /*
+        Receive frames and append the images to a capture file, readable by
+        binary_to_images. The link is read by one thread and the frames are
+        handled by another one, which is where the classification plugs in:
+        a frame is processed while the next ones are still on the wire.
+        Bayer frames are demosaiced with the gamma register value gamma_reg
+        of AXI_GammaCorrection (0 to 4, 0 by default).
+        With shm:<name> instead of a capture file, the images are written in
+        place into the slots of the shared-memory frame ring /name, read by
+        the inference process. The receiver exits with an error if the
+        inference process does not open the ring within RING_ATTACH_MS, or
+        exits while the ring is full.
+    */
+    if (argc < 5) {
+        printf("Usage: %s <port> <baudrate> <capture_file | shm:name> <n_frames> [gamma_reg]\n", argv[0]);
+        return 1;
+    }
+    const char* port = argv[1];
+    int baudrate = atoi(argv[2]);
+    const char* capture_file = argv[3];
+    uint64_t n_frames = atoll(argv[4]);
+    uint8_t gamma_lut[1024];
+    build_gamma_lut(argc > 5 ? atoi(argv[5]) : GAMMA_1, gamma_lut);
+
+    int fd = open_serial(port, baudrate);
+    if (fd < 0) {
+        return 1;
+    }
+    FILE* file = NULL;
+    FrameRing* ring = NULL;
+    if (strncmp(capture_file, "shm:", 4) == 0) {
+        ring = frame_ring_create((string("/") + (capture_file + 4)).c_str(), RING_SLOTS, RING_SLOT_SIZE);
+    } else {
+        file = fopen(capture_file, "wb");
+    }
+    if (file == NULL && ring == NULL) {
+        fprintf(stderr, "[ERROR] Failed to open %s\n", capture_file);
+        close(fd);
+        return 1;
+    }
+
+    FrameQueue queue(QUEUE_SIZE);
+    FrameParser parser([&queue](Frame& frame) { queue.push(move(frame)); });
+    atomic<bool> ring_failed(false);
+    auto ring_start = steady_clock::now();
+
+    thread consumer([&] {
+        Frame frame;
+        vector<uint8_t> image;
+        while (queue.pop(frame)) {
+            if (ring_failed) {
+                // Emptied so that the reader is not blocked, until it stops
+                continue;
+            }
+            const FrameHeader& h = frame.header;
+            if (h.flags & FRAME_FLAG_ROI) {
+                printf("[INFO] Frame %d: %dx%d at (%d, %d) of %dx%d\n", h.seq, h.width, h.height, h.roi_x, h.roi_y, h.frame_width, h.frame_height);
+            } else {
+                printf("[INFO] Frame %d: %dx%d\n", h.seq, h.width, h.height);
+            }
+            size_t size = h.width * h.height * 3;
+            if (ring != NULL) {
+                // Straight into the shared memory, no intermediate image
+                if (size > RING_SLOT_SIZE) {
+                    fprintf(stderr, "[ERROR] Frame %d does not fit in a slot of the frame ring\n", h.seq);
+                    continue;
+                }
+                uint8_t* slot;
+                while ((slot = frame_ring_write_slot(ring, RING_TIMEOUT_MS)) == NULL) {
+                    int alive = frame_ring_peer_alive(ring);
+                    if (alive == 0) {
+                        fprintf(stderr, "[ERROR] The consumer of the frame ring %s exited\n", capture_file);
+                    } else if (alive < 0 && steady_clock::now() - ring_start > milliseconds(RING_ATTACH_MS)) {
+                        fprintf(stderr, "[ERROR] No consumer opened the frame ring %s in %d ms\n", capture_file, RING_ATTACH_MS);
+                    } else {
+                        continue;
+                    }
+                    ring_failed = true;
+                    break;
+                }
+                if (slot == NULL) {
+                    continue;
+                }
+                frame_to_rgb(frame, gamma_lut, slot, h.width * 3);
+                FrameRingInfo info = {(uint32_t)size, h.width, h.height, FRAME_RING_NO_LABEL, 0};
+                frame_ring_commit(ring, &info);
+            } else {
+                image.resize(size);
+                frame_to_rgb(frame, gamma_lut, image.data(), h.width * 3);
+                fwrite(image.data(), 1, image.size(), file);
+            }
+        }
+    });
+
+    vector<uint8_t> buffer(1 << 16);
+    auto start = high_resolution_clock::now();
+    while (parser.stats().frames < n_frames && !ring_failed) {
+        // Not blocked in read when the link goes quiet, so a failure of the ring stops the receiver
+        struct pollfd readable = {fd, POLLIN, 0};
+        if (poll(&readable, 1, RING_TIMEOUT_MS) == 0) {
+            continue;
+        }
+        ssize_t n = read(fd, buffer.data(), buffer.size());
+        if (n <= 0) {
+            break;
+        }
+        parser.feed(buffer.data(), n);
+    }
+    double seconds = duration<double>(high_resolution_clock::now() - start).count();
+    queue.close();
+    consumer.join();
+
+    const LinkStats& stats = parser.stats();
+    printf(ring_failed ? "[ERROR] Stopped after %" PRIu64 " frames received in %.2f seconds (%.0f bytes/s)\n"
+                       : "[SUCCESS] %" PRIu64 " frames received in %.2f seconds (%.0f bytes/s)\n",
+           stats.frames, seconds, stats.bytes / seconds);
+    printf("[INFO] Header errors: %" PRIu64 ", payload errors: %" PRIu64 ", lost frames: %" PRIu64 ", skipped bytes: %" PRIu64 "\n",
+           stats.header_errors, stats.payload_errors, stats.lost_frames, stats.skipped_bytes);
+    if (ring != NULL) {
+        // The inference process keeps reading the frames left in the ring
+        frame_ring_close(ring);
+        frame_ring_destroy(ring);
+    } else {
+        fclose(file);
+    }
+    close(fd);
+    return ring_failed ? 1 : 0;
+}
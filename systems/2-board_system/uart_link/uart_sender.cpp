@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+
+#include "isp.h"
+#include "uart_link.h"
+
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -I../../isp -o uart_sender uart_sender.cpp uart_link.cpp ../../isp/isp.cpp -lpthread
+// (add -DUSE_LZ4 ... -llz4 for the lz4 option)
+
+int main(int argc, char** argv) {
+    /*
+        Send the images of a capture file (raw RGB images, no labels) over the link.
+        With a ROI "x,y,w,h", only this region of each image is sent.
+        With raw8 or raw10, the capture file holds 10-bit Bayer frames
+        (uint16_t per sample, before AXI_BayerToRGB) and they are sent as
+        Bayer samples, demosaiced by the receiver.
+    */
+    if (argc < 6) {
+        printf("Usage: %s <port> <baudrate> <capture_file> <width> <height> [lz4] [raw8|raw10] [x,y,w,h]\n", argv[0]);
+        return 1;
+    }
+    const char* port = argv[1];
+    int baudrate = atoi(argv[2]);
+    const char* capture_file = argv[3];
+    int width = atoi(argv[4]);
+    int height = atoi(argv[5]);
+    bool compress = false;
+    int bayer_format = 0;
+    int roi[4] = {0, 0, 0, 0};
+    for (int i = 6; i < argc; i++) {
+        if (strcmp(argv[i], "lz4") == 0) {
+            compress = true;
+        } else if (strcmp(argv[i], "raw8") == 0) {
+            bayer_format = BAYER_RAW8;
+        } else if (strcmp(argv[i], "raw10") == 0) {
+            bayer_format = BAYER_RAW10;
+        } else if (sscanf(argv[i], "%d,%d,%d,%d", &roi[0], &roi[1], &roi[2], &roi[3]) != 4) {
+            fprintf(stderr, "[ERROR] Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (roi[2] > 0 && (roi[0] + roi[2] > width || roi[1] + roi[3] > height)) {
+        fprintf(stderr, "[ERROR] The ROI is outside of the %dx%d images\n", width, height);
+        return 1;
+    }
+#ifndef USE_LZ4
+    if (compress) {
+        printf("[INFO] Built without LZ4, the images are sent uncompressed\n");
+    }
+#endif
+
+    FILE* file = fopen(capture_file, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Failed to open %s\n", capture_file);
+        return 1;
+    }
+    int fd = open_serial(port, baudrate);
+    if (fd < 0) {
+        fclose(file);
+        return 1;
+    }
+
+    size_t image_size = bayer_format ? width * height * sizeof(uint16_t) : width * height * 3;
+    vector<uint8_t> image(image_size), frame;
+    uint16_t seq = 0;
+    size_t bytes = 0;
+    auto start = high_resolution_clock::now();
+    while (fread(image.data(), 1, image_size, file) == image_size) {
+        if (bayer_format) {
+            if (roi[2] == 0) {
+                roi[2] = width;
+                roi[3] = height;
+            }
+            encode_bayer_frame((const uint16_t*)image.data(), width, height, roi[0], roi[1], roi[2], roi[3], bayer_format, seq, compress, frame);
+        } else if (roi[2] > 0) {
+            encode_roi_frame(image.data(), width, height, roi[0], roi[1], roi[2], roi[3], seq, compress, frame);
+        } else {
+            encode_frame(image.data(), width, height, seq, compress, frame);
+        }
+        // The UART driver does the pacing on a real port
+        if (!write_paced(fd, frame.data(), frame.size(), 0)) {
+            fprintf(stderr, "[ERROR] Failed to write to %s\n", port);
+            break;
+        }
+        bytes += frame.size();
+        seq++;
+    }
+    tcdrain(fd);
+    double seconds = duration<double>(high_resolution_clock::now() - start).count();
+
+    printf("[SUCCESS] %d frames sent (%zu bytes, %.2f bytes/image) in %.2f seconds\n",
+           seq, bytes, seq ? (double)bytes / seq : 0.0, seconds);
+    close(fd);
+    fclose(file);
+    return 0;
+}
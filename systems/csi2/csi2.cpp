@@ -0,0 +1,283 @@
+#include <string.h>
+
+#include <algorithm>
+
+#include "csi2.h"
+#include "isp.h"
+
+using namespace std;
+
+#define HEADER_SIZE     4
+#define MAX_PACKET_SIZE (HEADER_SIZE + 65535 + 2)
+#define MAX_DATA_TYPE   0x37    // 0x38 to 0x3F are reserved
+
+// Parity bits of each of the 24 data bits (syndrome in ECC.vhd)
+static const uint8_t syndrome[24] = {
+    0x07, 0x0B, 0x0D, 0x0E, 0x13, 0x15, 0x16, 0x19, 0x1A, 0x1C, 0x23, 0x25,
+    0x26, 0x29, 0x2A, 0x2C, 0x31, 0x32, 0x34, 0x38, 0x1F, 0x2F, 0x37, 0x3B};
+
+static uint8_t ecc_table[3][256];       // ECC of each byte of the header
+static int8_t error_bit[64];            // Data bit to flip for an error syndrome, -1 if none
+static uint16_t crc_table[8][256];      // Slicing by 8
+
+static bool init_tables() {
+    for (int k = 0; k < 3; k++) {
+        for (int v = 0; v < 256; v++) {
+            uint8_t ecc = 0;
+            for (int b = 0; b < 8; b++) {
+                if (v & (1 << b)) {
+                    ecc ^= syndrome[8 * k + b];
+                }
+            }
+            ecc_table[k][v] = ecc;
+        }
+    }
+    memset(error_bit, -1, sizeof(error_bit));
+    for (int d = 0; d < 24; d++) {
+        error_bit[syndrome[d]] = d;
+    }
+
+    // crc_table[k][v]: CRC of byte v followed by k zero bytes
+    for (int v = 0; v < 256; v++) {
+        uint16_t crc = v;
+        for (int b = 0; b < 8; b++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0x8408 : crc >> 1;
+        }
+        crc_table[0][v] = crc;
+    }
+    for (int k = 1; k < 8; k++) {
+        for (int v = 0; v < 256; v++) {
+            uint16_t crc = crc_table[k - 1][v];
+            crc_table[k][v] = (crc >> 8) ^ crc_table[0][crc & 0xFF];
+        }
+    }
+    return true;
+}
+
+static bool tables_ready = init_tables();
+
+uint8_t csi2_ecc(const uint8_t header[3]) {
+    return ecc_table[0][header[0]] ^ ecc_table[1][header[1]] ^ ecc_table[2][header[2]];
+}
+
+int csi2_correct_header(uint8_t header[4]) {
+    uint8_t error = csi2_ecc(header) ^ header[3];
+    if (error == 0) {
+        return CSI2_HEADER_OK;
+    }
+    if ((error & (error - 1)) == 0 && error < 0x40) {
+        // A single bit of the ECC itself is wrong
+        header[3] ^= error;
+        return CSI2_HEADER_CORRECTED;
+    }
+    if (error < 0x40 && error_bit[error] >= 0) {
+        header[error_bit[error] / 8] ^= 1 << (error_bit[error] % 8);
+        return CSI2_HEADER_CORRECTED;
+    }
+    return CSI2_HEADER_ERROR;
+}
+
+uint16_t csi2_crc16(const uint8_t *data, size_t size, uint16_t crc) {
+    // 8 bytes per step: the CRC is folded into the first 2 bytes, the others only need their table
+    for (; size >= 8; data += 8, size -= 8) {
+        uint16_t x = crc ^ (data[0] | data[1] << 8);
+        crc = crc_table[7][x & 0xFF] ^ crc_table[6][x >> 8] ^
+              crc_table[5][data[2]] ^ crc_table[4][data[3]] ^
+              crc_table[3][data[4]] ^ crc_table[2][data[5]] ^
+              crc_table[1][data[6]] ^ crc_table[0][data[7]];
+    }
+    for (; size > 0; data++, size--) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *data) & 0xFF];
+    }
+    return crc;
+}
+
+size_t csi2_write_packet(uint8_t vc, uint8_t data_type, uint16_t word_count,
+                         const uint8_t *payload, uint8_t *out) {
+    out[0] = vc << 6 | (data_type & 0x3F);
+    out[1] = word_count & 0xFF;
+    out[2] = word_count >> 8;
+    out[3] = csi2_ecc(out);
+    if (data_type < 0x10) {
+        return HEADER_SIZE;
+    }
+    memcpy(out + HEADER_SIZE, payload, word_count);
+    uint16_t crc = csi2_crc16(payload, word_count);
+    out[HEADER_SIZE + word_count] = crc & 0xFF;
+    out[HEADER_SIZE + word_count + 1] = crc >> 8;
+    return HEADER_SIZE + word_count + 2;
+}
+
+Csi2Decoder::Csi2Decoder(function<void(Csi2Frame&)> on_frame, bool unpack)
+    : on_frame(on_frame), unpack(unpack) {}
+
+void Csi2Decoder::feed(const uint8_t *data, size_t size) {
+    if (!buffer.empty()) {
+        // End of the previous chunk: complete its packet with the beginning of this one
+        size_t old_size = buffer.size();
+        // Enough for the largest packet and the next header
+        size_t added = min(size, (size_t)MAX_PACKET_SIZE + HEADER_SIZE);
+        buffer.insert(buffer.end(), data, data + added);
+        size_t used = parse(buffer.data(), buffer.size(), false);
+        if (used < old_size) {
+            // Only possible if the whole chunk was added: still waiting for the end of a packet
+            buffer.erase(buffer.begin(), buffer.begin() + used);
+            return;
+        }
+        buffer.clear();
+        data += used - old_size;
+        size -= used - old_size;
+    }
+    size_t used = parse(data, size, false);
+    buffer.assign(data + used, data + size);
+}
+
+void Csi2Decoder::flush() {
+    parse(buffer.data(), buffer.size(), true);
+    buffer.clear();
+    synchronized = false;
+}
+
+static bool valid_header(const uint8_t *data, bool allow_correction) {
+    uint8_t header[HEADER_SIZE];
+    memcpy(header, data, HEADER_SIZE);
+    int ecc = csi2_correct_header(header);
+    return (ecc == CSI2_HEADER_OK || (ecc == CSI2_HEADER_CORRECTED && allow_correction)) &&
+           (header[3] & 0xC0) == 0 && (header[0] & 0x3F) <= MAX_DATA_TYPE;
+}
+
+size_t Csi2Decoder::parse(const uint8_t *data, size_t size, bool last) {
+    /*
+        Returns the number of bytes used, the rest is an incomplete packet.
+        Long packets with a valid header and CRC are trusted, and so are short
+        packets without error right after another packet, if they fit the
+        frame of their virtual channel (see expected). Short packets with a
+        corrected header must fit it too. Other short packets,
+        corrected headers and CRC errors are accepted only if the next header
+        is valid (or at the end of the capture, with last), and long packets
+        with both are rejected. One of the two headers must be without error,
+        and the next one too after a CRC error, so that the bytes between the
+        packets are not taken for a packet (a long one could hide up to 64 KB
+        of valid packets).
+    */
+    size_t pos = 0;
+    while (size - pos >= HEADER_SIZE) {
+        uint8_t header[HEADER_SIZE];
+        memcpy(header, data + pos, HEADER_SIZE);
+        int ecc = csi2_correct_header(header);
+        int data_type = header[0] & 0x3F;
+        size_t word_count = header[1] | header[2] << 8;
+        bool valid = ecc != CSI2_HEADER_ERROR && (header[3] & 0xC0) == 0 && data_type <= MAX_DATA_TYPE;
+        bool is_long = data_type >= 0x10;
+        size_t packet_size = HEADER_SIZE + (is_long ? word_count + 2 : 0);
+        bool crc_ok = true;
+
+        if (valid && is_long && size - pos < packet_size) {
+            if (!last) {
+                break;
+            }
+            valid = false;
+        }
+        if (valid && is_long) {
+            const uint8_t *payload = data + pos + HEADER_SIZE;
+            crc_ok = csi2_crc16(payload, word_count) == (payload[word_count] | payload[word_count + 1] << 8);
+            valid = crc_ok || ecc == CSI2_HEADER_OK;
+        }
+        if (valid && !is_long && ecc == CSI2_HEADER_CORRECTED) {
+            valid = expected(header);
+        }
+        bool trusted = ecc == CSI2_HEADER_OK && (is_long ? crc_ok : synchronized && expected(header));
+        if (valid && !trusted) {
+            if (size - pos >= packet_size + HEADER_SIZE) {
+                valid = valid_header(data + pos + packet_size, ecc == CSI2_HEADER_OK && crc_ok);
+            } else if (!last) {
+                break;
+            }
+        }
+
+        if (!valid) {
+            if (synchronized) {
+                decoder_stats.header_errors++;
+                synchronized = false;
+            }
+            decoder_stats.skipped_bytes++;
+            pos++;
+            continue;
+        }
+        decoder_stats.corrected_headers += ecc == CSI2_HEADER_CORRECTED;
+        decoder_stats.crc_errors += !crc_ok;
+        synchronized = true;
+        packet(header, is_long ? data + pos + HEADER_SIZE : NULL, crc_ok);
+        pos += packet_size;
+    }
+    return pos;
+}
+
+bool Csi2Decoder::expected(const uint8_t *header) const {
+    // Frame start outside of a frame, frame end with the number of the frame start, line start or end in a frame
+    int vc = header[0] >> 6;
+    int word_count = header[1] | header[2] << 8;
+    switch (header[0] & 0x3F) {
+        case CSI2_DT_FRAME_START: return !in_frame[vc];
+        case CSI2_DT_FRAME_END:   return in_frame[vc] && word_count == frames[vc].frame_number;
+        case CSI2_DT_LINE_START:
+        case CSI2_DT_LINE_END:    return in_frame[vc];
+        default:                  return false;
+    }
+}
+
+void Csi2Decoder::packet(const uint8_t *header, const uint8_t *payload, bool crc_ok) {
+    int vc = header[0] >> 6;
+    int data_type = header[0] & 0x3F;
+    int word_count = header[1] | header[2] << 8;
+    Csi2Frame& frame = frames[vc];
+    decoder_stats.packets++;
+
+    if (data_type == CSI2_DT_FRAME_START) {
+        if (in_frame[vc]) {
+            decoder_stats.incomplete_frames++;
+        }
+        in_frame[vc] = true;
+        frame.vc = vc;
+        frame.frame_number = word_count;
+        frame.width = frame.height = 0;
+        frame.data_type = -1;
+        frame.crc_errors = 0;
+    } else if (data_type == CSI2_DT_FRAME_END) {
+        if (in_frame[vc]) {
+            decoder_stats.frames++;
+            in_frame[vc] = false;
+            frame.samples.resize(unpack ? (size_t)frame.width * frame.height : 0);
+            on_frame(frame);
+        } else {
+            decoder_stats.incomplete_frames++;
+        }
+    } else if (data_type == CSI2_DT_RAW8 || data_type == CSI2_DT_RAW10) {
+        decoder_stats.lines++;
+        if (!in_frame[vc]) {
+            return;
+        }
+        // RAW10: 4 samples in 5 bytes
+        int width = data_type == CSI2_DT_RAW10 ? word_count / 5 * 4 : word_count;
+        if (frame.height == 0) {
+            frame.width = width;
+            frame.data_type = data_type;
+        } else if (width != frame.width || data_type != frame.data_type) {
+            // Not the same frame any more, wait for the next frame start
+            decoder_stats.incomplete_frames++;
+            in_frame[vc] = false;
+            return;
+        }
+        frame.crc_errors += !crc_ok;
+        if (unpack) {
+            // The buffer of the previous frame is reused, it only grows
+            size_t start = (size_t)frame.height * width;
+            if (frame.samples.size() < start + width) {
+                frame.samples.resize(start + width);
+            }
+            unpack_bayer(payload, width, data_type == CSI2_DT_RAW10 ? BAYER_RAW10 : BAYER_RAW8,
+                         frame.samples.data() + start);
+        }
+        frame.height++;
+    }
+}
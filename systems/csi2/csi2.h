@@ -0,0 +1,104 @@
+#ifndef CSI2_H
+#define CSI2_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+/*
+    Software version of the low level protocol of the MIPI_CSI_2_RX IP
+    (LLP.vhd, ECC.vhd, CRC16_behavioral.vhd), to decode captures of the
+    camera link on a host.
+
+    The input is the byte stream of the packets, after the lanes are merged
+    (the output of LM.vhd): for each packet a 4-byte header (data identifier,
+    word count LSB and MSB, ECC), then for long packets the word count bytes
+    of payload and the CRC16 of the payload, LSB first. Bytes between the
+    packets (sync bytes, padding of the lanes, garbage) are skipped.
+*/
+
+// Data types (6 LSBs of the data identifier, the 2 MSBs are the virtual channel)
+#define CSI2_DT_FRAME_START     0x00
+#define CSI2_DT_FRAME_END       0x01
+#define CSI2_DT_LINE_START      0x02
+#define CSI2_DT_LINE_END        0x03
+#define CSI2_DT_EMBEDDED        0x12
+#define CSI2_DT_RGB565          0x22
+#define CSI2_DT_RAW8            0x2A
+#define CSI2_DT_RAW10           0x2B
+
+// Results of csi2_correct_header, like sValid and sError of ECC.vhd
+#define CSI2_HEADER_OK          0   // No error
+#define CSI2_HEADER_CORRECTED   1   // One bit was wrong and is corrected
+#define CSI2_HEADER_ERROR       2   // More than one bit is wrong
+
+// ECC of the 24 bits of a header (data identifier and word count)
+uint8_t csi2_ecc(const uint8_t header[3]);
+
+// Check the ECC of a 4-byte header and correct a single bit error in place
+int csi2_correct_header(uint8_t header[4]);
+
+// CRC16 of the payload of long packets: polynomial x^16 + x^12 + x^5 + 1,
+// reflected, starts at 0xFFFF
+uint16_t csi2_crc16(const uint8_t *data, size_t size, uint16_t crc = 0xFFFF);
+
+// Write a packet: header with its ECC, and payload with its CRC for long packets
+// (data types 0x10 and above). Returns the number of bytes written.
+size_t csi2_write_packet(uint8_t vc, uint8_t data_type, uint16_t word_count,
+                         const uint8_t *payload, uint8_t *out);
+
+typedef struct {
+    uint64_t packets;
+    uint64_t lines;
+    uint64_t frames;
+    uint64_t corrected_headers;     // Single bit errors corrected by the ECC
+    uint64_t header_errors;         // Invalid headers right after a packet (synchronization lost)
+    uint64_t crc_errors;            // Long packets with a wrong CRC (the line is still used)
+    uint64_t incomplete_frames;     // Frame end without frame start, or lines of different sizes
+    uint64_t skipped_bytes;         // Bytes that are not part of a valid packet
+} Csi2Stats;
+
+typedef struct {
+    int vc;
+    uint16_t frame_number;          // Word count of the frame start packet
+    int width;
+    int height;
+    int data_type;
+    int crc_errors;                 // Lines of this frame with a wrong CRC
+    std::vector<uint16_t> samples;  // 10-bit samples (RAW8 shifted by 2), width * height
+} Csi2Frame;
+
+/*
+    Streaming decoder: feed it the bytes of the capture in chunks of any
+    size. Packets are parsed in place in the chunk when they are complete,
+    only the end of a chunk is kept for the next one. RAW8 and RAW10 lines
+    are unpacked between the frame start and end of their virtual channel,
+    and on_frame is called at the frame end. With unpack false, the packets
+    are only checked (ECC, CRC, frame structure), which is faster.
+    Packets that could be garbage are only used once the header of the next
+    one is there: call flush at the end of the capture.
+*/
+class Csi2Decoder {
+public:
+    explicit Csi2Decoder(std::function<void(Csi2Frame&)> on_frame, bool unpack = true);
+    void feed(const uint8_t *data, size_t size);
+    void flush();
+    const Csi2Stats& stats() const { return decoder_stats; }
+
+private:
+    size_t parse(const uint8_t *data, size_t size, bool last);
+    bool expected(const uint8_t *header) const;
+    void packet(const uint8_t *header, const uint8_t *payload, bool crc_ok);
+
+    std::function<void(Csi2Frame&)> on_frame;
+    bool unpack;
+    bool synchronized = false;      // The last bytes were a valid packet
+    std::vector<uint8_t> buffer;
+    Csi2Stats decoder_stats = {};
+    Csi2Frame frames[4];            // One per virtual channel
+    bool in_frame[4] = {};
+};
+
+#endif // CSI2_H
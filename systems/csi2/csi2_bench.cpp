@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "csi2.h"
+#include "isp.h"
+
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -I../isp -o csi2_bench csi2_bench.cpp csi2.cpp ../isp/isp.cpp
+
+#define ERROR_HEADER    0   // One bit of the header flipped, corrected by the ECC
+#define ERROR_PAYLOAD   1   // One bit of the payload flipped, CRC error
+#define ERROR_GARBAGE   2   // Random bytes between two packets
+#define ERROR_DROP      3   // Packet lost
+
+uint16_t serial_crc16(const uint8_t* data, size_t size) {
+    // Bit by bit transcription of crc16_serial in CRC16_behavioral.vhd
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < size; i++) {
+        for (int b = 0; b < 8; b++) {
+            int bit = (data[i] >> b) & 1;
+            crc = ((crc ^ bit) & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+int main(int argc, char** argv) {
+    /*
+        Builds a capture of RAW10 frames (frame start, one long packet per
+        line, frame end) with errors in a given fraction of the packets,
+        decodes it in chunks and checks the frames against the images sent:
+        frames with corrected headers must be exact, frames with a corrupted
+        payload must report CRC errors, lost packets must drop their frame.
+        Then measures the speed of the CRC and of the decoder without errors.
+        With capture_file, the capture with errors is also written to a file,
+        to test csi2_decode.
+    */
+    int width = argc > 1 ? atoi(argv[1]) : 1920;
+    int height = argc > 2 ? atoi(argv[2]) : 1080;
+    int n_frames = argc > 3 ? atoi(argv[3]) : 10;
+    double error_rate = argc > 4 ? atof(argv[4]) : 0.001;
+    if (width <= 0 || width % 4 != 0 || height <= 0 || n_frames <= 0) {
+        printf("Usage: %s [width (multiple of 4)] [height] [n_frames] [error_rate] [capture_file]\n", argv[0]);
+        return 1;
+    }
+
+    // The CRC of the examples of the CSI-2 specification, and of the HDL on random data
+    const uint8_t examples[2][24] = {
+        {0xFF, 0x00, 0x00, 0x02, 0xB9, 0xDC, 0xF3, 0x72, 0xBB, 0xD4, 0xB8, 0x5A,
+         0xC8, 0x75, 0xC2, 0x7C, 0x81, 0xF8, 0x05, 0xDF, 0xFF, 0x00, 0x00, 0x01},
+        {0xFF, 0x00, 0x00, 0x00, 0x1E, 0xF0, 0x1E, 0xC7, 0x4F, 0x82, 0x78, 0xC5,
+         0x82, 0xE0, 0x8C, 0x70, 0xD2, 0x3C, 0x78, 0xE9, 0xFF, 0x00, 0x00, 0x01}};
+    int errors = csi2_crc16(examples[0], 24) != 0x00F0 || csi2_crc16(examples[1], 24) != 0xE569;
+    mt19937 rng(1);
+    for (int t = 0; t < 100; t++) {
+        vector<uint8_t> data(rng() % 300);
+        for (auto& v : data) {
+            v = rng();
+        }
+        errors += csi2_crc16(data.data(), data.size()) != serial_crc16(data.data(), data.size());
+    }
+
+    // Every single bit error of a header is corrected, double errors are detected
+    for (int t = 0; t < 1000; t++) {
+        uint8_t header[4] = {(uint8_t)(rng() & 0x3F), (uint8_t)rng(), (uint8_t)rng(), 0};
+        header[3] = csi2_ecc(header);
+        uint8_t original[4];
+        memcpy(original, header, 4);
+        int b1 = rng() % 30, b2 = (b1 + 1 + rng() % 29) % 30;
+        // Bits 24 to 29 are the ECC, bits 30 and 31 are not covered
+        header[b1 / 8] ^= 1 << (b1 % 8);
+        errors += csi2_correct_header(header) != CSI2_HEADER_CORRECTED || memcmp(header, original, 4) != 0;
+        header[b1 / 8] ^= 1 << (b1 % 8);
+        header[b2 / 8] ^= 1 << (b2 % 8);
+        errors += csi2_correct_header(header) != CSI2_HEADER_ERROR;
+    }
+    if (errors > 0) {
+        fprintf(stderr, "[ERROR] %d ECC or CRC checks failed\n", errors);
+        return 1;
+    }
+    printf("[INFO] ECC and CRC match the HDL\n");
+
+    // Capture with errors
+    int line_bytes = width / 4 * 5;
+    vector<vector<uint16_t>> images(n_frames, vector<uint16_t>((size_t)width * height));
+    vector<uint8_t> capture, clean;
+    vector<int> frame_errors(n_frames, -1);     // Error of each frame, -1 if none
+    vector<uint8_t> line(line_bytes), packet(line_bytes + 6);
+    uniform_real_distribution<double> uniform(0, 1);
+    int n_injected = 0;
+    for (int f = 0; f < n_frames; f++) {
+        for (auto& s : images[f]) {
+            s = rng() & 1023;
+        }
+        for (int y = -1; y <= height; y++) {
+            size_t size;
+            if (y == -1) {
+                size = csi2_write_packet(0, CSI2_DT_FRAME_START, f + 1, NULL, packet.data());
+            } else if (y == height) {
+                size = csi2_write_packet(0, CSI2_DT_FRAME_END, f + 1, NULL, packet.data());
+            } else {
+                pack_bayer(&images[f][(size_t)y * width], width, BAYER_RAW10, line.data());
+                size = csi2_write_packet(0, CSI2_DT_RAW10, line_bytes, line.data(), packet.data());
+            }
+            clean.insert(clean.end(), packet.begin(), packet.begin() + size);
+
+            // One error every other frame at most, so that its effect can be checked
+            // (a lost frame end followed by a lost frame start merges two frames)
+            if (f % 2 == 0 && frame_errors[f] < 0 && uniform(rng) < error_rate) {
+                int error = rng() % 4;
+                if (y < 0 || y == height) {
+                    error = error == ERROR_PAYLOAD ? ERROR_HEADER : error;
+                }
+                frame_errors[f] = error;
+                n_injected++;
+                if (error == ERROR_HEADER) {
+                    int bit = rng() % 30;
+                    packet[bit / 8] ^= 1 << (bit % 8);
+                } else if (error == ERROR_PAYLOAD) {
+                    packet[4 + rng() % line_bytes] ^= 1 << (rng() % 8);
+                } else if (error == ERROR_GARBAGE) {
+                    for (int k = rng() % 64 + 1; k > 0; k--) {
+                        capture.push_back(rng());
+                    }
+                } else {
+                    continue;
+                }
+            }
+            capture.insert(capture.end(), packet.begin(), packet.begin() + size);
+        }
+    }
+
+    if (argc > 5) {
+        FILE* file = fopen(argv[5], "wb");
+        if (file == NULL || fwrite(capture.data(), 1, capture.size(), file) != capture.size()) {
+            fprintf(stderr, "[ERROR] Failed to write %s\n", argv[5]);
+            return 1;
+        }
+        fclose(file);
+    }
+
+    // Decoding in chunks of random sizes, to cross the packets anywhere
+    vector<int> received(n_frames, 0);
+    Csi2Decoder decoder([&](Csi2Frame& frame) {
+        int f = frame.frame_number - 1;
+        if (f < 0 || f >= n_frames) {
+            errors++;
+            return;
+        }
+        received[f]++;
+        bool exact = frame.width == width && frame.height == height && frame.samples == images[f];
+        if (frame_errors[f] == ERROR_PAYLOAD) {
+            errors += frame.crc_errors != 1 || exact;
+        } else if (frame_errors[f] == ERROR_DROP) {
+            // Only a lost line leaves a frame, one line short
+            errors += frame.crc_errors != 0 || frame.height != height - 1;
+        } else {
+            errors += frame.crc_errors != 0 || !exact;
+        }
+    });
+    for (size_t pos = 0; pos < capture.size();) {
+        size_t chunk = min(capture.size() - pos, (size_t)(rng() % 200000 + 1));
+        decoder.feed(capture.data() + pos, chunk);
+        pos += chunk;
+    }
+    decoder.flush();
+    for (int f = 0; f < n_frames; f++) {
+        // A lost frame start or frame end loses the frame
+        errors += frame_errors[f] == ERROR_DROP ? received[f] > 1 : received[f] != 1;
+    }
+    const Csi2Stats& s = decoder.stats();
+    printf("[INFO] %d errors injected in %d frames: %lu frames, %lu corrected headers, %lu header errors, "
+           "%lu CRC errors, %lu incomplete frames, %lu skipped bytes\n",
+           n_injected, n_frames, s.frames, s.corrected_headers, s.header_errors, s.crc_errors,
+           s.incomplete_frames, s.skipped_bytes);
+    if (errors > 0) {
+        fprintf(stderr, "[ERROR] %d frames are not as expected\n", errors);
+        return 1;
+    }
+
+    // Speed on the capture without errors
+    double gb = clean.size() / 1e9;
+    auto start = steady_clock::now();
+    volatile uint16_t crc = csi2_crc16(clean.data(), clean.size());
+    (void)crc;
+    double crc_s = duration<double>(steady_clock::now() - start).count();
+
+    double rates[2];
+    for (int unpack = 0; unpack < 2; unpack++) {
+        uint64_t n_samples = 0;
+        Csi2Decoder fast([&](Csi2Frame& frame) { n_samples += frame.samples.size(); }, unpack);
+        start = steady_clock::now();
+        for (size_t pos = 0; pos < clean.size(); pos += 4 << 20) {
+            fast.feed(clean.data() + pos, min(clean.size() - pos, (size_t)4 << 20));
+        }
+        fast.flush();
+        rates[unpack] = gb / duration<double>(steady_clock::now() - start).count();
+        if (fast.stats().frames != (uint64_t)n_frames || n_samples != (unpack ? (uint64_t)n_frames * width * height : 0)) {
+            fprintf(stderr, "[ERROR] Frames lost without errors\n");
+            return 1;
+        }
+    }
+    printf("[INFO] %dx%d RAW10, %d frames, %.1f MB\n", width, height, n_frames, gb * 1e3);
+    printf("[INFO] CRC16:                  %.2f GB/s\n", gb / crc_s);
+    printf("[INFO] Decoder, check only:    %.2f GB/s\n", rates[0]);
+    printf("[INFO] Decoder, RAW10 samples: %.2f GB/s\n", rates[1]);
+    printf("[SUCCESS] All frames decoded as expected\n");
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "csi2.h"
+
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -I../isp -o csi2_decode csi2_decode.cpp csi2.cpp ../isp/isp.cpp
+
+#define CHUNK_SIZE (4 << 20)
+
+int main(int argc, char** argv) {
+    /*
+        Decodes a capture of the CSI-2 packets of the camera (lanes merged)
+        and reports the errors: corrected headers, lost synchronization, CRC
+        errors, incomplete frames. With bayer_file, the frames of virtual
+        channel vc (0 by default) are written as 10-bit samples, one uint16_t
+        each, which isp_convert (systems/isp) turns into RGB images. Frames
+        of a different size than the first one are not written.
+    */
+    if (argc < 2) {
+        printf("Usage: %s <capture_file> [bayer_file] [vc]\n", argv[0]);
+        return 1;
+    }
+    FILE* capture = fopen(argv[1], "rb");
+    FILE* bayer_file = argc > 2 ? fopen(argv[2], "wb") : NULL;
+    int vc = argc > 3 ? atoi(argv[3]) : 0;
+    if (capture == NULL || (argc > 2 && bayer_file == NULL)) {
+        fprintf(stderr, "[ERROR] Failed to open the files\n");
+        return 1;
+    }
+
+    int width = 0, height = 0;
+    long n_written = 0, n_skipped = 0;
+    Csi2Decoder decoder([&](Csi2Frame& frame) {
+        if (frame.crc_errors > 0) {
+            printf("[INFO] Frame %u of VC %d: %d lines with a CRC error\n", frame.frame_number, frame.vc, frame.crc_errors);
+        }
+        if (bayer_file == NULL || frame.vc != vc) {
+            return;
+        }
+        if (width == 0) {
+            width = frame.width;
+            height = frame.height;
+            printf("[INFO] Frames of %dx%d, %s\n", width, height, frame.data_type == CSI2_DT_RAW10 ? "RAW10" : "RAW8");
+        }
+        if (frame.width != width || frame.height != height) {
+            n_skipped++;
+            return;
+        }
+        fwrite(frame.samples.data(), sizeof(uint16_t), frame.samples.size(), bayer_file);
+        n_written++;
+    }, bayer_file != NULL);
+
+    vector<uint8_t> chunk(CHUNK_SIZE);
+    size_t total = 0, n;
+    auto start = steady_clock::now();
+    while ((n = fread(chunk.data(), 1, chunk.size(), capture)) > 0) {
+        decoder.feed(chunk.data(), n);
+        total += n;
+    }
+    decoder.flush();
+    double seconds = duration<double>(steady_clock::now() - start).count();
+    fclose(capture);
+
+    const Csi2Stats& s = decoder.stats();
+    printf("[INFO] %lu packets, %lu lines, %lu frames\n", s.packets, s.lines, s.frames);
+    printf("[INFO] Corrected headers: %lu, synchronization lost: %lu, CRC errors: %lu, incomplete frames: %lu, skipped bytes: %lu\n",
+           s.corrected_headers, s.header_errors, s.crc_errors, s.incomplete_frames, s.skipped_bytes);
+    if (bayer_file != NULL) {
+        fclose(bayer_file);
+        printf("[INFO] %ld frames written to %s, %ld frames of another size skipped\n", n_written, argv[2], n_skipped);
+    }
+    printf("[SUCCESS] %.1f MB decoded in %.2f seconds (%.2f GB/s)\n", total / 1e6, seconds, total / 1e9 / seconds);
+    return 0;
+}
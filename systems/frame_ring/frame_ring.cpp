@@ -0,0 +1,332 @@
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+
+#include "frame_ring.h"
+
+using namespace std;
+
+#define RING_MAGIC      0x474E5246u     // "FRNG"
+#define RING_VERSION    2
+#define RING_ALIGN      4096
+#define OPEN_RETRY_MS   10
+
+// Start of the shared memory, followed by the FrameRingInfo of each slot, then the slots
+typedef struct {
+    uint32_t magic;                 // Written last by the creator
+    uint32_t version;
+    uint32_t n_slots;
+    uint32_t slot_size;
+    uint64_t slot_stride;
+    uint64_t data_offset;
+    uint64_t map_size;
+
+    // Each counter on its own cache line, written by one side only.
+    // The events are the futex words: they change after each update of the
+    // counter of the other side, and on close.
+    alignas(64) atomic<uint32_t> head;      // Frames committed by the producer
+    atomic<uint32_t> consumer_event;
+    atomic<uint32_t> consumer_waiting;
+    alignas(64) atomic<uint32_t> tail;      // Frames released by the consumer
+    atomic<uint32_t> producer_event;
+    atomic<uint32_t> producer_waiting;
+    alignas(64) atomic<uint32_t> closed;
+    // Processes of the two sides, 0 until the other side opens the ring
+    atomic<int32_t> creator_pid;
+    atomic<int32_t> opener_pid;
+} RingShared;
+
+struct FrameRing {
+    RingShared *shared;
+    FrameRingInfo *infos;
+    uint8_t *data;
+    string name;
+    bool owner;
+};
+
+static size_t align_up(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void futex_wait(atomic<uint32_t> *word, uint32_t value, int64_t timeout_ns) {
+    // The futexes are shared between processes, so no FUTEX_PRIVATE_FLAG
+    struct timespec ts, *timeout = NULL;
+    if (timeout_ns >= 0) {
+        ts.tv_sec = timeout_ns / 1000000000;
+        ts.tv_nsec = timeout_ns % 1000000000;
+        timeout = &ts;
+    }
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, value, timeout, NULL, 0);
+}
+
+static void futex_wake(atomic<uint32_t> *word) {
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+static bool process_alive(pid_t pid) {
+    // A process that exited but was not waited for yet is a zombie: dead too
+    if (kill(pid, 0) != 0 && errno != EPERM) {
+        return false;
+    }
+    char path[64], stat[256] = "";
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return true;
+    }
+    size_t n = fread(stat, 1, sizeof(stat) - 1, file);
+    fclose(file);
+    stat[n] = '\0';
+    const char *state = strrchr(stat, ')');
+    return state == NULL || state[1] == '\0' || (state[2] != 'Z' && state[2] != 'X');
+}
+
+static FrameRing *map_ring(int fd, size_t map_size, const char *name, bool owner) {
+    void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "[ERROR] Failed to map the frame ring %s: %s\n", name, strerror(errno));
+        return NULL;
+    }
+    FrameRing *ring = new FrameRing;
+    ring->shared = (RingShared *)map;
+    ring->infos = (FrameRingInfo *)((uint8_t *)map + align_up(sizeof(RingShared), 64));
+    ring->name = name;
+    ring->owner = owner;
+    return ring;
+}
+
+FrameRing *frame_ring_create(const char *name, uint32_t n_slots, uint32_t slot_size) {
+    if (n_slots == 0 || (n_slots & (n_slots - 1)) != 0 || slot_size == 0) {
+        // The counters run freely and wrap at 2^32: only a power of 2 divides it
+        fprintf(stderr, "[ERROR] The frame ring %s needs a power of 2 slots and a slot size, not %u slots of %u bytes\n",
+                name, n_slots, slot_size);
+        return NULL;
+    }
+    size_t data_offset = align_up(align_up(sizeof(RingShared), 64) + n_slots * sizeof(FrameRingInfo), RING_ALIGN);
+    size_t slot_stride = align_up(slot_size, RING_ALIGN);
+    size_t map_size = data_offset + n_slots * slot_stride;
+
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 || ftruncate(fd, map_size) != 0) {
+        fprintf(stderr, "[ERROR] Failed to create the frame ring %s: %s\n", name, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(name);
+        }
+        return NULL;
+    }
+    FrameRing *ring = map_ring(fd, map_size, name, true);
+    if (ring == NULL) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    // ftruncate filled the memory with zeros: counters at 0, not closed
+    RingShared *shared = ring->shared;
+    shared->version = RING_VERSION;
+    shared->n_slots = n_slots;
+    shared->slot_size = slot_size;
+    shared->slot_stride = slot_stride;
+    shared->data_offset = data_offset;
+    shared->map_size = map_size;
+    shared->creator_pid.store(getpid());
+    atomic_thread_fence(memory_order_release);
+    shared->magic = RING_MAGIC;
+    ring->data = (uint8_t *)shared + data_offset;
+    return ring;
+}
+
+static FrameRing *open_ring(const char *name, bool verbose) {
+    int fd = shm_open(name, O_RDWR, 0);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RingShared)) {
+        if (verbose) {
+            fprintf(stderr, "[ERROR] Failed to open the frame ring %s\n", name);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    FrameRing *ring = map_ring(fd, st.st_size, name, false);
+    if (ring == NULL) {
+        return NULL;
+    }
+    RingShared *shared = ring->shared;
+    atomic_thread_fence(memory_order_acquire);
+    if (shared->magic != RING_MAGIC || shared->version != RING_VERSION || shared->map_size != (uint64_t)st.st_size ||
+        shared->n_slots == 0 || (shared->n_slots & (shared->n_slots - 1)) != 0) {
+        if (verbose) {
+            fprintf(stderr, "[ERROR] %s is not a frame ring, or is not initialised yet\n", name);
+        }
+        munmap(shared, st.st_size);
+        delete ring;
+        return NULL;
+    }
+    shared->opener_pid.store(getpid());
+    ring->data = (uint8_t *)shared + shared->data_offset;
+    return ring;
+}
+
+FrameRing *frame_ring_open(const char *name) {
+    return open_ring(name, true);
+}
+
+FrameRing *frame_ring_open_wait(const char *name, int timeout_ms) {
+    uint64_t deadline = timeout_ms < 0 ? 0 : now_ns() + (uint64_t)timeout_ms * 1000000;
+    for (;;) {
+        FrameRing *ring = open_ring(name, false);
+        if (ring != NULL) {
+            return ring;
+        }
+        if (deadline != 0 && now_ns() >= deadline) {
+            // Once more for the error message
+            return open_ring(name, true);
+        }
+        usleep(OPEN_RETRY_MS * 1000);
+    }
+}
+
+void frame_ring_destroy(FrameRing *ring) {
+    if (ring == NULL) {
+        return;
+    }
+    munmap(ring->shared, ring->shared->map_size);
+    if (ring->owner) {
+        shm_unlink(ring->name.c_str());
+    }
+    delete ring;
+}
+
+uint32_t frame_ring_n_slots(const FrameRing *ring) {
+    return ring->shared->n_slots;
+}
+
+uint32_t frame_ring_slot_size(const FrameRing *ring) {
+    return ring->shared->slot_size;
+}
+
+int frame_ring_peer_alive(const FrameRing *ring) {
+    pid_t pid = ring->owner ? ring->shared->opener_pid.load() : ring->shared->creator_pid.load();
+    if (pid == 0) {
+        return -1;
+    }
+    return process_alive(pid) ? 1 : 0;
+}
+
+int frame_ring_closed(const FrameRing *ring) {
+    return ring->shared->closed.load(memory_order_acquire) ? 1 : 0;
+}
+
+static bool wait_event(atomic<uint32_t> *event, atomic<uint32_t> *waiting, uint32_t value, uint64_t deadline) {
+    /*
+        Sleep while *event == value, until the deadline (0 for none).
+        Returns false on timeout. The value is read before checking the ring,
+        and the other side changes it after updating the ring, so a wake-up
+        between the check and the sleep is not lost.
+    */
+    waiting->store(1);
+    int64_t timeout = -1;
+    if (deadline != 0) {
+        uint64_t now = now_ns();
+        timeout = now < deadline ? deadline - now : 0;
+    }
+    if (timeout != 0) {
+        futex_wait(event, value, timeout);
+    }
+    waiting->store(0);
+    return deadline == 0 || now_ns() < deadline;
+}
+
+static void signal_event(atomic<uint32_t> *event, atomic<uint32_t> *waiting) {
+    event->fetch_add(1);
+    if (waiting->load()) {
+        futex_wake(event);
+    }
+}
+
+uint8_t *frame_ring_write_slot(FrameRing *ring, int timeout_ms) {
+    RingShared *shared = ring->shared;
+    uint64_t deadline = timeout_ms < 0 ? 0 : now_ns() + (uint64_t)timeout_ms * 1000000;
+    uint32_t head = shared->head.load(memory_order_relaxed);
+    for (;;) {
+        uint32_t event = shared->producer_event.load();
+        if (shared->closed.load(memory_order_acquire)) {
+            return NULL;
+        }
+        uint32_t tail = shared->tail.load(memory_order_acquire);
+        if (head - tail < shared->n_slots) {
+            return ring->data + (size_t)(head & (shared->n_slots - 1)) * shared->slot_stride;
+        }
+        if (!wait_event(&shared->producer_event, &shared->producer_waiting, event, deadline)) {
+            return NULL;
+        }
+    }
+}
+
+void frame_ring_commit(FrameRing *ring, const FrameRingInfo *info) {
+    RingShared *shared = ring->shared;
+    uint32_t head = shared->head.load(memory_order_relaxed);
+    FrameRingInfo *slot_info = &ring->infos[head & (shared->n_slots - 1)];
+    *slot_info = *info;
+    slot_info->timestamp_ns = now_ns();
+    shared->head.store(head + 1);
+    signal_event(&shared->consumer_event, &shared->consumer_waiting);
+}
+
+void frame_ring_close(FrameRing *ring) {
+    RingShared *shared = ring->shared;
+    shared->closed.store(1);
+    signal_event(&shared->consumer_event, &shared->consumer_waiting);
+    signal_event(&shared->producer_event, &shared->producer_waiting);
+}
+
+uint8_t *frame_ring_read_slot(FrameRing *ring, FrameRingInfo *info, int timeout_ms) {
+    RingShared *shared = ring->shared;
+    uint64_t deadline = timeout_ms < 0 ? 0 : now_ns() + (uint64_t)timeout_ms * 1000000;
+    uint32_t tail = shared->tail.load(memory_order_relaxed);
+    for (;;) {
+        uint32_t event = shared->consumer_event.load();
+        // closed is read before head, so that the last frames are not missed
+        bool closed = shared->closed.load(memory_order_acquire);
+        uint32_t head = shared->head.load(memory_order_acquire);
+        if (head != tail) {
+            uint32_t index = tail & (shared->n_slots - 1);
+            if (info != NULL) {
+                *info = ring->infos[index];
+            }
+            return ring->data + (size_t)index * shared->slot_stride;
+        }
+        if (closed) {
+            return NULL;
+        }
+        if (!wait_event(&shared->consumer_event, &shared->consumer_waiting, event, deadline)) {
+            return NULL;
+        }
+    }
+}
+
+void frame_ring_release(FrameRing *ring) {
+    RingShared *shared = ring->shared;
+    shared->tail.store(shared->tail.load(memory_order_relaxed) + 1);
+    signal_event(&shared->producer_event, &shared->producer_waiting);
+}
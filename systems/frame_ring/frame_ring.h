@@ -0,0 +1,84 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Ring of fixed-size frame slots in POSIX shared memory, to pass images
+    between processes without files: one producer (capture, detection)
+    writes into a slot and commits it, one consumer (inference) reads the
+    slot in place and releases it.
+
+    The producer and consumer indices are free-running counters in the
+    shared memory; each side only writes its own counter, so no lock is
+    needed. A side that finds the ring full (producer) or empty (consumer)
+    sleeps on the other counter with a futex, and is only woken up if it
+    is actually waiting.
+
+    Slots are page aligned, so they can be handed to a DMA or used as an
+    input tensor directly. The images are 8-bit RGB, interleaved. The C ABI
+    is used as is by frame_ring.py.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct FrameRing FrameRing;
+
+typedef struct {
+    uint32_t size;          // Bytes used in the slot
+    uint32_t width;
+    uint32_t height;
+    uint32_t label;         // Class of the image if known, FRAME_RING_NO_LABEL otherwise
+    uint64_t timestamp_ns;  // CLOCK_MONOTONIC time of the commit, set by frame_ring_commit
+} FrameRingInfo;
+
+#define FRAME_RING_NO_LABEL 0xFFFFFFFFu
+
+// Create the ring /name (replacing an existing one), n_slots a power of 2. Returns NULL on error.
+FrameRing *frame_ring_create(const char *name, uint32_t n_slots, uint32_t slot_size);
+// Attach to a ring created by another process. Returns NULL on error.
+FrameRing *frame_ring_open(const char *name);
+// frame_ring_open, retried until the ring is created (timeout_ms < 0 waits forever). Returns NULL on timeout.
+FrameRing *frame_ring_open_wait(const char *name, int timeout_ms);
+// Unmap the ring, and remove it if this process created it
+void frame_ring_destroy(FrameRing *ring);
+
+uint32_t frame_ring_n_slots(const FrameRing *ring);
+uint32_t frame_ring_slot_size(const FrameRing *ring);
+
+/*
+    The process of the other side: 1 if it is running, 0 if it exited
+    (without closing the ring, or after), -1 if no process opened the ring
+    yet. A side that waits with a timeout checks it on each timeout, so it
+    does not wait forever for a process that died.
+*/
+int frame_ring_peer_alive(const FrameRing *ring);
+// 1 once frame_ring_close was called by either side
+int frame_ring_closed(const FrameRing *ring);
+
+/*
+    Producer side. frame_ring_write_slot waits for a free slot (timeout_ms < 0
+    waits forever) and returns it, or NULL on timeout or if the ring is closed.
+    frame_ring_commit publishes it with its info. frame_ring_close tells the
+    consumer that no more frames will come.
+*/
+uint8_t *frame_ring_write_slot(FrameRing *ring, int timeout_ms);
+void frame_ring_commit(FrameRing *ring, const FrameRingInfo *info);
+void frame_ring_close(FrameRing *ring);
+
+/*
+    Consumer side. frame_ring_read_slot waits for a committed slot and returns
+    it with its info, or NULL on timeout or once the ring is closed and empty.
+    The slot stays valid until frame_ring_release.
+*/
+uint8_t *frame_ring_read_slot(FrameRing *ring, FrameRingInfo *info, int timeout_ms);
+void frame_ring_release(FrameRing *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FRAME_RING_H
@@ -0,0 +1,119 @@
+import ctypes
+import os
+
+import numpy as np
+
+# Python side of the shared-memory frame ring (see frame_ring.h), for the PYNQ tools.
+# Build the library first: g++ -O2 -shared -fPIC -o libframe_ring.so frame_ring.cpp
+
+NO_LABEL = 0xFFFFFFFF
+
+
+class FrameRingInfo(ctypes.Structure):
+    _fields_ = [
+        ("size", ctypes.c_uint32),
+        ("width", ctypes.c_uint32),
+        ("height", ctypes.c_uint32),
+        ("label", ctypes.c_uint32),
+        ("timestamp_ns", ctypes.c_uint64),
+    ]
+
+
+def load_library(path=None):
+    if path is None:
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "libframe_ring.so")
+    lib = ctypes.CDLL(path)
+    lib.frame_ring_create.restype = ctypes.c_void_p
+    lib.frame_ring_create.argtypes = [ctypes.c_char_p, ctypes.c_uint32, ctypes.c_uint32]
+    lib.frame_ring_open.restype = ctypes.c_void_p
+    lib.frame_ring_open.argtypes = [ctypes.c_char_p]
+    lib.frame_ring_destroy.argtypes = [ctypes.c_void_p]
+    lib.frame_ring_n_slots.restype = ctypes.c_uint32
+    lib.frame_ring_n_slots.argtypes = [ctypes.c_void_p]
+    lib.frame_ring_slot_size.restype = ctypes.c_uint32
+    lib.frame_ring_slot_size.argtypes = [ctypes.c_void_p]
+    lib.frame_ring_write_slot.restype = ctypes.POINTER(ctypes.c_uint8)
+    lib.frame_ring_write_slot.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.frame_ring_commit.argtypes = [ctypes.c_void_p, ctypes.POINTER(FrameRingInfo)]
+    lib.frame_ring_close.argtypes = [ctypes.c_void_p]
+    lib.frame_ring_read_slot.restype = ctypes.POINTER(ctypes.c_uint8)
+    lib.frame_ring_read_slot.argtypes = [ctypes.c_void_p, ctypes.POINTER(FrameRingInfo), ctypes.c_int]
+    lib.frame_ring_release.argtypes = [ctypes.c_void_p]
+    lib.frame_ring_peer_alive.restype = ctypes.c_int
+    lib.frame_ring_peer_alive.argtypes = [ctypes.c_void_p]
+    lib.frame_ring_closed.restype = ctypes.c_int
+    lib.frame_ring_closed.argtypes = [ctypes.c_void_p]
+    return lib
+
+
+class FrameRing:
+    """
+    Attach to (or create, with n_slots and slot_size) the ring /name.
+    n_slots must be a power of 2.
+    The slots are returned as numpy arrays on the shared memory: no copy is
+    made, so a slot must not be used after commit() or release().
+    """
+
+    def __init__(self, name, n_slots=None, slot_size=None, lib=None):
+        self.lib = lib if lib is not None else load_library()
+        if n_slots is not None:
+            if n_slots <= 0 or n_slots & (n_slots - 1):
+                raise ValueError(f"The frame ring needs a power of 2 slots, not {n_slots}")
+            self.ring = self.lib.frame_ring_create(name.encode(), n_slots, slot_size)
+        else:
+            self.ring = self.lib.frame_ring_open(name.encode())
+        if not self.ring:
+            raise RuntimeError(f"Could not attach to the frame ring {name}")
+        self.slot_size = self.lib.frame_ring_slot_size(self.ring)
+
+    def write_slot(self, shape, timeout_ms=-1):
+        # Free slot viewed as a uint8 array of the given shape, None on timeout or if the ring is closed
+        ptr = self.lib.frame_ring_write_slot(self.ring, timeout_ms)
+        if not ptr:
+            return None
+        if int(np.prod(shape)) > self.slot_size:
+            raise ValueError(f"{shape} does not fit in slots of {self.slot_size} bytes")
+        return np.ctypeslib.as_array(ptr, shape=(int(np.prod(shape)),)).reshape(shape)
+
+    def commit(self, width, height, size, label=NO_LABEL):
+        info = FrameRingInfo(size, width, height, label, 0)
+        self.lib.frame_ring_commit(self.ring, ctypes.byref(info))
+
+    def write(self, image, label=NO_LABEL, timeout_ms=-1):
+        # Copy an HxWxC image into the next slot and commit it
+        slot = self.write_slot(image.shape, timeout_ms)
+        if slot is None:
+            return False
+        slot[...] = image
+        self.commit(image.shape[1], image.shape[0], image.nbytes, label)
+        return True
+
+    def read_slot(self, channels=3, timeout_ms=-1):
+        # Next frame as (image, label), viewed in place, or (None, None) once the ring is closed and empty
+        info = FrameRingInfo()
+        ptr = self.lib.frame_ring_read_slot(self.ring, ctypes.byref(info), timeout_ms)
+        if not ptr:
+            return None, None
+        image = np.ctypeslib.as_array(ptr, shape=(info.size,))
+        if info.width * info.height * channels == info.size:
+            image = image.reshape(info.height, info.width, channels)
+        return image, info.label
+
+    def release(self):
+        self.lib.frame_ring_release(self.ring)
+
+    def close(self):
+        self.lib.frame_ring_close(self.ring)
+
+    def closed(self):
+        return self.lib.frame_ring_closed(self.ring) != 0
+
+    def peer_alive(self):
+        # True or False, None while no process opened the ring on the other side
+        alive = self.lib.frame_ring_peer_alive(self.ring)
+        return None if alive < 0 else alive == 1
+
+    def __del__(self):
+        if getattr(self, "ring", None):
+            self.lib.frame_ring_destroy(self.ring)
+            self.ring = None
@@ -0,0 +1,218 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "frame_ring.h"
+
+using namespace std;
+
+// g++ -O2 -std=c++17 -o frame_ring_bench frame_ring_bench.cpp frame_ring.cpp
+
+#define RING_NAME   "/frame_ring_bench"
+#define RING_SLOTS  8
+#define TIMEOUT_MS  1000    // Between the checks that the other process is alive
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void fill_frame(uint8_t* frame, size_t size, int index) {
+    // Something the consumer can check, written like a capture would be
+    memset(frame, index & 0xFF, size);
+}
+
+static uint64_t checksum(const uint8_t* frame, size_t size) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < size; i++) {
+        sum += frame[i];
+    }
+    return sum;
+}
+
+typedef struct {
+    double seconds;
+    double mean_latency_us;
+    double max_latency_us;
+    int errors;
+} BenchResult;
+
+BenchResult bench_ring(int n_frames, size_t frame_size, int width, int height) {
+    /*
+        A child process writes the frames into the ring, this process reads
+        them in place.
+    */
+    BenchResult result = {};
+    FrameRing* ring = frame_ring_create(RING_NAME, RING_SLOTS, frame_size);
+    if (ring == NULL) {
+        exit(1);
+    }
+    uint64_t start = now_ns();
+    pid_t pid = fork();
+    if (pid == 0) {
+        FrameRing* producer = frame_ring_open(RING_NAME);
+        if (producer == NULL) {
+            _exit(1);
+        }
+        for (int i = 0; i < n_frames; i++) {
+            uint8_t* slot;
+            while ((slot = frame_ring_write_slot(producer, TIMEOUT_MS)) == NULL) {
+                if (frame_ring_closed(producer) || frame_ring_peer_alive(producer) == 0) {
+                    fprintf(stderr, "[ERROR] The consumer of the frame ring exited\n");
+                    _exit(1);
+                }
+            }
+            fill_frame(slot, frame_size, i);
+            FrameRingInfo info = {(uint32_t)frame_size, (uint32_t)width, (uint32_t)height, (uint32_t)i, 0};
+            frame_ring_commit(producer, &info);
+        }
+        frame_ring_close(producer);
+        frame_ring_destroy(producer);
+        _exit(0);
+    }
+
+    FrameRingInfo info;
+    uint8_t* slot;
+    double total_latency = 0;
+    int n = 0, status = 0;
+    bool exited = false, reaped = false;
+    for (;;) {
+        slot = frame_ring_read_slot(ring, &info, TIMEOUT_MS);
+        if (slot == NULL) {
+            // The producer may die before it opens the ring, so its pid is checked too
+            bool closed = frame_ring_closed(ring);
+            if (!closed && !exited) {
+                reaped = waitpid(pid, &status, WNOHANG) == pid;
+                exited = reaped || frame_ring_peer_alive(ring) == 0;
+            }
+            if (!closed && !exited) {
+                continue;
+            }
+            // The frames committed before the end are still read
+            if ((slot = frame_ring_read_slot(ring, &info, 0)) == NULL) {
+                if (!closed) {
+                    fprintf(stderr, "[ERROR] The producer of the frame ring exited after %d frames\n", n);
+                }
+                break;
+            }
+        }
+        double latency = (now_ns() - info.timestamp_ns) / 1000.0;
+        total_latency += latency;
+        result.max_latency_us = max(result.max_latency_us, latency);
+        if (checksum(slot, info.size) != (uint64_t)(info.label & 0xFF) * info.size) {
+            result.errors++;
+        }
+        frame_ring_release(ring);
+        n++;
+    }
+    if (!reaped) {
+        waitpid(pid, &status, 0);
+    }
+    result.seconds = (now_ns() - start) / 1e9;
+    result.mean_latency_us = total_latency / max(n, 1);
+    result.errors += n_frames - n;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        result.errors++;
+    }
+    frame_ring_destroy(ring);
+    return result;
+}
+
+BenchResult bench_files(int n_frames, size_t frame_size, const string& directory) {
+    /*
+        The current handoff: the child process writes each frame to a file
+        (temporary name, then rename), this process polls for the next file,
+        reads it and deletes it. The first 8 bytes hold the write time.
+    */
+    BenchResult result = {};
+    uint64_t start = now_ns();
+    pid_t pid = fork();
+    if (pid == 0) {
+        vector<uint8_t> frame(frame_size + 8);
+        for (int i = 0; i < n_frames; i++) {
+            string path = directory + "/frame_" + to_string(i) + ".bin";
+            fill_frame(frame.data() + 8, frame_size, i);
+            uint64_t timestamp = now_ns();
+            memcpy(frame.data(), &timestamp, 8);
+            FILE* file = fopen((path + ".tmp").c_str(), "wb");
+            fwrite(frame.data(), 1, frame.size(), file);
+            fclose(file);
+            rename((path + ".tmp").c_str(), path.c_str());
+        }
+        _exit(0);
+    }
+
+    vector<uint8_t> frame(frame_size + 8);
+    double total_latency = 0;
+    for (int i = 0; i < n_frames; i++) {
+        string path = directory + "/frame_" + to_string(i) + ".bin";
+        int fd;
+        while ((fd = open(path.c_str(), O_RDONLY)) < 0) {
+            usleep(50);
+        }
+        size_t offset = 0;
+        ssize_t r;
+        while (offset < frame.size() && (r = read(fd, frame.data() + offset, frame.size() - offset)) > 0) {
+            offset += r;
+        }
+        close(fd);
+        unlink(path.c_str());
+
+        uint64_t timestamp;
+        memcpy(&timestamp, frame.data(), 8);
+        double latency = (now_ns() - timestamp) / 1000.0;
+        total_latency += latency;
+        result.max_latency_us = max(result.max_latency_us, latency);
+        if (offset != frame.size() || checksum(frame.data() + 8, frame_size) != (uint64_t)(i & 0xFF) * frame_size) {
+            result.errors++;
+        }
+    }
+    waitpid(pid, NULL, 0);
+    result.seconds = (now_ns() - start) / 1e9;
+    result.mean_latency_us = total_latency / max(n_frames, 1);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    /*
+        Compare the shared-memory ring with the file-based handoff between two
+        processes, for n_frames frames of width x height x 3 bytes.
+    */
+    if (argc < 5) {
+        printf("Usage: %s <n_frames> <width> <height> <directory>\n", argv[0]);
+        printf("Example: %s 2000 224 224 /tmp\n", argv[0]);
+        return 1;
+    }
+    int n_frames = atoi(argv[1]);
+    int width = atoi(argv[2]);
+    int height = atoi(argv[3]);
+    string directory = argv[4];
+    size_t frame_size = width * height * 3;
+
+    BenchResult results[2] = {
+        bench_ring(n_frames, frame_size, width, height),
+        bench_files(n_frames, frame_size, directory),
+    };
+    const char* names[2] = {"Shared-memory ring", "Files"};
+    int errors = 0;
+    for (int i = 0; i < 2; i++) {
+        printf("[INFO] %-18s: %8.1f frames/s, %7.1f MB/s, latency %8.1f us mean, %8.1f us max\n", names[i],
+               n_frames / results[i].seconds, n_frames * frame_size / results[i].seconds / 1e6,
+               results[i].mean_latency_us, results[i].max_latency_us);
+        errors += results[i].errors;
+    }
+    if (errors > 0) {
+        fprintf(stderr, "[ERROR] %d frames missing or corrupted\n", errors);
+        return 1;
+    }
+    printf("[SUCCESS] %d frames passed through each handoff\n", n_frames);
+    return 0;
+}
@@ -0,0 +1,253 @@
+#include <math.h>
+#include <string.h>
+
+#include "isp.h"
+
+#if defined(__SSE2__) && !defined(ISP_NO_SIMD)
+#include <emmintrin.h>
+#define ISP_SSE2
+#elif defined(__ARM_NEON) && !defined(ISP_NO_SIMD)
+#include <arm_neon.h>
+#define ISP_NEON
+#endif
+
+#define SPAN 256    // Pixels demosaiced before the gamma lookups
+
+// Weights of RGB2Gray, in the order of the video bus: R, B, G
+#define GRAY_WEIGHT_R   76
+#define GRAY_WEIGHT_B   150
+#define GRAY_WEIGHT_G   29
+
+void build_gamma_lut(int gamma_reg, uint8_t lut[1024]) {
+    /*
+        Factor 1 keeps the 8 MSBs. The other ROMs hold
+        round(255 * (i / 1023)^(1 / gamma)).
+    */
+    double gamma;
+    switch (gamma_reg) {
+        case GAMMA_1:   gamma = 1.0; break;
+        case GAMMA_1_2: gamma = 1.2; break;
+        case GAMMA_1_5: gamma = 1.5; break;
+        case GAMMA_1_8: gamma = 1.8; break;
+        default:        gamma = 2.2; break;
+    }
+    for (int i = 0; i < 1024; i++) {
+        if (gamma_reg == GAMMA_1) {
+            lut[i] = i >> 2;
+        } else {
+            lut[i] = (uint8_t)floor(255.0 * pow(i / 1023.0, 1.0 / gamma) + 0.5);
+        }
+    }
+}
+
+size_t bayer_packed_size(int format, size_t n_samples) {
+    if (format == BAYER_RAW10) {
+        return (n_samples + 3) / 4 * 5;
+    }
+    return n_samples;
+}
+
+void pack_bayer(const uint16_t *samples, size_t n_samples, int format, uint8_t *packed) {
+    if (format != BAYER_RAW10) {
+        for (size_t i = 0; i < n_samples; i++) {
+            packed[i] = samples[i] >> 2;
+        }
+        return;
+    }
+    for (size_t i = 0; i < n_samples; i += 4) {
+        uint8_t lsbs = 0;
+        for (size_t k = 0; k < 4; k++) {
+            uint16_t s = i + k < n_samples ? samples[i + k] : 0;
+            packed[k] = s >> 2;
+            lsbs |= (s & 3) << (2 * k);
+        }
+        packed[4] = lsbs;
+        packed += 5;
+    }
+}
+
+void unpack_bayer(const uint8_t *packed, size_t n_samples, int format, uint16_t *samples) {
+    if (format != BAYER_RAW10) {
+        for (size_t i = 0; i < n_samples; i++) {
+            samples[i] = packed[i] << 2;
+        }
+        return;
+    }
+    size_t i = 0;
+    for (; i + 4 <= n_samples; i += 4) {
+        uint8_t lsbs = packed[4];
+        samples[i] = (packed[0] << 2) | (lsbs & 3);
+        samples[i + 1] = (packed[1] << 2) | ((lsbs >> 2) & 3);
+        samples[i + 2] = (packed[2] << 2) | ((lsbs >> 4) & 3);
+        samples[i + 3] = (packed[3] << 2) | (lsbs >> 6);
+        packed += 5;
+    }
+    for (size_t k = 0; i + k < n_samples; k++) {
+        samples[i + k] = (packed[k] << 2) | ((packed[4] >> (2 * k)) & 3);
+    }
+}
+
+static void demosaic_span(const uint16_t *blue_line, const uint16_t *red_line, int first_even, int n,
+                          uint16_t *r, uint16_t *g, uint16_t *b) {
+    /*
+        blue_line is the line with the blue samples (even line) and red_line
+        the other one; both hold one more sample before the first pixel.
+        Blue is on even columns and red on odd columns, so the window of a
+        pixel on an even column takes blue from this column and red from the
+        previous one, and the other way around on odd columns. Green is the
+        mean of the two other samples. first_even is 1 if the first pixel is
+        on an even column.
+    */
+    int i = 0;
+#if defined(ISP_SSE2)
+    __m128i even = first_even ? _mm_setr_epi16(-1, 0, -1, 0, -1, 0, -1, 0)
+                              : _mm_setr_epi16(0, -1, 0, -1, 0, -1, 0, -1);
+    for (; i + 8 <= n; i += 8) {
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(blue_line + i));
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(blue_line + i - 1));
+        __m128i r0 = _mm_loadu_si128((const __m128i *)(red_line + i));
+        __m128i r1 = _mm_loadu_si128((const __m128i *)(red_line + i - 1));
+        __m128i vb = _mm_or_si128(_mm_and_si128(even, b0), _mm_andnot_si128(even, b1));
+        __m128i vr = _mm_or_si128(_mm_and_si128(even, r1), _mm_andnot_si128(even, r0));
+        __m128i gb = _mm_or_si128(_mm_and_si128(even, b1), _mm_andnot_si128(even, b0));
+        __m128i gr = _mm_or_si128(_mm_and_si128(even, r0), _mm_andnot_si128(even, r1));
+        _mm_storeu_si128((__m128i *)(b + i), vb);
+        _mm_storeu_si128((__m128i *)(r + i), vr);
+        _mm_storeu_si128((__m128i *)(g + i), _mm_srli_epi16(_mm_add_epi16(gb, gr), 1));
+    }
+#elif defined(ISP_NEON)
+    static const uint16_t even_lanes[2][8] = {
+        {0, 0xFFFF, 0, 0xFFFF, 0, 0xFFFF, 0, 0xFFFF},
+        {0xFFFF, 0, 0xFFFF, 0, 0xFFFF, 0, 0xFFFF, 0}};
+    uint16x8_t even = vld1q_u16(even_lanes[first_even != 0]);
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t b0 = vld1q_u16(blue_line + i);
+        uint16x8_t b1 = vld1q_u16(blue_line + i - 1);
+        uint16x8_t r0 = vld1q_u16(red_line + i);
+        uint16x8_t r1 = vld1q_u16(red_line + i - 1);
+        vst1q_u16(b + i, vbslq_u16(even, b0, b1));
+        vst1q_u16(r + i, vbslq_u16(even, r1, r0));
+        // Halving add: (a + b) >> 1 without overflow, like the IP
+        vst1q_u16(g + i, vhaddq_u16(vbslq_u16(even, b1, b0), vbslq_u16(even, r0, r1)));
+    }
+#endif
+    for (; i < n; i++) {
+        if (((i & 1) == 0) == (first_even != 0)) {
+            b[i] = blue_line[i];
+            r[i] = red_line[i - 1];
+            g[i] = (blue_line[i - 1] + red_line[i]) >> 1;
+        } else {
+            b[i] = blue_line[i - 1];
+            r[i] = red_line[i];
+            g[i] = (blue_line[i] + red_line[i - 1]) >> 1;
+        }
+    }
+}
+
+static void build_gray_luts(const uint8_t lut[1024], uint8_t gray_luts[3][1024]) {
+    // One table per component of R, G, B, already through the gamma
+    for (int i = 0; i < 1024; i++) {
+        gray_luts[0][i] = lut[i] * GRAY_WEIGHT_R / 256;
+        gray_luts[1][i] = lut[i] * GRAY_WEIGHT_G / 256;
+        gray_luts[2][i] = lut[i] * GRAY_WEIGHT_B / 256;
+    }
+}
+
+static void convert_line(const uint16_t *row, const uint16_t *above, int x, int y, int width,
+                         const uint8_t lut[1024], const uint8_t gray_luts[3][1024],
+                         uint8_t *rgb, uint8_t *gray) {
+    /*
+        One line of the region starting at column x of line y. row and above
+        point at the first pixel, with one more sample before it if x > 0;
+        above is not read on line 0. The pixels without a window (line 0,
+        column 0) get 512 before the gamma, like in the IP.
+    */
+    uint16_t r[SPAN], g[SPAN], b[SPAN];
+    for (int start = 0; start < width; start += SPAN) {
+        int n = width - start < SPAN ? width - start : SPAN;
+        int i = 0;
+        if (y == 0) {
+            for (; i < n; i++) {
+                r[i] = g[i] = b[i] = 512;
+            }
+        } else if (x == 0 && start == 0) {
+            r[0] = g[0] = b[0] = 512;
+            i = 1;
+        }
+        if (i < n) {
+            const uint16_t *blue_line = (y & 1) ? above : row;
+            const uint16_t *red_line = (y & 1) ? row : above;
+            demosaic_span(blue_line + start + i, red_line + start + i, ((x + start + i) & 1) == 0, n - i,
+                          r + i, g + i, b + i);
+        }
+
+        if (rgb != NULL && gray != NULL) {
+            uint8_t *out = rgb + 3 * start;
+            for (i = 0; i < n; i++) {
+                out[3 * i] = lut[r[i]];
+                out[3 * i + 1] = lut[g[i]];
+                out[3 * i + 2] = lut[b[i]];
+                gray[start + i] = gray_luts[0][r[i]] + gray_luts[1][g[i]] + gray_luts[2][b[i]];
+            }
+        } else if (rgb != NULL) {
+            uint8_t *out = rgb + 3 * start;
+            for (i = 0; i < n; i++) {
+                out[3 * i] = lut[r[i]];
+                out[3 * i + 1] = lut[g[i]];
+                out[3 * i + 2] = lut[b[i]];
+            }
+        } else if (gray != NULL) {
+            for (i = 0; i < n; i++) {
+                gray[start + i] = gray_luts[0][r[i]] + gray_luts[1][g[i]] + gray_luts[2][b[i]];
+            }
+        }
+    }
+}
+
+void bayer_to_rgb(const uint16_t *bayer, int x, int y, int width, int height,
+                  const uint8_t lut[1024], uint8_t *rgb, size_t rgb_stride) {
+    int mx = x > 0;
+    int my = y > 0;
+    int bayer_width = width + mx;
+
+    for (int j = 0; j < height; j++) {
+        const uint16_t *row = bayer + (j + my) * bayer_width + mx;
+        // Not read on line 0 of the frame, where there is no line above in bayer
+        const uint16_t *above = j + my > 0 ? row - bayer_width : row;
+        convert_line(row, above, x, y + j, width, lut, NULL, rgb + j * rgb_stride, NULL);
+    }
+}
+
+void rgb_to_gray(const uint8_t *rgb, size_t n_pixels, uint8_t *gray) {
+    for (size_t i = 0; i < n_pixels; i++) {
+        const uint8_t *p = rgb + 3 * i;
+        gray[i] = p[0] * GRAY_WEIGHT_R / 256 + p[1] * GRAY_WEIGHT_G / 256 + p[2] * GRAY_WEIGHT_B / 256;
+    }
+}
+
+IspStream::IspStream(int width, int gamma_reg, bool gray_delay)
+    : width(width), y(0), gray_delay(gray_delay), above(width) {
+    // Registers of RGB2Gray after reset
+    gray_carry[0] = gray_carry[1] = 0;
+    build_gamma_lut(gamma_reg, lut);
+    build_gray_luts(lut, gray_luts);
+}
+
+void IspStream::start_frame() {
+    y = 0;
+}
+
+void IspStream::push_line(const uint16_t *bayer, uint8_t *rgb, uint8_t *gray) {
+    convert_line(bayer, above.data(), 0, y, width, lut, gray_luts, rgb, gray);
+    memcpy(above.data(), bayer, width * sizeof(uint16_t));
+    y++;
+
+    if (gray != NULL && gray_delay && width >= 2) {
+        uint8_t last[2] = {gray[width - 2], gray[width - 1]};
+        memmove(gray + 2, gray, width - 2);
+        gray[0] = gray_carry[0];
+        gray[1] = gray_carry[1];
+        gray_carry[0] = last[0];
+        gray_carry[1] = last[1];
+    }
+}
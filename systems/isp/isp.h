@@ -0,0 +1,99 @@
+#ifndef ISP_H
+#define ISP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/*
+    Software version of the camera chain of the Zybo Z7 bitstreams:
+    AXI_BayerToRGB (10-bit Bayer to 10-bit RGB) then AXI_GammaCorrection
+    (10-bit to 8-bit through a ROM). The output is bit-exact with the IPs,
+    so that the raw Bayer samples can be sent off the board and converted on
+    the receiver.
+
+    AXI_BayerToRGB works on a 2x2 window ending at the current pixel: red and
+    blue are taken as is, green is the mean of the two greens (truncated).
+    Blue is on even lines and even columns, red on odd lines and odd columns.
+    The first line and the first column of the frame have no window and are
+    set to mid-gray (512).
+
+    The RGB output is written R, G, B, like the capture files.
+
+    RGB2Gray (detection) follows AXI_GammaCorrection. It computes
+    r * 76 / 256 + g * 150 / 256 + b * 29 / 256 with each term truncated, but
+    it takes r, g, b from the video bus, which is ordered R, B, G: the 150
+    weight applies to blue and the 29 weight to green. Its data is also
+    registered twice while tlast and tuser are registered once, so each gray
+    value comes out two pixels late.
+
+    The demosaic uses SSE2 or NEON when the compiler targets them (define
+    ISP_NO_SIMD to force the scalar code). Gamma and gray are table lookups.
+*/
+
+// Bayer sample formats
+#define BAYER_RAW8      8   // 1 byte per sample, the 8 MSBs
+#define BAYER_RAW10     10  // MIPI CSI-2 RAW10: 4 samples in 5 bytes (4 MSB bytes, then the 2 LSBs of each)
+
+// Values of the gamma register of AXI_GammaCorrection
+#define GAMMA_1         0
+#define GAMMA_1_2       1
+#define GAMMA_1_5       2
+#define GAMMA_1_8       3
+#define GAMMA_2_2       4
+
+// Same content as the ROMs of AXI_GammaCorrection (StoredGammaCoefs.vhd)
+void build_gamma_lut(int gamma_reg, uint8_t lut[1024]);
+
+// Bytes needed for n samples
+size_t bayer_packed_size(int format, size_t n_samples);
+
+// 10-bit samples (in uint16_t) to packed bytes, and back. RAW8 drops the 2 LSBs.
+void pack_bayer(const uint16_t *samples, size_t n_samples, int format, uint8_t *packed);
+void unpack_bayer(const uint8_t *packed, size_t n_samples, int format, uint16_t *samples);
+
+/*
+    Demosaic and gamma of the region (x, y, width, height) of a frame.
+    bayer holds the samples of the region plus one column on the left if x > 0
+    and one line above if y > 0 (the window of AXI_BayerToRGB), so it is
+    (width + (x > 0)) samples wide. rgb gets width * height * 3 bytes, with
+    rows of rgb_stride bytes.
+*/
+void bayer_to_rgb(const uint16_t *bayer, int x, int y, int width, int height,
+                  const uint8_t lut[1024], uint8_t *rgb, size_t rgb_stride);
+
+// Gray of RGB2Gray for n pixels of R, G, B (8 bits, after the gamma)
+void rgb_to_gray(const uint8_t *rgb, size_t n_pixels, uint8_t *gray);
+
+/*
+    Line by line version of the chain for full frames, with a single line of
+    samples kept between two calls (the LineBuffer of AXI_BayerToRGB), so it
+    needs O(width) memory whatever the height of the frame.
+    With gray_delay, the gray lines are shifted by two pixels like the output
+    of RGB2Gray, the two last pixels of a frame going to the next one.
+*/
+class IspStream {
+public:
+    IspStream(int width, int gamma_reg, bool gray_delay = false);
+
+    // Next frame: the next line pushed is line 0
+    void start_frame();
+
+    // Next line of width 10-bit samples. rgb gets width * 3 bytes and gray
+    // width bytes, either can be NULL.
+    void push_line(const uint16_t *bayer, uint8_t *rgb, uint8_t *gray);
+
+    int line() const { return y; }
+
+private:
+    int width;
+    int y;
+    bool gray_delay;
+    uint8_t gray_carry[2];
+    uint8_t lut[1024];
+    uint8_t gray_luts[3][1024];
+    std::vector<uint16_t> above;
+};
+
+#endif // ISP_H
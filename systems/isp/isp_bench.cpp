@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "isp.h"
+
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -o isp_bench isp_bench.cpp isp.cpp
+// (add -march=native for AVX builds of the scalar loops, -DISP_NO_SIMD for the scalar demosaic)
+
+void hdl_chain(const uint16_t* bayer, int width, int height, const uint8_t* lut, uint8_t* rgb, uint8_t* gray, int delayed[2]) {
+    /*
+        Pixel by pixel transcription of AXI_BayerToRGB, the gamma ROM and
+        RGB2Gray, used as the reference. P0 is the current pixel, P1 the
+        previous one on the line, P2 and P3 the same two pixels on the line
+        above (sPixel in the VHDL). RGB2Gray reads the video bus R, B, G as
+        r, g, b, and its gray comes out two pixels late: delayed holds the two
+        last values of the previous frame (0 after reset).
+    */
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int r = 512, g = 1024, b = 512;
+            if (x > 0 && y > 0) {
+                int p0 = bayer[y * width + x];
+                int p1 = bayer[y * width + x - 1];
+                int p2 = bayer[(y - 1) * width + x];
+                int p3 = bayer[(y - 1) * width + x - 1];
+                int position = ((y & 1) << 1) | (x & 1);
+                switch (position) {
+                    case 1: b = p1; g = p0 + p3; r = p2; break;
+                    case 0: b = p0; g = p1 + p2; r = p3; break;
+                    case 3: b = p3; g = p1 + p2; r = p0; break;
+                    case 2: b = p2; g = p0 + p3; r = p1; break;
+                }
+            }
+            uint8_t* out = &rgb[(y * width + x) * 3];
+            out[0] = lut[r];
+            out[1] = lut[g >> 1];
+            out[2] = lut[b];
+
+            int bus[3] = {out[0], out[2], out[1]};
+            int value = bus[0] * 76 / 256 + bus[1] * 150 / 256 + bus[2] * 29 / 256;
+            gray[y * width + x] = delayed[0];
+            delayed[0] = delayed[1];
+            delayed[1] = value;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    /*
+        Speed of the software ISP on full frames (1920x1080 by default):
+        the pixel by pixel reference, bayer_to_rgb on the whole frame, and
+        IspStream line by line with and without the gray output. Every output
+        is checked against the reference, including the gray of the second
+        frame, which starts with the two last pixels of the first one.
+    */
+    int width = argc > 1 ? atoi(argv[1]) : 1920;
+    int height = argc > 2 ? atoi(argv[2]) : 1080;
+    int n_frames = argc > 3 ? atoi(argv[3]) : 20;
+    int gamma_reg = argc > 4 ? atoi(argv[4]) : GAMMA_2_2;
+    if (width < 2 || height < 1 || n_frames < 2) {
+        printf("Usage: %s [width] [height] [n_frames >= 2] [gamma_reg]\n", argv[0]);
+        return 1;
+    }
+#if defined(ISP_NO_SIMD)
+    printf("[INFO] Scalar demosaic\n");
+#elif defined(__SSE2__)
+    printf("[INFO] SSE2 demosaic\n");
+#elif defined(__ARM_NEON)
+    printf("[INFO] NEON demosaic\n");
+#else
+    printf("[INFO] Scalar demosaic\n");
+#endif
+
+    size_t n_pixels = (size_t)width * height;
+    vector<uint16_t> frames[2] = {vector<uint16_t>(n_pixels), vector<uint16_t>(n_pixels)};
+    mt19937 rng(1);
+    for (auto& frame : frames) {
+        for (auto& s : frame) {
+            s = rng() & 1023;
+        }
+    }
+    uint8_t lut[1024];
+    build_gamma_lut(gamma_reg, lut);
+
+    // The gray of the second frame starts with the two last pixels of the first one
+    vector<uint8_t> ref_rgb[2], ref_gray[2];
+    int delayed[2] = {0, 0};
+    for (int f = 0; f < 2; f++) {
+        ref_rgb[f].resize(n_pixels * 3);
+        ref_gray[f].resize(n_pixels);
+        hdl_chain(frames[f].data(), width, height, lut, ref_rgb[f].data(), ref_gray[f].data(), delayed);
+    }
+
+    vector<uint8_t> rgb(n_pixels * 3), gray(n_pixels);
+    int errors = 0;
+
+    auto start = steady_clock::now();
+    for (int f = 0; f < n_frames; f++) {
+        hdl_chain(frames[f & 1].data(), width, height, lut, rgb.data(), gray.data(), delayed);
+    }
+    double reference_ms = duration<double, milli>(steady_clock::now() - start).count() / n_frames;
+
+    start = steady_clock::now();
+    for (int f = 0; f < n_frames; f++) {
+        bayer_to_rgb(frames[f & 1].data(), 0, 0, width, height, lut, rgb.data(), width * 3);
+    }
+    double frame_ms = duration<double, milli>(steady_clock::now() - start).count() / n_frames;
+    errors += memcmp(rgb.data(), ref_rgb[(n_frames - 1) & 1].data(), rgb.size()) != 0;
+
+    // Line by line: only one line of samples is kept between the calls
+    IspStream rgb_stream(width, gamma_reg);
+    start = steady_clock::now();
+    for (int f = 0; f < n_frames; f++) {
+        rgb_stream.start_frame();
+        for (int y = 0; y < height; y++) {
+            rgb_stream.push_line(&frames[f & 1][(size_t)y * width], &rgb[(size_t)y * width * 3], NULL);
+        }
+    }
+    double stream_ms = duration<double, milli>(steady_clock::now() - start).count() / n_frames;
+    errors += memcmp(rgb.data(), ref_rgb[(n_frames - 1) & 1].data(), rgb.size()) != 0;
+
+    IspStream gray_stream(width, gamma_reg, true);
+    start = steady_clock::now();
+    for (int f = 0; f < n_frames; f++) {
+        gray_stream.start_frame();
+        for (int y = 0; y < height; y++) {
+            gray_stream.push_line(&frames[f & 1][(size_t)y * width], &rgb[(size_t)y * width * 3], &gray[(size_t)y * width]);
+        }
+        if (f < 2) {
+            errors += memcmp(gray.data(), ref_gray[f].data(), n_pixels) != 0;
+        }
+    }
+    double gray_ms = duration<double, milli>(steady_clock::now() - start).count() / n_frames;
+    errors += memcmp(rgb.data(), ref_rgb[(n_frames - 1) & 1].data(), rgb.size()) != 0;
+
+    // rgb_to_gray gives the gray of the IP without its delay
+    vector<uint8_t> aligned(n_pixels);
+    rgb_to_gray(ref_rgb[0].data(), n_pixels, aligned.data());
+    errors += memcmp(aligned.data(), ref_gray[0].data() + 2, n_pixels - 2) != 0;
+
+    double megapixels = n_pixels / 1e6;
+    printf("[INFO] %dx%d, gamma register %d, %d frames\n", width, height, gamma_reg, n_frames);
+    printf("[INFO] Pixel by pixel reference: %7.2f ms/frame (%6.1f Mpixels/s)\n", reference_ms, megapixels / reference_ms * 1e3);
+    printf("[INFO] bayer_to_rgb:             %7.2f ms/frame (%6.1f Mpixels/s)\n", frame_ms, megapixels / frame_ms * 1e3);
+    printf("[INFO] IspStream, RGB:           %7.2f ms/frame (%6.1f Mpixels/s)\n", stream_ms, megapixels / stream_ms * 1e3);
+    printf("[INFO] IspStream, RGB and gray:  %7.2f ms/frame (%6.1f Mpixels/s)\n", gray_ms, megapixels / gray_ms * 1e3);
+    if (errors > 0) {
+        fprintf(stderr, "[ERROR] %d outputs differ from the reference\n", errors);
+        return 1;
+    }
+    printf("[SUCCESS] All outputs are bit-exact with the reference\n");
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "isp.h"
+
+using namespace std;
+
+// g++ -O2 -std=c++17 -o isp_convert isp_convert.cpp isp.cpp
+
+int main(int argc, char** argv) {
+    /*
+        Converts a dump of 10-bit Bayer frames (one uint16_t per sample, as
+        written for uart_sender) into RGB frames, and optionally the gray
+        frames of RGB2Gray, like the bitstream. The frames are read and
+        converted line by line, so any number of frames of any size fit in
+        memory. With hdl_delay, the gray frames have the two pixel delay of
+        RGB2Gray, to compare them with captures of its output.
+    */
+    if (argc < 6) {
+        printf("Usage: %s <bayer_file> <width> <height> <gamma_reg> <rgb_file> [gray_file] [hdl_delay]\n", argv[0]);
+        return 1;
+    }
+    int width = atoi(argv[2]);
+    int height = atoi(argv[3]);
+    int gamma_reg = atoi(argv[4]);
+    bool hdl_delay = argc > 7 && strcmp(argv[7], "hdl_delay") == 0;
+
+    FILE* bayer_file = fopen(argv[1], "rb");
+    FILE* rgb_file = fopen(argv[5], "wb");
+    FILE* gray_file = argc > 6 ? fopen(argv[6], "wb") : NULL;
+    if (bayer_file == NULL || rgb_file == NULL || (argc > 6 && gray_file == NULL)) {
+        fprintf(stderr, "[ERROR] Failed to open the files\n");
+        return 1;
+    }
+
+    IspStream stream(width, gamma_reg, hdl_delay);
+    vector<uint16_t> line(width);
+    vector<uint8_t> rgb(width * 3), gray(width);
+    long n_frames = 0;
+    while (fread(line.data(), sizeof(uint16_t), width, bayer_file) == (size_t)width) {
+        if (stream.line() == height) {
+            stream.start_frame();
+        }
+        stream.push_line(line.data(), rgb.data(), gray_file != NULL ? gray.data() : NULL);
+        fwrite(rgb.data(), 1, rgb.size(), rgb_file);
+        if (gray_file != NULL) {
+            fwrite(gray.data(), 1, gray.size(), gray_file);
+        }
+        if (stream.line() == height) {
+            n_frames++;
+        }
+    }
+    if (stream.line() != height) {
+        fprintf(stderr, "[ERROR] The last frame is incomplete (%d lines)\n", stream.line());
+    }
+
+    fclose(bayer_file);
+    fclose(rgb_file);
+    if (gray_file != NULL) {
+        fclose(gray_file);
+    }
+    printf("[SUCCESS] %ld frames converted\n", n_frames);
+    return 0;
+}
@@ -0,0 +1,172 @@
+#ifndef FP16BP8_H
+#define FP16BP8_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) && !defined(TCU_NO_SIMD)
+#include <emmintrin.h>
+#define TCU_SSE2
+#elif defined(__ARM_NEON) && !defined(TCU_NO_SIMD)
+#include <arm_neon.h>
+#define TCU_NEON
+#endif
+
+/*
+    Host side input and output of the Tensil TCU, without numpy.
+
+    The TCU works on vectors of array_size values in FP16BP8: int16 with 8
+    fractional bits, little endian, like the arch files of tensil/arch
+    (array_size 8 for the Zybo Z7, 16 for the Ultra96v2). The input image
+    is one vector per pixel in DRAM0, the channels padded with zeros, which
+    is what preprocessing in boards/ultra96v2_pynq_tcu/software/eval.py
+    builds before the driver converts it.
+
+    Fp16bp8Encoder does the same in one pass from the uint8 HWC image: the
+    normalization of eval.py, (v / 255 - mean) / std, is computed once per
+    channel and value into a table, rounded to the nearest FP16BP8 value and
+    saturated, so the vectors are exactly those of the Python path. The
+    array sizes 8 and 16 write each vector with 16-byte SSE2 or NEON stores
+    (define TCU_NO_SIMD to force the scalar code), which matters when DRAM0
+    is not cached.
+
+    decode_output converts the output vectors back into logits and returns
+    the argmax of the first n_classes values, the padding is ignored.
+*/
+
+static const double IMAGENET_MEAN[3] = {0.485, 0.456, 0.406};
+static const double IMAGENET_STD[3] = {0.229, 0.224, 0.225};
+
+static inline int16_t float_to_fp16bp8(double x) {
+    // Nearest value, ties to even like np.round, saturated
+    double v = nearbyint(x * 256.0);
+    return v > 32767.0 ? 32767 : v < -32768.0 ? -32768 : (int16_t)v;
+}
+
+static inline float fp16bp8_to_float(int16_t v) {
+    return v * (1.0f / 256.0f);
+}
+
+// Stores the first vector word (channels 0 to 2 in lanes 0 to 2) and the zeros of the padding
+template <int ARRAY_SIZE>
+struct Fp16bp8Store {
+    static inline void vector(uint64_t word, int16_t *out) {
+        for (int k = 0; k < 3; k++) {
+            out[k] = (int16_t)(word >> (16 * k));
+        }
+        for (int k = 3; k < ARRAY_SIZE; k++) {
+            out[k] = 0;
+        }
+    }
+};
+
+template <>
+struct Fp16bp8Store<8> {
+    static inline void vector(uint64_t word, int16_t *out) {
+#if defined(TCU_SSE2)
+        _mm_storeu_si128((__m128i *)out, _mm_loadl_epi64((const __m128i *)&word));
+#elif defined(TCU_NEON)
+        vst1q_s16(out, vcombine_s16(vcreate_s16(word), vdup_n_s16(0)));
+#else
+        uint64_t lanes[2] = {word, 0};
+        memcpy(out, lanes, sizeof(lanes));
+#endif
+    }
+};
+
+template <>
+struct Fp16bp8Store<16> {
+    static inline void vector(uint64_t word, int16_t *out) {
+#if defined(TCU_SSE2)
+        _mm_storeu_si128((__m128i *)out, _mm_loadl_epi64((const __m128i *)&word));
+        _mm_storeu_si128((__m128i *)(out + 8), _mm_setzero_si128());
+#elif defined(TCU_NEON)
+        vst1q_s16(out, vcombine_s16(vcreate_s16(word), vdup_n_s16(0)));
+        vst1q_s16(out + 8, vdupq_n_s16(0));
+#else
+        uint64_t lanes[4] = {word, 0, 0, 0};
+        memcpy(out, lanes, sizeof(lanes));
+#endif
+    }
+};
+
+template <int ARRAY_SIZE>
+class Fp16bp8Encoder {
+    static_assert(ARRAY_SIZE >= 3, "the 3 channels must fit in a vector");
+
+public:
+    explicit Fp16bp8Encoder(const double mean[3] = IMAGENET_MEAN, const double std[3] = IMAGENET_STD) {
+        /*
+            Same operations as eval.py: the division by 255 in float32, the
+            mean and std in float64.
+        */
+        for (int c = 0; c < 3; c++) {
+            for (int v = 0; v < 256; v++) {
+                double x = ((double)((float)v / 255.0f) - mean[c]) / std[c];
+                lanes[c][v] = (uint64_t)(uint16_t)float_to_fp16bp8(x) << (16 * c);
+            }
+        }
+    }
+
+    // Number of int16_t of the vectors of an image
+    static size_t vectors_size(size_t n_pixels) { return n_pixels * ARRAY_SIZE; }
+
+    // FP16BP8 value of channel c for the byte v
+    int16_t value(int c, uint8_t v) const { return (int16_t)(lanes[c][v] >> (16 * c)); }
+
+    // Converts n_pixels of an HWC image with 3 channels, or 4 (the 4th is
+    // dropped like the alpha channel in eval.py), into vectors_size(n_pixels) values
+    void encode(const uint8_t *image, size_t n_pixels, int channels, int16_t *vectors) const {
+        for (size_t i = 0; i < n_pixels; i++, image += channels, vectors += ARRAY_SIZE) {
+            uint64_t word = lanes[0][image[0]] | lanes[1][image[1]] | lanes[2][image[2]];
+            Fp16bp8Store<ARRAY_SIZE>::vector(word, vectors);
+        }
+    }
+
+private:
+    uint64_t lanes[3][256];     // Value of channel c already in its lane of the first 64 bits
+};
+
+template <int ARRAY_SIZE>
+int decode_output(const int16_t *vectors, int n_classes, float *logits) {
+    /*
+        Reads the n_classes values of the output vectors (whole vectors, the
+        padding of the last one included), writes them as floats and returns
+        the index of the first maximum like np.argmax. The conversion is
+        exact, so the argmax is taken on the int16 values.
+    */
+    int best = 0;
+    int i = 0;
+#if defined(TCU_SSE2) || defined(TCU_NEON)
+    if (ARRAY_SIZE % 8 == 0) {
+        for (; i < n_classes; i += 8) {
+            float converted[8];
+#if defined(TCU_SSE2)
+            __m128i v = _mm_loadu_si128((const __m128i *)(vectors + i));
+            __m128 scale = _mm_set1_ps(1.0f / 256.0f);
+            _mm_storeu_ps(converted, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)), scale));
+            _mm_storeu_ps(converted + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)), scale));
+#else
+            int16x8_t v = vld1q_s16(vectors + i);
+            vst1q_f32(converted, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), 1.0f / 256.0f));
+            vst1q_f32(converted + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.0f / 256.0f));
+#endif
+            int n = n_classes - i < 8 ? n_classes - i : 8;
+            for (int k = 0; k < n; k++) {
+                logits[i + k] = converted[k];
+                best = vectors[i + k] > vectors[best] ? i + k : best;
+            }
+        }
+        return best;
+    }
+#endif
+    for (; i < n_classes; i++) {
+        logits[i] = fp16bp8_to_float(vectors[i]);
+        best = vectors[i] > vectors[best] ? i : best;
+    }
+    return best;
+}
+
+#endif // FP16BP8_H
@@ -0,0 +1,96 @@
+import argparse
+import ast
+import os
+import subprocess
+import tempfile
+
+import numpy as np
+
+# Compares fp16bp8_tool (fp16bp8.h) with the Python path of the TCU: the preprocessing
+# function of eval.py, then the FP16BP8 conversion of the driver.
+# Build the tool first: g++ -O2 -std=c++17 -o fp16bp8_tool fp16bp8_tool.cpp
+
+EVAL_PY = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "boards",
+                       "ultra96v2_pynq_tcu", "software", "eval.py")
+
+
+class FakeTcu:
+    # Only what preprocessing uses of the driver
+    class Arch:
+        pass
+
+    def __init__(self, array_size):
+        self.arch = FakeTcu.Arch()
+        self.arch.array_size = array_size
+
+
+def load_preprocessing(array_size):
+    # eval.py needs pynq to be imported, so only its preprocessing function is taken
+    with open(EVAL_PY) as f:
+        tree = ast.parse(f.read())
+    function = next(node for node in tree.body if isinstance(node, ast.FunctionDef) and node.name == "preprocessing")
+    scope = {"np": np, "tcu": FakeTcu(array_size)}
+    exec(compile(ast.Module(body=[function], type_ignores=[]), EVAL_PY, "exec"), scope)
+    return scope["preprocessing"]
+
+
+def to_fp16bp8(x):
+    # Nearest value with 8 fractional bits, saturated to int16
+    return np.clip(np.round(x * 256), -32768, 32767).astype("<i2")
+
+
+def run(tool, *args):
+    return subprocess.run([tool] + [str(a) for a in args], check=True, capture_output=True, text=True).stdout
+
+
+def check_encode(tool, array_size, width, height, channels, n_images, rng, tmp):
+    preprocessing = load_preprocessing(array_size)
+    images = rng.integers(0, 256, (n_images, height, width, channels), dtype=np.uint8)
+    # Every value in every channel at least once
+    images[0].reshape(-1, channels)[:256] = np.arange(256, dtype=np.uint8)[:, None]
+    image_file = os.path.join(tmp, "images.bin")
+    vectors_file = os.path.join(tmp, "vectors.bin")
+    images.tofile(image_file)
+    run(tool, "encode", array_size, width, height, channels, image_file, vectors_file)
+    vectors = np.fromfile(vectors_file, dtype="<i2").reshape(n_images, -1, array_size)
+    expected = np.stack([to_fp16bp8(preprocessing(image)) for image in images])
+    return int(np.count_nonzero(vectors != expected))
+
+
+def check_decode(tool, array_size, n_classes, n_outputs, rng, tmp):
+    n_vectors = -(-n_classes // array_size)
+    # Few distinct values to have ties
+    outputs = (rng.integers(0, 16, (n_outputs, n_vectors * array_size)) * 2000 - 16000).astype("<i2")
+    vectors_file = os.path.join(tmp, "outputs.bin")
+    outputs.tofile(vectors_file)
+    lines = run(tool, "decode", array_size, n_classes, vectors_file).splitlines()
+    errors = 0
+    for line, output in zip(lines, outputs):
+        values = line.split()
+        classes = output.astype(np.float32)[:n_classes] / np.float32(256)
+        logits = np.array([float(v) for v in values[1:]], dtype=np.float32)
+        errors += int(values[0]) != np.argmax(classes) or not np.array_equal(logits, classes)
+    return errors + abs(len(lines) - n_outputs)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Check fp16bp8_tool against eval.py")
+    parser.add_argument("-t", "--tool", default="./fp16bp8_tool", help="Path to fp16bp8_tool")
+    parser.add_argument("-n", "--n-images", type=int, default=4, help="Images per configuration")
+    args = parser.parse_args()
+
+    rng = np.random.default_rng(0)
+    errors = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        for array_size in (8, 16):
+            for channels in (3, 4):
+                n = check_encode(args.tool, array_size, 224, 224, channels, args.n_images, rng, tmp)
+                print(f"[INFO] Array size {array_size}, {channels} channels: {n} values differ from eval.py")
+                errors += n
+            n = check_decode(args.tool, array_size, 12, 1000, rng, tmp)
+            print(f"[INFO] Array size {array_size}: {n} outputs decoded differently")
+            errors += n
+    if errors > 0:
+        print("[ERROR] fp16bp8_tool does not match the Python path")
+        exit(1)
+    print("[SUCCESS] fp16bp8_tool matches the Python path")
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "fp16bp8.h"
+
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -o fp16bp8_tool fp16bp8_tool.cpp
+
+template <int ARRAY_SIZE>
+int encode_file(FILE* in, FILE* out, size_t n_pixels, int channels) {
+    // Converts the images one after the other, returns the number of images
+    Fp16bp8Encoder<ARRAY_SIZE> encoder;
+    vector<uint8_t> image(n_pixels * channels);
+    vector<int16_t> vectors(encoder.vectors_size(n_pixels));
+    int n_images = 0;
+    while (fread(image.data(), 1, image.size(), in) == image.size()) {
+        encoder.encode(image.data(), n_pixels, channels, vectors.data());
+        fwrite(vectors.data(), sizeof(int16_t), vectors.size(), out);
+        n_images++;
+    }
+    return n_images;
+}
+
+template <int ARRAY_SIZE>
+int decode_file(FILE* in, int n_classes) {
+    // Prints the argmax and the logits of each output, returns the number of outputs
+    vector<int16_t> vectors((n_classes + ARRAY_SIZE - 1) / ARRAY_SIZE * ARRAY_SIZE);
+    vector<float> logits(n_classes);
+    int n_outputs = 0;
+    while (fread(vectors.data(), sizeof(int16_t), vectors.size(), in) == vectors.size()) {
+        printf("%d", decode_output<ARRAY_SIZE>(vectors.data(), n_classes, logits.data()));
+        for (float l : logits) {
+            printf(" %.9g", l);
+        }
+        printf("\n");
+        n_outputs++;
+    }
+    return n_outputs;
+}
+
+template <int ARRAY_SIZE>
+int bench(int width, int height, int n_runs) {
+    /*
+        Checks the encoder against the normalization computed pixel by pixel
+        like eval.py, and the decoder on random outputs, then measures both.
+    */
+    size_t n_pixels = (size_t)width * height;
+    mt19937 rng(ARRAY_SIZE);
+    vector<uint8_t> image(n_pixels * 4);
+    for (auto& v : image) {
+        v = rng();
+    }
+    Fp16bp8Encoder<ARRAY_SIZE> encoder;
+    vector<int16_t> vectors(encoder.vectors_size(n_pixels), -1);
+    int errors = 0;
+    for (int channels = 3; channels <= 4; channels++) {
+        encoder.encode(image.data(), n_pixels, channels, vectors.data());
+        for (size_t i = 0; i < n_pixels; i++) {
+            for (int k = 0; k < ARRAY_SIZE; k++) {
+                double x = k < 3 ? ((double)((float)image[i * channels + k] / 255.0f) - IMAGENET_MEAN[k]) / IMAGENET_STD[k] : 0.0;
+                errors += vectors[i * ARRAY_SIZE + k] != float_to_fp16bp8(x);
+            }
+        }
+    }
+
+    vector<int16_t> outputs(64 * ARRAY_SIZE);
+    float logits[64];
+    for (int t = 0; t < 1000; t++) {
+        int n_classes = rng() % 64 + 1;
+        for (auto& v : outputs) {
+            // Few distinct values to have ties
+            v = (int16_t)(rng() % 16) * 2000 - 16000;
+        }
+        int best = decode_output<ARRAY_SIZE>(outputs.data(), n_classes, logits);
+        int expected = 0;
+        for (int i = 0; i < n_classes; i++) {
+            errors += logits[i] != outputs[i] / 256.0f;
+            expected = outputs[i] > outputs[expected] ? i : expected;
+        }
+        errors += best != expected;
+    }
+    if (errors > 0) {
+        fprintf(stderr, "[ERROR] Array size %d: %d values differ from the reference\n", ARRAY_SIZE, errors);
+        return 1;
+    }
+
+    // The reference in floats, pixel by pixel, as a baseline
+    auto start = steady_clock::now();
+    for (int r = 0; r < n_runs; r++) {
+        for (size_t i = 0; i < n_pixels; i++) {
+            for (int k = 0; k < ARRAY_SIZE; k++) {
+                double x = k < 3 ? (image[i * 3 + k] / 255.0f - IMAGENET_MEAN[k]) / IMAGENET_STD[k] : 0.0;
+                vectors[i * ARRAY_SIZE + k] = float_to_fp16bp8(x);
+            }
+        }
+    }
+    double float_ms = duration<double, milli>(steady_clock::now() - start).count() / n_runs;
+    start = steady_clock::now();
+    for (int r = 0; r < n_runs; r++) {
+        encoder.encode(image.data(), n_pixels, 3, vectors.data());
+    }
+    double encode_ms = duration<double, milli>(steady_clock::now() - start).count() / n_runs;
+    start = steady_clock::now();
+    volatile int sink = 0;
+    for (int r = 0; r < 100000; r++) {
+        sink = sink + decode_output<ARRAY_SIZE>(outputs.data(), 12, logits);
+    }
+    double decode_us = duration<double, micro>(steady_clock::now() - start).count() / 100000;
+    printf("[INFO] Array size %2d, %dx%d: floats %.3f ms, encoder %.3f ms (%.0f MB/s written), 12 logits decoded in %.3f us\n",
+           ARRAY_SIZE, width, height, float_ms, encode_ms,
+           vectors.size() * sizeof(int16_t) / encode_ms / 1e3, decode_us);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    /*
+        encode: converts a file of uint8 HWC images (3 or 4 channels) into
+        the FP16BP8 vectors of DRAM0 (int16, little endian), the input of the
+        TCU. decode: prints the argmax and the logits of a file of output
+        vectors, one line per output. bench: checks the conversions against
+        the computation of eval.py and measures them. fp16bp8_check.py
+        compares encode and decode with the Python path.
+    */
+    if (argc < 2) {
+        printf("Usage: %s encode <array_size> <width> <height> <channels> <image_file> <vectors_file>\n", argv[0]);
+        printf("       %s decode <array_size> <n_classes> <vectors_file>\n", argv[0]);
+        printf("       %s bench [width] [height] [n_runs]\n", argv[0]);
+        return 1;
+    }
+
+    if (strcmp(argv[1], "bench") == 0) {
+        int width = argc > 2 ? atoi(argv[2]) : 224;
+        int height = argc > 3 ? atoi(argv[3]) : 224;
+        int n_runs = argc > 4 ? atoi(argv[4]) : 100;
+        if (width <= 0 || height <= 0 || n_runs <= 0 || bench<8>(width, height, n_runs) || bench<16>(width, height, n_runs)) {
+            return 1;
+        }
+        printf("[SUCCESS] Encoder and decoder match the reference\n");
+        return 0;
+    }
+
+    int array_size = argc > 2 ? atoi(argv[2]) : 0;
+    if (array_size != 8 && array_size != 16) {
+        fprintf(stderr, "[ERROR] Array size must be 8 (Zybo Z7) or 16 (Ultra96v2)\n");
+        return 1;
+    }
+    if (strcmp(argv[1], "encode") == 0 && argc == 8) {
+        int width = atoi(argv[3]), height = atoi(argv[4]), channels = atoi(argv[5]);
+        if (width <= 0 || height <= 0 || (channels != 3 && channels != 4)) {
+            fprintf(stderr, "[ERROR] Invalid image size or number of channels\n");
+            return 1;
+        }
+        FILE* in = fopen(argv[6], "rb");
+        FILE* out = fopen(argv[7], "wb");
+        if (in == NULL || out == NULL) {
+            fprintf(stderr, "[ERROR] Failed to open the files\n");
+            return 1;
+        }
+        size_t n_pixels = (size_t)width * height;
+        int n = array_size == 8 ? encode_file<8>(in, out, n_pixels, channels) : encode_file<16>(in, out, n_pixels, channels);
+        fclose(in);
+        fclose(out);
+        printf("[SUCCESS] %d images converted to %s\n", n, argv[7]);
+        return 0;
+    }
+    if (strcmp(argv[1], "decode") == 0 && argc == 5) {
+        int n_classes = atoi(argv[3]);
+        FILE* in = fopen(argv[4], "rb");
+        if (n_classes <= 0 || in == NULL) {
+            fprintf(stderr, "[ERROR] Invalid number of classes or failed to open %s\n", argv[4]);
+            return 1;
+        }
+        array_size == 8 ? decode_file<8>(in, n_classes) : decode_file<16>(in, n_classes);
+        fclose(in);
+        return 0;
+    }
+    fprintf(stderr, "[ERROR] Unknown command or wrong number of arguments\n");
+    return 1;
+}
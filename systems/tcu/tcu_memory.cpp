@@ -0,0 +1,160 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tcu_memory.h"
+
+void tcu_memory_defaults(TcuMemoryRequest *request) {
+    memset(request, 0, sizeof(*request));
+    request->ddr_base = 0x00100000;
+    request->ddr_end = 0x20000000;
+    request->alignment = 1 << 20;
+    request->elf_size = 8 << 20;
+    request->stack_size = 1 << 20;
+    request->heap_size = 16 << 20;
+    request->record_size = 224 * 224 * 3 + sizeof(uint16_t);
+    request->n_images = TCU_MEMORY_ALL_IMAGES;
+}
+
+int tcu_data_type_size(const char *data_type) {
+    if (strcmp(data_type, "FP8BP4") == 0) {
+        return 1;
+    }
+    if (strcmp(data_type, "FP16BP8") == 0) {
+        return 2;
+    }
+    if (strcmp(data_type, "FP32BP16") == 0) {
+        return 4;
+    }
+    return 0;
+}
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static uint64_t add_region(TcuMemoryPlan *plan, const char *name, uint64_t base, uint64_t size) {
+    TcuMemoryRegion &region = plan->regions[plan->n_regions++];
+    snprintf(region.name, sizeof(region.name), "%s", name);
+    region.base = base;
+    region.size = size;
+    plan->end = base + size;
+    return plan->end;
+}
+
+static bool objects_fit(const TensilObject *objects, int n, uint32_t depth) {
+    for (int i = 0; i < n; i++) {
+        if ((uint64_t)objects[i].base + objects[i].size > depth) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int tcu_plan_memory(const TensilArch &arch, const TensilModel &model, const TcuMemoryRequest &request, TcuMemoryPlan *plan) {
+    /*
+        Checks that the model was compiled for arch and that its objects fit
+        in its DRAMs, then places the regions one after the other from
+        ddr_base. DRAM1 directly follows DRAM0, both form the DRAM buffer of
+        the driver. The dataset takes n_images records, or all the DDR left,
+        and max_images is the largest number of records that fits after the
+        other regions.
+    */
+    memset(plan, 0, sizeof(*plan));
+    int scalar = tcu_data_type_size(arch.data_type);
+    if (scalar == 0) {
+        fprintf(stderr, "[ERROR] Unknown data type %s.\n", arch.data_type);
+        return -1;
+    }
+    if (strcmp(model.arch.data_type, arch.data_type) != 0 || model.arch.array_size != arch.array_size ||
+        model.arch.dram0_depth != arch.dram0_depth || model.arch.dram1_depth != arch.dram1_depth) {
+        fprintf(stderr, "[ERROR] The model %s was compiled for another architecture.\n", model.name);
+        return -1;
+    }
+    if (!objects_fit(model.consts, model.n_consts, arch.dram1_depth) ||
+        !objects_fit(model.inputs, model.n_inputs, arch.dram0_depth) ||
+        !objects_fit(model.outputs, model.n_outputs, arch.dram0_depth)) {
+        fprintf(stderr, "[ERROR] The constants, inputs or outputs of %s do not fit in the DRAMs of the architecture.\n", model.name);
+        return -1;
+    }
+    if (request.alignment == 0 || request.record_size == 0 || request.n_buffers > TCU_MEMORY_MAX_REGIONS - 5) {
+        fprintf(stderr, "[ERROR] Invalid memory request.\n");
+        return -1;
+    }
+
+    uint64_t vector = (uint64_t)arch.array_size * scalar;
+    uint64_t a = request.alignment;
+    uint64_t cursor = add_region(plan, "elf", align_up(request.ddr_base, a), request.elf_size + request.stack_size + request.heap_size);
+    cursor = add_region(plan, "dram0", align_up(cursor, a), (uint64_t)arch.dram0_depth * vector);
+    cursor = add_region(plan, "dram1", cursor, (uint64_t)arch.dram1_depth * vector);
+    cursor = add_region(plan, "prog", align_up(cursor, a), request.stream_window > 0 ? request.stream_window : model.prog_size);
+    for (int i = 0; i < request.n_buffers; i++) {
+        cursor = add_region(plan, request.buffers[i].name, align_up(cursor, a), request.buffers[i].size);
+    }
+
+    uint64_t dataset_base = align_up(cursor, a);
+    plan->max_images = dataset_base <= request.ddr_end ? (int64_t)((request.ddr_end - dataset_base) / request.record_size) : -1;
+    plan->n_images = request.n_images == TCU_MEMORY_ALL_IMAGES ? plan->max_images : request.n_images;
+    if (plan->n_images < 0) {
+        plan->n_images = 0;
+    }
+    add_region(plan, "dataset", dataset_base, plan->n_images * request.record_size);
+    return plan->end <= request.ddr_end ? 0 : -1;
+}
+
+static void macro_name(const char *name, char *macro, size_t size) {
+    size_t i = 0;
+    for (; name[i] != '\0' && i + 1 < size; i++) {
+        macro[i] = isalnum((unsigned char)name[i]) ? toupper((unsigned char)name[i]) : '_';
+    }
+    macro[i] = '\0';
+}
+
+int tcu_write_memory_header(const char *path, const TcuMemoryPlan &plan, const TcuMemoryRequest &request, const TensilModel &model) {
+    /*
+        One BASE and SIZE per region, the buffers of tensil_platform.h with
+        their inclusive HIGH address, and the values of lscript.ld.
+    */
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Failed to open %s.\n", path);
+        return -1;
+    }
+    const TcuMemoryRegion *regions = plan.regions;
+    const TcuMemoryRegion &elf = regions[0], &dram0 = regions[1], &dram1 = regions[2], &prog = regions[3];
+    const TcuMemoryRegion &dataset = regions[plan.n_regions - 1];
+    fprintf(file, "// Generated by tcu_memory_plan for %s, do not edit\n", model.name);
+    fprintf(file, "#ifndef TCU_MEMORY_MAP_H\n#define TCU_MEMORY_MAP_H\n\n");
+    fprintf(file, "#define TCU_MEMORY_MODEL \"%s\"\n\n", model.name);
+
+    fprintf(file, "// lscript.ld: ps7_ddr_0 : ORIGIN = 0x%08llX, LENGTH = 0x%08llX, _STACK_SIZE = 0x%llX, _HEAP_SIZE = 0x%llX\n",
+            (unsigned long long)elf.base, (unsigned long long)elf.size, (unsigned long long)request.stack_size,
+            (unsigned long long)request.heap_size);
+    fprintf(file, "#define TCU_MEMORY_STACK_SIZE 0x%llX\n", (unsigned long long)request.stack_size);
+    fprintf(file, "#define TCU_MEMORY_HEAP_SIZE 0x%llX\n\n", (unsigned long long)request.heap_size);
+
+    fprintf(file, "// tensil_platform.h\n");
+    fprintf(file, "#define TENSIL_PLATFORM_DRAM_BUFFER_BASE 0x%08llX\n", (unsigned long long)dram0.base);
+    fprintf(file, "#define TENSIL_PLATFORM_DRAM_BUFFER_HIGH 0x%08llX\n", (unsigned long long)(dram1.base + dram1.size - 1));
+    fprintf(file, "#define TENSIL_PLATFORM_PROG_BUFFER_BASE 0x%08llX\n", (unsigned long long)prog.base);
+    fprintf(file, "#define TENSIL_PLATFORM_PROG_BUFFER_HIGH 0x%08llX\n\n", (unsigned long long)(prog.base + prog.size - 1));
+    fprintf(file, "#define TCU_MEMORY_PROG_STREAMED %d\n\n", request.stream_window > 0 ? 1 : 0);
+
+    for (int i = 0; i < plan.n_regions; i++) {
+        char macro[32];
+        macro_name(regions[i].name, macro, sizeof(macro));
+        fprintf(file, "#define TCU_MEMORY_%s_BASE 0x%08llX\n", macro, (unsigned long long)regions[i].base);
+        fprintf(file, "#define TCU_MEMORY_%s_SIZE 0x%08llX\n", macro, (unsigned long long)regions[i].size);
+    }
+    fprintf(file, "#define TCU_MEMORY_DATASET_RECORD_SIZE %llu\n", (unsigned long long)request.record_size);
+    fprintf(file, "#define TCU_MEMORY_DATASET_IMAGES %lld\n\n", (long long)plan.n_images);
+    fprintf(file, "#define TCU_MEMORY_END 0x%08llX\n\n", (unsigned long long)(dataset.base + dataset.size));
+    fprintf(file, "#endif // TCU_MEMORY_MAP_H\n");
+    int error = ferror(file);
+    fclose(file);
+    if (error) {
+        fprintf(stderr, "[ERROR] Failed to write %s.\n", path);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+#ifndef TCU_MEMORY_H
+#define TCU_MEMORY_H
+
+#include <stdint.h>
+
+#include "tensil_model.h"
+
+/*
+    Memory map of a bare-metal Tensil deployment on the DDR of the Zybo Z7
+    (512 MB from 0x00000000, the application linked from 0x00100000 like the
+    default lscript.ld). The regions follow each other without overlapping,
+    each one aligned:
+
+        elf      code, data, bss, stack and heap of the application (ps7_ddr_0 of lscript.ld)
+        dram0    DRAM0 of the TCU: inputs, outputs and activations
+        dram1    DRAM1 of the TCU: the constants (.tdata)
+        prog     the program (.tprog), or the window that streams it (tprog_stream.h)
+        ...      the other buffers of the application (frames, ...)
+        dataset  n_images records of the binary dataset
+
+    The default alignment is 1 MB, the size of a section of the MMU, so that
+    the attributes of a region (non-cacheable for example) can be set with
+    Xil_SetTlbAttributes without touching its neighbours.
+*/
+
+#define TCU_MEMORY_MAX_REGIONS  16
+#define TCU_MEMORY_ALL_IMAGES   -1      // n_images of the dataset: all the DDR left
+
+typedef struct {
+    char name[32];
+    uint64_t base;
+    uint64_t size;
+} TcuMemoryRegion;
+
+typedef struct {
+    uint64_t ddr_base;              // First address the application may use
+    uint64_t ddr_end;               // After the last byte of the DDR
+    uint64_t alignment;
+    uint64_t elf_size;              // Code, data and bss
+    uint64_t stack_size;
+    uint64_t heap_size;
+    uint64_t stream_window;         // 0: the whole program is loaded
+    uint64_t record_size;           // One record of the dataset
+    int64_t n_images;               // Or TCU_MEMORY_ALL_IMAGES
+    int n_buffers;                  // Other buffers of the application, placed before the dataset
+    TcuMemoryRegion buffers[TCU_MEMORY_MAX_REGIONS - 5];
+} TcuMemoryRequest;
+
+typedef struct {
+    int n_regions;
+    TcuMemoryRegion regions[TCU_MEMORY_MAX_REGIONS];
+    uint64_t end;                   // After the last region: the peak address used
+    int64_t n_images;               // Records of the dataset in the map
+    int64_t max_images;             // Largest dataset that fits with the other regions
+} TcuMemoryPlan;
+
+// Zybo Z7 defaults: 512 MB, 1 MB alignment, 8 MB of ELF, 1 MB of stack, 16 MB of heap, 224x224 RGB records with their label
+void tcu_memory_defaults(TcuMemoryRequest *request);
+
+// Bytes of one scalar of a Tensil data type, 0 if unknown
+int tcu_data_type_size(const char *data_type);
+
+// Place the regions for a model compiled for arch. Return 0 if everything fits,
+// -1 otherwise (plan still filled, with max_images < 0 when even no image fits).
+int tcu_plan_memory(const TensilArch &arch, const TensilModel &model, const TcuMemoryRequest &request, TcuMemoryPlan *plan);
+
+// Write the plan as a C header for the application. Return 0 on success, -1 on error.
+int tcu_write_memory_header(const char *path, const TcuMemoryPlan &plan, const TcuMemoryRequest &request, const TensilModel &model);
+
+#endif // TCU_MEMORY_H
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tcu_memory.h"
+
+// g++ -O2 -std=c++17 -o tcu_memory_plan tcu_memory_plan.cpp tcu_memory.cpp tensil_model.cpp
+
+static void print_plan(const TcuMemoryPlan &plan, const TcuMemoryRequest &request) {
+    printf("%-12s %-10s %-10s %10s\n", "Region", "Base", "End", "Size (MB)");
+    for (int i = 0; i < plan.n_regions; i++) {
+        const TcuMemoryRegion &r = plan.regions[i];
+        printf("%-12s 0x%08llX 0x%08llX %10.2f\n", r.name, (unsigned long long)r.base, (unsigned long long)(r.base + r.size),
+               r.size / 1048576.0);
+    }
+    double used = (double)(plan.end - request.ddr_base) / 1048576.0;
+    double total = (double)(request.ddr_end - request.ddr_base) / 1048576.0;
+    printf("[INFO] Peak address 0x%08llX: %.2f MB of %.2f MB used (%.1f%%)\n", (unsigned long long)plan.end, used, total,
+           100.0 * used / total);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    /*
+        Plans the DDR of a bare-metal deployment of a model: the application,
+        the DRAMs of the TCU, the program, the other buffers and n_images
+        records of the dataset (max for all the DDR left). If everything
+        fits, writes the map as a header for tensil_platform.h and the
+        application. Otherwise, prints what overflows and what would fit.
+    */
+    if (argc < 4) {
+        printf("Usage: %s <arch.tarch> <model.tmodel> <n_images | max> [header.h] [record_bytes=n] [ddr_mb=n] [align_kb=n] "
+               "[elf_kb=n] [stack_kb=n] [heap_kb=n] [stream_kb=n] [buffer=<name>:<kb>]...\n", argv[0]);
+        return 1;
+    }
+    TensilArch arch;
+    TensilModel model;
+    if (tensil_load_arch(argv[1], &arch) != 0 || tensil_load_model(argv[2], &model) != 0) {
+        return 1;
+    }
+    TcuMemoryRequest request;
+    tcu_memory_defaults(&request);
+    request.n_images = strcmp(argv[3], "max") == 0 ? TCU_MEMORY_ALL_IMAGES : atoll(argv[3]);
+    if (request.n_images < 0 && strcmp(argv[3], "max") != 0) {
+        fprintf(stderr, "[ERROR] Invalid number of images %s\n", argv[3]);
+        return 1;
+    }
+    const char *header = NULL;
+    for (int i = 4; i < argc; i++) {
+        char *value = strchr(argv[i], '=');
+        if (value == NULL) {
+            header = argv[i];
+            continue;
+        }
+        *value++ = '\0';
+        unsigned long long n = strtoull(value, NULL, 10);
+        if (strcmp(argv[i], "record_bytes") == 0) {
+            request.record_size = n;
+        } else if (strcmp(argv[i], "ddr_mb") == 0) {
+            request.ddr_end = n << 20;
+        } else if (strcmp(argv[i], "align_kb") == 0) {
+            request.alignment = n << 10;
+        } else if (strcmp(argv[i], "elf_kb") == 0) {
+            request.elf_size = n << 10;
+        } else if (strcmp(argv[i], "stack_kb") == 0) {
+            request.stack_size = n << 10;
+        } else if (strcmp(argv[i], "heap_kb") == 0) {
+            request.heap_size = n << 10;
+        } else if (strcmp(argv[i], "stream_kb") == 0) {
+            request.stream_window = n << 10;
+        } else if (strcmp(argv[i], "buffer") == 0) {
+            char *size = strchr(value, ':');
+            if (size == NULL || request.n_buffers == TCU_MEMORY_MAX_REGIONS - 5) {
+                fprintf(stderr, "[ERROR] Invalid buffer %s\n", value);
+                return 1;
+            }
+            *size++ = '\0';
+            TcuMemoryRegion &buffer = request.buffers[request.n_buffers++];
+            snprintf(buffer.name, sizeof(buffer.name), "%s", value);
+            buffer.size = strtoull(size, NULL, 10) << 10;
+        } else {
+            fprintf(stderr, "[ERROR] Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    TcuMemoryPlan plan;
+    int result = tcu_plan_memory(arch, model, request, &plan);
+    if (plan.n_regions == 0) {
+        return 1;
+    }
+    print_plan(plan, request);
+    if (result != 0) {
+        fprintf(stderr, "[ERROR] The map ends at 0x%08llX, %.2f MB after the end of the DDR\n", (unsigned long long)plan.end,
+                (plan.end - request.ddr_end) / 1048576.0);
+        if (plan.max_images >= 0) {
+            printf("[INFO] At most %lld images fit: run with %lld (or max)\n", (long long)plan.max_images, (long long)plan.max_images);
+        } else if (request.stream_window == 0) {
+            // The program itself does not fit: would it with a streaming window?
+            TcuMemoryRequest streamed = request;
+            TcuMemoryPlan streamed_plan;
+            streamed.stream_window = 1 << 20;
+            streamed.n_images = 0;
+            tcu_plan_memory(arch, model, streamed, &streamed_plan);
+            if (streamed_plan.max_images > 0) {
+                printf("[INFO] The program does not fit: stream it from the SD card (stream_kb=1024, see tprog_stream.h), "
+                       "then %lld images fit\n", (long long)streamed_plan.max_images);
+            }
+        }
+        return 1;
+    }
+    if (request.n_images != TCU_MEMORY_ALL_IMAGES && plan.max_images > plan.n_images) {
+        printf("[INFO] Up to %lld images fit (max)\n", (long long)plan.max_images);
+    }
+    if (header != NULL) {
+        if (tcu_write_memory_header(header, plan, request, model) != 0) {
+            return 1;
+        }
+        printf("[SUCCESS] Memory map of %s with %lld images written to %s\n", model.name, (long long)plan.n_images, header);
+    }
+    return 0;
+}
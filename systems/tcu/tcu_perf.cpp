@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "tcu_perf.h"
+
+using namespace std;
+
+static int parse_layer(char *line, TcuLayer *layer) {
+    memset(layer, 0, sizeof(*layer));
+    char *token = strtok(line, " \t\r\n");
+    if (token == NULL || token[0] == '#') {
+        return 0;
+    }
+    if (strcmp(token, "conv") == 0 || strcmp(token, "fc") == 0) {
+        layer->type = TCU_LAYER_CONV;
+    } else if (strcmp(token, "avgpool") == 0) {
+        layer->type = TCU_LAYER_AVGPOOL;
+    } else {
+        return -1;
+    }
+    // fc is a 1x1 convolution on a 1x1 input
+    layer->in_h = layer->in_w = layer->kernel = layer->stride = 1;
+    while ((token = strtok(NULL, " \t\r\n")) != NULL) {
+        char *value = strchr(token, '=');
+        if (value != NULL) {
+            *value++ = '\0';
+        }
+        if (strcmp(token, "relu") == 0) {
+            layer->relu = true;
+        } else if (strcmp(token, "add") == 0) {
+            layer->add = true;
+        } else if (value == NULL) {
+            return -1;
+        } else if (strcmp(token, "name") == 0) {
+            snprintf(layer->name, sizeof(layer->name), "%s", value);
+        } else if (strcmp(token, "input") == 0) {
+            int h, w, c;
+            if (sscanf(value, "%dx%dx%d", &h, &w, &c) == 3) {
+                layer->in_h = h;
+                layer->in_w = w;
+                layer->in_c = c;
+            } else if (sscanf(value, "%d", &layer->in_c) != 1) {
+                return -1;
+            }
+        } else if (strcmp(token, "output") == 0) {
+            layer->out_c = atoi(value);
+        } else if (strcmp(token, "kernel") == 0) {
+            layer->kernel = atoi(value);
+        } else if (strcmp(token, "stride") == 0) {
+            layer->stride = atoi(value);
+        } else if (strcmp(token, "pad") == 0) {
+            layer->pad = atoi(value);
+        } else if (strcmp(token, "maxpool") == 0) {
+            if (sscanf(value, "%d,%d,%d", &layer->pool_kernel, &layer->pool_stride, &layer->pool_pad) != 3) {
+                return -1;
+            }
+        } else {
+            return -1;
+        }
+    }
+    if (layer->type == TCU_LAYER_AVGPOOL) {
+        layer->out_c = layer->in_c;
+    }
+    int out_h, out_w;
+    tcu_layer_output(*layer, &out_h, &out_w);
+    if (layer->in_c <= 0 || layer->out_c <= 0 || layer->kernel <= 0 || layer->stride <= 0 || out_h <= 0 || out_w <= 0) {
+        return -1;
+    }
+    return 1;
+}
+
+int tcu_load_layers(const char *path, vector<TcuLayer> &layers) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Failed to open %s.\n", path);
+        return -1;
+    }
+    layers.clear();
+    char line[512];
+    for (int n = 1; fgets(line, sizeof(line), file) != NULL; n++) {
+        TcuLayer layer;
+        int result = parse_layer(line, &layer);
+        if (result < 0) {
+            fprintf(stderr, "[ERROR] Invalid layer at line %d of %s.\n", n, path);
+            fclose(file);
+            return -1;
+        }
+        if (result > 0) {
+            layers.push_back(layer);
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+static void conv_output(const TcuLayer &layer, int *out_h, int *out_w) {
+    *out_h = (layer.in_h + 2 * layer.pad - layer.kernel) / layer.stride + 1;
+    *out_w = (layer.in_w + 2 * layer.pad - layer.kernel) / layer.stride + 1;
+}
+
+void tcu_layer_output(const TcuLayer &layer, int *out_h, int *out_w) {
+    if (layer.type == TCU_LAYER_AVGPOOL) {
+        *out_h = *out_w = 1;
+        return;
+    }
+    conv_output(layer, out_h, out_w);
+    if (layer.pool_kernel > 0) {
+        *out_h = (*out_h + 2 * layer.pool_pad - layer.pool_kernel) / layer.pool_stride + 1;
+        *out_w = (*out_w + 2 * layer.pool_pad - layer.pool_kernel) / layer.pool_stride + 1;
+    }
+}
+
+static uint64_t div_ceil(uint64_t a, uint64_t b) {
+    return (a + b - 1) / b;
+}
+
+static uint64_t move_cycles(uint64_t vectors, int array_size, const TcuPerfOptions &options) {
+    // One vector per cycle, or less when the DRAM port is narrower than a vector
+    if (options.dram_bytes_per_cycle <= 0) {
+        return vectors;
+    }
+    uint64_t limited = (uint64_t)(vectors * array_size * 2 / options.dram_bytes_per_cycle + 0.5);
+    return limited > vectors ? limited : vectors;
+}
+
+typedef struct {
+    int64_t rows;           // Output rows of a partition (1 in column mode)
+    int64_t cols;           // Output columns of a partition
+    uint64_t partitions;    // Per stage
+    uint64_t input;         // Input vectors read per stage, halos included
+} Partitioning;
+
+static bool partition(const TcuLayer &layer, int out_h, int out_w, int64_t ci_tiles, int64_t outputs_per_pixel,
+                      int64_t local_available, int64_t accumulators, Partitioning *p) {
+    /*
+        Largest partitions of whole output rows whose input rows and results
+        fit in local_available vectors and whose results fit in the
+        accumulators, or of a part of a single row if a row does not fit.
+    */
+    int64_t k = layer.kernel, s = layer.stride;
+    int64_t row_in = (int64_t)layer.in_w * ci_tiles;
+    int64_t rows = (local_available - (k - s) * row_in) / (s * row_in + out_w * outputs_per_pixel);
+    rows = min(rows, accumulators / (out_w * outputs_per_pixel));
+    rows = min(rows, (int64_t)out_h);
+    if (rows >= 1) {
+        uint64_t full = out_h / rows, last = out_h % rows;
+        uint64_t rows_in = full * min((int64_t)layer.in_h, (rows - 1) * s + k) +
+                           (last > 0 ? min((int64_t)layer.in_h, ((int64_t)last - 1) * s + k) : 0);
+        *p = {rows, out_w, full + (last > 0), rows_in * row_in};
+        return true;
+    }
+    // k input rows of the columns of a part of one output row
+    int64_t cols = (local_available - k * (k - s) * ci_tiles) / (k * s * ci_tiles + outputs_per_pixel);
+    cols = min(cols, accumulators / outputs_per_pixel);
+    if (cols < 1) {
+        return false;
+    }
+    uint64_t full = out_w / cols, last = out_w % cols;
+    uint64_t cols_in = full * min((int64_t)layer.in_w, (cols - 1) * s + k) +
+                       (last > 0 ? min((int64_t)layer.in_w, ((int64_t)last - 1) * s + k) : 0);
+    *p = {1, cols, (uint64_t)out_h * (full + (last > 0)), (uint64_t)out_h * k * cols_in * ci_tiles};
+    return true;
+}
+
+static TcuLayerCost avgpool_cost(const TensilArch &arch, const TcuLayer &layer, const TcuPerfOptions &options) {
+    // Each input vector read, moved to the accumulators and summed, then one vector per channel tile
+    uint64_t in = (uint64_t)layer.in_h * layer.in_w * div_ceil(layer.in_c, arch.array_size);
+    uint64_t out = div_ceil(layer.in_c, arch.array_size);
+    TcuLayerCost cost = {};
+    cost.dram0_vectors = in + out;
+    cost.cycles = move_cycles(in, arch.array_size, options) + 2 * in + 2 * out + move_cycles(out, arch.array_size, options);
+    cost.stages = cost.partitions = 1;
+    return cost;
+}
+
+TcuLayerCost tcu_layer_cost(const TensilArch &arch, const TcuLayer &layer, const TcuPerfOptions &options) {
+    /*
+        For each number of output channel tiles per stage, the partitions
+        are the largest that fit, and the cheapest choice is kept. Per stage:
+        its weights from DRAM1 once, and for each partition the input rows
+        from DRAM0 (again for each stage), one weight tile loaded per kernel
+        position and input channel tile, the matrix multiplications, then
+        the results moved to the local memory, through the SIMD unit
+        (activation, residual, pooling) and to DRAM0. Stages is 0 when the
+        layer cannot be scheduled on this architecture.
+    */
+    if (layer.type == TCU_LAYER_AVGPOOL) {
+        return avgpool_cost(arch, layer, options);
+    }
+    int64_t a = arch.array_size;
+    int64_t ci_tiles = div_ceil(layer.in_c, a), co_tiles = div_ceil(layer.out_c, a);
+    int64_t taps = (int64_t)layer.kernel * layer.kernel;
+    int out_h, out_w, pooled_h, pooled_w;
+    conv_output(layer, &out_h, &out_w);
+    tcu_layer_output(layer, &pooled_h, &pooled_w);
+    uint64_t out_vectors = (uint64_t)out_h * out_w * co_tiles;
+    uint64_t pooled_vectors = (uint64_t)pooled_h * pooled_w * co_tiles;
+    uint64_t in_vectors = (uint64_t)layer.in_h * layer.in_w * ci_tiles;
+    uint64_t weight_vectors = taps * ci_tiles * co_tiles * a + co_tiles;
+    int64_t accumulators = arch.accumulator_depth / 2;      // Double-buffered
+    int64_t staging = layer.add ? 2 : 1;                    // Results, and residuals read from DRAM0
+
+    // Independent of the stages: multiplications, SIMD, results, residuals
+    uint64_t matmul = taps * ci_tiles * out_vectors;
+    uint64_t simd = (layer.relu ? out_vectors : 0) + (layer.add ? out_vectors : 0) +
+                    (layer.pool_kernel > 0 ? pooled_vectors * layer.pool_kernel * layer.pool_kernel : 0);
+    uint64_t fixed = matmul + simd + out_vectors + (layer.add ? out_vectors : 0) +
+                     move_cycles((layer.add ? out_vectors : 0) + pooled_vectors, a, options);
+
+    TcuLayerCost best = {};
+    for (int64_t g = 1; g <= co_tiles; g++) {
+        int64_t stages = div_ceil(co_tiles, g);
+        if (g > 1 && (int64_t)div_ceil(co_tiles, g - 1) == stages) {
+            continue;       // Same number of stages with fewer tiles
+        }
+        int64_t stage_weights = taps * ci_tiles * g * a + g;
+        Partitioning p;
+        if (!partition(layer, out_h, out_w, ci_tiles, g * staging, arch.local_depth - stage_weights, accumulators, &p)) {
+            continue;
+        }
+        uint64_t input = p.input * stages;
+        uint64_t load_weights = taps * ci_tiles * co_tiles * p.partitions * (a + 1);
+        uint64_t cycles = fixed + move_cycles(input + weight_vectors, a, options) + load_weights;
+        if (best.stages == 0 || cycles < best.cycles) {
+            best = {};
+            best.cycles = cycles;
+            best.dram0_vectors = input + (layer.add ? out_vectors : 0) + pooled_vectors;
+            best.dram1_vectors = weight_vectors;
+            best.spill_vectors = input > in_vectors ? input - in_vectors : 0;     // Strided 1x1 convolutions skip rows
+            best.stages = stages;
+            best.partitions = stages * p.partitions;
+        }
+    }
+
+    if (best.stages == 0) {
+        // The weights of one output tile do not fit: half of the local memory for the input
+        // and the results of a partition, the other half for the weights, read again for each partition
+        Partitioning p;
+        if (arch.local_depth / 2 < (uint32_t)a + 1 ||
+            !partition(layer, out_h, out_w, ci_tiles, staging, arch.local_depth / 2, accumulators, &p)) {
+            return best;
+        }
+        uint64_t input = p.input * co_tiles;
+        uint64_t weights = weight_vectors * p.partitions;
+        uint64_t load_weights = taps * ci_tiles * co_tiles * p.partitions * (a + 1);
+        best.cycles = fixed + move_cycles(input + weights, a, options) + load_weights;
+        best.dram0_vectors = input + (layer.add ? out_vectors : 0) + pooled_vectors;
+        best.dram1_vectors = weights;
+        best.spill_vectors = (input > in_vectors ? input - in_vectors : 0) + weights - weight_vectors;
+        best.stages = co_tiles;
+        best.partitions = co_tiles * p.partitions;
+        best.weights_streamed = true;
+    }
+    best.matmul_cycles = matmul;
+    best.true_macs = (uint64_t)out_h * out_w * layer.out_c * layer.in_c * taps;
+    return best;
+}
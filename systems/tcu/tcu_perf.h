@@ -0,0 +1,70 @@
+#ifndef TCU_PERF_H
+#define TCU_PERF_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "tensil_model.h"
+
+/*
+    Performance model of the TCU for an architecture (.tarch), to compare
+    arch variants before synthesis. Each layer is scheduled like the Tensil
+    compiler does: the output channels are split in stages whose weights
+    stay in the local memory, each stage in partitions of output rows whose
+    inputs fit in the rest of the local memory and whose results fit in half
+    of the accumulators. The instructions of the partitions are counted with
+    the latencies of the compiler (one vector per cycle for the data moves,
+    array_size + 1 cycles to load a weight tile), so the cycles can be
+    compared with its compile logs.
+
+    Layers are described in a text file, one per line (see models/ and
+    tensil/onnx_to_layers.py):
+
+        conv name=<name> input=<h>x<w>x<c> output=<c> kernel=<k> stride=<s> pad=<p> [relu] [add] [maxpool=<k>,<s>,<p>]
+        fc name=<name> input=<c> output=<c>
+        avgpool name=<name> input=<h>x<w>x<c>
+
+    add is a residual connection added to the output (read from DRAM0),
+    maxpool a pooling fused after the activation, avgpool a global average.
+*/
+
+#define TCU_LAYER_CONV      0
+#define TCU_LAYER_AVGPOOL   1
+
+typedef struct {
+    char name[64];
+    int type;
+    int in_h, in_w, in_c;
+    int out_c;
+    int kernel, stride, pad;
+    bool relu;
+    bool add;
+    int pool_kernel, pool_stride, pool_pad;     // pool_kernel 0 without maxpool
+} TcuLayer;
+
+typedef struct {
+    double dram_bytes_per_cycle;    // Bandwidth of the DRAM ports, 0 for one vector per cycle like the compiler
+} TcuPerfOptions;
+
+typedef struct {
+    uint64_t cycles;
+    uint64_t matmul_cycles;
+    uint64_t dram0_vectors;         // Read and written
+    uint64_t dram1_vectors;
+    uint64_t spill_vectors;         // DRAM vectors beyond reading the inputs and weights once: halos and re-reads
+    uint64_t true_macs;             // Without the padding of the channels
+    int stages;
+    int partitions;
+    bool weights_streamed;          // The weights of one output tile do not fit in the local memory
+} TcuLayerCost;
+
+// Parse a layer file. Return 0 on success, -1 on error.
+int tcu_load_layers(const char *path, std::vector<TcuLayer> &layers);
+
+// Output size of a layer (after its maxpool)
+void tcu_layer_output(const TcuLayer &layer, int *out_h, int *out_w);
+
+TcuLayerCost tcu_layer_cost(const TensilArch &arch, const TcuLayer &layer, const TcuPerfOptions &options);
+
+#endif // TCU_PERF_H
@@ -0,0 +1,270 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tcu_perf.h"
+
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -pthread -o tcu_perf_sim tcu_perf_sim.cpp tcu_perf.cpp tensil_model.cpp
+
+typedef struct {
+    const char* key;
+    size_t offset;
+    bool is_int;                // int field, uint32_t otherwise
+} ArchField;
+
+static const ArchField arch_fields[] = {
+    {"array_size", offsetof(TensilArch, array_size), true},
+    {"local_depth", offsetof(TensilArch, local_depth), false},
+    {"accumulator_depth", offsetof(TensilArch, accumulator_depth), false},
+    {"dram0_depth", offsetof(TensilArch, dram0_depth), false},
+    {"dram1_depth", offsetof(TensilArch, dram1_depth), false},
+};
+
+typedef struct {
+    TensilArch arch;
+    uint64_t cycles;
+    uint64_t dram_vectors;
+    uint64_t spill_vectors;
+    uint64_t max_activation;    // Largest input plus output of a layer, in vectors
+    uint64_t weights;           // All the weights, in vectors
+    bool schedulable;
+} Result;
+
+static uint32_t get_field(const TensilArch& arch, const ArchField& field) {
+    if (field.is_int) {
+        return (uint32_t)*(const int*)((const char*)&arch + field.offset);
+    }
+    return *(const uint32_t*)((const char*)&arch + field.offset);
+}
+
+static void set_field(TensilArch& arch, const ArchField& field, uint32_t value) {
+    if (field.is_int) {
+        *(int*)((char*)&arch + field.offset) = (int)value;
+    } else {
+        *(uint32_t*)((char*)&arch + field.offset) = value;
+    }
+}
+
+static uint64_t vectors(int h, int w, int c, int array_size) {
+    return (uint64_t)h * w * ((c + array_size - 1) / array_size);
+}
+
+static Result evaluate(const TensilArch& arch, const vector<TcuLayer>& layers, const TcuPerfOptions& options,
+                       vector<TcuLayerCost>* costs) {
+    Result r = {};
+    r.arch = arch;
+    r.schedulable = true;
+    for (const TcuLayer& layer : layers) {
+        TcuLayerCost cost = tcu_layer_cost(arch, layer, options);
+        if (costs != NULL) {
+            costs->push_back(cost);
+        }
+        r.schedulable = r.schedulable && cost.stages > 0;
+        r.cycles += cost.cycles;
+        r.dram_vectors += cost.dram0_vectors + cost.dram1_vectors;
+        r.spill_vectors += cost.spill_vectors;
+        int out_h, out_w;
+        tcu_layer_output(layer, &out_h, &out_w);
+        r.max_activation = max(r.max_activation, vectors(layer.in_h, layer.in_w, layer.in_c, arch.array_size) +
+                                                 vectors(out_h, out_w, layer.out_c, arch.array_size));
+        if (layer.type == TCU_LAYER_CONV) {
+            r.weights += (uint64_t)layer.kernel * layer.kernel * ((layer.in_c + arch.array_size - 1) / arch.array_size) *
+                         ((layer.out_c + arch.array_size - 1) / arch.array_size) * (arch.array_size + 1);
+        }
+    }
+    return r;
+}
+
+static int bram36(const TensilArch& arch) {
+    // Local memory and accumulators, array_size values of 16 bits per vector, 36 Kb per block
+    uint64_t bits = ((uint64_t)arch.local_depth + arch.accumulator_depth) * arch.array_size * 16;
+    return (int)((bits + 36863) / 36864);
+}
+
+static const char* fit(const Result& r, int max_dsp, int max_bram36) {
+    if (!r.schedulable) {
+        return "no (local)";
+    }
+    if ((max_dsp > 0 && r.arch.array_size * r.arch.array_size > max_dsp) || (max_bram36 > 0 && bram36(r.arch) > max_bram36)) {
+        return "no (FPGA)";
+    }
+    if (r.max_activation > r.arch.dram0_depth) {
+        return "no (DRAM0)";
+    }
+    return r.weights > r.arch.dram1_depth ? "no (DRAM1)" : "yes";
+}
+
+int main(int argc, char** argv) {
+    /*
+        Estimates the cycles, DRAM traffic and spills of a model on an
+        architecture, layer by layer. With lists of values for fields of the
+        architecture (array_size=8,16 local_depth=4096,8192,...), estimates
+        every combination on n_threads threads and prints the fastest ones
+        that fit in the FPGA (max_dsp multipliers, max_bram36 blocks) and in
+        the DRAM buffers.
+        The cycles are those of the compiler estimate; with clock_mhz, the
+        time of an inference is printed too. dram_bytes_per_cycle limits the
+        data moves to the bandwidth of the DRAM ports.
+    */
+    if (argc < 3) {
+        printf("Usage: %s <arch.tarch> <model.layers> [field=v1,v2,...]... [threads=n] [top=n] [clock_mhz=f] "
+               "[dram_bytes_per_cycle=b] [max_dsp=n] [max_bram36=n]\n", argv[0]);
+        return 1;
+    }
+    TensilArch base;
+    vector<TcuLayer> layers;
+    if (tensil_load_arch(argv[1], &base) != 0 || tcu_load_layers(argv[2], layers) != 0) {
+        return 1;
+    }
+    TcuPerfOptions options = {0};
+    int n_threads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+    int top = 20;
+    double clock_mhz = 0;
+    int max_dsp = 0, max_bram36 = 0;
+    vector<const ArchField*> sweep_fields;
+    vector<vector<uint32_t>> sweep_values;
+    for (int i = 3; i < argc; i++) {
+        char* value = strchr(argv[i], '=');
+        if (value == NULL) {
+            fprintf(stderr, "[ERROR] Invalid option %s\n", argv[i]);
+            return 1;
+        }
+        string key(argv[i], value - argv[i]);
+        value++;
+        if (key == "threads") {
+            n_threads = max(1, atoi(value));
+        } else if (key == "top") {
+            top = atoi(value);
+        } else if (key == "clock_mhz") {
+            clock_mhz = atof(value);
+        } else if (key == "max_dsp") {
+            max_dsp = atoi(value);
+        } else if (key == "max_bram36") {
+            max_bram36 = atoi(value);
+        } else if (key == "dram_bytes_per_cycle") {
+            options.dram_bytes_per_cycle = atof(value);
+        } else {
+            const ArchField* field = NULL;
+            for (const ArchField& f : arch_fields) {
+                field = key == f.key ? &f : field;
+            }
+            if (field == NULL) {
+                fprintf(stderr, "[ERROR] Unknown field %s\n", key.c_str());
+                return 1;
+            }
+            vector<uint32_t> values;
+            for (char* v = strtok(value, ","); v != NULL; v = strtok(NULL, ",")) {
+                values.push_back(strtoul(v, NULL, 10));
+                if (values.back() == 0) {
+                    fprintf(stderr, "[ERROR] Invalid value for %s\n", key.c_str());
+                    return 1;
+                }
+            }
+            sweep_fields.push_back(field);
+            sweep_values.push_back(values);
+        }
+    }
+
+    if (sweep_fields.empty()) {
+        // One architecture, layer by layer
+        vector<TcuLayerCost> costs;
+        Result r = evaluate(base, layers, options, &costs);
+        int a = base.array_size;
+        printf("%-22s %7s %10s %8s %6s %9s %9s %9s %7s\n", "Layer", "Stages", "Partitions", "MCycles", "MAC %",
+               "DRAM0 MB", "DRAM1 MB", "Spill MB", "");
+        for (size_t i = 0; i < layers.size(); i++) {
+            const TcuLayerCost& c = costs[i];
+            if (c.stages == 0) {
+                printf("%-22s does not fit in the local memory or the accumulators\n", layers[i].name);
+                continue;
+            }
+            printf("%-22s %7d %10d %8.3f %6.1f %9.2f %9.2f %9.2f %7s\n", layers[i].name, c.stages, c.partitions,
+                   c.cycles / 1e6, c.cycles > 0 ? 100.0 * c.true_macs / ((double)c.cycles * a * a) : 0.0,
+                   c.dram0_vectors * a * 2 / 1e6, c.dram1_vectors * a * 2 / 1e6, c.spill_vectors * a * 2 / 1e6,
+                   c.weights_streamed ? "stream" : "");
+        }
+        printf("[INFO] Total: %.3f MCycles, %.2f MB of DRAM traffic, %.2f MB of spills, %d DSP, ~%d BRAM36, fits: %s\n",
+               r.cycles / 1e6, r.dram_vectors * a * 2 / 1e6, r.spill_vectors * a * 2 / 1e6, a * a, bram36(base), fit(r, max_dsp, max_bram36));
+        if (clock_mhz > 0) {
+            printf("[INFO] %.2f ms per inference at %.0f MHz\n", r.cycles / clock_mhz / 1e3, clock_mhz);
+        }
+        return strcmp(fit(r, max_dsp, max_bram36), "yes") == 0 ? 0 : 1;
+    }
+
+    // Every combination of the values, evaluated on n_threads threads
+    vector<TensilArch> variants(1, base);
+    for (size_t f = 0; f < sweep_fields.size(); f++) {
+        vector<TensilArch> next;
+        for (const TensilArch& arch : variants) {
+            for (uint32_t v : sweep_values[f]) {
+                next.push_back(arch);
+                set_field(next.back(), *sweep_fields[f], v);
+            }
+        }
+        variants.swap(next);
+    }
+    vector<Result> results(variants.size());
+    atomic<size_t> next_variant(0);
+    auto start = steady_clock::now();
+    vector<thread> threads;
+    for (int t = 0; t < n_threads; t++) {
+        threads.emplace_back([&]() {
+            for (size_t i; (i = next_variant++) < variants.size();) {
+                results[i] = evaluate(variants[i], layers, options, NULL);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    double seconds = duration<double>(steady_clock::now() - start).count();
+
+    // The variants that fit first, fastest first
+    int n_fit = 0;
+    for (const Result& r : results) {
+        n_fit += strcmp(fit(r, max_dsp, max_bram36), "yes") == 0;
+    }
+    stable_sort(results.begin(), results.end(), [&](const Result& x, const Result& y) {
+        bool x_fits = strcmp(fit(x, max_dsp, max_bram36), "yes") == 0;
+        bool y_fits = strcmp(fit(y, max_dsp, max_bram36), "yes") == 0;
+        if (x_fits != y_fits) {
+            return x_fits;
+        }
+        return x.cycles < y.cycles;
+    });
+    for (const ArchField* field : sweep_fields) {
+        printf("%*s ", (int)strlen(field->key), field->key);
+    }
+    printf("%9s", "MCycles");
+    if (clock_mhz > 0) {
+        printf(" %8s", "ms");
+    }
+    printf(" %8s %9s %5s %7s %s\n", "DRAM MB", "Spill MB", "DSP", "BRAM36", "Fits");
+    for (int i = 0; i < (int)results.size() && i < top; i++) {
+        const Result& r = results[i];
+        int a = r.arch.array_size;
+        for (const ArchField* field : sweep_fields) {
+            printf("%*u ", (int)strlen(field->key), get_field(r.arch, *field));
+        }
+        printf("%9.3f", r.cycles / 1e6);
+        if (clock_mhz > 0) {
+            printf(" %8.2f", r.cycles / clock_mhz / 1e3);
+        }
+        printf(" %8.1f %9.1f %5d %7d %s\n", r.dram_vectors * a * 2 / 1e6, r.spill_vectors * a * 2 / 1e6, a * a,
+               bram36(r.arch), fit(r, max_dsp, max_bram36));
+    }
+    printf("[INFO] %zu variants of %zu layers in %.3f s on %d threads, %d fit\n", variants.size(), layers.size(), seconds,
+           n_threads, n_fit);
+    return 0;
+}
@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tensil_model.h"
+
+/*
+    Minimal JSON reader: each function takes a pointer to the start of a
+    value and returns the pointer after it, or NULL on a syntax error.
+    Members that are not needed are skipped.
+*/
+
+typedef const char *(*MemberParser)(const char *key, const char *p, void *ctx);
+typedef const char *(*ElementParser)(int i, const char *p, void *ctx);
+
+static const char *skip_ws(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+        p++;
+    }
+    return p;
+}
+
+static const char *parse_string(const char *p, char *out, size_t max) {
+    // Escaped characters are kept as they are, the names of the compiler have none
+    if (*p != '"') {
+        return NULL;
+    }
+    size_t n = 0;
+    for (p++; *p != '"'; p++) {
+        if (*p == '\0') {
+            return NULL;
+        }
+        if (*p == '\\' && p[1] != '\0') {
+            p++;
+        }
+        if (out != NULL && n + 1 < max) {
+            out[n++] = *p;
+        }
+    }
+    if (out != NULL) {
+        out[n] = '\0';
+    }
+    return p + 1;
+}
+
+static const char *parse_uint(const char *p, uint64_t *value) {
+    char *end;
+    unsigned long long v = strtoull(p, &end, 10);
+    if (end == p || *p == '-') {
+        return NULL;
+    }
+    *value = v;
+    return end;
+}
+
+static const char *skip_value(const char *p);
+
+static const char *parse_object(const char *p, MemberParser member, void *ctx) {
+    if (*p != '{') {
+        return NULL;
+    }
+    p = skip_ws(p + 1);
+    if (*p == '}') {
+        return p + 1;
+    }
+    while (p != NULL) {
+        char key[64];
+        p = parse_string(p, key, sizeof(key));
+        if (p == NULL) {
+            return NULL;
+        }
+        p = skip_ws(p);
+        if (*p != ':') {
+            return NULL;
+        }
+        p = skip_ws(p + 1);
+        p = member != NULL ? member(key, p, ctx) : skip_value(p);
+        if (p == NULL) {
+            return NULL;
+        }
+        p = skip_ws(p);
+        if (*p == '}') {
+            return p + 1;
+        }
+        p = *p == ',' ? skip_ws(p + 1) : NULL;
+    }
+    return NULL;
+}
+
+static const char *parse_array(const char *p, ElementParser element, void *ctx) {
+    if (*p != '[') {
+        return NULL;
+    }
+    p = skip_ws(p + 1);
+    if (*p == ']') {
+        return p + 1;
+    }
+    for (int i = 0; p != NULL; i++) {
+        p = element != NULL ? element(i, p, ctx) : skip_value(p);
+        if (p == NULL) {
+            return NULL;
+        }
+        p = skip_ws(p);
+        if (*p == ']') {
+            return p + 1;
+        }
+        p = *p == ',' ? skip_ws(p + 1) : NULL;
+    }
+    return NULL;
+}
+
+static const char *skip_value(const char *p) {
+    if (*p == '{') {
+        return parse_object(p, NULL, NULL);
+    }
+    if (*p == '[') {
+        return parse_array(p, NULL, NULL);
+    }
+    if (*p == '"') {
+        return parse_string(p, NULL, 0);
+    }
+    const char *start = p;
+    while (*p != '\0' && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t') {
+        p++;
+    }
+    return p > start ? p : NULL;
+}
+
+static const char *parse_u32(const char *p, uint32_t *value) {
+    uint64_t v;
+    p = parse_uint(p, &v);
+    if (p == NULL || v > 0xFFFFFFFF) {
+        return NULL;
+    }
+    *value = (uint32_t)v;
+    return p;
+}
+
+static const char *parse_int(const char *p, int *value) {
+    uint32_t v;
+    p = parse_u32(p, &v);
+    if (p == NULL || v > 0x7FFFFFFF) {
+        return NULL;
+    }
+    *value = (int)v;
+    return p;
+}
+
+static const char *arch_member(const char *key, const char *p, void *ctx) {
+    TensilArch *arch = (TensilArch *)ctx;
+    if (strcmp(key, "data_type") == 0)               return parse_string(p, arch->data_type, sizeof(arch->data_type));
+    if (strcmp(key, "array_size") == 0)              return parse_int(p, &arch->array_size);
+    if (strcmp(key, "dram0_depth") == 0)             return parse_u32(p, &arch->dram0_depth);
+    if (strcmp(key, "dram1_depth") == 0)             return parse_u32(p, &arch->dram1_depth);
+    if (strcmp(key, "local_depth") == 0)             return parse_u32(p, &arch->local_depth);
+    if (strcmp(key, "accumulator_depth") == 0)       return parse_u32(p, &arch->accumulator_depth);
+    if (strcmp(key, "simd_registers_depth") == 0)    return parse_u32(p, &arch->simd_registers_depth);
+    if (strcmp(key, "stride0_depth") == 0)           return parse_u32(p, &arch->stride0_depth);
+    if (strcmp(key, "stride1_depth") == 0)           return parse_u32(p, &arch->stride1_depth);
+    if (strcmp(key, "number_of_threads") == 0)       return parse_int(p, &arch->number_of_threads);
+    if (strcmp(key, "thread_queue_depth") == 0)      return parse_int(p, &arch->thread_queue_depth);
+    return skip_value(p);
+}
+
+static const char *object_member(const char *key, const char *p, void *ctx) {
+    TensilObject *object = (TensilObject *)ctx;
+    if (strcmp(key, "name") == 0 || strcmp(key, "file_name") == 0) return parse_string(p, object->name, sizeof(object->name));
+    if (strcmp(key, "base") == 0)                    return parse_u32(p, &object->base);
+    if (strcmp(key, "size") == 0)                    return parse_u32(p, &object->size);
+    return skip_value(p);
+}
+
+typedef struct {
+    TensilObject *objects;
+    int *n_objects;
+} ObjectList;
+
+static const char *object_element(int i, const char *p, void *ctx) {
+    ObjectList *list = (ObjectList *)ctx;
+    if (i >= TENSIL_MAX_OBJECTS) {
+        fprintf(stderr, "[ERROR] More than %d consts, inputs or outputs in the model.\n", TENSIL_MAX_OBJECTS);
+        return NULL;
+    }
+    *list->n_objects = i + 1;
+    return parse_object(p, object_member, &list->objects[i]);
+}
+
+static const char *prog_member(const char *key, const char *p, void *ctx) {
+    TensilModel *model = (TensilModel *)ctx;
+    if (strcmp(key, "file_name") == 0)               return parse_string(p, model->prog_file, sizeof(model->prog_file));
+    if (strcmp(key, "size") == 0)                    return parse_uint(p, &model->prog_size);
+    return skip_value(p);
+}
+
+static const char *model_member(const char *key, const char *p, void *ctx) {
+    TensilModel *model = (TensilModel *)ctx;
+    if (strcmp(key, "name") == 0)                    return parse_string(p, model->name, sizeof(model->name));
+    if (strcmp(key, "prog") == 0)                    return parse_object(p, prog_member, model);
+    if (strcmp(key, "arch") == 0)                    return parse_object(p, arch_member, &model->arch);
+    if (strcmp(key, "load_consts_to_local") == 0) {
+        model->load_consts_to_local = strncmp(p, "true", 4) == 0;
+        return skip_value(p);
+    }
+    ObjectList list;
+    if (strcmp(key, "consts") == 0) {
+        list = {model->consts, &model->n_consts};
+    } else if (strcmp(key, "inputs") == 0) {
+        list = {model->inputs, &model->n_inputs};
+    } else if (strcmp(key, "outputs") == 0) {
+        list = {model->outputs, &model->n_outputs};
+    } else {
+        return skip_value(p);
+    }
+    return parse_array(p, object_element, &list);
+}
+
+static int check_arch(const TensilArch *arch) {
+    if (arch->array_size <= 0 || arch->local_depth == 0 || arch->accumulator_depth == 0 ||
+        arch->dram0_depth == 0 || arch->dram1_depth == 0 || arch->stride0_depth == 0 || arch->stride1_depth == 0) {
+        fprintf(stderr, "[ERROR] The architecture misses array_size, a depth or a stride.\n");
+        return -1;
+    }
+    return 0;
+}
+
+int tensil_parse_arch(const char *json, TensilArch *arch) {
+    memset(arch, 0, sizeof(*arch));
+    const char *end = parse_object(skip_ws(json), arch_member, arch);
+    if (end == NULL || *skip_ws(end) != '\0') {
+        fprintf(stderr, "[ERROR] Invalid JSON in the architecture.\n");
+        return -1;
+    }
+    return check_arch(arch);
+}
+
+int tensil_parse_model(const char *json, TensilModel *model) {
+    memset(model, 0, sizeof(*model));
+    const char *end = parse_object(skip_ws(json), model_member, model);
+    if (end == NULL || *skip_ws(end) != '\0') {
+        fprintf(stderr, "[ERROR] Invalid JSON in the model.\n");
+        return -1;
+    }
+    if (model->prog_file[0] == '\0' || model->prog_size == 0) {
+        fprintf(stderr, "[ERROR] The model has no program.\n");
+        return -1;
+    }
+    return check_arch(&model->arch);
+}
+
+static char *read_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Failed to open %s.\n", path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = size >= 0 ? (char *)malloc(size + 1) : NULL;
+    if (text == NULL || fread(text, 1, size, file) != (size_t)size) {
+        fprintf(stderr, "[ERROR] Failed to read %s.\n", path);
+        free(text);
+        fclose(file);
+        return NULL;
+    }
+    text[size] = '\0';
+    fclose(file);
+    return text;
+}
+
+int tensil_load_arch(const char *path, TensilArch *arch) {
+    char *json = read_file(path);
+    int result = json != NULL ? tensil_parse_arch(json, arch) : -1;
+    free(json);
+    return result;
+}
+
+int tensil_load_model(const char *path, TensilModel *model) {
+    char *json = read_file(path);
+    int result = json != NULL ? tensil_parse_model(json, model) : -1;
+    free(json);
+    return result;
+}
+
+static int address_bits(uint32_t depth) {
+    // Bits to address depth entries (log2Ceil of the compiler)
+    int bits = 0;
+    while (bits < 32 && ((uint64_t)1 << bits) < depth) {
+        bits++;
+    }
+    return bits;
+}
+
+static int max_bits(int a, int b) {
+    return a > b ? a : b;
+}
+
+int tensil_instruction_size(const TensilArch *arch) {
+    /*
+        Operand 0: local or accumulator address and stride 0. Operand 1:
+        local, DRAM0, DRAM1 or accumulator address and stride 1. Operand 2:
+        size of a data move (up to a local or accumulator depth) or SIMD
+        operation (4 bits of opcode and 3 registers). The ResNet18 of
+        tensil/ for the Zybo Z7 is 9 bytes per instruction: 54507321 bytes
+        for 6056369 instructions in its compile log.
+    */
+    int local = address_bits(arch->local_depth);
+    int accumulator = address_bits(arch->accumulator_depth);
+    int operand0 = max_bits(local, accumulator) + address_bits(arch->stride0_depth);
+    int operand1 = max_bits(max_bits(local, accumulator), max_bits(address_bits(arch->dram0_depth), address_bits(arch->dram1_depth))) +
+                   address_bits(arch->stride1_depth);
+    int operand2 = max_bits(max_bits(local, accumulator), 4 + 3 * address_bits(arch->simd_registers_depth + 1));
+    return 1 + (operand0 + 7) / 8 + (operand1 + 7) / 8 + (operand2 + 7) / 8;
+}
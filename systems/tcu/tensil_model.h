@@ -0,0 +1,66 @@
+#ifndef TENSIL_MODEL_H
+#define TENSIL_MODEL_H
+
+#include <stdint.h>
+
+/*
+    Metadata of the files produced by the Tensil compiler (see tensil/):
+    the architecture (.tarch, also embedded in the .tmodel) and the model
+    manifest (.tmodel), which names the program (.tprog), the constants
+    (.tdata) and where the inputs and outputs are in DRAM0. Sizes and bases
+    are in vectors of array_size values, except the program size in bytes.
+
+    Only the fields above are parsed from the JSON, without allocation, so
+    that it also runs on the Zybo Z7 in bare-metal.
+*/
+
+#define TENSIL_MAX_NAME     128
+#define TENSIL_MAX_OBJECTS  8
+
+typedef struct {
+    char data_type[16];             // FP16BP8 for the arch files of this repo
+    int array_size;
+    uint32_t dram0_depth;
+    uint32_t dram1_depth;
+    uint32_t local_depth;
+    uint32_t accumulator_depth;
+    uint32_t simd_registers_depth;
+    uint32_t stride0_depth;
+    uint32_t stride1_depth;
+    int number_of_threads;
+    int thread_queue_depth;
+} TensilArch;
+
+typedef struct {
+    char name[TENSIL_MAX_NAME];     // File name for the constants, tensor name for the inputs and outputs
+    uint32_t base;
+    uint32_t size;
+} TensilObject;
+
+typedef struct {
+    char name[TENSIL_MAX_NAME];
+    char prog_file[TENSIL_MAX_NAME];
+    uint64_t prog_size;             // Bytes
+    int n_consts;
+    TensilObject consts[TENSIL_MAX_OBJECTS];
+    int n_inputs;
+    TensilObject inputs[TENSIL_MAX_OBJECTS];
+    int n_outputs;
+    TensilObject outputs[TENSIL_MAX_OBJECTS];
+    TensilArch arch;
+    int load_consts_to_local;
+} TensilModel;
+
+// Parse the JSON of a .tarch or a .tmodel. Return 0 on success, -1 on error.
+int tensil_parse_arch(const char *json, TensilArch *arch);
+int tensil_parse_model(const char *json, TensilModel *model);
+
+// Same from a file
+int tensil_load_arch(const char *path, TensilArch *arch);
+int tensil_load_model(const char *path, TensilModel *model);
+
+// Bytes of one instruction of the program: opcode and flags, then 3 operands
+// rounded up to whole bytes, sized by the depths and strides of the arch
+int tensil_instruction_size(const TensilArch *arch);
+
+#endif // TENSIL_MODEL_H
@@ -0,0 +1,146 @@
+#include "tprog_stream.h"
+
+#ifdef USE_XAXIDMA
+#include "xil_cache.h"
+#include "xtime_l.h"
+#else
+#include <chrono>
+#endif
+
+#define CACHE_LINE_SIZE 64
+
+static double now_seconds() {
+#ifdef USE_XAXIDMA
+    XTime t;
+    XTime_GetTime(&t);
+    return (double)t / COUNTS_PER_SECOND;
+#else
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+long FileProgramSource::read(uint8_t *data, size_t size) {
+    size_t n = fread(data, 1, size, file);
+    return n == 0 && ferror(file) ? -1 : (long)n;
+}
+
+int FileProgramSource::rewind() {
+    return fseek(file, 0, SEEK_SET) == 0 ? 0 : -1;
+}
+
+#ifdef USE_XILFFS
+long FatfsProgramSource::read(uint8_t *data, size_t size) {
+    UINT n;
+    return f_read(file, data, size, &n) == FR_OK ? (long)n : -1;
+}
+
+int FatfsProgramSource::rewind() {
+    return f_lseek(file, 0) == FR_OK ? 0 : -1;
+}
+#endif
+
+#ifdef USE_XAXIDMA
+int DmaInstructionSink::start(const uint8_t *data, size_t size) {
+    // The chunk was written by the CPU, the DMA reads the memory
+    Xil_DCacheFlushRange((UINTPTR)data, size);
+    return XAxiDma_SimpleTransfer(dma, (UINTPTR)data, size, XAXIDMA_DMA_TO_DEVICE) == XST_SUCCESS ? 0 : -1;
+}
+
+bool DmaInstructionSink::busy() {
+    return XAxiDma_Busy(dma, XAXIDMA_DMA_TO_DEVICE);
+}
+
+int DmaInstructionSink::wait() {
+    while (XAxiDma_Busy(dma, XAXIDMA_DMA_TO_DEVICE)) {
+    }
+    return 0;
+}
+#endif
+
+TprogStreamer::TprogStreamer(ProgramSource &source, InstructionSink &sink, int instruction_size,
+                             uint8_t *window, size_t window_size)
+    : source(source), sink(sink), instruction_size(instruction_size), window(window), chunk(0) {
+    // Smallest multiple of the instruction size and of the cache line
+    size_t a = instruction_size, b = CACHE_LINE_SIZE;
+    while (b != 0) {
+        size_t r = a % b;
+        a = b;
+        b = r;
+    }
+    size_t unit = instruction_size > 0 ? (size_t)instruction_size / a * CACHE_LINE_SIZE : 0;
+    if (unit > 0) {
+        chunk = window_size / 2 / unit * unit;
+    }
+}
+
+long TprogStreamer::fill(uint8_t *data, size_t size) {
+    double start = now_seconds();
+    size_t total = 0;
+    while (total < size) {
+        long n = source.read(data + total, size - total);
+        if (n <= 0) {
+            break;
+        }
+        total += n;
+    }
+    stream_stats.read_seconds += now_seconds() - start;
+    return total;
+}
+
+int TprogStreamer::run(uint64_t prog_size) {
+    /*
+        Chunk k is sent while chunk k + 1 is read into the other half of the
+        window. Before chunk k + 1 is sent, the transfer of chunk k must be
+        finished: its half of the window is then free for chunk k + 2.
+    */
+    if (chunk == 0) {
+        fprintf(stderr, "[ERROR] The instruction window is smaller than 2 chunks.\n");
+        return -1;
+    }
+    if (prog_size % instruction_size != 0) {
+        fprintf(stderr, "[ERROR] The program size is not a multiple of %d bytes per instruction.\n", instruction_size);
+        return -1;
+    }
+    if (source.rewind() != 0) {
+        fprintf(stderr, "[ERROR] Failed to go back to the start of the program.\n");
+        return -1;
+    }
+
+    uint64_t remaining = prog_size;
+    size_t size = remaining < chunk ? remaining : chunk;
+    if (fill(window, size) != (long)size) {
+        fprintf(stderr, "[ERROR] The program ends before %llu bytes.\n", (unsigned long long)prog_size);
+        return -1;
+    }
+    int current = 0;
+    bool sending = false;
+    while (size > 0) {
+        remaining -= size;
+        if (sending) {
+            stream_stats.stalls += !sink.busy();
+            double start = now_seconds();
+            if (sink.wait() != 0) {
+                fprintf(stderr, "[ERROR] Transfer of the instructions failed.\n");
+                return -1;
+            }
+            stream_stats.wait_seconds += now_seconds() - start;
+        }
+        if (sink.start(window + current * chunk, size) != 0) {
+            fprintf(stderr, "[ERROR] Failed to start the transfer of the instructions.\n");
+            return -1;
+        }
+        sending = true;
+        stream_stats.bytes += size;
+        stream_stats.chunks++;
+
+        // Next chunk into the other half, while the TCU consumes this one
+        current ^= 1;
+        size = remaining < chunk ? remaining : chunk;
+        if (size > 0 && fill(window + current * chunk, size) != (long)size) {
+            sink.wait();
+            fprintf(stderr, "[ERROR] The program ends before %llu bytes.\n", (unsigned long long)prog_size);
+            return -1;
+        }
+    }
+    return sending ? sink.wait() : 0;
+}
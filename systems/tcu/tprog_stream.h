@@ -0,0 +1,126 @@
+#ifndef TPROG_STREAM_H
+#define TPROG_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef USE_XILFFS
+#include "ff.h"
+#endif
+#ifdef USE_XAXIDMA
+#include "xaxidma.h"
+#endif
+
+/*
+    Streaming of the instructions of a Tensil program (.tprog) to the TCU,
+    for programs that do not fit in memory (a ResNet50 for a 4x4 array
+    needs about 1 GB, the Zybo Z7 has 512 MB).
+
+    The program has no jumps, the TCU executes the instructions in the order
+    of the file, so it does not need to be in memory all at once. The
+    window, a buffer the DMA can read (for example the program buffer of
+    tensil_platform.h), is split in two chunks: while the TCU consumes one,
+    the next one is read from the storage into the other. A chunk is a whole
+    number of instructions and of 64-byte cache lines.
+
+    The program is read again for each inference: streaming is only worth
+    it when the program does not fit, and the TCU waits for the storage
+    whenever it reads slower than the TCU executes (see stats().stalls).
+
+    The storage and the consumer of the instructions are interfaces:
+    FileProgramSource (stdio) on Linux, FatfsProgramSource (xilffs, build
+    with -DUSE_XILFFS) and DmaInstructionSink (AXI DMA of the TCU, build
+    with -DUSE_XAXIDMA) in bare-metal on the Zybo Z7.
+*/
+
+class ProgramSource {
+public:
+    virtual ~ProgramSource() {}
+    // Read up to size bytes, return the number of bytes read (0 at the end), or -1 on error
+    virtual long read(uint8_t *data, size_t size) = 0;
+    // Back to the first instruction, for the next inference. Return 0 or -1.
+    virtual int rewind() = 0;
+};
+
+class InstructionSink {
+public:
+    virtual ~InstructionSink() {}
+    // Start sending size bytes to the TCU, data must not change until wait returns. Return 0 or -1.
+    virtual int start(const uint8_t *data, size_t size) = 0;
+    // True while the last transfer started is not finished
+    virtual bool busy() = 0;
+    // Wait for the end of the last transfer started. Return 0 or -1.
+    virtual int wait() = 0;
+};
+
+class FileProgramSource : public ProgramSource {
+public:
+    explicit FileProgramSource(FILE *file) : file(file) {}
+    long read(uint8_t *data, size_t size) override;
+    int rewind() override;
+
+private:
+    FILE *file;
+};
+
+#ifdef USE_XILFFS
+class FatfsProgramSource : public ProgramSource {
+public:
+    explicit FatfsProgramSource(FIL *file) : file(file) {}
+    long read(uint8_t *data, size_t size) override;
+    int rewind() override;
+
+private:
+    FIL *file;
+};
+#endif
+
+#ifdef USE_XAXIDMA
+// The chunks must not be larger than the maximum transfer of the DMA (width of its length register)
+class DmaInstructionSink : public InstructionSink {
+public:
+    explicit DmaInstructionSink(XAxiDma *dma) : dma(dma) {}
+    int start(const uint8_t *data, size_t size) override;
+    bool busy() override;
+    int wait() override;
+
+private:
+    XAxiDma *dma;
+};
+#endif
+
+typedef struct {
+    uint64_t bytes;
+    uint64_t chunks;
+    uint64_t stalls;            // Chunks ready after the TCU had finished the previous one
+    double read_seconds;        // Reading the storage
+    double wait_seconds;        // Waiting for the TCU with the next chunk ready
+} TprogStreamStats;
+
+class TprogStreamer {
+public:
+    // window holds window_size bytes, at least 2 chunks of lcm(instruction_size, 64) bytes
+    TprogStreamer(ProgramSource &source, InstructionSink &sink, int instruction_size,
+                  uint8_t *window, size_t window_size);
+
+    // Bytes of each of the 2 chunks of the window, 0 if the window is too small
+    size_t chunk_size() const { return chunk; }
+
+    // Send the whole program of prog_size bytes to the TCU once. Return 0 or -1.
+    int run(uint64_t prog_size);
+
+    const TprogStreamStats& stats() const { return stream_stats; }
+
+private:
+    long fill(uint8_t *data, size_t size);
+
+    ProgramSource &source;
+    InstructionSink &sink;
+    int instruction_size;
+    uint8_t *window;
+    size_t chunk;
+    TprogStreamStats stream_stats = {};
+};
+
+#endif // TPROG_STREAM_H
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tensil_model.h"
+#include "tprog_stream.h"
+
+using namespace std;
+using namespace chrono;
+
+// g++ -O2 -std=c++17 -o tprog_stream_sim tprog_stream_sim.cpp tprog_stream.cpp tensil_model.cpp
+
+static uint64_t hash_update(uint64_t hash, const uint8_t* data, size_t size) {
+    // FNV-1a on 8-byte words, then on the last bytes: the same in chunks of multiples of 8 bytes or at once
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 0x100000001B3ULL;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+class SimulatedTcu : public InstructionSink {
+    /*
+        Consumes the instructions at a fixed rate: a transfer ends
+        size / instruction_size / rate seconds after its start. The chunk is
+        only read (hashed) at the end of the transfer, so a chunk overwritten
+        while it is sent changes the hash.
+    */
+public:
+    SimulatedTcu(double rate, int instruction_size) : rate(rate), instruction_size(instruction_size) {}
+
+    int start(const uint8_t* data, size_t size) override {
+        auto now = steady_clock::now();
+        if (pending != NULL) {
+            fprintf(stderr, "[ERROR] Transfer started before the end of the previous one\n");
+            return -1;
+        }
+        if (n_transfers > 0 && now > end) {
+            idle += now - end;
+        }
+        pending = data;
+        pending_size = size;
+        end = now + duration_cast<steady_clock::duration>(duration<double>(size / instruction_size / rate));
+        n_transfers++;
+        return 0;
+    }
+
+    bool busy() override {
+        return steady_clock::now() < end;
+    }
+
+    int wait() override {
+        // Sleep, then spin for the last 200 us: the wake up of sleep_until is late
+        bool early = steady_clock::now() < end;
+        this_thread::sleep_until(end - microseconds(200));
+        while (steady_clock::now() < end) {
+        }
+        if (pending != NULL) {
+            hash = hash_update(hash, pending, pending_size);
+            pending = NULL;
+        }
+        if (early) {
+            // The loader was waiting: the time of the simulation itself is not idle time
+            end = steady_clock::now();
+        }
+        return 0;
+    }
+
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    steady_clock::duration idle = steady_clock::duration::zero();     // Without instructions between two transfers
+
+private:
+    double rate;
+    double instruction_size;
+    const uint8_t* pending = NULL;
+    size_t pending_size = 0;
+    steady_clock::time_point end;
+    uint64_t n_transfers = 0;
+};
+
+class ThrottledSource : public ProgramSource {
+    // A file read at most at rate bytes per second (0: as fast as possible), like an SD card
+public:
+    ThrottledSource(FILE* file, double rate) : file_source(file), rate(rate) {}
+
+    long read(uint8_t* data, size_t size) override {
+        if (total == 0) {
+            start = steady_clock::now();
+        }
+        long n = file_source.read(data, size);
+        if (n > 0 && rate > 0) {
+            total += n;
+            this_thread::sleep_until(start + duration_cast<steady_clock::duration>(duration<double>(total / rate)));
+        }
+        return n;
+    }
+
+    int rewind() override {
+        total = 0;
+        return file_source.rewind();
+    }
+
+private:
+    FileProgramSource file_source;
+    double rate;
+    uint64_t total = 0;
+    steady_clock::time_point start;
+};
+
+static string program_path(const char* model_path, const TensilModel& model) {
+    // The program is next to the model
+    string path = model_path;
+    size_t slash = path.find_last_of('/');
+    return (slash == string::npos ? string() : path.substr(0, slash + 1)) + model.prog_file;
+}
+
+int main(int argc, char** argv) {
+    /*
+        Streams the program of a model from its file through a window of
+        window_kb KB to a simulated TCU that executes instructions_per_s
+        instructions per second, with the file read at read_mb_per_s MB/s at
+        most (an SD card, 0 for no limit), and checks that the TCU received
+        the whole program in order. synth writes a random program of the size
+        given in the model, for the models of the repo without their .tprog.
+    */
+    if (argc < 2) {
+        printf("Usage: %s <model.tmodel> [window_kb] [instructions_per_s] [read_mb_per_s] [n_runs]\n", argv[0]);
+        printf("       %s synth <model.tmodel>\n", argv[0]);
+        return 1;
+    }
+    bool synth = strcmp(argv[1], "synth") == 0;
+    const char* model_path = argv[synth ? 2 : 1];
+    TensilModel model;
+    if (model_path == NULL || tensil_load_model(model_path, &model) != 0) {
+        return 1;
+    }
+    int instruction_size = tensil_instruction_size(&model.arch);
+    string prog_path = program_path(model_path, model);
+    printf("[INFO] Model %s: %.1f MB of program, %llu instructions of %d bytes\n", model.name, model.prog_size / 1e6,
+           (unsigned long long)(model.prog_size / instruction_size), instruction_size);
+
+    if (synth) {
+        FILE* existing = fopen(prog_path.c_str(), "rb");
+        if (existing != NULL) {
+            fclose(existing);
+            fprintf(stderr, "[ERROR] %s already exists\n", prog_path.c_str());
+            return 1;
+        }
+        FILE* file = fopen(prog_path.c_str(), "wb");
+        if (file == NULL) {
+            fprintf(stderr, "[ERROR] Failed to open %s\n", prog_path.c_str());
+            return 1;
+        }
+        mt19937_64 rng(1);
+        vector<uint64_t> block(1 << 17);
+        for (uint64_t written = 0; written < model.prog_size;) {
+            for (auto& v : block) {
+                v = rng();
+            }
+            size_t n = min((uint64_t)block.size() * 8, model.prog_size - written);
+            fwrite(block.data(), 1, n, file);
+            written += n;
+        }
+        fclose(file);
+        printf("[SUCCESS] Random program written to %s\n", prog_path.c_str());
+        return 0;
+    }
+
+    size_t window_size = (size_t)(argc > 2 ? atof(argv[2]) : 1024) * 1024;
+    double rate = argc > 3 ? atof(argv[3]) : 5e6;
+    double read_rate = argc > 4 ? atof(argv[4]) * 1e6 : 0;
+    int n_runs = argc > 5 ? atoi(argv[5]) : 1;
+    FILE* file = fopen(prog_path.c_str(), "rb");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Failed to open %s (run synth to make a random one)\n", prog_path.c_str());
+        return 1;
+    }
+    if (rate <= 0 || n_runs <= 0) {
+        fprintf(stderr, "[ERROR] Invalid rate or number of runs\n");
+        return 1;
+    }
+
+    // Reference: the hash of the whole file
+    vector<uint8_t> block(4 << 20);
+    uint64_t expected = 0xCBF29CE484222325ULL;
+    size_t n;
+    while ((n = fread(block.data(), 1, block.size(), file)) > 0) {
+        expected = hash_update(expected, block.data(), n);
+    }
+
+    vector<uint8_t> window(window_size);
+    ThrottledSource source(file, read_rate);
+    for (int r = 0; r < n_runs; r++) {
+        SimulatedTcu tcu(rate, instruction_size);
+        TprogStreamer streamer(source, tcu, instruction_size, window.data(), window.size());
+        if (r == 0) {
+            printf("[INFO] Window of %zu KB: 2 chunks of %zu bytes, %.2f%% of the program\n", window_size / 1024,
+                   streamer.chunk_size(), 100.0 * window_size / model.prog_size);
+        }
+        auto start = steady_clock::now();
+        if (streamer.run(model.prog_size) != 0) {
+            return 1;
+        }
+        double seconds = duration<double>(steady_clock::now() - start).count();
+        const TprogStreamStats& s = streamer.stats();
+        double tcu_seconds = model.prog_size / instruction_size / rate;
+        printf("[INFO] Run %d: %.3f s for %.3f s of TCU, %llu chunks, %llu stalls, TCU idle %.3f s, "
+               "reading %.3f s, waiting for the TCU %.3f s\n",
+               r, seconds, tcu_seconds, (unsigned long long)s.chunks, (unsigned long long)s.stalls,
+               duration<double>(tcu.idle).count(), s.read_seconds, s.wait_seconds);
+        if (s.bytes != model.prog_size || tcu.hash != expected) {
+            fprintf(stderr, "[ERROR] The TCU did not receive the program in order\n");
+            return 1;
+        }
+    }
+    fclose(file);
+    printf("[SUCCESS] Whole program received in order\n");
+    return 0;
+}
@@ -0,0 +1,130 @@
+"""
+Describe the layers of an ONNX model for the TCU performance simulator (systems/tcu/tcu_perf_sim)
+Layers are grouped like the Tensil compiler does: a convolution with its batch norm, activation,
+residual addition and max pooling is one layer, the residual addition going to the last
+convolution of the two branches.
+Save :
+    - layer file (.layers), one layer per line
+"""
+
+import argparse
+import sys
+
+import onnx
+from onnx import helper, shape_inference
+
+
+def tensor_shapes(model):
+    """
+    Shapes of the tensors of the graph, after shape inference
+    Args :
+        - model (onnx.ModelProto) : the model
+    """
+    shapes = {}
+    graph = model.graph
+    for value in list(graph.input) + list(graph.value_info) + list(graph.output):
+        dims = value.type.tensor_type.shape.dim
+        shapes[value.name] = [d.dim_value for d in dims]
+    for initializer in graph.initializer:
+        shapes[initializer.name] = list(initializer.dims)
+    return shapes
+
+
+def attributes(node):
+    return {attr.name: helper.get_attribute_value(attr) for attr in node.attribute}
+
+
+def layer_name(node, index):
+    name = node.name if node.name else node.op_type + "_" + str(index)
+    return name.replace(" ", "_").replace("/", ".").strip(".")
+
+
+def onnx_to_layers(model):
+    """
+    Walk the nodes in order and fuse them into the layers of the simulator
+    Args :
+        - model (onnx.ModelProto) : the model
+    Returns :
+        - list of dict, one per layer
+    """
+    model = shape_inference.infer_shapes(model)
+    shapes = tensor_shapes(model)
+    initializers = {initializer.name for initializer in model.graph.initializer}
+    layers = []
+    producer = {}   # Tensor -> index of the layer that computes it
+
+    for index, node in enumerate(model.graph.node):
+        attrs = attributes(node)
+        inputs = [name for name in node.input if name and name not in initializers]
+        op = node.op_type
+
+        if op == "Conv":
+            if attrs.get("group", 1) != 1:
+                sys.exit("Grouped convolution " + node.name + " is not supported by the TCU")
+            n, c, h, w = shapes[node.input[0]]
+            kernel = attrs.get("kernel_shape", shapes[node.input[1]][2:])
+            layers.append({"type": "conv", "name": layer_name(node, index), "input": (h, w, c),
+                           "output": shapes[node.input[1]][0], "kernel": kernel[0],
+                           "stride": attrs.get("strides", [1, 1])[0], "pad": attrs.get("pads", [0, 0, 0, 0])[0]})
+            producer[node.output[0]] = len(layers) - 1
+        elif op in ("Gemm", "MatMul"):
+            weights = shapes[node.input[1]]
+            transposed = op == "Gemm" and attrs.get("transB", 0)
+            layers.append({"type": "fc", "name": layer_name(node, index),
+                           "input": weights[1] if transposed else weights[0],
+                           "output": weights[0] if transposed else weights[1]})
+            producer[node.output[0]] = len(layers) - 1
+        elif op == "GlobalAveragePool" or (op == "AveragePool" and shapes[node.output[0]][2:] == [1, 1]):
+            n, c, h, w = shapes[node.input[0]]
+            layers.append({"type": "avgpool", "name": layer_name(node, index), "input": (h, w, c)})
+            producer[node.output[0]] = len(layers) - 1
+        elif op == "Add" and len(inputs) == 2 and all(name in producer for name in inputs):
+            # The residual is added to the result of the convolution computed last
+            layer = max(producer[name] for name in inputs)
+            layers[layer]["add"] = True
+            producer[node.output[0]] = layer
+        elif op in ("BatchNormalization", "Relu", "MaxPool", "Flatten", "Reshape", "Identity") and inputs[0] in producer:
+            layer = producer[inputs[0]]
+            if op == "Relu":
+                layers[layer]["relu"] = True
+            elif op == "MaxPool":
+                layers[layer]["maxpool"] = (attrs["kernel_shape"][0], attrs.get("strides", [1, 1])[0],
+                                            attrs.get("pads", [0, 0, 0, 0])[0])
+            producer[node.output[0]] = layer
+        elif inputs and inputs[0] in producer:
+            print("[WARNING] " + op + " " + node.name + " is not modeled, ignored")
+            producer[node.output[0]] = producer[inputs[0]]
+    return layers
+
+
+def format_layer(layer):
+    if layer["type"] == "fc":
+        return "fc name={} input={} output={}".format(layer["name"], layer["input"], layer["output"])
+    h, w, c = layer["input"]
+    if layer["type"] == "avgpool":
+        return "avgpool name={} input={}x{}x{}".format(layer["name"], h, w, c)
+    line = "conv name={} input={}x{}x{} output={} kernel={} stride={} pad={}".format(
+        layer["name"], h, w, c, layer["output"], layer["kernel"], layer["stride"], layer["pad"])
+    if layer.get("relu"):
+        line += " relu"
+    if layer.get("add"):
+        line += " add"
+    if "maxpool" in layer:
+        line += " maxpool={},{},{}".format(*layer["maxpool"])
+    return line
+
+
+if __name__ == "__main__":
+    # Parse arguments
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--onnx", "-o", type=str, required=True, help="Path to the ONNX model")
+    parser.add_argument("--output", "-d", type=str, default="", help="Path of the layer file. Default: <model>.layers")
+    args = parser.parse_args()
+
+    layers = onnx_to_layers(onnx.load(args.onnx))
+    output = args.output if args.output else args.onnx.rsplit(".", 1)[0] + ".layers"
+    with open(output, "w") as f:
+        f.write("# " + args.onnx.split("/")[-1] + "\n")
+        for layer in layers:
+            f.write(format_layer(layer) + "\n")
+    print("{} layers written to {}".format(len(layers), output))